@@ -2,4 +2,7 @@
   native <methods>; # either whole class must be gone or all native methods must be present to prevent failed linking
 }
 -keep class com.darkyen.sqlitelite.SQLiteInterruptedException # created from native code
+-keepclassmembers class * extends com.darkyen.sqlitelite.SQLiteDelegate {
+  public void onConfigure(com.darkyen.sqlitelite.SQLiteConnection); # looked up by name to detect overrides
+}
 -keepattributes Exceptions,InnerClasses
@@ -3,6 +3,9 @@ package com.darkyen.sqlitelite;
 import android.database.Cursor;
 import android.database.sqlite.SQLiteDatabase;
 import android.database.sqlite.SQLiteStatement;
+import android.system.ErrnoException;
+import android.system.Os;
+import androidx.test.core.app.ApplicationProvider;
 import androidx.test.ext.junit.runners.AndroidJUnit4;
 import androidx.test.filters.Suppress;
 import io.requery.android.database.sqlite.SQLiteCursor;
@@ -12,6 +15,8 @@ import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
 
+import java.io.File;
+import java.util.Arrays;
 import java.util.Random;
 import java.util.function.IntConsumer;
 
@@ -384,6 +389,233 @@ public class DatabaseBenchmarkTest {
          */
     }
 
+    @Test
+    public void downsampleBenchmark() {
+        final int roundCycles = 2;
+        final int entries = 500_000;
+        final int points = 1000;
+
+        mDatabaseLight.command("CREATE TABLE Samples (Time INTEGER PRIMARY KEY, Value REAL)");
+        mDatabaseLight.beginTransactionExclusive();
+        try (com.darkyen.sqlitelite.SQLiteStatement statement = mDatabaseLight.statement("INSERT INTO Samples (Time, Value) VALUES (?, ?)")) {
+            final Random random = new Random(1);
+            for (int i = 0; i < entries; i++) {
+                statement.bind(1, i * 100L);
+                statement.bind(2, Math.sin(i / 5000.0) + random.nextGaussian() * 0.1);
+                statement.executeForNothing();
+            }
+            mDatabaseLight.setTransactionSuccessful();
+        } finally {
+            mDatabaseLight.endTransaction();
+        }
+
+        final double java = measureThroughput(roundCycles, () -> {}, () -> {}, (cycle) -> {
+            final double[] x = new double[entries];
+            final double[] y = new double[entries];
+            int count = 0;
+            try (com.darkyen.sqlitelite.SQLiteStatement cursor = mDatabaseLight.statement("SELECT Time, Value FROM Samples ORDER BY Time")) {
+                while (cursor.cursorNextRow()) {
+                    x[count] = cursor.cursorGetLong(0);
+                    y[count] = cursor.cursorGetDouble(1);
+                    count++;
+                }
+            }
+            Assert.assertEquals(points * 2, lttb(x, y, count, points).length);
+        });
+
+        final double nativeLttb = measureThroughput(roundCycles, () -> {}, () -> {}, (cycle) -> {
+            try (com.darkyen.sqlitelite.SQLiteStatement cursor = mDatabaseLight.statement("SELECT lttb(Time, Value, ?) FROM Samples")) {
+                cursor.bind(1, points);
+                assertTrue(cursor.cursorNextRow());
+                Assert.assertEquals(points * 2, cursor.cursorGetDoubles(0, new double[points * 2]));
+            }
+        });
+        mDatabaseLight.command("DROP TABLE Samples");
+
+        System.out.println("DOWNSAMPLE BENCHMARK RESULTS");
+        System.out.printf("%10s: %10.2f charts/second%n", "Java", java);
+        System.out.printf("%10s: %10.2f charts/second%n", "Native", nativeLttb);
+    }
+
+    @Test
+    public void sortWideRowsBenchmark() {
+        final int roundCycles = 2;
+        final int entries = 50_000;
+        final byte[] blob = new byte[800];
+        new Random().nextBytes(blob);
+
+        // Global configuration can change only when no connection is open
+        mDatabaseLight.close();
+        final File file = new File(ApplicationProvider.getApplicationContext().getCacheDir(), "sort_benchmark.db");
+        SQLiteDatabase.deleteDatabase(file);
+
+        final int[] sorterReferenceSizes = {Integer.MAX_VALUE, 16};
+        final double[] sortAll = new double[sorterReferenceSizes.length];
+        final double[] sortTop = new double[sorterReferenceSizes.length];
+        final long[] sortAllMemory = new long[sorterReferenceSizes.length];
+        final long[] sortTopMemory = new long[sorterReferenceSizes.length];
+        for (int setting = 0; setting < sorterReferenceSizes.length; setting++) {
+            SQLiteConnection.setSorterReferenceSize(sorterReferenceSizes[setting]);
+            SQLiteConnection.setMemoryStatistics(true);
+            try (SQLiteConnection db = SQLiteConnection.open(file.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE | SQLiteConnection.SQLITE_OPEN_CREATE)) {
+                db.pragma("PRAGMA journal_mode=OFF");
+                db.pragma("PRAGMA synchronous=0");
+                if (setting == 0) {
+                    db.command("CREATE TABLE Benchmark (Id INTEGER PRIMARY KEY, Name TEXT, Data BLOB)");
+                    db.beginTransactionExclusive();
+                    try (com.darkyen.sqlitelite.SQLiteStatement statement = db.statement("INSERT INTO Benchmark (Name, Data) VALUES (?, ?)")) {
+                        final Random random = new Random(1);
+                        for (int i = 0; i < entries; i++) {
+                            statement.bind(1, "Name " + random.nextInt());
+                            statement.bind(2, blob);
+                            statement.executeForNothing();
+                        }
+                        db.setTransactionSuccessful();
+                    } finally {
+                        db.endTransaction();
+                    }
+                }
+
+                final long baseline = SQLiteConnection.memoryUsed();
+                SQLiteConnection.memoryHighwater(true);
+                sortAll[setting] = measureThroughput(roundCycles, () -> {}, () -> {}, (cycle) -> {
+                    try (com.darkyen.sqlitelite.SQLiteStatement cursor = db.statement("SELECT Id, Name, Data FROM Benchmark ORDER BY Name")) {
+                        int rows = 0;
+                        while (cursor.cursorNextRow()) {
+                            rows += cursor.cursorGetBlob(2).length == blob.length ? 1 : 0;
+                        }
+                        assertEquals(entries, rows);
+                    }
+                });
+                sortAllMemory[setting] = SQLiteConnection.memoryHighwater(true) - baseline;
+
+                sortTop[setting] = measureThroughput(roundCycles * 50, () -> {}, () -> {}, (cycle) -> {
+                    try (com.darkyen.sqlitelite.SQLiteStatement cursor = db.statement("SELECT Id, Name, Data FROM Benchmark ORDER BY Name LIMIT 100")) {
+                        int rows = 0;
+                        while (cursor.cursorNextRow()) {
+                            rows += cursor.cursorGetBlob(2).length == blob.length ? 1 : 0;
+                        }
+                        assertEquals(100, rows);
+                    }
+                });
+                sortTopMemory[setting] = SQLiteConnection.memoryHighwater(true) - baseline;
+            }
+        }
+        SQLiteConnection.setSorterReferenceSize(Integer.MAX_VALUE);
+        SQLiteConnection.setMemoryStatistics(false);
+        SQLiteDatabase.deleteDatabase(file);
+
+        System.out.println("SORT WIDE ROWS BENCHMARK RESULTS");
+        for (int setting = 0; setting < sorterReferenceSizes.length; setting++) {
+            final String name = sorterReferenceSizes[setting] == Integer.MAX_VALUE ? "Copied" : "References";
+            System.out.printf("%10s: %10.2f full sorts/second, peak %d KiB%n", name, sortAll[setting], sortAllMemory[setting] / 1024);
+            System.out.printf("%10s: %10.2f top 100 sorts/second, peak %d KiB%n", name, sortTop[setting], sortTopMemory[setting] / 1024);
+        }
+    }
+
+    @Test
+    public void fileGrowthBenchmark() throws ErrnoException {
+        final int commits = 20_000;
+        final int keptRows = 5_000;
+        final byte[] blob = new byte[1000];
+        new Random(1).nextBytes(blob);
+        final File file = new File(ApplicationProvider.getApplicationContext().getCacheDir(), "growth_benchmark.db");
+        final String walPath = file.getPath() + "-wal";
+
+        final String[] names = {"Pages", "Chunks"};
+        final int[] chunkSizes = {0, 4 * 1024 * 1024};
+        final int[] walSizes = {0, 8 * 1024 * 1024};
+        final long[][] latencies = new long[names.length][commits];
+        final long[][] fileSizes = new long[names.length][];
+        final long[][] walFileSizes = new long[names.length][];
+        for (int setting = 0; setting < names.length; setting++) {
+            SQLiteDatabase.deleteDatabase(file);
+            final int chunkSize = chunkSizes[setting];
+            final int walSize = walSizes[setting];
+            try (SQLiteConnection db = SQLiteConnection.open(new SQLiteDelegate(file) {
+                {
+                    fileChunkSize = chunkSize;
+                    walPreallocateSize = walSize;
+                }
+
+                @Override
+                public void onCreate(SQLiteConnection db) {}
+            })) {
+                db.command("CREATE TABLE Benchmark (Id INTEGER PRIMARY KEY, Data BLOB)");
+                // Rows are added and old ones deleted, so the file grows and (with auto vacuum) shrinks
+                try (com.darkyen.sqlitelite.SQLiteStatement insert = db.statement("INSERT INTO Benchmark (Data) VALUES (?)");
+                     com.darkyen.sqlitelite.SQLiteStatement delete = db.statement("DELETE FROM Benchmark WHERE Id <= ?")) {
+                    for (int i = 0; i < commits; i++) {
+                        final long start = System.nanoTime();
+                        db.beginTransactionExclusive();
+                        try {
+                            insert.bind(1, blob);
+                            insert.executeForNothing();
+                            if (i % 100 == 99) {
+                                delete.bind(1, i - keptRows);
+                                delete.executeForNothing();
+                            }
+                            db.setTransactionSuccessful();
+                        } finally {
+                            db.endTransaction();
+                        }
+                        latencies[setting][i] = System.nanoTime() - start;
+                    }
+                }
+                fileSizes[setting] = new long[]{Os.stat(file.getPath()).st_size, Os.stat(file.getPath()).st_blocks * 512};
+                walFileSizes[setting] = new long[]{Os.stat(walPath).st_size, Os.stat(walPath).st_blocks * 512};
+            }
+        }
+        SQLiteDatabase.deleteDatabase(file);
+
+        System.out.println("FILE GROWTH BENCHMARK RESULTS");
+        for (int setting = 0; setting < names.length; setting++) {
+            final long[] latency = latencies[setting];
+            Arrays.sort(latency);
+            System.out.printf("%10s: commit p50 %d us, p99 %d us, max %d us%n", names[setting],
+                    latency[commits / 2] / 1000, latency[commits * 99 / 100] / 1000, latency[commits - 1] / 1000);
+            System.out.printf("%10s: database %d KiB (%d KiB allocated), WAL %d KiB (%d KiB allocated)%n", names[setting],
+                    fileSizes[setting][0] / 1024, fileSizes[setting][1] / 1024,
+                    walFileSizes[setting][0] / 1024, walFileSizes[setting][1] / 1024);
+        }
+    }
+
+    /** Java implementation of the lttb() SQL function, for comparison. */
+    private static double[] lttb(double[] x, double[] y, int count, int threshold) {
+        final double[] result = new double[threshold * 2];
+        final double bucketSize = (double) (count - 2) / (threshold - 2);
+        int selected = 0;
+        result[0] = x[0];
+        result[1] = y[0];
+        for (int bucket = 0; bucket < threshold - 2; bucket++) {
+            final int nextStart = (int) ((bucket + 1) * bucketSize) + 1;
+            final int nextEnd = Math.min((int) ((bucket + 2) * bucketSize) + 1, count);
+            double averageX = 0, averageY = 0;
+            for (int i = nextStart; i < nextEnd; i++) {
+                averageX += x[i];
+                averageY += y[i];
+            }
+            averageX /= nextEnd - nextStart;
+            averageY /= nextEnd - nextStart;
+
+            double maxArea = -1;
+            int maxIndex = 0;
+            for (int i = (int) (bucket * bucketSize) + 1; i < nextStart; i++) {
+                final double area = Math.abs((x[selected] - averageX) * (y[i] - y[selected]) - (x[selected] - x[i]) * (averageY - y[selected]));
+                if (area > maxArea) {
+                    maxArea = area;
+                    maxIndex = i;
+                }
+            }
+            result[bucket * 2 + 2] = x[maxIndex];
+            result[bucket * 2 + 3] = y[maxIndex];
+            selected = maxIndex;
+        }
+        result[threshold * 2 - 2] = x[count - 1];
+        result[threshold * 2 - 1] = y[count - 1];
+        return result;
+    }
+
     /**
      * Run operation many times to measure how fast it is.
      * @return how many times per second operation can run
@@ -297,4 +297,88 @@ public class DatabaseMigrationTest {
             }
         }
     }
+
+    @Test
+    public void configuredOpen() {
+        final SQLiteDelegate delegate = new SQLiteDelegate(mDatabaseFile) {
+            {
+                version = 3;
+                foreignKeyConstraintsEnabled = true;
+            }
+            @Override
+            public void onCreate(SQLiteConnection db) {
+                assertEquals("1", db.pragma("PRAGMA foreign_keys"));
+                assertEquals("wal", db.pragma("PRAGMA journal_mode"));
+            }
+
+            @Override
+            public void onUpgrade(SQLiteConnection db, int oldVersion, int newVersion) {
+                fail("Not expected onUpgade("+oldVersion+", "+newVersion+")");
+            }
+        };
+        try (SQLiteConnection db = SQLiteConnection.open(delegate)) {
+            assertEquals("3", db.pragma("PRAGMA user_version"));
+        }
+        // Reopened with the version read during the open
+        try (SQLiteConnection db = SQLiteConnection.open(delegate)) {
+            assertEquals("1", db.pragma("PRAGMA foreign_keys"));
+        }
+
+        final SQLiteDelegate rollbackDelegate = new SQLiteDelegate(mDatabaseFile) {
+            {
+                version = 3;
+                writeAheadLoggingEnabled = false;
+            }
+            @Override
+            public void onCreate(SQLiteConnection db) {
+                fail("Not expected onCreate()");
+            }
+        };
+        try (SQLiteConnection db = SQLiteConnection.open(rollbackDelegate)) {
+            assertEquals("0", db.pragma("PRAGMA foreign_keys"));
+            // WAL mode is persistent
+            assertEquals("wal", db.pragma("PRAGMA journal_mode"));
+            assertEquals("delete", db.pragma("PRAGMA journal_mode=DELETE"));
+        }
+        try (SQLiteConnection db = SQLiteConnection.open(rollbackDelegate)) {
+            assertEquals("delete", db.pragma("PRAGMA journal_mode"));
+        }
+    }
+
+    @Test
+    public void overriddenConfigure() {
+        final SQLiteDelegate delegate = new SQLiteDelegate(mDatabaseFile) {
+            {
+                foreignKeyConstraintsEnabled = true;
+            }
+            @Override
+            public void onConfigure(SQLiteConnection db) {
+                // Without super, nothing is set up
+                assertEquals("0", db.pragma("PRAGMA foreign_keys"));
+                assertEquals("delete", db.pragma("PRAGMA journal_mode"));
+            }
+            @Override
+            public void onCreate(SQLiteConnection db) {}
+        };
+        try (SQLiteConnection db = SQLiteConnection.open(delegate)) {
+            assertEquals("delete", db.pragma("PRAGMA journal_mode"));
+        }
+
+        final SQLiteDelegate superDelegate = new SQLiteDelegate(mDatabaseFile) {
+            {
+                foreignKeyConstraintsEnabled = true;
+            }
+            @Override
+            public void onConfigure(SQLiteConnection db) {
+                super.onConfigure(db);
+                assertEquals("1", db.pragma("PRAGMA foreign_keys"));
+                assertEquals("wal", db.pragma("PRAGMA journal_mode"));
+            }
+            @Override
+            public void onCreate(SQLiteConnection db) {}
+        };
+        try (SQLiteConnection db = SQLiteConnection.open(superDelegate)) {
+            assertEquals("wal", db.pragma("PRAGMA journal_mode"));
+        }
+    }
 }
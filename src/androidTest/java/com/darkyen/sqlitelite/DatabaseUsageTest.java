@@ -1,21 +1,48 @@
 package com.darkyen.sqlitelite;
 
 import android.content.Context;
+import android.content.Intent;
+import android.database.Cursor;
 import android.database.sqlite.SQLiteDatabase;
+import android.database.sqlite.SQLiteException;
+import android.os.Bundle;
+import android.os.Handler;
+import android.os.HandlerThread;
+import android.os.Message;
+import android.os.Messenger;
+import android.os.ParcelFileDescriptor;
+import android.os.Process;
 import androidx.test.core.app.ApplicationProvider;
 import androidx.test.ext.junit.runners.AndroidJUnit4;
+import androidx.test.rule.ServiceTestRule;
 import org.junit.After;
 import org.junit.Before;
+import org.junit.Rule;
 import org.junit.Test;
 import org.junit.runner.RunWith;
 
 import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Random;
+import java.util.concurrent.Executor;
+import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.TimeUnit;
 
 import static org.junit.Assert.assertArrayEquals;
 import static org.junit.Assert.assertEquals;
 import static org.junit.Assert.assertFalse;
+import static org.junit.Assert.assertNotEquals;
+import static org.junit.Assert.assertNotNull;
 import static org.junit.Assert.assertNull;
+import static org.junit.Assert.assertSame;
 import static org.junit.Assert.assertThrows;
 import static org.junit.Assert.assertTrue;
 
@@ -25,6 +52,9 @@ public class DatabaseUsageTest {
     private File mDatabaseFile;
     private SQLiteConnection mDatabase;
 
+    @Rule
+    public final ServiceTestRule mServiceRule = new ServiceTestRule();
+
     @Before
     public void setUp() {
         File dbDir = ApplicationProvider.getApplicationContext().getDir(this.getClass().getName(), Context.MODE_PRIVATE);
@@ -157,6 +187,48 @@ public class DatabaseUsageTest {
         }
     }
 
+    @Test
+    public void primitiveArrays() {
+        mDatabase.command("CREATE TABLE Arrays (Ints, Longs, Floats, Doubles)");
+        final int[] ints = {1, -2, Integer.MAX_VALUE};
+        final long[] longs = {Long.MIN_VALUE, 0L};
+        final float[] floats = {1.5f, -0f, Float.NaN, 3f};
+        final double[] doubles = {};
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Arrays VALUES (?, ?, ?, ?)")) {
+            statement.bind(1, ints);
+            statement.bind(2, longs);
+            statement.bind(3, floats);
+            statement.bind(4, doubles);
+            statement.executeForNothing();
+            statement.bind(1, (int[]) null);
+            statement.executeForNothing();
+        }
+        try (SQLiteStatement statement = mDatabase.statement("SELECT hex(Ints) FROM Arrays WHERE rowid = 1")) {
+            assertEquals("01000000FEFFFFFFFFFFFF7F", statement.executeForString());
+        }
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Ints, Longs, Floats, Doubles FROM Arrays ORDER BY rowid")) {
+            assertTrue(statement.cursorNextRow());
+            final int[] intsOut = new int[3];
+            assertEquals(3, statement.cursorGetInts(0, intsOut));
+            assertArrayEquals(ints, intsOut);
+            final long[] longsOut = new long[2];
+            assertEquals(2, statement.cursorGetLongs(1, longsOut));
+            assertArrayEquals(longs, longsOut);
+            final float[] floatsOut = new float[2];
+            assertEquals(4, statement.cursorGetFloats(2, floatsOut));
+            assertArrayEquals(new float[]{1.5f, -0f}, floatsOut, 0f);
+            assertEquals(0, statement.cursorGetDoubles(3, new double[1]));
+            assertThrows(SQLiteException.class, () -> statement.cursorGetLongs(0, new long[2]));
+            //noinspection DataFlowIssue
+            assertThrows(IllegalArgumentException.class, () -> statement.cursorGetFloats(2, null));
+
+            assertTrue(statement.cursorNextRow());
+            assertEquals(-1, statement.cursorGetInts(0, intsOut));
+            assertFalse(statement.cursorNextRow());
+        }
+    }
+
     @Test
     public void executeForLastInsertedRowIDAndChangedRows() {
         mDatabase.command("CREATE TABLE Testing (Key, Value)");
@@ -311,4 +383,979 @@ public class DatabaseUsageTest {
             assertEquals("value", s.cursorGetString(0));
         }
     }
+
+    @Test
+    public void columnarTable() {
+        mDatabase.command("CREATE TABLE Items (Id INTEGER PRIMARY KEY, Name TEXT)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Items (Id, Name) VALUES (?, ?)")) {
+            for (int i = 0; i < 100; i++) {
+                statement.bind(1, i);
+                statement.bind(2, "Item" + i);
+                statement.executeForNothing();
+            }
+        }
+
+        final long[] ids = {3, 5, 5, 40, 99, 1000};
+        final float[] scores = {0.5f, 1f, 1.5f, 2f, 2.5f, 3f};
+        final ByteBuffer ranks = ByteBuffer.allocateDirect(6 * 4).order(ByteOrder.LITTLE_ENDIAN);
+        for (int i = 0; i < 6; i++) ranks.putInt(i * 4, 6 - i);
+
+        try (SQLiteColumnarTable table = SQLiteColumnarTable.builder("Scores", ids.length)
+                .sortedKey("Id", ids)
+                .column("Score", scores)
+                .column("Rank", ranks, SQLiteColumnarTable.TYPE_INT32)
+                .register(mDatabase)) {
+            assertEquals("Scores", table.name());
+            assertEquals(6, queryLong("SELECT count(*) FROM Scores"));
+            assertEquals(2, queryLong("SELECT count(*) FROM Scores WHERE Id = 5"));
+            assertEquals(4, queryLong("SELECT count(*) FROM Scores WHERE Id > 3 AND Id <= 99"));
+            assertEquals(2, queryLong("SELECT count(*) FROM Scores WHERE Id IN (3, 40, 41)"));
+            assertEquals(1, queryLong("SELECT count(*) FROM Scores WHERE Id = '40'"));
+            assertEquals(40, queryLong("SELECT Id FROM Scores WHERE rowid = 3"));
+            assertEquals(6, queryLong("SELECT Rank FROM Scores ORDER BY Id LIMIT 1"));
+
+            try (SQLiteStatement statement = mDatabase.statement("SELECT Items.Name, Scores.Score FROM Items JOIN Scores ON Scores.Id = Items.Id ORDER BY Scores.Score")) {
+                final StringBuilder result = new StringBuilder();
+                while (statement.cursorNextRow()) {
+                    result.append(statement.cursorGetString(0)).append('=').append(statement.cursorGetDouble(1)).append(' ');
+                }
+                assertEquals("Item3=0.5 Item5=1.0 Item5=1.5 Item40=2.0 Item99=2.5 ", result.toString());
+            }
+
+            // Direct buffers are read in place
+            ranks.putInt(0, 100);
+            assertEquals(100, queryLong("SELECT Rank FROM Scores WHERE Id = 3"));
+            // Arrays are copied
+            scores[0] = 100f;
+            assertEquals(0.5, queryDouble("SELECT Score FROM Scores WHERE Id = 3"), 0.0);
+
+            assertThrows(SQLiteException.class, () -> mDatabase.command("INSERT INTO Scores (Id) VALUES (1)"));
+
+            // Names of modules are not replaced
+            assertThrows(SQLiteException.class, () -> SQLiteColumnarTable.builder("scores", 1).column("Id", new int[1]).register(mDatabase));
+            assertThrows(SQLiteException.class, () -> SQLiteColumnarTable.builder("json_each", 1).column("Id", new int[1]).register(mDatabase));
+            assertThrows(SQLiteException.class, () -> SQLiteColumnarTable.builder("pragma_table_info", 1).column("Id", new int[1]).register(mDatabase));
+            assertEquals(6, queryLong("SELECT count(*) FROM Scores"));
+        }
+        assertEquals(1, queryLong("SELECT count(*) FROM json_each('[1]')"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT count(*) FROM Scores"));
+
+        assertThrows(IllegalArgumentException.class, () -> SQLiteColumnarTable.builder("Short", 10).column("Values", new int[5]));
+        assertThrows(IllegalArgumentException.class, () -> SQLiteColumnarTable.builder("Heap", 1).column("Values", ByteBuffer.allocate(8), SQLiteColumnarTable.TYPE_INT64));
+    }
+
+    @Test
+    public void aggregateTable() {
+        mDatabase.command("CREATE TABLE Orders (Id INTEGER PRIMARY KEY, Status TEXT, Price INTEGER)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Orders (Status, Price) VALUES (?, ?)")) {
+            for (int i = 0; i < 1000; i++) {
+                statement.bind(1, i % 10 == 0 ? null : i % 3 == 0 ? "paid" : "new");
+                statement.bind(2, i);
+                statement.executeForNothing();
+            }
+        }
+
+        final SQLiteAggregateTable stats = new SQLiteAggregateTable("OrderStats", "Orders", "Status")
+                .count("Orders")
+                .sum("Revenue", "Price");
+        stats.create(mDatabase);
+        assertTrue(stats.verify(mDatabase));
+        assertEquals(100, queryLong("SELECT Orders FROM OrderStats WHERE Status IS NULL"));
+        assertEquals(queryLong("SELECT sum(Price) FROM Orders WHERE Status = 'paid'"), queryLong("SELECT Revenue FROM OrderStats WHERE Status = 'paid'"));
+
+        mDatabase.command("INSERT INTO Orders (Status, Price) VALUES ('refunded', NULL)");
+        mDatabase.command("UPDATE Orders SET Status = 'paid' WHERE Status = 'new' AND Id % 7 = 0");
+        mDatabase.command("UPDATE Orders SET Price = Price * 2 WHERE Id < 50");
+        mDatabase.command("DELETE FROM Orders WHERE Status IS NULL");
+        assertTrue(stats.verify(mDatabase));
+        assertEquals(0, queryLong("SELECT count(*) FROM OrderStats WHERE Status IS NULL"));
+        assertEquals(0, queryLong("SELECT Revenue FROM OrderStats WHERE Status = 'refunded'"));
+
+        mDatabase.command("DROP TRIGGER OrderStats_delete");
+        mDatabase.command("DELETE FROM Orders WHERE Status = 'refunded'");
+        assertFalse(stats.verify(mDatabase));
+        stats.rebuild(mDatabase);
+        assertTrue(stats.verify(mDatabase));
+        assertEquals(2, queryLong("SELECT count(*) FROM OrderStats"));
+
+        stats.drop(mDatabase);
+        assertEquals(0, queryLong("SELECT count(*) FROM sqlite_schema WHERE name LIKE 'OrderStats%'"));
+    }
+
+    @Test
+    public void sharedMemoryRows() throws IOException {
+        mDatabase.command("CREATE TABLE Rows (Id INTEGER PRIMARY KEY, Name TEXT, Score REAL, Data BLOB)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Rows (Name, Score, Data) VALUES (?, ?, ?)")) {
+            for (int i = 0; i < 10000; i++) {
+                statement.bind(1, i % 5 == 0 ? null : "Row \u00e9" + i);
+                statement.bind(2, i / 4.0);
+                statement.bind(3, new byte[i % 7]);
+                statement.executeForNothing();
+            }
+        }
+
+        final ParcelFileDescriptor fd;
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Id, Name, Score, Data FROM Rows WHERE Id > ? ORDER BY Id")) {
+            statement.bind(1, 100);
+            fd = statement.executeForSharedMemory();
+        }
+        // Sealed
+        assertThrows(IOException.class, () -> new FileOutputStream(fd.getFileDescriptor()).write(1));
+
+        try (SQLiteRowReader reader = SQLiteRowReader.map(fd)) {
+            fd.close();
+            assertTrue(reader.serialized().isReadOnly());
+            assertEquals(4, reader.getColumnCount());
+            assertEquals("Score", reader.getColumnName(2));
+            assertEquals(9900, reader.getRowCount());
+
+            int rows = 0;
+            while (reader.moveToNext()) {
+                final long id = reader.getLong(0);
+                assertEquals(101 + rows, id);
+                if ((id - 1) % 5 == 0) {
+                    assertTrue(reader.isNull(1));
+                    assertNull(reader.getString(1));
+                } else {
+                    assertEquals(Cursor.FIELD_TYPE_STRING, reader.getType(1));
+                    assertEquals("Row \u00e9" + (id - 1), reader.getString(1));
+                }
+                assertEquals((id - 1) / 4.0, reader.getDouble(2), 0.0);
+                assertEquals(Cursor.FIELD_TYPE_BLOB, reader.getType(3));
+                //noinspection DataFlowIssue
+                assertEquals((id - 1) % 7, reader.getBlob(3).length);
+                rows++;
+            }
+            assertEquals(9900, rows);
+
+            assertTrue(reader.moveToPosition(899));
+            assertEquals(1000, reader.getLong(0));
+            assertEquals("1000", reader.getString(0));
+            assertThrows(IllegalStateException.class, () -> reader.getLong(3));
+            assertFalse(reader.moveToPosition(9900));
+            assertThrows(IllegalStateException.class, () -> reader.getLong(0));
+        }
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT * FROM Rows WHERE 0");
+             ParcelFileDescriptor empty = statement.executeForSharedMemory();
+             SQLiteRowReader reader = SQLiteRowReader.map(empty)) {
+            assertEquals(4, reader.getColumnCount());
+            assertEquals(0, reader.getRowCount());
+            assertFalse(reader.moveToNext());
+        }
+    }
+
+    /** Send the request to the {@link RemoteProcessService}, which runs in another process, and wait for its reply. */
+    private Bundle callRemoteProcess(Class<? extends RemoteProcessService> serviceClass, int what, Bundle data) throws Exception {
+        final Context context = ApplicationProvider.getApplicationContext();
+        final Messenger service = new Messenger(mServiceRule.bindService(new Intent(context, serviceClass)));
+        final HandlerThread replyThread = new HandlerThread("Replies");
+        replyThread.start();
+        try {
+            final LinkedBlockingQueue<Bundle> replies = new LinkedBlockingQueue<>();
+            final Message message = Message.obtain(null, what);
+            message.setData(data);
+            message.replyTo = new Messenger(new Handler(replyThread.getLooper(), reply -> replies.add(new Bundle(reply.getData()))));
+            service.send(message);
+            final Bundle reply = replies.poll(30, TimeUnit.SECONDS);
+            assertNotNull("No reply from the remote process", reply);
+            assertNull(reply.getString("error"));
+            assertNotEquals(Process.myPid(), reply.getInt("pid"));
+            return reply;
+        } finally {
+            replyThread.quit();
+        }
+    }
+
+    @Test
+    public void sharedMemoryRowsInRemoteProcess() throws Exception {
+        mDatabase.command("CREATE TABLE Rows (Id INTEGER PRIMARY KEY, Name TEXT)");
+        mDatabase.command("INSERT INTO Rows (Name) VALUES ('first'), (NULL), ('third \u00e9')");
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Id, Name FROM Rows ORDER BY Id");
+             ParcelFileDescriptor fd = statement.executeForSharedMemory()) {
+            final Bundle request = new Bundle();
+            request.putParcelable("rows", fd);
+            final Bundle reply = callRemoteProcess(RemoteProcessService.class, RemoteProcessService.READ_ROWS, request);
+            assertFalse(reply.getBoolean("writable", true));
+            assertArrayEquals(new long[]{1, 2, 3}, reply.getLongArray("ids"));
+            assertArrayEquals(new String[]{"first", null, "third \u00e9"}, reply.getStringArray("names"));
+
+            // Unchanged here
+            try (SQLiteRowReader reader = SQLiteRowReader.map(fd)) {
+                assertEquals(3, reader.getRowCount());
+                assertTrue(reader.moveToPosition(2));
+                assertEquals("third \u00e9", reader.getString(1));
+            }
+        }
+    }
+
+    @Test
+    public void windowedCursor() {
+        mDatabase.command("CREATE TABLE Items (Id INTEGER PRIMARY KEY, Name TEXT NOT NULL, Category INTEGER)");
+        mDatabase.command("CREATE INDEX ItemsName ON Items (Name, Id)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Items (Name, Category) VALUES (?, ?)")) {
+            for (int i = 0; i < 10000; i++) {
+                statement.bind(1, "Item " + (i * 7919 % 1000));
+                statement.bind(2, i % 3);
+                statement.executeForNothing();
+            }
+        }
+
+        final long[] expectedIds = new long[10000];
+        int expectedCount = 0;
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Id FROM Items WHERE Category = ? ORDER BY Name DESC, Id DESC")) {
+            statement.bind(1, 1);
+            while (statement.cursorNextRow()) {
+                expectedIds[expectedCount++] = statement.cursorGetLong(0);
+            }
+            statement.cursorReset();
+        }
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Id, Name FROM Items WHERE Category = ? ORDER BY Name DESC, Id DESC LIMIT 3");
+             SQLiteRowReader rows = statement.executeForRows()) {
+            statement.bind(1, 1);
+            assertEquals(2, rows.getColumnCount());
+            assertEquals(0, rows.getRowCount());
+            try (SQLiteRowReader boundRows = statement.executeForRows()) {
+                assertEquals(3, boundRows.getRowCount());
+                assertTrue(boundRows.moveToPosition(2));
+                assertEquals(expectedIds[2], boundRows.getLong(0));
+            }
+        }
+
+        final Executor executor = Runnable::run;
+        try (SQLiteWindowedCursor cursor = SQLiteWindowedCursor.builder("SELECT Id, Name FROM Items WHERE Category = ?", "Id")
+                .orderBy("Name")
+                .descending()
+                .arguments(1)
+                .windowSize(100)
+                .prefetch(executor)
+                .open(mDatabase)) {
+            assertEquals(expectedCount, cursor.getCount());
+            assertEquals("Name", cursor.getColumnName(1));
+
+            int position = 0;
+            while (cursor.moveToNext()) {
+                assertEquals(position, cursor.getPosition());
+                assertEquals(expectedIds[position], cursor.getLong(0));
+                position++;
+            }
+            assertEquals(expectedCount, position);
+            assertThrows(IllegalStateException.class, () -> cursor.getLong(0));
+
+            while (cursor.moveToPrevious()) {
+                position--;
+                assertEquals(expectedIds[position], cursor.getLong(0));
+            }
+            assertEquals(0, position);
+
+            final Random random = new Random(5);
+            for (int i = 0; i < 200; i++) {
+                position = random.nextInt(expectedCount);
+                assertTrue(cursor.moveToPosition(position));
+                assertEquals(expectedIds[position], cursor.getLong(0));
+            }
+            assertFalse(cursor.moveToPosition(expectedCount));
+        }
+
+        try (SQLiteWindowedCursor cursor = SQLiteWindowedCursor.builder("SELECT Id FROM Items WHERE Category = ?", "Id")
+                .arguments(5)
+                .open(mDatabase)) {
+            assertEquals(0, cursor.getCount());
+            assertEquals(1, cursor.getColumnCount());
+            assertFalse(cursor.moveToNext());
+        }
+    }
+
+    private static final class ValidSql {
+        @SQLiteSql
+        static final byte[] INSERT = "INSERT INTO Notes (Text) VALUES (?)".getBytes(StandardCharsets.UTF_8);
+        @SQLiteSql
+        static final String SELECT = "SELECT Text FROM Notes WHERE Id = ?";
+        static final String NOT_SQL = "Hello";
+    }
+
+    private static final class InvalidSql {
+        @SQLiteSql
+        static final byte[] MISSING_COLUMN = "SELECT Title FROM Notes".getBytes(StandardCharsets.UTF_8);
+        @SQLiteSql
+        static final String SYNTAX = "SELEC Text FROM Notes";
+        @SQLiteSql
+        static final String VALID = "DELETE FROM Notes";
+    }
+
+    @Test
+    public void utf8Statements() {
+        mDatabase.command("CREATE TABLE Notes (Id INTEGER PRIMARY KEY, Text TEXT)");
+        mDatabase.validateSql(ValidSql.class);
+        final SQLiteException e = assertThrows(SQLiteException.class, () -> mDatabase.validateSql(ValidSql.class, InvalidSql.class));
+        //noinspection DataFlowIssue
+        assertTrue(e.getMessage(), e.getMessage().contains("MISSING_COLUMN") && e.getMessage().contains("SYNTAX"));
+        assertFalse(e.getMessage(), e.getMessage().contains("VALID:"));
+
+        try (SQLiteStatement insert = mDatabase.statement(ValidSql.INSERT);
+             SQLiteStatement select = mDatabase.statement(ValidSql.SELECT)) {
+            insert.bind(1, "\u010c\u00e1p \ud83d\udc1f");
+            final long id = insert.executeForRowID();
+            select.bind(1, id);
+            assertEquals("\u010c\u00e1p \ud83d\udc1f", select.executeForString());
+        }
+        assertThrows(SQLiteException.class, () -> mDatabase.statement(InvalidSql.MISSING_COLUMN));
+    }
+
+    @Test
+    public void globalConfigurationNeedsClosedConnections() {
+        assertThrows(IllegalStateException.class, () -> SQLiteConnection.setSorterReferenceSize(16));
+        assertThrows(IllegalStateException.class, () -> SQLiteConnection.setMemoryStatistics(true));
+    }
+
+    @Test
+    public void pageSizeAdvisor() {
+        mDatabase.command("CREATE TABLE Pages (Id INTEGER PRIMARY KEY, Text TEXT)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Pages (Text) VALUES (?)")) {
+            for (int i = 0; i < 2000; i++) {
+                statement.bind(1, "Text of row " + i);
+                statement.executeForNothing();
+            }
+        }
+
+        final File directory = ApplicationProvider.getApplicationContext().getCacheDir();
+        final SQLitePageSizeAdvisor.Result[] results = SQLitePageSizeAdvisor.evaluate(mDatabase, directory, new int[]{1024, 8192}, 3, db -> {
+            try (SQLiteStatement statement = db.statement("SELECT count(*) FROM Pages WHERE Text LIKE '%7%'")) {
+                assertTrue(statement.executeForLong(0) > 0);
+            }
+            db.command("UPDATE Pages SET Text = Text || '.' WHERE Id % 100 = 0");
+        });
+        assertEquals(2, results.length);
+        assertEquals(1024, results[0].pageSize);
+        assertEquals(8192, results[1].pageSize);
+        for (SQLitePageSizeAdvisor.Result result : results) {
+            assertTrue(result.toString(), result.runsPerSecond > 0);
+            assertTrue(result.toString(), result.fileSize >= result.pageSize * 2L);
+            assertTrue(result.toString(), result.cacheHitRate >= 0.0 && result.cacheHitRate <= 1.0);
+        }
+        assertFalse(new File(directory, "page_size_1024.db").exists());
+        assertEquals(2000, queryLong("SELECT count(*) FROM Pages WHERE Text NOT LIKE '%.'"));
+
+        SQLitePageSizeAdvisor.migrate(mDatabase, 8192);
+        assertEquals("8192", mDatabase.pragma("PRAGMA page_size"));
+        assertEquals(2000, queryLong("SELECT count(*) FROM Pages"));
+        assertEquals("ok", mDatabase.pragma("PRAGMA integrity_check"));
+        assertThrows(IllegalArgumentException.class, () -> SQLitePageSizeAdvisor.migrate(mDatabase, 3000));
+    }
+
+    @Test
+    public void walMonitor() {
+        assertEquals("wal", mDatabase.pragma("PRAGMA journal_mode=WAL"));
+        mDatabase.command("CREATE TABLE Log (Id INTEGER PRIMARY KEY, Message TEXT)");
+        mDatabase.command("INSERT INTO Log (Message) VALUES ('first'), ('second')");
+
+        final int[] starvations = {0};
+        final File otherFile = new File(mDatabaseFile.getPath() + "-other");
+        SQLiteCursorTracker.setEnabled(true);
+        try (SQLiteConnection reader = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+             SQLiteConnection checkpointer = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+             SQLiteStatement forgotten = reader.statement("SELECT Message FROM Log");
+             SQLiteConnection other = SQLiteConnection.open(otherFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE | SQLiteConnection.SQLITE_OPEN_CREATE);
+             SQLiteStatement otherCursor = other.statement("SELECT 1 UNION ALL SELECT 2")) {
+            // Cursors of other databases are not reported
+            assertTrue(otherCursor.cursorNextRow());
+            final SQLiteWalMonitor monitor = new SQLiteWalMonitor(checkpointer, 2, (last, incomplete, cursors) -> {
+                starvations[0]++;
+                assertEquals(2, incomplete);
+                assertFalse(last.isComplete());
+                assertEquals(1, cursors.size());
+                assertSame(reader, cursors.get(0).connection);
+                assertEquals("SELECT Message FROM Log", cursors.get(0).sql);
+            });
+            assertTrue(monitor.checkpoint(SQLiteWalMonitor.CHECKPOINT_PASSIVE).isComplete());
+
+            // Forgotten cursor keeps its read transaction
+            assertTrue(forgotten.cursorNextRow());
+            for (int i = 0; i < 10; i++) {
+                mDatabase.command("INSERT INTO Log (Message) VALUES ('more')");
+            }
+            final SQLiteWalMonitor.Checkpoint blocked = monitor.checkpoint(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+            assertFalse(blocked.toString(), blocked.isComplete());
+            assertTrue(blocked.toString(), blocked.uncheckpointedFrames() > 0);
+            assertTrue(monitor.walSize() > 0);
+            assertEquals(0, starvations[0]);
+            assertFalse(monitor.checkpoint(SQLiteWalMonitor.CHECKPOINT_PASSIVE).isComplete());
+            assertEquals(1, starvations[0]);
+            assertEquals(2, monitor.consecutiveIncompleteCheckpoints());
+
+            forgotten.cursorReset();
+            final SQLiteWalMonitor.Checkpoint complete = monitor.checkpoint(SQLiteWalMonitor.CHECKPOINT_TRUNCATE);
+            assertTrue(complete.toString(), complete.isComplete());
+            assertEquals(0, monitor.consecutiveIncompleteCheckpoints());
+            assertEquals(4, monitor.checkpoints());
+            assertEquals(2, monitor.incompleteCheckpoints());
+            assertEquals(0, monitor.walSize());
+            assertTrue(monitor.openCursors().isEmpty());
+            assertEquals(1, SQLiteCursorTracker.openCursors().size());
+            otherCursor.cursorReset();
+        } finally {
+            SQLiteCursorTracker.setEnabled(false);
+            SQLiteDatabase.deleteDatabase(otherFile);
+        }
+    }
+
+    @Test
+    public void leakedCursors() throws InterruptedException {
+        mDatabase.command("CREATE TABLE Log (Id INTEGER PRIMARY KEY, Message TEXT)");
+        mDatabase.command("INSERT INTO Log (Message) VALUES ('first'), ('second')");
+        SQLiteCursorTracker.setEnabled(true);
+        SQLiteCursorTracker.setCaptureStacks(true);
+
+        try (SQLiteStatement leaked = mDatabase.statement("SELECT Message FROM Log ORDER BY Id");
+             SQLiteStatement other = mDatabase.statement("SELECT count(*) FROM Log")) {
+            assertTrue(leaked.cursorNextRow());
+            Thread.sleep(20);
+            assertTrue(SQLiteCursorTracker.heldCursors(60_000, true).isEmpty());
+
+            final List<SQLiteCursorTracker.OpenCursor> held = SQLiteCursorTracker.heldCursors(10, false);
+            assertEquals(1, held.size());
+            assertEquals("SELECT Message FROM Log ORDER BY Id", held.get(0).sql);
+            assertTrue(held.get(0).heldNanos >= 10_000_000L);
+            final Throwable stack = held.get(0).stack;
+            assertNotNull(stack);
+            boolean startedHere = false;
+            for (StackTraceElement element : stack.getStackTrace()) {
+                startedHere |= element.getMethodName().equals("leakedCursors");
+            }
+            assertTrue(startedHere);
+
+            // Owner thread keeps using the cursor, until the reset is requested
+            assertEquals("first", leaked.cursorGetString(0));
+            assertEquals(1, SQLiteCursorTracker.heldCursors(10, true).size());
+            assertEquals("first", leaked.cursorGetString(0));
+            assertEquals(1, SQLiteCursorTracker.openCursors().size());
+
+            // Next use of the connection resets it
+            assertEquals(2L, other.executeForLong(-1L));
+            assertTrue(SQLiteCursorTracker.openCursors().isEmpty());
+            assertThrows(IllegalStateException.class, () -> leaked.cursorGetString(0));
+            assertThrows(IllegalStateException.class, leaked::cursorNextRow);
+
+            leaked.cursorReset();
+            assertTrue(leaked.cursorNextRow());
+            assertEquals("first", leaked.cursorGetString(0));
+
+            // Continuing the cursor resets it too
+            SQLiteCursorTracker.heldCursors(0, true);
+            assertThrows(IllegalStateException.class, leaked::cursorNextRow);
+            assertTrue(SQLiteCursorTracker.openCursors().isEmpty());
+            leaked.cursorReset();
+        } finally {
+            SQLiteCursorTracker.setCaptureStacks(false);
+        }
+    }
+
+    @Test
+    public void membershipFilter() {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Uuid TEXT)");
+        mDatabase.command("WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 2 FROM c WHERE x < 9999) "
+                + "INSERT INTO Item SELECT x, 'u' || x FROM c");
+
+        try (SQLiteMembershipFilter ids = SQLiteMembershipFilter.create(mDatabase, "Item", "Id", 0.01);
+             SQLiteMembershipFilter uuids = SQLiteMembershipFilter.create(mDatabase, "Item", "Uuid", 0.01)) {
+            final long[] values = new long[10_000];
+            for (int i = 0; i < values.length; i++) {
+                values[i] = i;
+            }
+            final boolean[] results = new boolean[values.length];
+            assertEquals(5000, ids.contains(values, results));
+            for (int i = 0; i < values.length; i++) {
+                assertEquals(i % 2 == 1, results[i]);
+            }
+
+            // Writes of this connection are followed by triggers, writes of other connections rebuild the filter
+            mDatabase.command("INSERT INTO Item VALUES (20000, 'new')");
+            mDatabase.command("UPDATE Item SET Id = 20002 WHERE Id = 1");
+            final boolean[] changed = new boolean[4];
+            assertEquals(3, ids.contains(new long[]{20000, 20002, 20004, 1}, changed));
+            // Old values stay until the filter is rebuilt
+            assertArrayEquals(new boolean[]{true, true, false, true}, changed);
+            assertEquals(1, uuids.contains(new String[]{"new", "other", null, "u2"}, changed));
+            assertArrayEquals(new boolean[]{true, false, false, false}, changed);
+
+            try (SQLiteConnection other = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE)) {
+                other.command("INSERT INTO Item VALUES (20004, 'other')");
+            }
+            assertEquals(3, ids.contains(new long[]{20000, 20002, 20004, 1}, changed));
+            assertArrayEquals(new boolean[]{true, true, true, false}, changed);
+            assertEquals(2, uuids.contains(new String[]{"new", "other", null, "u2"}, changed));
+            assertArrayEquals(new boolean[]{true, true, false, false}, changed);
+
+            mDatabase.command("INSERT INTO Item VALUES (20006, '')");
+            assertEquals(1, uuids.contains(new String[]{""}, changed));
+            assertTrue(changed[0]);
+        }
+
+        assertThrows(SQLiteException.class, () -> SQLiteMembershipFilter.create(mDatabase, "Item", "Missing", 0.01));
+        assertThrows(SQLiteException.class, () -> SQLiteMembershipFilter.create(mDatabase, "Missing", "Id", 0.01));
+        // No triggers are left behind
+        mDatabase.command("INSERT INTO Item VALUES (30000, 'after')");
+    }
+
+    @Test
+    public void largeValueStore() throws IOException {
+        final File directory = new File(mDatabaseFile.getPath() + "-values");
+        final SQLiteLargeValueStore store = new SQLiteLargeValueStore(directory, 1024);
+        mDatabase.command("CREATE TABLE Attachment (Id INTEGER PRIMARY KEY, Data BLOB)");
+        store.track(mDatabase, "Attachment", "Data");
+        store.track(mDatabase, "Attachment", "Data");
+
+        final byte[] large = new byte[100_000];
+        new Random(1).nextBytes(large);
+        final byte[] small = {1, 2, 3};
+        try (SQLiteStatement insert = mDatabase.statement("INSERT INTO Attachment (Id, Data) VALUES (?, ?)")) {
+            insert.setLargeValueStore(store);
+            for (int id = 1; id <= 3; id++) {
+                insert.bind(1, id);
+                insert.bind(2, id == 3 ? small : large);
+                insert.executeForNothing();
+            }
+        }
+        // Rows hold references and equal values share one file
+        assertEquals(44L, queryLong("SELECT length(Data) FROM Attachment WHERE Id = 1"));
+        assertEquals(1, directory.list().length);
+        assertEquals(2L, queryLong("SELECT Refs FROM sqlitelite_large_values"));
+
+        try (SQLiteStatement query = mDatabase.statement("SELECT Data FROM Attachment ORDER BY Id")) {
+            query.setLargeValueStore(store);
+            assertTrue(query.cursorNextRow());
+            assertArrayEquals(large, query.cursorGetBlob(0));
+            try (InputStream in = query.cursorGetBlobStream(0)) {
+                final byte[] streamed = new byte[large.length];
+                int offset = 0, read;
+                while ((read = in.read(streamed, offset, streamed.length - offset)) > 0) offset += read;
+                assertEquals(large.length, offset);
+                assertEquals(-1, in.read());
+                assertArrayEquals(large, streamed);
+            }
+            assertTrue(query.cursorNextRow());
+            assertTrue(query.cursorNextRow());
+            assertArrayEquals(small, query.cursorGetBlob(0));
+            query.cursorReset();
+        }
+
+        // Rolled back delete keeps the file, committed delete frees it
+        mDatabase.beginTransactionImmediate();
+        mDatabase.command("DELETE FROM Attachment");
+        mDatabase.endTransaction();
+        assertEquals(0, store.collectGarbage(mDatabase, 0));
+        mDatabase.command("DELETE FROM Attachment WHERE Id = 1");
+        assertEquals(0, store.collectGarbage(mDatabase, 0));
+        mDatabase.command("UPDATE Attachment SET Data = X'00' WHERE Id = 2");
+        assertEquals(0, store.collectGarbage(mDatabase, 60_000));
+        assertEquals(1, store.collectGarbage(mDatabase, 0));
+        assertEquals(0, directory.list().length);
+        assertEquals(0L, queryLong("SELECT count(*) FROM sqlitelite_large_values"));
+
+        // Small value which looks like a reference is stored in a file, so that it is not mistaken for one
+        final byte[] lookalike = new byte[44];
+        System.arraycopy(new byte[]{'S', 'Q', 'L', 'V'}, 0, lookalike, 0, 4);
+        try (SQLiteStatement insert = mDatabase.statement("INSERT INTO Attachment (Id, Data) VALUES (4, ?)")) {
+            insert.setLargeValueStore(store);
+            insert.bind(1, lookalike);
+            insert.executeForNothing();
+        }
+        assertEquals(1, directory.list().length);
+        assertEquals(1L, queryLong("SELECT Refs FROM sqlitelite_large_values"));
+        try (SQLiteStatement query = mDatabase.statement("SELECT Data FROM Attachment WHERE Id = 4")) {
+            query.setLargeValueStore(store);
+            assertTrue(query.cursorNextRow());
+            assertArrayEquals(lookalike, query.cursorGetBlob(0));
+            query.cursorReset();
+        }
+        mDatabase.command("DELETE FROM Attachment");
+        assertEquals(1, store.collectGarbage(mDatabase, 0));
+    }
+
+    @Test
+    public void importFile() throws IOException {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT NOT NULL, Price REAL)");
+        final File csv = new File(mDatabaseFile.getParentFile(), "import.csv");
+        try (FileOutputStream out = new FileOutputStream(csv)) {
+            out.write(("Id,Name,Price\r\n1,Apple,0.5\r\n2,\"Pear, \"\"green\"\"\nlarge\",\n3\n4,,1\n5,Plum,2\n")
+                    .getBytes(StandardCharsets.UTF_8));
+        }
+        final File ndjson = new File(mDatabaseFile.getParentFile(), "import.ndjson");
+        try (FileOutputStream out = new FileOutputStream(ndjson)) {
+            out.write(("{\"Id\": 10, \"Name\": \"K\\u00e1vov\u00e9\", \"Tags\": [1, 2]}\n"
+                    + "{\"Name\": \"Nut\", \"Price\": 1.5e1}\n"
+                    + "not json\n").getBytes(StandardCharsets.UTF_8));
+        }
+        try {
+            final SQLiteConnection.ImportResult csvResult = mDatabase.importFile(csv.getPath(), SQLiteConnection.FORMAT_CSV_HEADER,
+                    "Item", new String[]{"Id", "Name", "Price"}, 2, 100);
+            assertEquals(5, csvResult.records);
+            assertEquals(3, csvResult.insertedRows);
+            assertEquals(2, csvResult.failedRecords);
+            assertEquals(5, csvResult.errors.get(0).line);
+            assertEquals(6, csvResult.errors.get(1).line);
+            assertTrue(csvResult.errors.get(1).message.contains("NOT NULL"));
+            assertEquals("Pear, \"green\"\nlarge", queryString("SELECT Name FROM Item WHERE Id = 2"));
+            assertEquals("null", queryString("SELECT typeof(Price) FROM Item WHERE Id = 2"));
+            assertEquals("real", queryString("SELECT typeof(Price) FROM Item WHERE Id = 5"));
+
+            final SQLiteConnection.ImportResult jsonResult = mDatabase.importFile(ndjson.getPath(), SQLiteConnection.FORMAT_NDJSON,
+                    "Item", new String[]{"Id", "Name", "Price"});
+            assertEquals(2, jsonResult.insertedRows);
+            assertEquals(1, jsonResult.errors.size());
+            assertEquals(3, jsonResult.errors.get(0).line);
+            assertEquals("K\u00e1vov\u00e9", queryString("SELECT Name FROM Item WHERE Id = 10"));
+            assertEquals(15L, queryLong("SELECT Price FROM Item WHERE Name = 'Nut'"));
+
+            assertThrows(SQLiteException.class, () -> mDatabase.importFile(csv.getPath(), SQLiteConnection.FORMAT_CSV, "Item", new String[]{"Missing"}));
+            assertThrows(SQLiteException.class, () -> mDatabase.importFile(csv.getPath() + ".missing", SQLiteConnection.FORMAT_CSV, "Item", new String[]{"Id"}));
+            assertEquals(5L, queryLong("SELECT count(*) FROM Item"));
+        } finally {
+            assertTrue(csv.delete());
+            assertTrue(ndjson.delete());
+        }
+    }
+
+    @Test
+    public void exportTo() throws IOException {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT, Price REAL, Data BLOB)");
+        mDatabase.command("INSERT INTO Item VALUES (1, 'Apple', 0.5, X'00FF'), (2, 'Pear, \"green\"', NULL, NULL)");
+        final File file = new File(mDatabaseFile.getParentFile(), "export");
+        try (SQLiteStatement query = mDatabase.statement("SELECT * FROM Item WHERE Id >= ? ORDER BY Id")) {
+            query.bind(1, 1);
+            assertEquals(2, query.exportTo(file.getPath(), SQLiteConnection.FORMAT_CSV_HEADER));
+            assertEquals("Id,Name,Price,Data\n1,Apple,0.5,00ff\n2,\"Pear, \"\"green\"\"\",,\n", readFile(file));
+
+            assertEquals(2, query.exportTo(file.getPath(), SQLiteConnection.FORMAT_NDJSON));
+            assertEquals("{\"Id\":1,\"Name\":\"Apple\",\"Price\":0.5,\"Data\":\"00ff\"}\n"
+                    + "{\"Id\":2,\"Name\":\"Pear, \\\"green\\\"\",\"Price\":null,\"Data\":null}\n", readFile(file));
+
+            // Exported CSV imports back
+            mDatabase.command("CREATE TABLE Copy (Id INTEGER PRIMARY KEY, Name TEXT, Price REAL, Data BLOB)");
+            query.exportTo(file.getPath(), SQLiteConnection.FORMAT_CSV);
+            assertEquals(2, mDatabase.importFile(file.getPath(), SQLiteConnection.FORMAT_CSV, "Copy",
+                    new String[]{"Id", "Name", "Price", null}).insertedRows);
+            assertEquals(2L, queryLong("SELECT count(*) FROM Item JOIN Copy USING (Id, Name) WHERE Item.Price IS Copy.Price"));
+
+            query.bind(1, 2);
+            assertEquals(1, query.exportTo(file.getPath(), SQLiteConnection.FORMAT_ROWS));
+            try (ParcelFileDescriptor fd = ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY);
+                 SQLiteRowReader reader = SQLiteRowReader.map(fd)) {
+                assertEquals(1, reader.getRowCount());
+                assertTrue(reader.moveToNext());
+                assertEquals("Pear, \"green\"", reader.getString(1));
+                assertTrue(reader.isNull(3));
+            }
+
+            assertThrows(SQLiteException.class, () -> query.exportTo(file.getPath(), 42));
+            assertThrows(SQLiteException.class, () -> query.exportTo(new File(file, "missing").getPath(), SQLiteConnection.FORMAT_CSV));
+        } finally {
+            assertTrue(file.delete());
+        }
+    }
+
+    @Test
+    public void exportEmptyText() throws IOException {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT)");
+        mDatabase.command("INSERT INTO Item VALUES (1, ''), (2, NULL)");
+        final File file = new File(mDatabaseFile.getParentFile(), "export");
+        try (SQLiteStatement query = mDatabase.statement("SELECT * FROM Item ORDER BY Id")) {
+            assertEquals(2, query.exportTo(file.getPath(), SQLiteConnection.FORMAT_CSV));
+            assertEquals("1,\"\"\n2,\n", readFile(file));
+
+            mDatabase.command("CREATE TABLE Copy (Id INTEGER PRIMARY KEY, Name TEXT)");
+            assertEquals(2, mDatabase.importFile(file.getPath(), SQLiteConnection.FORMAT_CSV, "Copy",
+                    new String[]{"Id", "Name"}).insertedRows);
+            assertEquals("text", queryString("SELECT typeof(Name) FROM Copy WHERE Id = 1"));
+            assertEquals("", queryString("SELECT Name FROM Copy WHERE Id = 1"));
+            assertEquals("null", queryString("SELECT typeof(Name) FROM Copy WHERE Id = 2"));
+        } finally {
+            assertTrue(file.delete());
+        }
+    }
+
+    @Test
+    public void queryServer() throws IOException {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT NOT NULL, Data BLOB)");
+        final String name = "sqlitelite-test-" + System.nanoTime();
+        try (SQLiteQueryServer server = new SQLiteQueryServer(mDatabase, name)) {
+            try (SQLiteQueryClient client = SQLiteQueryClient.connect(name);
+                 SQLiteQueryClient other = SQLiteQueryClient.connect(name)) {
+                assertEquals(1, client.insert("INSERT INTO Item (Name, Data) VALUES (?, ?)", "first", new byte[]{1, 2}));
+                final ArrayList<Object[]> batch = new ArrayList<>();
+                for (int i = 0; i < 100; i++) {
+                    batch.add(new Object[]{"item " + i, null});
+                }
+                assertEquals(100, other.executeBatch("INSERT INTO Item (Name, Data) VALUES (?, ?)", batch));
+                assertEquals(101L, queryLong("SELECT count(*) FROM Item"));
+
+                try (SQLiteRowReader rows = client.query("SELECT Id, Name, Data FROM Item WHERE Id <= ? ORDER BY Id", 2)) {
+                    assertEquals(2, rows.getRowCount());
+                    assertTrue(rows.moveToNext());
+                    assertEquals("first", rows.getString(1));
+                    assertArrayEquals(new byte[]{1, 2}, rows.getBlob(2));
+                    assertTrue(rows.moveToNext());
+                    assertEquals("item 0", rows.getString(1));
+                    assertTrue(rows.isNull(2));
+                }
+                assertEquals(100, other.execute("UPDATE Item SET Data = ? WHERE Data IS NULL", new byte[0]));
+
+                // Errors are reported and the connection stays usable, a failed batch changes nothing
+                assertThrows(SQLiteException.class, () -> client.query("SELECT Missing FROM Item"));
+                batch.add(new Object[]{null, null});
+                assertThrows(SQLiteException.class, () -> other.executeBatch("INSERT INTO Item (Name, Data) VALUES (?, ?)", batch));
+                assertEquals(101L, queryLong("SELECT count(*) FROM Item"));
+                // Transactions can't be left open on the shared connection
+                assertThrows(SQLiteException.class, () -> client.execute("BEGIN"));
+                assertThrows(SQLiteException.class, () -> client.execute("SAVEPOINT Client"));
+                assertTrue(mDatabase.isAutocommit());
+                assertEquals(1, client.execute("DELETE FROM Item WHERE Id = ?", 1L));
+                client.closeStatement("DELETE FROM Item WHERE Id = ?");
+            }
+        }
+        assertThrows(IOException.class, () -> SQLiteQueryClient.connect(name));
+        assertEquals(100L, queryLong("SELECT count(*) FROM Item"));
+    }
+
+    @Test
+    public void queryServerInRemoteProcess() throws Exception {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT)");
+        mDatabase.command("INSERT INTO Item (Name) VALUES ('local')");
+        final String name = "sqlitelite-test-" + System.nanoTime();
+        try (SQLiteQueryServer server = new SQLiteQueryServer(mDatabase, name)) {
+            final Bundle request = new Bundle();
+            request.putString("name", name);
+            final Bundle reply = callRemoteProcess(RemoteProcessService.class, RemoteProcessService.QUERY_SERVER, request);
+            assertFalse(reply.getBoolean("refused", true));
+            assertEquals(2L, reply.getLong("rowId"));
+            assertEquals(2L, reply.getLong("count"));
+            assertEquals("remote", queryString("SELECT Name FROM Item WHERE Id = 2"));
+        }
+    }
+
+    @Test
+    public void queryServerRefusesOtherUid() throws Exception {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT)");
+        final String name = "sqlitelite-test-" + System.nanoTime();
+        try (SQLiteQueryServer server = new SQLiteQueryServer(mDatabase, name)) {
+            final Bundle request = new Bundle();
+            request.putString("name", name);
+            // Isolated process runs with another user id
+            final Bundle reply = callRemoteProcess(RemoteProcessService.Isolated.class, RemoteProcessService.QUERY_SERVER, request);
+            assertTrue(reply.getBoolean("refused", false));
+            assertEquals(0L, queryLong("SELECT count(*) FROM Item"));
+        }
+    }
+
+    @Test
+    public void walArchiver() throws IOException {
+        assertEquals("wal", mDatabase.pragma("PRAGMA journal_mode"));
+        mDatabase.pragma("PRAGMA wal_autocheckpoint=0");
+        mDatabase.command("CREATE TABLE Log (Id INTEGER PRIMARY KEY, Message TEXT)");
+        final File directory = new File(mDatabaseFile.getPath() + "-archive");
+        final File restoredFile = new File(mDatabaseFile.getPath() + "-restored");
+
+        final SQLiteWalArchiver.Segment[] segments = new SQLiteWalArchiver.Segment[4];
+        final long[] counts = new long[segments.length];
+        final SQLiteWalArchiver.Segment base;
+        final SQLiteWalArchiver.Segment afterTruncate;
+        final long afterTruncateCount;
+        try (SQLiteConnection archiveDb = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+             SQLiteConnection checkpointDb = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+             SQLiteStatement insert = mDatabase.statement("INSERT INTO Log (Message) VALUES (?)")) {
+            final SQLiteWalMonitor monitor = new SQLiteWalMonitor(checkpointDb, 5, (last, incomplete, cursors) -> {});
+            final SQLiteWalArchiver archiver = new SQLiteWalArchiver(archiveDb, monitor, directory);
+            for (int i = 0; i < segments.length; i++) {
+                mDatabase.beginTransactionImmediate();
+                try {
+                    for (int row = 0; row < 100; row++) {
+                        insert.bind(1, "message " + i + " " + row);
+                        insert.executeForNothing();
+                    }
+                    mDatabase.setTransactionSuccessful();
+                } finally {
+                    mDatabase.endTransaction();
+                }
+                counts[i] = queryLong("SELECT count(*) FROM Log");
+                // Each archive checkpoints the WAL, so the next one starts in a restarted WAL
+                segments[i] = archiver.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+                assertNotNull(segments[i]);
+                assertEquals(i == 0, segments[i].base);
+                assertTrue(monitor.lastCheckpoint().isComplete());
+            }
+            assertNull(archiver.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE));
+            assertThrows(IllegalArgumentException.class, () -> archiver.archive(SQLiteWalMonitor.CHECKPOINT_TRUNCATE));
+
+            // Another archiver continues the archive
+            final SQLiteWalArchiver continued = new SQLiteWalArchiver(archiveDb, monitor, directory);
+            mDatabase.command("DELETE FROM Log WHERE Id % 2 = 0");
+            final SQLiteWalArchiver.Segment next = continued.archive(SQLiteWalMonitor.CHECKPOINT_FULL);
+            assertNotNull(next);
+            assertFalse(next.base);
+            continued.requestBase();
+            base = continued.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+            assertNotNull(base);
+            assertTrue(base.base);
+            assertEquals(segments.length + 2, SQLiteWalArchiver.segments(directory).size());
+
+            // Frames lost with a truncated WAL are in the new base
+            mDatabase.command("INSERT INTO Log (Message) VALUES ('truncated')");
+            mDatabase.pragma("PRAGMA wal_checkpoint(TRUNCATE)");
+            final SQLiteWalArchiver.Segment truncated = continued.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+            assertNotNull(truncated);
+            assertTrue(truncated.base);
+            assertNull(continued.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE));
+            // The first WAL after a base without one gets a base too, then it is continued
+            mDatabase.command("INSERT INTO Log (Message) VALUES ('new WAL')");
+            final SQLiteWalArchiver.Segment newWal = continued.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+            assertNotNull(newWal);
+            assertTrue(newWal.base);
+            mDatabase.command("INSERT INTO Log (Message) VALUES ('continued')");
+            afterTruncate = continued.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE);
+            assertNotNull(afterTruncate);
+            assertFalse(afterTruncate.base);
+            afterTruncateCount = queryLong("SELECT count(*) FROM Log");
+        }
+
+        try {
+            for (int i = 0; i < segments.length; i++) {
+                SQLiteWalArchiver.restore(directory, segments[i].number, restoredFile);
+                try (SQLiteConnection restored = SQLiteConnection.open(restoredFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                     SQLiteStatement count = restored.statement("SELECT count(*) FROM Log")) {
+                    assertEquals("ok", restored.pragma("PRAGMA integrity_check"));
+                    assertEquals(counts[i], count.executeForLong(-1));
+                }
+            }
+            assertThrows(IOException.class, () -> SQLiteWalArchiver.restore(directory, 100, restoredFile));
+
+            // Segments before the new base are not needed for it
+            assertEquals(segments.length + 1, SQLiteWalArchiver.deleteSegmentsBefore(directory, base.number));
+            SQLiteWalArchiver.restore(directory, base.number, restoredFile);
+            try (SQLiteConnection restored = SQLiteConnection.open(restoredFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                 SQLiteStatement count = restored.statement("SELECT count(*) FROM Log")) {
+                assertEquals(counts[segments.length - 1] / 2, count.executeForLong(-1));
+            }
+            SQLiteWalArchiver.restore(directory, afterTruncate.number, restoredFile);
+            try (SQLiteConnection restored = SQLiteConnection.open(restoredFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                 SQLiteStatement count = restored.statement("SELECT count(*) FROM Log")) {
+                assertEquals("ok", restored.pragma("PRAGMA integrity_check"));
+                assertEquals(afterTruncateCount, count.executeForLong(-1));
+            }
+        } finally {
+            SQLiteDatabase.deleteDatabase(restoredFile);
+            final File[] files = directory.listFiles();
+            if (files != null) {
+                for (File file : files) {
+                    assertTrue(file.delete());
+                }
+            }
+            assertTrue(directory.delete());
+        }
+    }
+
+    @Test
+    public void cloneDatabase() {
+        mDatabase.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Name TEXT)");
+        mDatabase.command("INSERT INTO Item (Name) VALUES ('first'), ('second')");
+        mDatabase.pragma("PRAGMA user_version=3");
+        final File clone = new File(mDatabaseFile.getPath() + "-cloned");
+        try {
+            // The rows are still in the WAL of the template
+            final int method = SQLiteDatabaseFiles.cloneFrom(mDatabase, clone);
+            assertTrue(method == SQLiteDatabaseFiles.CLONE_REFLINK || method == SQLiteDatabaseFiles.CLONE_COPY);
+            mDatabase.command("INSERT INTO Item (Name) VALUES ('third')");
+            try (SQLiteConnection db = SQLiteConnection.open(clone.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                 SQLiteStatement count = db.statement("SELECT count(*) FROM Item")) {
+                assertEquals("3", db.pragma("PRAGMA user_version"));
+                assertEquals("ok", db.pragma("PRAGMA integrity_check"));
+                assertEquals(2, count.executeForLong(-1));
+            }
+
+            // Reader keeps the WAL from being checkpointed
+            try (SQLiteConnection reader = SQLiteConnection.open(mDatabaseFile.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                 SQLiteStatement read = reader.statement("SELECT Name FROM Item")) {
+                assertTrue(read.cursorNextRow());
+                assertEquals(SQLiteDatabaseFiles.CLONE_BACKUP, SQLiteDatabaseFiles.cloneFrom(mDatabase, clone));
+            }
+            try (SQLiteConnection db = SQLiteConnection.open(clone.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE);
+                 SQLiteStatement count = db.statement("SELECT count(*) FROM Item")) {
+                assertEquals(3, count.executeForLong(-1));
+            }
+
+            try (SQLiteConnection memory = SQLiteConnection.open(":memory:", SQLiteConnection.SQLITE_OPEN_READWRITE)) {
+                assertThrows(SQLiteException.class, () -> SQLiteDatabaseFiles.cloneFrom(memory, clone));
+            }
+        } finally {
+            SQLiteDatabase.deleteDatabase(clone);
+        }
+    }
+
+    @Test
+    public void fileGrowth() {
+        final File file = new File(mDatabaseFile.getPath() + "-growth");
+        final File wal = new File(file.getPath() + "-wal");
+        SQLiteDatabase.deleteDatabase(file);
+        final SQLiteDelegate delegate = new SQLiteDelegate(file) {
+            {
+                fileChunkSize = 256 * 1024;
+                walPreallocateSize = 1024 * 1024;
+            }
+
+            @Override
+            public void onCreate(SQLiteConnection db) {}
+        };
+        try (SQLiteConnection db = SQLiteConnection.open(delegate)) {
+            assertEquals(1024 * 1024, wal.length());
+            assertEquals("1048576", db.pragma("PRAGMA journal_size_limit"));
+            db.pragma("PRAGMA wal_autocheckpoint=100");
+            db.command("CREATE TABLE Item (Id INTEGER PRIMARY KEY, Data BLOB)");
+            try (SQLiteStatement insert = db.statement("INSERT INTO Item (Data) VALUES (zeroblob(1000))")) {
+                for (int i = 0; i < 3000; i++) {
+                    insert.executeForNothing();
+                }
+            }
+            // Overwritten after the checkpoints, never truncated or grown
+            assertEquals(1024 * 1024, wal.length());
+            db.pragma("PRAGMA wal_checkpoint(PASSIVE)");
+            assertEquals(0, file.length() % (256 * 1024));
+
+            // Second connection preallocates nothing, the WAL has the data
+            try (SQLiteConnection other = SQLiteConnection.open(delegate);
+                 SQLiteStatement count = other.statement("SELECT count(*) FROM Item")) {
+                assertEquals(3000, count.executeForLong(-1));
+                assertEquals("ok", other.pragma("PRAGMA integrity_check"));
+            }
+        } finally {
+            SQLiteDatabase.deleteDatabase(file);
+        }
+    }
+
+    private long queryLong(String sql) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            return statement.executeForLong(Long.MIN_VALUE);
+        }
+    }
+
+    private double queryDouble(String sql) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            return statement.executeForDouble(Double.NaN);
+        }
+    }
+
+    private String queryString(String sql) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            return statement.executeForString();
+        }
+    }
+
+    private static String readFile(File file) throws IOException {
+        try (FileInputStream in = new FileInputStream(file)) {
+            final byte[] bytes = new byte[(int) file.length()];
+            int offset = 0, read;
+            while (offset < bytes.length && (read = in.read(bytes, offset, bytes.length - offset)) > 0) offset += read;
+            return new String(bytes, 0, offset, StandardCharsets.UTF_8);
+        }
+    }
 }
@@ -0,0 +1,130 @@
+package com.darkyen.sqlitelite;
+
+import android.app.Service;
+import android.content.Intent;
+import android.os.Bundle;
+import android.os.Handler;
+import android.os.IBinder;
+import android.os.Looper;
+import android.os.Message;
+import android.os.Messenger;
+import android.os.ParcelFileDescriptor;
+import android.os.Process;
+import android.os.RemoteException;
+import android.util.Log;
+
+import java.io.FileOutputStream;
+import java.io.IOException;
+
+/**
+ * Runs in its own process (android:process in the test manifest), to test features shared between processes.
+ * Requests are {@link Message}s whose {@link Message#replyTo} receives a reply with the same what.
+ * Each reply has "pid" of this process and "error", if the request failed.
+ */
+public class RemoteProcessService extends Service {
+
+    private static final String TAG = "RemoteProcessService";
+
+    /**
+     * "rows": {@link ParcelFileDescriptor} of {@link SQLiteStatement#executeForSharedMemory()} with Id and Name columns
+     * -&gt; "writable": whether the region could be written, "ids": long[], "names": String[]
+     */
+    static final int READ_ROWS = 1;
+    /**
+     * "name": of a {@link SQLiteQueryServer} of a database with table Item (Id INTEGER PRIMARY KEY, Name TEXT)
+     * -&gt; "refused": whether the connection failed, otherwise "rowId": of a row inserted with Name "remote",
+     * "count": rows of Item after that
+     */
+    static final int QUERY_SERVER = 2;
+
+    /** Same service in an isolated process, which has its own user id. */
+    public static final class Isolated extends RemoteProcessService {}
+
+    private Messenger messenger;
+
+    @Override
+    public void onCreate() {
+        super.onCreate();
+        messenger = new Messenger(new Handler(Looper.getMainLooper(), this::handleMessage));
+    }
+
+    @Override
+    public IBinder onBind(Intent intent) {
+        return messenger.getBinder();
+    }
+
+    private boolean handleMessage(Message message) {
+        final Bundle reply = new Bundle();
+        reply.putInt("pid", Process.myPid());
+        try {
+            switch (message.what) {
+                case READ_ROWS:
+                    readRows(message.getData(), reply);
+                    break;
+                case QUERY_SERVER:
+                    queryServer(message.getData(), reply);
+                    break;
+                default:
+                    return false;
+            }
+        } catch (Exception e) {
+            Log.e(TAG, "Request " + message.what + " failed", e);
+            reply.putString("error", e.toString());
+        }
+
+        final Message response = Message.obtain(null, message.what);
+        response.setData(reply);
+        try {
+            message.replyTo.send(response);
+        } catch (RemoteException e) {
+            Log.e(TAG, "Failed to reply", e);
+        }
+        return true;
+    }
+
+    private static void readRows(Bundle data, Bundle reply) throws IOException {
+        try (ParcelFileDescriptor fd = data.getParcelable("rows")) {
+            // Sealed memfd, or read-only ashmem, must not be writable here either
+            boolean writable;
+            try {
+                new FileOutputStream(fd.getFileDescriptor()).write(1);
+                writable = true;
+            } catch (IOException e) {
+                writable = false;
+            }
+            reply.putBoolean("writable", writable);
+
+            try (SQLiteRowReader reader = SQLiteRowReader.map(fd)) {
+                final long[] ids = new long[reader.getRowCount()];
+                final String[] names = new String[ids.length];
+                while (reader.moveToNext()) {
+                    ids[reader.getPosition()] = reader.getLong(0);
+                    names[reader.getPosition()] = reader.getString(1);
+                }
+                reply.putLongArray("ids", ids);
+                reply.putStringArray("names", names);
+            }
+        }
+    }
+
+    private static void queryServer(Bundle data, Bundle reply) throws IOException {
+        final SQLiteQueryClient client;
+        try {
+            client = SQLiteQueryClient.connect(data.getString("name"));
+        } catch (IOException e) {
+            Log.i(TAG, "Connection refused", e);
+            reply.putBoolean("refused", true);
+            return;
+        }
+        try {
+            reply.putBoolean("refused", false);
+            reply.putLong("rowId", client.insert("INSERT INTO Item (Name) VALUES (?)", "remote"));
+            try (SQLiteRowReader rows = client.query("SELECT count(*) FROM Item")) {
+                rows.moveToNext();
+                reply.putLong("count", rows.getLong(0));
+            }
+        } finally {
+            client.close();
+        }
+    }
+}
@@ -0,0 +1,323 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+
+import static org.junit.Assert.assertArrayEquals;
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertFalse;
+import static org.junit.Assert.assertNotEquals;
+import static org.junit.Assert.assertNull;
+import static org.junit.Assert.assertThrows;
+import static org.junit.Assert.assertTrue;
+
+/**
+ * Tests SQL functions built into the native library.
+ */
+@RunWith(AndroidJUnit4.class)
+public class SQLFunctionsTest {
+
+    private SQLiteConnection mDatabase;
+
+    @Before
+    public void setUp() {
+        mDatabase = SQLiteConnection.open(new SQLiteDelegate(null) {
+            @Override
+            public void onCreate(SQLiteConnection db) {}
+        });
+    }
+
+    @After
+    public void tearDown() {
+        mDatabase.close();
+    }
+
+    private long queryLong(String sql) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            return statement.executeForLong(Long.MIN_VALUE);
+        }
+    }
+
+    private String queryString(String sql) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            return statement.executeForString();
+        }
+    }
+
+    @Test
+    public void xxh3() {
+        // Reference values of XXH3_64bits
+        assertEquals(0x2D06800538D394C2L, queryLong("SELECT xxh3('')"));
+        assertEquals(0x2D06800538D394C2L, queryLong("SELECT xxh3(x'')"));
+        assertEquals(queryLong("SELECT xxh3(x'616263')"), queryLong("SELECT xxh3('abc')"));
+        assertEquals(1L, queryLong("SELECT xxh3(NULL) IS NULL"));
+
+        // Rows
+        assertNotEquals(queryLong("SELECT xxh3('ab', 'c')"), queryLong("SELECT xxh3('a', 'bc')"));
+        assertNotEquals(queryLong("SELECT xxh3(1, '1')"), queryLong("SELECT xxh3('1', 1)"));
+        assertNotEquals(queryLong("SELECT xxh3(NULL, 1)"), queryLong("SELECT xxh3(1, NULL)"));
+        assertEquals(queryLong("SELECT xxh3(1, 2.5, 'c', x'00')"), queryLong("SELECT xxh3(1, 2.5, 'c', x'00')"));
+
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT xxh3()"));
+    }
+
+    @Test
+    public void xxh3_128() {
+        assertEquals("99AA06D3014798D86001C324468D497F", queryString("SELECT hex(xxh3_128(''))"));
+        assertEquals("06B05AB6733A618578AF5F94892F3950", queryString("SELECT hex(xxh3_128('abc'))"));
+        assertNotEquals(queryString("SELECT hex(xxh3_128('ab', 'c'))"), queryString("SELECT hex(xxh3_128('a', 'bc'))"));
+    }
+
+    @Test
+    public void crc32c() {
+        assertEquals(0xE3069283L, queryLong("SELECT crc32c('123456789')"));
+        assertEquals(0xE3069283L, queryLong("SELECT crc32c('6789', crc32c('12345'))"));
+        assertEquals(queryLong("SELECT crc32c(zeroblob(1000) || 'x')"), queryLong("SELECT crc32c('x', crc32c(zeroblob(1000)))"));
+        assertEquals(1L, queryLong("SELECT crc32c(NULL) IS NULL"));
+    }
+
+    @Test
+    public void compress() {
+        assertEquals("hello", queryString("SELECT decompress(compress('hello'))"));
+        assertEquals("text", queryString("SELECT typeof(decompress(compress('hello')))"));
+        assertEquals("blob", queryString("SELECT typeof(decompress(compress(x'0102')))"));
+        assertEquals(1L, queryLong("SELECT decompress(compress(printf('%.*c', 10000, 'a'))) = printf('%.*c', 10000, 'a')"));
+        assertTrue(queryLong("SELECT length(compress(printf('%.*c', 10000, 'a')))") < 100);
+        assertEquals(5L, queryLong("SELECT decompress(compress(5))"));
+        assertEquals(1L, queryLong("SELECT decompress(compress(NULL)) IS NULL"));
+        assertEquals("", queryString("SELECT decompress(compress(''))"));
+
+        final String dictionary = "'the quick brown fox jumps over the lazy dog'";
+        final String value = "'the lazy dog jumps over the quick brown fox'";
+        assertTrue(queryLong("SELECT length(compress("+value+", "+dictionary+"))") < queryLong("SELECT length(compress("+value+"))"));
+        assertEquals(1L, queryLong("SELECT decompress(compress("+value+", "+dictionary+"), "+dictionary+") = "+value));
+        assertThrows(SQLiteException.class, () -> queryString("SELECT decompress(compress("+value+", "+dictionary+"))"));
+        assertThrows(SQLiteException.class, () -> queryString("SELECT decompress(compress("+value+", "+dictionary+"), 'other')"));
+        assertThrows(SQLiteException.class, () -> queryString("SELECT decompress(x'0102030405')"));
+    }
+
+    @Test
+    public void compressedStatement() {
+        final byte[] dictionary = "{\"type\":\"message\",\"body\":\"\"}".getBytes(StandardCharsets.UTF_8);
+        final String text = "{\"type\":\"message\",\"body\":\"Příliš žluťoučký kůň \uD83D\uDC0E\"}";
+        final byte[] blob = new byte[10000];
+        Arrays.fill(blob, (byte) 42);
+
+        mDatabase.command("CREATE TABLE Messages (Text, Blob)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Messages VALUES (?, ?)")) {
+            statement.setParameterCompressed(1, true);
+            statement.setParameterCompressed(2, true);
+            statement.setCompressionDictionary(dictionary);
+            statement.bind(1, text);
+            statement.bind(2, blob);
+            statement.executeForNothing();
+            statement.bind(1, (String) null);
+            statement.bind(2, 5);
+            statement.executeForNothing();
+        }
+        assertTrue(queryLong("SELECT length(Blob) FROM Messages WHERE rowid = 1") < 1000);
+        assertEquals("blob", queryString("SELECT typeof(Text) FROM Messages WHERE rowid = 1"));
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT Text, Blob FROM Messages ORDER BY rowid")) {
+            statement.setColumnCompressed(0, true);
+            statement.setColumnCompressed(1, true);
+            statement.setCompressionDictionary(dictionary);
+            assertTrue(statement.cursorNextRow());
+            assertEquals(text, statement.cursorGetString(0));
+            assertArrayEquals(blob, statement.cursorGetBlob(1));
+            assertTrue(statement.cursorNextRow());
+            assertNull(statement.cursorGetString(0));
+            assertEquals(5L, statement.cursorGetLong(1));
+            assertEquals("5", statement.cursorGetString(1));
+            assertFalse(statement.cursorNextRow());
+            statement.cursorReset();
+
+            statement.setCompressionDictionary(null);
+            assertTrue(statement.cursorNextRow());
+            assertThrows(SQLiteException.class, () -> statement.cursorGetBlob(1));
+            statement.cursorReset();
+        }
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT decompress(Text, ?) FROM Messages WHERE rowid = 1")) {
+            statement.bind(1, dictionary);
+            assertEquals(text, statement.executeForString());
+        }
+    }
+
+    private static byte[] vector(float... elements) {
+        final ByteBuffer buffer = ByteBuffer.allocate(elements.length * 4).order(ByteOrder.LITTLE_ENDIAN);
+        buffer.asFloatBuffer().put(elements);
+        return buffer.array();
+    }
+
+    private double queryVectors(String sql, byte[] a, byte[] b) {
+        try (SQLiteStatement statement = mDatabase.statement(sql)) {
+            statement.bind(1, a);
+            statement.bind(2, b);
+            assertTrue(statement.cursorNextRow());
+            return statement.cursorGetDouble(0);
+        }
+    }
+
+    @Test
+    public void vectors() {
+        final byte[] a = vector(1f, 2f, 3f, 4f, 5f, 6f, 7f, 8f, 9f);
+        final byte[] b = vector(9f, 8f, 7f, 6f, 5f, 4f, 3f, 2f, 1f);
+        assertEquals(165.0, queryVectors("SELECT vec_dot(?, ?)", a, b), 1e-4);
+        assertEquals(165.0 / 285.0, queryVectors("SELECT vec_cosine(?, ?)", a, b), 1e-6);
+        assertEquals(Math.sqrt(240.0), queryVectors("SELECT vec_l2(?, ?)", a, b), 1e-4);
+        assertEquals(165.0, queryVectors("SELECT vec_dot_f16(vec_f16(?), vec_f16(?))", a, b), 1e-4);
+        assertEquals(165.0 / 285.0, queryVectors("SELECT vec_cosine_i8(vec_i8(?, 10), vec_i8(?, 10))", a, b), 1e-6);
+        assertEquals(1L, queryLong("SELECT vec_cosine(x'00000000', x'0000803F') IS NULL"));
+        assertThrows(SQLiteException.class, () -> queryVectors("SELECT vec_dot(?, ?)", a, vector(1f)));
+
+        mDatabase.command("CREATE TABLE Embeddings (Vector BLOB)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Embeddings VALUES (?)")) {
+            for (int i = 0; i < 100; i++) {
+                statement.bind(1, vector(i, 100 - i));
+                statement.executeForNothing();
+            }
+        }
+        try (SQLiteStatement statement = mDatabase.statement("SELECT id, distance FROM vec_top_k(?, 3, 'Embeddings', 'Vector')")) {
+            statement.bind(1, vector(50.2f, 49.8f));
+            assertTrue(statement.cursorNextRow());
+            assertEquals(51L, statement.cursorGetLong(0));
+            assertTrue(statement.cursorNextRow());
+            assertEquals(52L, statement.cursorGetLong(0));
+            assertTrue(statement.cursorNextRow());
+            assertEquals(50L, statement.cursorGetLong(0));
+            assertFalse(statement.cursorNextRow());
+        }
+        try (SQLiteStatement statement = mDatabase.statement("SELECT id FROM vec_top_k(?, 1, 'Embeddings', 'Vector', 'cosine')")) {
+            statement.bind(1, vector(0f, 1f));
+            assertTrue(statement.cursorNextRow());
+            assertEquals(1L, statement.cursorGetLong(0));
+            assertFalse(statement.cursorNextRow());
+        }
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT count(*) FROM vec_top_k(X'0000803F00000000', 1000001, 'Embeddings', 'Vector')"));
+        // Reads any table, so it is not allowed where the SQL is not written by the application
+        mDatabase.command("CREATE VIEW Nearest AS SELECT id FROM vec_top_k(X'0000803F00000000', 1, 'Embeddings', 'Vector')");
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT id FROM Nearest"));
+    }
+
+    @Test
+    public void roaringBitmaps() {
+        mDatabase.command("CREATE TABLE Tags (Item INTEGER, Tag TEXT)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Tags VALUES (?, ?)")) {
+            final String[] tags = {"even", "three", "thousand"};
+            final int[] divisors = {2, 3, 1000};
+            for (int item = 0; item < 100000; item++) {
+                for (int t = 0; t < tags.length; t++) {
+                    if (item % divisors[t] != 0) continue;
+                    statement.bind(1, item);
+                    statement.bind(2, tags[t]);
+                    statement.executeForNothing();
+                }
+            }
+        }
+        mDatabase.command("CREATE TABLE TagBitmaps AS SELECT Tag, roaring_build(Item) AS Bitmap FROM Tags GROUP BY Tag");
+
+        assertEquals(50000L, queryLong("SELECT roaring_cardinality(Bitmap) FROM TagBitmaps WHERE Tag = 'even'"));
+        assertEquals(16667L, queryLong("SELECT roaring_cardinality(roaring_and_agg(Bitmap)) FROM TagBitmaps WHERE Tag IN ('even', 'three')"));
+        assertEquals(66667L, queryLong("SELECT roaring_cardinality(roaring_or_agg(Bitmap)) FROM TagBitmaps WHERE Tag IN ('even', 'three')"));
+        assertEquals(33333L, queryLong("SELECT roaring_cardinality(roaring_andnot(e.Bitmap, t.Bitmap)) FROM TagBitmaps e, TagBitmaps t WHERE e.Tag = 'even' AND t.Tag = 'three'"));
+        assertEquals(queryLong("SELECT count(*) FROM Tags a JOIN Tags b USING (Item) JOIN Tags c USING (Item) WHERE a.Tag = 'even' AND b.Tag = 'three' AND c.Tag = 'thousand'"),
+                queryLong("SELECT roaring_cardinality(roaring_and(a.Bitmap, b.Bitmap, c.Bitmap)) FROM TagBitmaps a, TagBitmaps b, TagBitmaps c WHERE a.Tag = 'even' AND b.Tag = 'three' AND c.Tag = 'thousand'"));
+        assertEquals(1L, queryLong("SELECT roaring_contains(Bitmap, 3000) FROM TagBitmaps WHERE Tag = 'thousand'"));
+        assertEquals(0L, queryLong("SELECT roaring_contains(Bitmap, 3001) FROM TagBitmaps WHERE Tag = 'thousand'"));
+
+        assertEquals("0,6000,12000", queryString("SELECT group_concat(value) FROM (SELECT value FROM roaring_each("
+                + "(SELECT roaring_and_agg(Bitmap) FROM TagBitmaps WHERE Tag IN ('even', 'three', 'thousand'))) LIMIT 3)"));
+        assertEquals(17L, queryLong("SELECT count(*) FROM Tags WHERE Tag = 'thousand' AND Item IN roaring_each("
+                + "(SELECT roaring_and_agg(Bitmap) FROM TagBitmaps WHERE Tag IN ('even', 'three')))"));
+
+        // Portable serialization format
+        assertEquals("3A300000010000000000020010000000010002000300", queryString("SELECT hex(roaring_build(column1)) FROM (VALUES (3), (1), (2), (2))"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT roaring_cardinality(x'0102')"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT roaring_build(-1)"));
+    }
+
+    @Test
+    public void sketches() {
+        mDatabase.command("CREATE TABLE Events (Day INTEGER, User INTEGER, Latency REAL)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Events VALUES (?, ?, ?)")) {
+            for (int i = 0; i < 100000; i++) {
+                statement.bind(1, i % 7);
+                statement.bind(2, (i * 7919) % 20000);
+                statement.bind(3, i % 1000);
+                statement.executeForNothing();
+            }
+        }
+        mDatabase.command("CREATE TABLE DailyRollups AS SELECT Day, hll(User) AS Users, tdigest(Latency) AS Latencies, cms(User % 100) AS Buckets FROM Events GROUP BY Day");
+
+        final long distinctUsers = queryLong("SELECT hll_count(hll_merge(Users)) FROM DailyRollups");
+        assertTrue(Math.abs(distinctUsers - 20000) < 20000 * 0.03);
+        assertEquals(distinctUsers, queryLong("SELECT hll_count(hll(User)) FROM Events"));
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT tdigest_quantile(tdigest_merge(Latencies), ?) FROM DailyRollups")) {
+            statement.bind(1, 0.5);
+            assertEquals(500.0, statement.executeForDouble(Double.NaN), 10.0);
+            statement.bind(1, 0.99);
+            assertEquals(990.0, statement.executeForDouble(Double.NaN), 5.0);
+            statement.bind(1, 1.0);
+            assertEquals(999.0, statement.executeForDouble(Double.NaN), 0.0);
+        }
+
+        final long bucketCount = queryLong("SELECT count(*) FROM Events WHERE User % 100 = 42");
+        final long bucketEstimate = queryLong("SELECT cms_estimate(cms_merge(Buckets), 42) FROM DailyRollups");
+        assertTrue(bucketEstimate >= bucketCount);
+        assertTrue(bucketEstimate < bucketCount * 1.1);
+
+        assertEquals(0L, queryLong("SELECT hll_count(hll(NULL))"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT hll_merge(Sketch) FROM (SELECT hll(1, 10) AS Sketch UNION ALL SELECT hll(1, 12))"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT hll_count(x'00')"));
+    }
+
+    @Test
+    public void timeSeries() {
+        assertEquals(120L, queryLong("SELECT time_bucket(125, 60)"));
+        assertEquals(-60L, queryLong("SELECT time_bucket(-1, 60)"));
+        assertEquals(70L, queryLong("SELECT time_bucket(125, 60, 10)"));
+        assertEquals("1.5", queryString("SELECT time_bucket(1.75, 0.5)"));
+        assertEquals(1L, queryLong("SELECT time_bucket(NULL, 60) IS NULL"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT time_bucket(1, 0)"));
+
+        mDatabase.command("CREATE TABLE Samples (Time INTEGER PRIMARY KEY, Value REAL)");
+        try (SQLiteStatement statement = mDatabase.statement("INSERT INTO Samples VALUES (?, ?)")) {
+            for (int i = 0; i < 100000; i++) {
+                statement.bind(1, i);
+                statement.bind(2, i == 54321 ? 1000.0 : Math.sin(i / 1000.0));
+                statement.executeForNothing();
+            }
+        }
+
+        try (SQLiteStatement statement = mDatabase.statement("SELECT lttb(Time, Value, 1000) FROM Samples")) {
+            assertTrue(statement.cursorNextRow());
+            final double[] points = new double[2000];
+            assertEquals(2000, statement.cursorGetDoubles(0, points));
+            assertEquals(0.0, points[0], 0.0);
+            assertEquals(99999.0, points[1998], 0.0);
+            boolean spike = false;
+            for (int i = 2; i < points.length; i += 2) {
+                assertTrue(points[i] > points[i - 2]);
+                spike |= points[i] == 54321.0 && points[i + 1] == 1000.0;
+            }
+            assertTrue("Outliers are kept", spike);
+        }
+
+        // Unordered input is sorted, short series are returned whole
+        assertEquals("00000000000000000000000000000000000000000000004000000000000014400000000000000840000000000000F03F", queryString(
+                "SELECT hex(lttb(column1, column2, 3)) FROM (VALUES (3, 1), (1, 2), (2, 5), (0, 0))"));
+        assertEquals(32L, queryLong("SELECT length(lttb(column1, column2, 3)) FROM (VALUES (1, 2), (0, 0))"));
+        assertThrows(SQLiteException.class, () -> queryLong("SELECT lttb(Time, Value, 2) FROM Samples"));
+    }
+}
@@ -0,0 +1,282 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+
+import java.util.ArrayList;
+
+/**
+ * Summary table with counts and sums of a source table grouped by some of its columns,
+ * kept up to date by triggers, so that dashboard queries read one row per group
+ * instead of scanning the whole source table.
+ * <pre>
+ *   SQLiteAggregateTable orderStats = new SQLiteAggregateTable("OrderStats", "Orders", "Status")
+ *           .count("Orders")
+ *           .sum("Revenue", "Price");
+ *   // In SQLiteDelegate.onCreate/onUpgrade:
+ *   orderStats.create(db);
+ *   // Later:
+ *   SELECT Status, Orders, Revenue FROM OrderStats
+ * </pre>
+ * The summary has the group columns, the row count column and the sum columns.
+ * Groups without rows are deleted.
+ * Sums behave like {@code coalesce(SUM(column), 0)}. Sums of REAL values may accumulate rounding errors,
+ * {@link #rebuild(SQLiteConnection)} recomputes them.
+ * Changes that bypass the triggers, such as rows deleted by {@code REPLACE} conflict resolution
+ * without {@code PRAGMA recursive_triggers}, can be detected with {@link #verify(SQLiteConnection)}.
+ * <p>
+ * This object only holds the definition, it is not bound to any connection.
+ */
+public final class SQLiteAggregateTable {
+
+    private final String name;
+    private final String source;
+    private final String[] groupColumns;
+    private String countColumn = "Count";
+    private final ArrayList<String> sumColumns = new ArrayList<>();
+    private final ArrayList<String> sumSourceColumns = new ArrayList<>();
+
+    /**
+     * @param name of the summary table
+     * @param source table to summarize
+     * @param groupColumns columns of the source to group by, may be empty for a single total row
+     */
+    public SQLiteAggregateTable(@NotNull String name, @NotNull String source, @NotNull String... groupColumns) {
+        this.name = name;
+        this.source = source;
+        this.groupColumns = groupColumns.clone();
+    }
+
+    /** Set the name of the column with row counts of each group ({@code COUNT(*)}), "Count" by default. */
+    public @NotNull SQLiteAggregateTable count(@NotNull String column) {
+        countColumn = column;
+        return this;
+    }
+
+    /** Add a column with {@code SUM(sourceColumn)} of each group. */
+    public @NotNull SQLiteAggregateTable sum(@NotNull String column, @NotNull String sourceColumn) {
+        sumColumns.add(column);
+        sumSourceColumns.add(sourceColumn);
+        return this;
+    }
+
+    /** @return name of the summary table */
+    public @NotNull String name() {
+        return name;
+    }
+
+    /**
+     * Create the summary table, its triggers and fill it from the source table.
+     * @throws SQLiteException if it already exists
+     */
+    public void create(@NotNull SQLiteConnection db) throws SQLiteException {
+        final StringBuilder sql = new StringBuilder();
+        sql.append("CREATE TABLE ").append(quote(name)).append(" (");
+        for (String column : groupColumns) {
+            sql.append(quote(column)).append(", ");
+        }
+        sql.append(quote(countColumn)).append(" INTEGER NOT NULL");
+        for (String column : sumColumns) {
+            sql.append(", ").append(quote(column)).append(" NOT NULL");
+        }
+        sql.append(')');
+
+        savepoint(db);
+        boolean success = false;
+        try {
+            db.command(sql.toString());
+            if (groupColumns.length > 0) {
+                sql.setLength(0);
+                sql.append("CREATE UNIQUE INDEX ").append(quote(name + "_groups")).append(" ON ").append(quote(name)).append(" (");
+                appendGroupColumns(sql, "");
+                sql.append(')');
+                db.command(sql.toString());
+            }
+
+            sql.setLength(0);
+            sql.append("CREATE TRIGGER ").append(quote(name + "_insert")).append(" AFTER INSERT ON ").append(quote(source)).append(" BEGIN ");
+            appendAdd(sql, "NEW.");
+            sql.append("END");
+            db.command(sql.toString());
+
+            sql.setLength(0);
+            sql.append("CREATE TRIGGER ").append(quote(name + "_delete")).append(" AFTER DELETE ON ").append(quote(source)).append(" BEGIN ");
+            appendRemove(sql, "OLD.");
+            sql.append("END");
+            db.command(sql.toString());
+
+            if (groupColumns.length > 0 || !sumColumns.isEmpty()) {
+                sql.setLength(0);
+                sql.append("CREATE TRIGGER ").append(quote(name + "_update")).append(" AFTER UPDATE OF ");
+                for (int i = 0; i < groupColumns.length; i++) {
+                    if (i > 0) sql.append(", ");
+                    sql.append(quote(groupColumns[i]));
+                }
+                for (int i = 0; i < sumSourceColumns.size(); i++) {
+                    if (i > 0 || groupColumns.length > 0) sql.append(", ");
+                    sql.append(quote(sumSourceColumns.get(i)));
+                }
+                sql.append(" ON ").append(quote(source)).append(" BEGIN ");
+                appendRemove(sql, "OLD.");
+                appendAdd(sql, "NEW.");
+                sql.append("END");
+                db.command(sql.toString());
+            }
+
+            fill(db);
+            success = true;
+        } finally {
+            release(db, success);
+        }
+    }
+
+    /** Drop the summary table with its triggers, if they exist. */
+    public void drop(@NotNull SQLiteConnection db) throws SQLiteException {
+        savepoint(db);
+        boolean success = false;
+        try {
+            db.command("DROP TRIGGER IF EXISTS " + quote(name + "_insert"));
+            db.command("DROP TRIGGER IF EXISTS " + quote(name + "_delete"));
+            db.command("DROP TRIGGER IF EXISTS " + quote(name + "_update"));
+            db.command("DROP TABLE IF EXISTS " + quote(name));
+            success = true;
+        } finally {
+            release(db, success);
+        }
+    }
+
+    /**
+     * Check that the summary table matches the source table.
+     * This scans the whole source table.
+     * @return true if the summary is correct
+     */
+    public boolean verify(@NotNull SQLiteConnection db) throws SQLiteException {
+        final String summary = summaryQuery();
+        final String stored = storedQuery();
+        final String sql = "SELECT count(*) FROM (SELECT * FROM (" + summary + " EXCEPT " + stored + ")"
+                + " UNION ALL SELECT * FROM (" + stored + " EXCEPT " + summary + "))";
+        try (SQLiteStatement statement = db.statement(sql)) {
+            return statement.executeForLong(-1) == 0;
+        }
+    }
+
+    /** Recompute the summary table from the source table. */
+    public void rebuild(@NotNull SQLiteConnection db) throws SQLiteException {
+        savepoint(db);
+        boolean success = false;
+        try {
+            db.command("DELETE FROM " + quote(name));
+            fill(db);
+            success = true;
+        } finally {
+            release(db, success);
+        }
+    }
+
+    private void fill(SQLiteConnection db) {
+        db.command("INSERT INTO " + quote(name) + " " + summaryQuery());
+    }
+
+    /** Summary computed from the source, in the column order of the table. */
+    private String summaryQuery() {
+        final StringBuilder sql = new StringBuilder("SELECT ");
+        appendGroupColumns(sql, "");
+        if (groupColumns.length > 0) sql.append(", ");
+        sql.append("count(*)");
+        for (String column : sumSourceColumns) {
+            sql.append(", coalesce(sum(").append(quote(column)).append("), 0)");
+        }
+        sql.append(" FROM ").append(quote(source));
+        if (groupColumns.length > 0) {
+            sql.append(" GROUP BY ");
+            appendGroupColumns(sql, "");
+        } else {
+            // No total row for an empty table
+            sql.append(" HAVING count(*) > 0");
+        }
+        return sql.toString();
+    }
+
+    private String storedQuery() {
+        final StringBuilder sql = new StringBuilder("SELECT ");
+        appendGroupColumns(sql, "");
+        if (groupColumns.length > 0) sql.append(", ");
+        sql.append(quote(countColumn));
+        for (String column : sumColumns) {
+            sql.append(", ").append(quote(column));
+        }
+        sql.append(" FROM ").append(quote(name));
+        return sql.toString();
+    }
+
+    private void appendGroupColumns(StringBuilder sql, String prefix) {
+        for (int i = 0; i < groupColumns.length; i++) {
+            if (i > 0) sql.append(", ");
+            sql.append(prefix).append(quote(groupColumns[i]));
+        }
+    }
+
+    /** WHERE clause matching the summary row of the group of the row. IS, because groups may be NULL. */
+    private void appendGroupCondition(StringBuilder sql, String row) {
+        sql.append(" WHERE ");
+        if (groupColumns.length == 0) {
+            sql.append("1");
+        }
+        for (int i = 0; i < groupColumns.length; i++) {
+            if (i > 0) sql.append(" AND ");
+            sql.append(quote(groupColumns[i])).append(" IS ").append(row).append(quote(groupColumns[i]));
+        }
+    }
+
+    private void appendAdd(StringBuilder sql, String row) {
+        // Create the group row if it does not exist yet
+        sql.append("INSERT INTO ").append(quote(name)).append(" SELECT ");
+        appendGroupColumns(sql, row);
+        if (groupColumns.length > 0) sql.append(", ");
+        sql.append('0');
+        for (int i = 0; i < sumColumns.size(); i++) {
+            sql.append(", 0");
+        }
+        sql.append(" WHERE NOT EXISTS (SELECT 1 FROM ").append(quote(name));
+        appendGroupCondition(sql, row);
+        sql.append("); ");
+
+        appendUpdate(sql, row, '+');
+    }
+
+    private void appendRemove(StringBuilder sql, String row) {
+        appendUpdate(sql, row, '-');
+
+        sql.append("DELETE FROM ").append(quote(name));
+        appendGroupCondition(sql, row);
+        sql.append(" AND ").append(quote(countColumn)).append(" <= 0; ");
+    }
+
+    private void appendUpdate(StringBuilder sql, String row, char operator) {
+        sql.append("UPDATE ").append(quote(name)).append(" SET ")
+                .append(quote(countColumn)).append(" = ").append(quote(countColumn)).append(' ').append(operator).append(" 1");
+        for (int i = 0; i < sumColumns.size(); i++) {
+            final String column = quote(sumColumns.get(i));
+            sql.append(", ").append(column).append(" = ").append(column).append(' ').append(operator)
+                    .append(" coalesce(").append(row).append(quote(sumSourceColumns.get(i))).append(", 0)");
+        }
+        appendGroupCondition(sql, row);
+        sql.append("; ");
+    }
+
+    // Savepoints work both inside and outside of transactions
+    private void savepoint(SQLiteConnection db) {
+        db.command("SAVEPOINT " + quote(name));
+    }
+
+    private void release(SQLiteConnection db, boolean success) {
+        if (!success) {
+            db.command("ROLLBACK TO " + quote(name));
+        }
+        db.command("RELEASE " + quote(name));
+    }
+
+    private static String quote(String identifier) {
+        return '"' + identifier.replace("\"", "\"\"") + '"';
+    }
+}
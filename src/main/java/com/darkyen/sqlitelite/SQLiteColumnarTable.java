@@ -0,0 +1,208 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+
+import static com.darkyen.sqlitelite.SQLiteNative.nativeCreateColumnarTable;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeDropColumnarTable;
+
+/**
+ * Read-only virtual table over columns of primitive values held in memory,
+ * for joining with data computed in Java without inserting it into a temporary table.
+ * <pre>
+ *   try (SQLiteColumnarTable scores = SQLiteColumnarTable.builder("scores", ids.length)
+ *           .sortedKey("id", ids)
+ *           .column("score", values)
+ *           .register(db)) {
+ *       ... SELECT Items.*, scores.score FROM Items JOIN scores ON scores.id = Items.id ...
+ *   }
+ * </pre>
+ * Columns of direct {@link ByteBuffer}s are read in place, so changes to them are visible to the following queries.
+ * Columns of arrays are copied once, when the table is registered.
+ * Rowid of the table is the index of the row.
+ * <p>
+ * When one column is declared as a sorted key, =, IN, &lt;, &lt;=, &gt;, &gt;= and ORDER BY on it
+ * are evaluated with binary search, so the table can be the inner table of a join without a full scan.
+ * <p>
+ * The table is visible only to the connection it is registered with, until closed.
+ * Real tables of the same name take precedence. Names of other virtual table modules
+ * and table-valued functions, such as json_each, can't be used.
+ */
+public final class SQLiteColumnarTable implements AutoCloseable {
+
+    /** 4 byte little-endian signed integers, INTEGER in SQL */
+    public static final int TYPE_INT32 = 1;
+    /** 8 byte little-endian signed integers, INTEGER in SQL */
+    public static final int TYPE_INT64 = 2;
+    /** 4 byte little-endian floats, REAL in SQL */
+    public static final int TYPE_FLOAT32 = 3;
+    /** 8 byte little-endian doubles, REAL in SQL */
+    public static final int TYPE_FLOAT64 = 4;
+
+    private final SQLiteConnection connection;
+    private final String name;
+    /** Keeps the buffers reachable while SQLite may read them. */
+    private Object[] data;
+
+    private SQLiteColumnarTable(SQLiteConnection connection, String name, Object[] data) {
+        this.connection = connection;
+        this.name = name;
+        this.data = data;
+    }
+
+    /**
+     * Start defining a new table.
+     * @param name of the table in SQL
+     * @param rowCount of the table, each column must have at least this many values
+     */
+    public static @NotNull Builder builder(@NotNull String name, int rowCount) {
+        if (rowCount < 0) throw new IllegalArgumentException("rowCount must not be negative: " + rowCount);
+        return new Builder(name, rowCount);
+    }
+
+    /** @return name of the table in SQL */
+    public @NotNull String name() {
+        return name;
+    }
+
+    /**
+     * Unregister the table. Statements that use it must be already closed or reset.
+     * Calling this again, or after the connection was closed, is a no-op.
+     */
+    @Override
+    public void close() {
+        if (data == null) return;
+        final long connectionPtr = connection.connectionPtrOrZero();
+        if (connectionPtr != 0) {
+            nativeDropColumnarTable(connectionPtr, name);
+        }
+        data = null;
+    }
+
+    public static final class Builder {
+        private final String name;
+        private final int rowCount;
+        private final ArrayList<String> columnNames = new ArrayList<>();
+        private final ArrayList<Object> columnData = new ArrayList<>();
+        private int[] columnTypes = new int[4];
+        private int sortedColumn = -1;
+
+        private Builder(String name, int rowCount) {
+            this.name = name;
+            this.rowCount = rowCount;
+        }
+
+        private Builder add(String name, Object data, int length, int type) {
+            if (length < rowCount) {
+                throw new IllegalArgumentException("Column " + name + " has " + length + " values, but the table has " + rowCount + " rows");
+            }
+            final int index = columnNames.size();
+            if (index == columnTypes.length) {
+                final int[] newColumnTypes = new int[index * 2];
+                System.arraycopy(columnTypes, 0, newColumnTypes, 0, index);
+                columnTypes = newColumnTypes;
+            }
+            columnNames.add(name);
+            columnData.add(data);
+            columnTypes[index] = type;
+            return this;
+        }
+
+        public @NotNull Builder column(@NotNull String name, @NotNull int[] values) {
+            return add(name, values, values.length, TYPE_INT32);
+        }
+
+        public @NotNull Builder column(@NotNull String name, @NotNull long[] values) {
+            return add(name, values, values.length, TYPE_INT64);
+        }
+
+        public @NotNull Builder column(@NotNull String name, @NotNull float[] values) {
+            return add(name, values, values.length, TYPE_FLOAT32);
+        }
+
+        public @NotNull Builder column(@NotNull String name, @NotNull double[] values) {
+            return add(name, values, values.length, TYPE_FLOAT64);
+        }
+
+        /**
+         * Add a column of values in a direct buffer, starting at its current position.
+         * The values must be little-endian and the buffer must not be modified while a query reads it.
+         * @param type one of TYPE_ constants
+         */
+        public @NotNull Builder column(@NotNull String name, @NotNull ByteBuffer values, int type) {
+            if (!values.isDirect()) throw new IllegalArgumentException("Buffer of column " + name + " is not direct");
+            final int elementSize;
+            switch (type) {
+                case TYPE_INT32:
+                case TYPE_FLOAT32:
+                    elementSize = 4;
+                    break;
+                case TYPE_INT64:
+                case TYPE_FLOAT64:
+                    elementSize = 8;
+                    break;
+                default:
+                    throw new IllegalArgumentException("Invalid type: " + type);
+            }
+            // Slice, so that the native address starts at the position
+            return add(name, values.slice(), values.remaining() / elementSize, type);
+        }
+
+        /**
+         * Add a column, whose values are in ascending order.
+         * Only one column can be the sorted key.
+         * Order of the values is not checked, queries with unsorted keys return wrong results.
+         */
+        public @NotNull Builder sortedKey(@NotNull String name, @NotNull int[] values) {
+            checkNotSorted();
+            return column(name, values).markSorted();
+        }
+
+        /** @see #sortedKey(String, int[]) */
+        public @NotNull Builder sortedKey(@NotNull String name, @NotNull long[] values) {
+            checkNotSorted();
+            return column(name, values).markSorted();
+        }
+
+        /** @see #sortedKey(String, int[]) */
+        public @NotNull Builder sortedKey(@NotNull String name, @NotNull double[] values) {
+            checkNotSorted();
+            return column(name, values).markSorted();
+        }
+
+        /** @see #sortedKey(String, int[]) */
+        public @NotNull Builder sortedKey(@NotNull String name, @NotNull ByteBuffer values, int type) {
+            checkNotSorted();
+            return column(name, values, type).markSorted();
+        }
+
+        private void checkNotSorted() {
+            if (sortedColumn != -1) throw new IllegalStateException("Table already has a sorted key");
+        }
+
+        private Builder markSorted() {
+            sortedColumn = columnNames.size() - 1;
+            return this;
+        }
+
+        /**
+         * Register the table with the connection.
+         * @throws SQLiteException if the table can't be created, for example when the name is already used by a module
+         */
+        public @NotNull SQLiteColumnarTable register(@NotNull SQLiteConnection connection) throws SQLiteException {
+            if (columnNames.isEmpty()) throw new IllegalStateException("Table has no columns");
+            final String[] names = columnNames.toArray(new String[0]);
+            final Object[] data = columnData.toArray();
+            // Explicit, because JNI can't tell arrays from direct buffers on all Android versions
+            final boolean[] direct = new boolean[data.length];
+            for (int i = 0; i < data.length; i++) {
+                direct[i] = data[i] instanceof ByteBuffer;
+            }
+            nativeCreateColumnarTable(connection.connectionPtr(), name, names, columnTypes, data, direct, rowCount, sortedColumn);
+            return new SQLiteColumnarTable(connection, name, data);
+        }
+    }
+}
@@ -8,14 +8,26 @@ import org.jetbrains.annotations.NotNull;
 import org.jetbrains.annotations.Nullable;
 
 import java.io.File;
+import java.lang.reflect.Field;
+import java.lang.reflect.Modifier;
+import java.nio.charset.StandardCharsets;
 import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.atomic.AtomicInteger;
 import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.locks.Lock;
+import java.util.concurrent.locks.ReentrantReadWriteLock;
 
 import static com.darkyen.sqlitelite.SQLiteNative.nativeClose;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeConfigure;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeExecutePragma;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeMemoryHighwater;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeMemoryUsed;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeOpen;
 import static com.darkyen.sqlitelite.SQLiteNative.nativePrepareStatement;
+import static com.darkyen.sqlitelite.SQLiteNative.nativePrepareStatementUtf8;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeReleaseMemory;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeSetFileGrowth;
 
 /**
  * A single connection to a database.
@@ -27,6 +39,7 @@ import static com.darkyen.sqlitelite.SQLiteNative.nativeReleaseMemory;
  */
 public class SQLiteConnection implements AutoCloseable {
     private final AtomicLong connectionPtr;
+    private final @Nullable String path;
 
     private boolean inTransaction = false;
     private boolean transactionSuccessful = false;
@@ -40,9 +53,22 @@ public class SQLiteConnection implements AutoCloseable {
     private final SQLiteStatement[] statementCache = new SQLiteStatement[STATEMENT_COUNT];
 
     private final ArrayList<SQLiteStatement> managedStatements = new ArrayList<>();
+    /** Some of the managed statements should be reset, see {@link SQLiteCursorTracker#heldCursors(long, boolean)}. */
+    volatile boolean cursorResetRequested = false;
+
+    /** Configuration applied by {@link SQLiteNative#nativeOpen}, must match OPEN_CONFIG_ constants in SQLiteNative.cpp. */
+    static final int OPEN_CONFIG_FOREIGN_KEYS = 0x1;
+    static final int OPEN_CONFIG_WAL = 0x2;
+
+    /** Global configuration can be changed only when this is 0. */
+    private static final AtomicInteger openConnections = new AtomicInteger();
+    /** Read-locked while a connection is opened and counted, write-locked while global configuration changes. */
+    private static final ReentrantReadWriteLock configurationLock = new ReentrantReadWriteLock();
 
     private SQLiteConnection(long connectionPtr) {
         this.connectionPtr = new AtomicLong(connectionPtr);
+        this.path = SQLiteNative.nativeDbFilename(connectionPtr);
+        openConnections.incrementAndGet();
     }
 
     long connectionPtr() {
@@ -51,6 +77,11 @@ public class SQLiteConnection implements AutoCloseable {
         return ptr;
     }
 
+    /** @return pointer of the connection or 0 if it is closed */
+    long connectionPtrOrZero() {
+        return connectionPtr.get();
+    }
+
     /**
      * Begins a transaction in DEFERRED mode.
      * Useful only when not using WAL journal mode (which is default).
@@ -186,7 +217,18 @@ public class SQLiteConnection implements AutoCloseable {
             e.addSuppressed(new SQLiteException("While preparing: '"+sql+"'"));
             throw e;
         }
-        return new SQLiteStatement(this, statementPtr);
+        return new SQLiteStatement(this, statementPtr, sql);
+    }
+
+    private @NotNull SQLiteStatement unmanagedStatement(@NotNull byte[] sql) {
+        long statementPtr;
+        try {
+            statementPtr = nativePrepareStatementUtf8(connectionPtr(), sql);
+        } catch (Exception e) {
+            e.addSuppressed(new SQLiteException("While preparing: '"+new String(sql, StandardCharsets.UTF_8)+"'"));
+            throw e;
+        }
+        return new SQLiteStatement(this, statementPtr, sql);
     }
 
     /**
@@ -200,12 +242,84 @@ public class SQLiteConnection implements AutoCloseable {
             @NotNull
             @Language("RoomSql"/*Should be just SQL, but that is not supported on community :( */)
             String sql) {
-        final SQLiteStatement statement = unmanagedStatement(sql);
+        return manage(unmanagedStatement(sql));
+    }
+
+    /**
+     * Create a new statement from UTF-8 encoded SQL, like {@link #statement(String)}.
+     * The SQL is passed to SQLite as is, without transcoding from UTF-16.
+     * The statement is prepared as long-lived, so use this for statements that are kept and reused,
+     * such as constants marked with {@link SQLiteSql}.
+     *
+     * @param sql one SQL command in UTF-8, without trailing semicolon
+     */
+    public @NotNull SQLiteStatement statement(@NotNull byte[] sql) {
+        return manage(unmanagedStatement(sql));
+    }
+
+    private @NotNull SQLiteStatement manage(@NotNull SQLiteStatement statement) {
         statement.managementIndex = managedStatements.size();
         managedStatements.add(statement);
         return statement;
     }
 
+    /**
+     * Prepare the SQL of all static fields marked with {@link SQLiteSql} in given classes,
+     * which checks its syntax and that the tables, columns and functions it uses exist.
+     * Nothing is executed. Call this from a test, on a database with the current schema,
+     * to find broken SQL before it runs.
+     * @throws SQLiteException listing all fields whose SQL could not be prepared
+     * @throws IllegalArgumentException if a marked field is not a static String or byte[]
+     */
+    public void validateSql(@NotNull Class<?>... classes) throws SQLiteException {
+        final StringBuilder errors = new StringBuilder();
+        for (Class<?> c : classes) {
+            for (Field field : c.getDeclaredFields()) {
+                if (!field.isAnnotationPresent(SQLiteSql.class)) continue;
+                final String fieldName = c.getName() + "." + field.getName();
+                if (!Modifier.isStatic(field.getModifiers())) {
+                    throw new IllegalArgumentException(fieldName + " is not static");
+                }
+                final Object sql;
+                try {
+                    field.setAccessible(true);
+                    sql = field.get(null);
+                } catch (IllegalAccessException e) {
+                    throw new IllegalArgumentException("Can't read " + fieldName, e);
+                }
+
+                final SQLiteStatement statement;
+                try {
+                    if (sql instanceof String) {
+                        statement = unmanagedStatement((String) sql);
+                    } else if (sql instanceof byte[]) {
+                        statement = unmanagedStatement((byte[]) sql);
+                    } else {
+                        throw new IllegalArgumentException(fieldName + " is not a String or byte[]");
+                    }
+                } catch (SQLiteException e) {
+                    errors.append('\n').append(fieldName).append(": ").append(e.getMessage());
+                    continue;
+                }
+                statement.close();
+            }
+        }
+        if (errors.length() > 0) {
+            throw new SQLiteException("Invalid SQL:" + errors);
+        }
+    }
+
+    /** Reset cursors of managed and cached statements on request of {@link SQLiteCursorTracker}. */
+    void resetRequestedCursors() {
+        cursorResetRequested = false;
+        for (final SQLiteStatement statement : statementCache) {
+            if (statement != null) statement.resetIfRequested();
+        }
+        for (int i = 0; i < managedStatements.size(); i++) {
+            managedStatements.get(i).resetIfRequested();
+        }
+    }
+
     void removeFromManaged(@NotNull SQLiteStatement statement) {
         final int managementIndex = statement.managementIndex;
         statement.managementIndex = -1;
@@ -259,6 +373,124 @@ public class SQLiteConnection implements AutoCloseable {
         }
     }
 
+    /** @return path of the main database file, null for in-memory and temporary databases */
+    public @Nullable String path() {
+        return path;
+    }
+
+    @Override
+    public String toString() {
+        return "SQLiteConnection@" + Integer.toHexString(System.identityHashCode(this)) + "(" + (path == null ? ":memory:" : path) + ")";
+    }
+
+    /**
+     * Get a statistic of this connection, see sqlite3_db_status.
+     * @param op one of SQLITE_DBSTATUS_ constants
+     * @param reset to reset the statistic to zero after reading it, where applicable
+     * @return current value of the statistic
+     * @throws SQLiteException if op is not known
+     */
+    public int status(int op, boolean reset) throws SQLiteException {
+        return SQLiteNative.nativeDbStatus(connectionPtr(), op, reset);
+    }
+
+    /**
+     * @return true if the connection is not in a transaction, including one started by a BEGIN or SAVEPOINT statement,
+     * see sqlite3_get_autocommit
+     */
+    public boolean isAutocommit() {
+        return SQLiteNative.nativeIsAutocommit(connectionPtr());
+    }
+
+    /**
+     * Import a CSV or NDJSON file into the table, like {@link #importFile(String, int, String, String[], int, int)}
+     * with batches of 10000 rows and at most 100 reported errors.
+     */
+    public @NotNull ImportResult importFile(@NotNull String path, int format, @NotNull String table, @NotNull String[] columns) throws SQLiteException {
+        return importFile(path, format, table, columns, 10_000, 100);
+    }
+
+    /**
+     * Import a CSV or NDJSON file into the table. The file is parsed natively and its values are bound
+     * to one prepared INSERT statement, without creating Java objects for rows.
+     * <ul>
+     *     <li>{@link #FORMAT_CSV} and {@link #FORMAT_CSV_HEADER}: field i is inserted into columns[i], or skipped if it is null.
+     *     Fields are inserted as TEXT and converted by column affinity, empty unquoted fields as NULL.</li>
+     *     <li>{@link #FORMAT_NDJSON}: one JSON object per line, the value of key columns[i] is inserted into columns[i].
+     *     Missing keys are NULL, other keys are ignored and nested objects and arrays are inserted as JSON TEXT.</li>
+     * </ul>
+     * Records which can't be parsed or violate a constraint are skipped and reported in the result.
+     * When this connection is not in a transaction, each batch of rows is committed in its own transaction,
+     * otherwise all rows are inserted into the current transaction.
+     *
+     * @param format one of FORMAT_ constants
+     * @param columns columns of the table, in the order of CSV fields
+     * @param batchRows rows inserted in one transaction
+     * @param maxErrors how many failed records are reported with their message, all of them are counted
+     * @throws SQLiteException if the file can't be read, the table or a column does not exist, or on a database error,
+     * in which case the rows of already committed batches stay in the table
+     */
+    public @NotNull ImportResult importFile(@NotNull String path, int format, @NotNull String table, @NotNull String[] columns,
+                                           int batchRows, int maxErrors) throws SQLiteException {
+        if (batchRows <= 0) throw new IllegalArgumentException("batchRows must be positive: " + batchRows);
+        final String[] errorMessages = new String[Math.max(maxErrors, 0)];
+        final long start = System.nanoTime();
+        final long[] result = SQLiteNative.nativeImportFile(connectionPtr(), path, format, table, columns, batchRows, errorMessages);
+        final long duration = System.nanoTime() - start;
+
+        final ArrayList<ImportResult.RecordError> errors = new ArrayList<>(result.length - 3);
+        for (int i = 3; i < result.length; i++) {
+            errors.add(new ImportResult.RecordError(result[i], errorMessages[i - 3]));
+        }
+        return new ImportResult(result[0], result[1], result[2], duration, errors);
+    }
+
+    /** Result of {@link #importFile(String, int, String, String[], int, int)}. */
+    public static final class ImportResult {
+        /** Records in the file, without the CSV header. */
+        public final long records;
+        public final long insertedRows;
+        public final long failedRecords;
+        public final long durationNanos;
+        /** The first failed records, at most maxErrors of them. */
+        public final @NotNull List<RecordError> errors;
+
+        ImportResult(long records, long insertedRows, long failedRecords, long durationNanos, @NotNull List<RecordError> errors) {
+            this.records = records;
+            this.insertedRows = insertedRows;
+            this.failedRecords = failedRecords;
+            this.durationNanos = durationNanos;
+            this.errors = errors;
+        }
+
+        public double rowsPerSecond() {
+            return durationNanos <= 0L ? 0.0 : insertedRows * 1_000_000_000.0 / durationNanos;
+        }
+
+        /** Record which was not imported. */
+        public static final class RecordError {
+            /** Line where the record starts, from 1. */
+            public final long line;
+            public final @NotNull String message;
+
+            RecordError(long line, @NotNull String message) {
+                this.line = line;
+                this.message = message;
+            }
+
+            @Override
+            public String toString() {
+                return "line " + line + ": " + message;
+            }
+        }
+
+        @Override
+        public String toString() {
+            return "ImportResult(" + insertedRows + "/" + records + " rows, " + failedRecords + " failed, "
+                    + (durationNanos / 1_000_000L) + " ms, " + Math.round(rowsPerSecond()) + " rows/s)";
+        }
+    }
+
     /**
      * Close the database connection.
      * Calling any other methods on it afterwards will throw {@link IllegalStateException}.
@@ -316,6 +548,7 @@ public class SQLiteConnection implements AutoCloseable {
                 throw t;
             }
             returnConnection = false;
+            openConnections.decrementAndGet();
         } finally {
             if (returnConnection) {
                 // Closing has failed, the database is not closed, return the pointer back so that it can be attempted again later
@@ -332,8 +565,19 @@ public class SQLiteConnection implements AutoCloseable {
      * @throws SQLiteException on any error
      */
     public static @NotNull SQLiteConnection open(@NotNull String path, int openFlags) throws SQLiteException {
-        long connectionPtr = nativeOpen(path, openFlags);
-        return new SQLiteConnection(connectionPtr);
+        return openCounted(path, openFlags, 0, null);
+    }
+
+    /** Open the connection with nativeOpen and count it, so that global configuration can't change in between. */
+    private static @NotNull SQLiteConnection openCounted(@NotNull String path, int openFlags, int configFlags,
+                                                         @Nullable int[] userVersionOut) throws SQLiteException {
+        final Lock lock = configurationLock.readLock();
+        lock.lock();
+        try {
+            return new SQLiteConnection(nativeOpen(path, openFlags, configFlags, userVersionOut));
+        } finally {
+            lock.unlock();
+        }
     }
 
     /**
@@ -344,19 +588,25 @@ public class SQLiteConnection implements AutoCloseable {
      */
     public static @NotNull SQLiteConnection open(SQLiteDelegate delegate) throws SQLiteException {
         final File file = delegate.file;
-        long connectionPtr = nativeOpen(
+        final boolean readOnly = (delegate.openFlags & SQLiteDatabase.OPEN_READONLY) != 0;
+        // Configuration and user_version in the same call as the open
+        final int[] userVersion = new int[1];
+        final SQLiteConnection connection = openCounted(
                 file == null ? ":memory:" : file.getAbsolutePath(),
-                delegate.openFlags);
-        final SQLiteConnection connection = new SQLiteConnection(connectionPtr);
+                delegate.openFlags, readOnly ? 0 : delegate.openConfig(), userVersion);
+        final long connectionPtr = connection.connectionPtr();
 
         // Initialize the database, possibly failing in the process
         try {
-            final int currentVersion = Integer.parseInt(nativeExecutePragma(connectionPtr, "PRAGMA user_version"));
+            final int currentVersion = userVersion[0];
             final int targetVersion = delegate.version;
 
-            boolean readOnly = (delegate.openFlags & SQLiteDatabase.OPEN_READONLY) != 0;
             if (!readOnly) {
                 delegate.onConfigure(connection);
+                // After onConfigure, which may switch to WAL
+                if (file != null && (delegate.fileChunkSize > 0 || delegate.walPreallocateSize > 0)) {
+                    nativeSetFileGrowth(connectionPtr, delegate.fileChunkSize, delegate.walPreallocateSize);
+                }
 
                 if (targetVersion > 0 && currentVersion != targetVersion) {
                     try {
@@ -405,6 +655,65 @@ public class SQLiteConnection implements AutoCloseable {
         return nativeReleaseMemory();
     }
 
+    private static final int SQLITE_CONFIG_MEMSTATUS = 9;
+    private static final int SQLITE_CONFIG_SORTERREF_SIZE = 28;
+
+    private static void configure(int option, int value) {
+        final Lock lock = configurationLock.writeLock();
+        lock.lock();
+        try {
+            if (openConnections.get() != 0) {
+                throw new IllegalStateException("Global configuration can't change while a connection is open");
+            }
+            nativeConfigure(option, value);
+        } finally {
+            lock.unlock();
+        }
+    }
+
+    /**
+     * Set the size from which columns are not copied into the sorter of ORDER BY with their whole rows,
+     * but read from their table again, after sorting. This saves memory (and copying) when sorting
+     * rows with large values, at the cost of one more lookup per returned row.
+     * <p>
+     * The size is estimated from the declared type of the column when the schema is read:
+     * length of text types with it, such as {@code VARCHAR(1000)}, 16 for other TEXT and BLOB columns,
+     * 4 for columns without a declared type and 0 for numeric columns, such as INTEGER or REAL,
+     * which are therefore never sorted by reference unless the size is 0.
+     * Only columns of ordinary rowid tables are affected.
+     * <p>
+     * Can be changed only when no connection is open, applies to connections opened later.
+     * @param size {@link Integer#MAX_VALUE} (default) to never use sorter references
+     * @throws IllegalStateException if a connection is open
+     */
+    public static void setSorterReferenceSize(int size) {
+        configure(SQLITE_CONFIG_SORTERREF_SIZE, size);
+    }
+
+    /**
+     * Enable or disable tracking of memory used by SQLite, for {@link #memoryUsed()} and {@link #memoryHighwater(boolean)}.
+     * Disabled by default, because the tracking makes allocations slower.
+     * Can be changed only when no connection is open.
+     * @throws IllegalStateException if a connection is open
+     */
+    public static void setMemoryStatistics(boolean enabled) {
+        configure(SQLITE_CONFIG_MEMSTATUS, enabled ? 1 : 0);
+    }
+
+    /** @return bytes of memory currently allocated by SQLite, 0 when memory statistics are disabled */
+    public static long memoryUsed() {
+        return nativeMemoryUsed();
+    }
+
+    /**
+     * @param reset to reset the highest value to the current value
+     * @return most bytes of memory allocated by SQLite at once since the last reset, 0 when memory statistics are disabled
+     * @see #setMemoryStatistics(boolean)
+     */
+    public static long memoryHighwater(boolean reset) {
+        return nativeMemoryHighwater(reset);
+    }
+
     public static final int SQLITE_OPEN_READONLY       = 0x00000001;
     public static final int SQLITE_OPEN_READWRITE      = 0x00000002;
     public static final int SQLITE_OPEN_CREATE         = 0x00000004;
@@ -412,4 +721,28 @@ public class SQLiteConnection implements AutoCloseable {
     public static final int SQLITE_OPEN_NOMUTEX        = 0x00008000;
     public static final int SQLITE_OPEN_FULLMUTEX      = 0x00010000;
     public static final int SQLITE_OPEN_NOFOLLOW       = 0x01000000;
+
+    /** Bytes of heap used by the page cache */
+    public static final int SQLITE_DBSTATUS_CACHE_USED = 1;
+    /** Bytes of heap used by the schema */
+    public static final int SQLITE_DBSTATUS_SCHEMA_USED = 2;
+    /** Bytes of heap used by prepared statements */
+    public static final int SQLITE_DBSTATUS_STMT_USED = 3;
+    /** Number of page cache hits */
+    public static final int SQLITE_DBSTATUS_CACHE_HIT = 7;
+    /** Number of page cache misses */
+    public static final int SQLITE_DBSTATUS_CACHE_MISS = 8;
+    /** Number of dirty pages written to the database file */
+    public static final int SQLITE_DBSTATUS_CACHE_WRITE = 9;
+    /** Number of dirty pages written in the middle of a transaction, because the cache was full */
+    public static final int SQLITE_DBSTATUS_CACHE_SPILL = 12;
+
+    /** CSV without a header line, must match FileFormat in SQLiteFileFormats.h */
+    public static final int FORMAT_CSV = 1;
+    /** CSV with a header line of column names, which is skipped on import */
+    public static final int FORMAT_CSV_HEADER = 2;
+    /** Newline delimited JSON objects */
+    public static final int FORMAT_NDJSON = 3;
+    /** Binary rows of {@link SQLiteStatement#executeForSharedMemory()}, export only */
+    public static final int FORMAT_ROWS = 4;
 }
@@ -0,0 +1,132 @@
+package com.darkyen.sqlitelite;
+
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
+
+/**
+ * Tracks statements of all connections, which are in the middle of a cursor
+ * ({@link SQLiteStatement#cursorNextRow()} returned a row, but the statement was not reset yet).
+ * Such statements hold a read transaction, which prevents WAL checkpoints from completing.
+ * <p>
+ * Leaked cursors can be found and reset periodically:
+ * <pre>
+ *   SQLiteCursorTracker.setEnabled(true);
+ *   SQLiteCursorTracker.setCaptureStacks(BuildConfig.DEBUG);
+ *   scheduler.scheduleWithFixedDelay(() -&gt; {
+ *       for (SQLiteCursorTracker.OpenCursor cursor : SQLiteCursorTracker.heldCursors(30_000, true)) {
+ *           Log.w(TAG, "Leaked cursor: " + cursor, cursor.stack);
+ *       }
+ *   }, 30, 30, TimeUnit.SECONDS);
+ * </pre>
+ * Disabled by default. When enabled, starting and ending a cursor costs one more set insertion and removal.
+ * Thread safe.
+ */
+public final class SQLiteCursorTracker {
+
+    private SQLiteCursorTracker() {}
+
+    static volatile boolean enabled = false;
+    private static volatile boolean captureStacks = false;
+    private static final Set<SQLiteStatement> cursors = Collections.newSetFromMap(new ConcurrentHashMap<>());
+
+    /** Enable or disable tracking of cursors started from now on. */
+    public static void setEnabled(boolean enabled) {
+        SQLiteCursorTracker.enabled = enabled;
+    }
+
+    public static boolean isEnabled() {
+        return enabled;
+    }
+
+    /**
+     * Capture the stack trace where each tracked cursor started, available as {@link OpenCursor#stack}.
+     * This makes starting a cursor considerably slower, use it to debug leaks.
+     */
+    public static void setCaptureStacks(boolean captureStacks) {
+        SQLiteCursorTracker.captureStacks = captureStacks;
+    }
+
+    public static boolean isCaptureStacks() {
+        return captureStacks;
+    }
+
+    static void started(SQLiteStatement statement) {
+        statement.cursorStack = captureStacks ? new Throwable("Cursor started here") : null;
+        statement.cursorSince = Math.max(System.nanoTime(), 1L);
+        cursors.add(statement);
+    }
+
+    static void ended(SQLiteStatement statement) {
+        statement.cursorSince = 0L;
+        statement.cursorStack = null;
+        cursors.remove(statement);
+    }
+
+    /** A statement in the middle of a cursor. */
+    public static final class OpenCursor {
+        /** Connection which holds the read transaction. */
+        public final @NotNull SQLiteConnection connection;
+        public final @NotNull String sql;
+        /** How long the cursor is open. */
+        public final long heldNanos;
+        /** Where the cursor started, null if {@link #setCaptureStacks(boolean)} was not enabled. */
+        public final @Nullable Throwable stack;
+
+        OpenCursor(@NotNull SQLiteConnection connection, @NotNull String sql, long heldNanos, @Nullable Throwable stack) {
+            this.connection = connection;
+            this.sql = sql;
+            this.heldNanos = heldNanos;
+            this.stack = stack;
+        }
+
+        @Override
+        public String toString() {
+            return connection + " holds '" + sql + "' for " + (heldNanos / 1_000_000L) + " ms";
+        }
+    }
+
+    /** @return statements in the middle of a cursor, longest held first */
+    public static @NotNull List<OpenCursor> openCursors() {
+        return heldCursors(0L, false);
+    }
+
+    /**
+     * Find cursors which are open for too long, most likely because they were never reset.
+     * <p>
+     * Statements are not thread safe, so a cursor can't be reset from here. When reset is requested,
+     * the cursor is reset by the thread that uses its connection next: either when it continues with the cursor,
+     * which then throws {@link IllegalStateException}, or when it executes any other statement of the connection.
+     * The read transaction is held until then.
+     *
+     * @param thresholdMillis report cursors held at least this long
+     * @param reset to request reset of the reported cursors
+     * @return statements in the middle of a cursor for at least thresholdMillis, longest held first
+     */
+    public static @NotNull List<OpenCursor> heldCursors(long thresholdMillis, boolean reset) {
+        final long now = System.nanoTime();
+        final long thresholdNanos = thresholdMillis * 1_000_000L;
+        final ArrayList<OpenCursor> result = new ArrayList<>();
+        for (SQLiteStatement statement : cursors) {
+            // Volatile cursorSince first, so that the stack is at least as new as the cursor it was read for
+            final long since = statement.cursorSince;
+            final Throwable stack = statement.cursorStack;
+            if (since == 0L) continue;// Ended meanwhile
+            final long held = now - since;
+            if (held < thresholdNanos) continue;
+            if (reset) {
+                // Only for this cursor, a cursor started after since was read is left alone
+                statement.resetRequestedFor = since;
+                statement.connection.cursorResetRequested = true;
+            }
+            result.add(new OpenCursor(statement.connection, statement.sql(), held, stack));
+        }
+        Collections.sort(result, (a, b) -> Long.compare(b.heldNanos, a.heldNanos));
+        return result;
+    }
+}
@@ -0,0 +1,87 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteDatabase;
+import android.database.sqlite.SQLiteException;
+import android.system.ErrnoException;
+import android.system.Os;
+import android.system.OsConstants;
+import org.jetbrains.annotations.NotNull;
+
+import java.io.File;
+import java.io.FileDescriptor;
+import java.io.IOException;
+
+import static com.darkyen.sqlitelite.SQLiteNative.nativeCloneDatabase;
+
+/**
+ * Operations on whole database files.
+ */
+public final class SQLiteDatabaseFiles {
+
+    private SQLiteDatabaseFiles() {}
+
+    // Must match CloneMethod in SQLiteDatabaseFiles.h
+    /** The clone shares its blocks with the template until either is written (FICLONE), so it takes no time or space. */
+    public static final int CLONE_REFLINK = 1;
+    /** The clone is a copy of the template file, the file system does not support FICLONE. Holes stay holes. */
+    public static final int CLONE_COPY = 2;
+    /** The clone was written page by page by the backup API, because other connections were using the template. */
+    public static final int CLONE_BACKUP = 3;
+
+    /**
+     * Create a database with the content of the template, for example a database with schema and seed data,
+     * instead of creating it with statements.
+     * <pre>
+     *   SQLiteDatabaseFiles.cloneFrom(template, accountFile);
+     *   SQLiteConnection db = SQLiteConnection.open(new AccountDelegate(accountFile));// Same version, no onCreate
+     * </pre>
+     * The WAL of the template is checkpointed and writers are locked out while the file is cloned,
+     * so the clone has all transactions committed to the template and does not need its WAL.
+     * When other connections read from the WAL or write, the pages are copied by the backup API instead.
+     * <p>
+     * The destination must not be open. It is replaced together with its WAL and other files,
+     * first the clone is written next to it.
+     * @param template connection to the template, not in a transaction
+     * @return one of CLONE_ constants, how the database was cloned
+     * @throws SQLiteException if the template can't be read or the clone written, in which case destination is not changed
+     */
+    public static int cloneFrom(@NotNull SQLiteConnection template, @NotNull File destination) throws SQLiteException {
+        final File clone = new File(destination.getPath() + "-clone");
+        boolean done = false;
+        try {
+            final int method = nativeCloneDatabase(template.connectionPtr(), clone.getAbsolutePath());
+            SQLiteDatabase.deleteDatabase(destination);
+            if (!clone.renameTo(destination)) {
+                throw new SQLiteException("Can't rename " + clone + " to " + destination);
+            }
+            done = true;
+            return method;
+        } finally {
+            if (!done) clone.delete();
+        }
+    }
+
+    /**
+     * Like {@link #cloneFrom(SQLiteConnection, File)}, with a connection to the template opened only for the clone.
+     * The connection is read-write, so that it can checkpoint the WAL of the template.
+     */
+    public static int cloneFrom(@NotNull File template, @NotNull File destination) throws SQLiteException {
+        try (SQLiteConnection db = SQLiteConnection.open(template.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE)) {
+            return cloneFrom(db, destination);
+        }
+    }
+
+    /** Sync the directory, so that files renamed into it are there also after a crash. */
+    static void syncDirectory(@NotNull File directory) throws IOException {
+        try {
+            final FileDescriptor fd = Os.open(directory.getPath(), OsConstants.O_RDONLY, 0);
+            try {
+                Os.fsync(fd);
+            } finally {
+                Os.close(fd);
+            }
+        } catch (ErrnoException e) {
+            throw e.rethrowAsIOException();
+        }
+    }
+}
@@ -16,7 +16,8 @@ import static com.darkyen.sqlitelite.SQLiteNative.nativeExecutePragma;
  * Provides configuration for newly opened {@link SQLiteConnection}.
  * Contains callbacks used for initial database configuration and version migrations.
  * <p>
- * Setting is in variables, such as {@link #version}, {@link #openFlags} and {@link #foreignKeyConstraintsEnabled}.
+ * Setting is in variables, such as {@link #version}, {@link #openFlags}, {@link #foreignKeyConstraintsEnabled},
+ * {@link #writeAheadLoggingEnabled}, {@link #fileChunkSize} and {@link #walPreallocateSize}.
  */
 public abstract class SQLiteDelegate {
     private static final String TAG = "SQLiteDelegate";
@@ -30,6 +31,25 @@ public abstract class SQLiteDelegate {
     protected int openFlags = SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOFOLLOW;
     /** True if foreign key constraints are enabled. Default is false. */
     protected boolean foreignKeyConstraintsEnabled = false;
+    /** True if the database file uses write-ahead logging journal mode. Default is true. */
+    protected boolean writeAheadLoggingEnabled = true;
+    /**
+     * When positive, the database file grows and shrinks in chunks of this many bytes (SQLITE_FCNTL_CHUNK_SIZE)
+     * instead of by pages, so write-heavy databases have fewer extents and change their size less often.
+     * Default is 0.
+     */
+    protected int fileChunkSize = 0;
+    /**
+     * When positive, the WAL is preallocated to this many bytes and is truncated back to this size when it is
+     * restarted after a checkpoint (journal_size_limit), instead of to 1 MiB. Keep it above the size of the WAL
+     * between automatic checkpoints, so that the WAL is only overwritten.
+     * Preallocation waits for writers, so it is skipped when they are busy for longer than the busy timeout.
+     * Only when the database is in WAL journal mode after {@link #onConfigure}. Default is 0.
+     */
+    protected int walPreallocateSize = 0;
+
+    /** True when {@link #onConfigure} is not overridden, so its settings are applied in the open call instead. */
+    private final boolean configureAtOpen;
 
     /**
      * Create a new delegate. Does not create the database, just this object.
@@ -37,6 +57,13 @@ public abstract class SQLiteDelegate {
      */
     protected SQLiteDelegate(@Nullable File file) {
         this.file = file;
+        boolean configureAtOpen;
+        try {
+            configureAtOpen = getClass().getMethod("onConfigure", SQLiteConnection.class).getDeclaringClass() == SQLiteDelegate.class;
+        } catch (NoSuchMethodException e) {
+            configureAtOpen = false;
+        }
+        this.configureAtOpen = configureAtOpen;
     }
 
     /**
@@ -51,17 +78,29 @@ public abstract class SQLiteDelegate {
      * database connection, such as executing PRAGMA statements.
      * </p>
      * Default implementation sets up {@link #foreignKeyConstraintsEnabled}
-     * and changes journal mode to WAL.
+     * and {@link #writeAheadLoggingEnabled}. When it is not overridden, they are set up
+     * in the open call instead. {@link #fileChunkSize} and {@link #walPreallocateSize}
+     * are applied after this is called.
      *
      * @param db The database.
      */
     public void onConfigure(SQLiteConnection db) {
+        if (configureAtOpen) return;// Already set up by openConfig()
         db.pragma("PRAGMA foreign_keys=" + (foreignKeyConstraintsEnabled ? "1" : "0"));
-        if (file != null) {
+        if (writeAheadLoggingEnabled && file != null) {
             db.pragma("PRAGMA journal_mode=wal");
         }
     }
 
+    /** @return OPEN_CONFIG_ flags of {@link SQLiteConnection} for the settings, when {@link #onConfigure} does not set them up */
+    int openConfig() {
+        if (!configureAtOpen) return 0;
+        int config = 0;
+        if (foreignKeyConstraintsEnabled) config |= SQLiteConnection.OPEN_CONFIG_FOREIGN_KEYS;
+        if (writeAheadLoggingEnabled && file != null) config |= SQLiteConnection.OPEN_CONFIG_WAL;
+        return config;
+    }
+
     /**
      * Called when the database is created for the first time. This is where the
      * creation of tables and the initial population of the tables should happen.
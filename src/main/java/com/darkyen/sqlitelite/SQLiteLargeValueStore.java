@@ -0,0 +1,336 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+
+import java.io.ByteArrayInputStream;
+import java.io.EOFException;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+
+/**
+ * Stores large BLOBs in files next to the database, while rows hold only a small reference to them.
+ * Large values in rows make long chains of overflow pages, which are copied through the WAL and the page cache
+ * on every write and read of the row.
+ * <pre>
+ *   SQLiteLargeValueStore store = new SQLiteLargeValueStore(new File(dbFile.getPath() + "-values"), 64 * 1024);
+ *   store.track(db, "Attachments", "Data");// Once, with the schema
+ *
+ *   insert.setLargeValueStore(store);
+ *   insert.bind(1, bytes);// Written to a file if it is large, the row gets a reference
+ *   query.setLargeValueStore(store);
+ *   query.cursorGetBlob(0);// Read from the file if the row has a reference
+ *
+ *   store.collectGarbage(db, 60 * 60 * 1000);// Periodically, deletes files of deleted values
+ * </pre>
+ * Files are named by SHA-256 of their content, so equal values are stored once.
+ * A file is written and synced, and renamed with its directory synced, before its reference is bound,
+ * so a committed reference always has its file, also after a crash.
+ * <p>
+ * Tracked columns have triggers, which count references to each file in the {@value #TABLE} table,
+ * in the same transaction as the change of the row. Files are deleted later by {@link #collectGarbage},
+ * when no row references them.
+ * The triggers use plain SQL, so the reference counts are maintained also by connections which don't use the store.
+ * Rows of tracked tables must not be replaced with {@code INSERT OR REPLACE} or {@code REPLACE}, because the rows
+ * it deletes don't fire DELETE triggers without {@code PRAGMA recursive_triggers}, and their files would be kept forever.
+ * Use an UPSERT ({@code INSERT ... ON CONFLICT DO UPDATE}) or an UPDATE instead.
+ * <p>
+ * Small values which look like a reference ({@link #isReference}) are stored in files too, so that they are not
+ * mistaken for one. Such values must not be written to tracked columns without the store.
+ * <p>
+ * Thread safe. Only one store should be used for a directory, because the store orders
+ * storing of values which already have a file with their deletion by {@link #collectGarbage}.
+ */
+public final class SQLiteLargeValueStore {
+
+    /** Table with the number of references to each file. */
+    public static final String TABLE = "sqlitelite_large_values";
+
+    // Reference: magic, length of the value (8 bytes little-endian), SHA-256 of the value
+    private static final byte[] MAGIC = {'S', 'Q', 'L', 'V'};
+    private static final int HASH_OFFSET = 12;
+    private static final int HASH_LENGTH = 32;
+    private static final int REFERENCE_LENGTH = HASH_OFFSET + HASH_LENGTH;
+    private static final String TEMPORARY_SUFFIX = ".tmp";
+
+    private final File directory;
+    private final int threshold;
+    /** Held while a file is reused by a new value or deleted as garbage. */
+    private final Object fileLock = new Object();
+
+    /**
+     * @param directory where the files are stored, created when needed. Should be used only for this store.
+     * @param threshold values of at least this many bytes are stored in files
+     */
+    public SQLiteLargeValueStore(@NotNull File directory, int threshold) {
+        if (threshold <= REFERENCE_LENGTH) throw new IllegalArgumentException("threshold must be larger than " + REFERENCE_LENGTH + ": " + threshold);
+        this.directory = directory;
+        this.threshold = threshold;
+    }
+
+    public @NotNull File directory() {
+        return directory;
+    }
+
+    public int threshold() {
+        return threshold;
+    }
+
+    /** SQL expression, which is the hash of the reference in the column, or NULL if it does not hold a reference. */
+    private static String referenceHash(String column) {
+        return "CASE WHEN typeof(" + column + ") = 'blob' AND length(" + column + ") = " + REFERENCE_LENGTH
+                + " AND substr(" + column + ", 1, 4) = X'53514C56' THEN substr(" + column + ", " + (HASH_OFFSET + 1) + ") END";
+    }
+
+    /**
+     * Count references in the column of the table and keep counting them on every change, with triggers.
+     * Call this for each column which holds references, before it gets any. Calling this again is a no-op.
+     * The rows of the table must not be replaced by {@code INSERT OR REPLACE}, see the class documentation.
+     */
+    public void track(@NotNull SQLiteConnection db, @NotNull String table, @NotNull String column) throws SQLiteException {
+        final String trigger = TABLE + "_" + table + "_" + column;
+        final String newHash = referenceHash("NEW." + quote(column));
+        final String oldHash = referenceHash("OLD." + quote(column));
+        final String addReference = "INSERT INTO " + TABLE + " (Hash, Refs) SELECT " + newHash + ", 1 WHERE " + newHash + " IS NOT NULL"
+                + " ON CONFLICT (Hash) DO UPDATE SET Refs = Refs + 1;";
+        final String removeReference = "UPDATE " + TABLE + " SET Refs = Refs - 1 WHERE Hash = " + oldHash + ";";
+
+        db.beginTransactionImmediate();
+        try {
+            db.command("CREATE TABLE IF NOT EXISTS " + TABLE + " (Hash BLOB PRIMARY KEY, Refs INTEGER NOT NULL) WITHOUT ROWID");
+            final boolean tracked;
+            try (SQLiteStatement exists = db.statement("SELECT count(*) FROM sqlite_master WHERE type = 'trigger' AND name = ?")) {
+                exists.bind(1, trigger + "_insert");
+                tracked = exists.executeForLong(0) > 0;
+            }
+            if (!tracked) {
+                // References which are already there
+                final String hash = referenceHash(quote(column));
+                db.command("INSERT INTO " + TABLE + " (Hash, Refs) SELECT " + hash + " AS h, count(*) FROM " + quote(table)
+                        + " WHERE h IS NOT NULL GROUP BY h ON CONFLICT (Hash) DO UPDATE SET Refs = Refs + excluded.Refs");
+                db.command("CREATE TRIGGER " + quote(trigger + "_insert") + " AFTER INSERT ON " + quote(table)
+                        + " BEGIN " + addReference + " END");
+                db.command("CREATE TRIGGER " + quote(trigger + "_delete") + " AFTER DELETE ON " + quote(table)
+                        + " BEGIN " + removeReference + " END");
+                db.command("CREATE TRIGGER " + quote(trigger + "_update") + " AFTER UPDATE OF " + quote(column)
+                        + " ON " + quote(table) + " WHEN " + oldHash + " IS NOT " + newHash
+                        + " BEGIN " + removeReference + " " + addReference + " END");
+            }
+            db.setTransactionSuccessful();
+        } finally {
+            db.endTransaction();
+        }
+    }
+
+    /** @return true if the value is a reference to a file of a store */
+    public static boolean isReference(@NotNull byte[] value) {
+        if (value.length != REFERENCE_LENGTH) return false;
+        for (int i = 0; i < MAGIC.length; i++) {
+            if (value[i] != MAGIC[i]) return false;
+        }
+        return true;
+    }
+
+    private static long referencedLength(byte[] reference) {
+        return ByteBuffer.wrap(reference, MAGIC.length, 8).order(ByteOrder.LITTLE_ENDIAN).getLong();
+    }
+
+    private static MessageDigest sha256() {
+        try {
+            return MessageDigest.getInstance("SHA-256");
+        } catch (NoSuchAlgorithmException e) {
+            throw new AssertionError("SHA-256 is always available", e);
+        }
+    }
+
+    private static final char[] HEX = "0123456789abcdef".toCharArray();
+
+    private File file(byte[] reference) {
+        final char[] name = new char[HASH_LENGTH * 2];
+        for (int i = 0; i < HASH_LENGTH; i++) {
+            final int b = reference[HASH_OFFSET + i] & 0xFF;
+            name[i * 2] = HEX[b >>> 4];
+            name[i * 2 + 1] = HEX[b & 0xF];
+        }
+        return new File(directory, new String(name));
+    }
+
+    private static byte[] reference(long length, byte[] hash) {
+        final byte[] reference = new byte[REFERENCE_LENGTH];
+        System.arraycopy(MAGIC, 0, reference, 0, MAGIC.length);
+        ByteBuffer.wrap(reference, MAGIC.length, 8).order(ByteOrder.LITTLE_ENDIAN).putLong(length);
+        System.arraycopy(hash, 0, reference, HASH_OFFSET, HASH_LENGTH);
+        return reference;
+    }
+
+    private File temporaryFile() throws IOException {
+        if (!directory.isDirectory() && !directory.mkdirs() && !directory.isDirectory()) {
+            throw new IOException("Can't create " + directory);
+        }
+        return File.createTempFile("value", TEMPORARY_SUFFIX, directory);
+    }
+
+    /** Move the synced temporary file to its final name, or keep the existing file with the same content. */
+    private byte[] commit(File temporary, long length, byte[] hash) throws IOException {
+        final byte[] reference = reference(length, hash);
+        final File file = file(reference);
+        synchronized (fileLock) {
+            if (file.length() == length) {
+                // Touch, so that garbage collection does not delete it before the reference is committed
+                file.setLastModified(System.currentTimeMillis());
+                temporary.delete();
+                return reference;
+            }
+            if (!temporary.renameTo(file)) {
+                temporary.delete();
+                throw new IOException("Can't rename " + temporary + " to " + file);
+            }
+        }
+        SQLiteDatabaseFiles.syncDirectory(directory);
+        return reference;
+    }
+
+    /**
+     * Store the value in a file, if it is at least {@link #threshold()} bytes long or if it looks like a reference.
+     * @return reference to bind instead of the value, or the value itself if it is small
+     */
+    public @NotNull byte[] put(@NotNull byte[] value) throws IOException {
+        if (value.length < threshold && !isReference(value)) return value;
+        final byte[] hash = sha256().digest(value);
+        final File temporary = temporaryFile();
+        try (FileOutputStream out = new FileOutputStream(temporary)) {
+            out.write(value);
+            out.getFD().sync();
+        } catch (IOException e) {
+            temporary.delete();
+            throw e;
+        }
+        return commit(temporary, value.length, hash);
+    }
+
+    /**
+     * Store the content of the stream in a file, regardless of its size.
+     * @return reference to bind instead of the value
+     */
+    public @NotNull byte[] put(@NotNull InputStream value) throws IOException {
+        final MessageDigest digest = sha256();
+        final File temporary = temporaryFile();
+        long length = 0;
+        try (FileOutputStream out = new FileOutputStream(temporary)) {
+            final byte[] buffer = new byte[64 * 1024];
+            int read;
+            while ((read = value.read(buffer)) > 0) {
+                digest.update(buffer, 0, read);
+                out.write(buffer, 0, read);
+                length += read;
+            }
+            out.getFD().sync();
+        } catch (IOException e) {
+            temporary.delete();
+            throw e;
+        }
+        return commit(temporary, length, digest.digest());
+    }
+
+    /**
+     * @param value as read from a column
+     * @return the referenced value read from its file, or the value itself if it is not a reference
+     * @throws IOException if the file can't be read
+     */
+    public @NotNull byte[] get(@NotNull byte[] value) throws IOException {
+        if (!isReference(value)) return value;
+        final long length = referencedLength(value);
+        if (length > Integer.MAX_VALUE - 8) throw new IOException("Value of " + length + " bytes does not fit into an array");
+        final byte[] result = new byte[(int) length];
+        try (FileInputStream in = new FileInputStream(file(value))) {
+            int offset = 0;
+            while (offset < result.length) {
+                final int read = in.read(result, offset, result.length - offset);
+                if (read < 0) throw new EOFException("Large value file is shorter than " + length + " bytes");
+                offset += read;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @param value as read from a column
+     * @return stream of the referenced file, or of the value itself if it is not a reference
+     * @throws IOException if the file can't be opened
+     */
+    public @NotNull InputStream open(@NotNull byte[] value) throws IOException {
+        if (!isReference(value)) return new ByteArrayInputStream(value);
+        return new FileInputStream(file(value));
+    }
+
+    /**
+     * Delete files which are not referenced from any tracked column.
+     * Files younger than minAgeMillis are kept, so that values which are stored but whose rows are not committed yet
+     * are not deleted. It must be longer than any transaction which stores values.
+     * @return number of deleted files
+     */
+    public int collectGarbage(@NotNull SQLiteConnection db, long minAgeMillis) throws SQLiteException {
+        final boolean hasTable;
+        try (SQLiteStatement exists = db.statement("SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = ?")) {
+            exists.bind(1, TABLE);
+            hasTable = exists.executeForLong(0) > 0;
+        }
+        if (hasTable) {
+            db.command("DELETE FROM " + TABLE + " WHERE Refs <= 0");
+        }
+
+        final File[] files = directory.listFiles();
+        if (files == null) return 0;
+        final long oldest = System.currentTimeMillis() - minAgeMillis;
+        int deleted = 0;
+        try (SQLiteStatement referenced = hasTable ? db.statement("SELECT count(*) FROM " + TABLE + " WHERE Hash = ?") : null) {
+            for (File file : files) {
+                if (file.lastModified() >= oldest) continue;
+                final String name = file.getName();
+                final boolean temporary = name.endsWith(TEMPORARY_SUFFIX);
+                if (!temporary) {
+                    final byte[] hash = parseHash(name);
+                    if (hash == null) continue;// Not ours
+                    if (referenced != null) {
+                        referenced.bind(1, hash);
+                        if (referenced.executeForLong(0) > 0) continue;
+                    }
+                }
+                synchronized (fileLock) {
+                    // The file could have been reused by a new value since it was checked
+                    if (file.lastModified() >= oldest) continue;
+                    if (file.delete()) deleted++;
+                }
+            }
+        }
+        return deleted;
+    }
+
+    private static byte[] parseHash(String name) {
+        if (name.length() != HASH_LENGTH * 2) return null;
+        final byte[] hash = new byte[HASH_LENGTH];
+        for (int i = 0; i < HASH_LENGTH; i++) {
+            final int high = Character.digit(name.charAt(i * 2), 16);
+            final int low = Character.digit(name.charAt(i * 2 + 1), 16);
+            if (high < 0 || low < 0) return null;
+            hash[i] = (byte) (high << 4 | low);
+        }
+        return hash;
+    }
+
+    private static String quote(String identifier) {
+        return '"' + identifier.replace("\"", "\"\"") + '"';
+    }
+
+    @Override
+    public String toString() {
+        return "SQLiteLargeValueStore(" + directory + ", " + threshold + " B)";
+    }
+}
@@ -0,0 +1,94 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+
+import static com.darkyen.sqlitelite.SQLiteNative.nativeCreateMembershipFilter;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeDropMembershipFilter;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeMembershipFilterContainsLongs;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeMembershipFilterContainsStrings;
+
+/**
+ * Native Bloom filter of the values of a column, which answers which of many values are in the table
+ * in one call. Only values that the filter may contain are looked up in the table, so the answers are exact.
+ * <pre>
+ *   try (SQLiteMembershipFilter ids = SQLiteMembershipFilter.create(db, "Items", "Id", 0.01)) {
+ *       boolean[] exists = new boolean[incomingIds.length];
+ *       ids.contains(incomingIds, exists);
+ *       ...
+ *   }
+ * </pre>
+ * The filter is built by reading the whole column, so keep it for many queries.
+ * It follows inserts and updates made through its connection with temporary triggers,
+ * and is rebuilt by the next query after another connection changes the database or after the table doubles.
+ * Deleted values only make the filter less effective.
+ * <p>
+ * Values are found only when queried with the type they are stored with, for example
+ * a number stored in a TEXT column is not found by {@link #contains(long[], boolean[])}.
+ * Not thread safe, use it like its connection.
+ */
+public final class SQLiteMembershipFilter implements AutoCloseable {
+
+    private final SQLiteConnection connection;
+    private long filterPtr;
+
+    private SQLiteMembershipFilter(SQLiteConnection connection, long filterPtr) {
+        this.connection = connection;
+        this.filterPtr = filterPtr;
+    }
+
+    /**
+     * Build a filter of the column of the table in the main database.
+     * @param falsePositiveRate fraction of absent values which are looked up in the table, between 0 and 1 exclusive
+     * @throws SQLiteException if the table or column does not exist
+     */
+    public static @NotNull SQLiteMembershipFilter create(@NotNull SQLiteConnection db, @NotNull String table,
+                                                         @NotNull String column, double falsePositiveRate) throws SQLiteException {
+        if (!(falsePositiveRate > 0.0 && falsePositiveRate < 1.0)) {
+            throw new IllegalArgumentException("falsePositiveRate must be between 0 and 1: " + falsePositiveRate);
+        }
+        return new SQLiteMembershipFilter(db, nativeCreateMembershipFilter(db.connectionPtr(), table, column, falsePositiveRate));
+    }
+
+    private long filterPtr() {
+        final long ptr = filterPtr;
+        if (ptr == 0) throw new IllegalStateException("Filter already closed");
+        return ptr;
+    }
+
+    /**
+     * Find out which INTEGER values are in the column.
+     * @param results set to whether the value at the same index is in the column, at least as long as values
+     * @return number of values in the column
+     */
+    public int contains(@NotNull long[] values, @NotNull boolean[] results) throws SQLiteException {
+        if (results.length < values.length) throw new IllegalArgumentException("results are shorter than values");
+        return nativeMembershipFilterContainsLongs(connection.connectionPtr(), filterPtr(), values, results);
+    }
+
+    /**
+     * Find out which TEXT values are in the column. Null values are not.
+     * @param results set to whether the value at the same index is in the column, at least as long as values
+     * @return number of values in the column
+     */
+    public int contains(@NotNull String[] values, @NotNull boolean[] results) throws SQLiteException {
+        if (results.length < values.length) throw new IllegalArgumentException("results are shorter than values");
+        return nativeMembershipFilterContainsStrings(connection.connectionPtr(), filterPtr(), values, results);
+    }
+
+    /**
+     * Remove the filter and its triggers.
+     * Calling this again, or after the connection was closed, is a no-op.
+     */
+    @Override
+    public void close() {
+        final long filterPtr = this.filterPtr;
+        if (filterPtr == 0) return;
+        this.filterPtr = 0;
+        // Closed connection has freed the filter
+        final long connectionPtr = connection.connectionPtrOrZero();
+        if (connectionPtr != 0) {
+            nativeDropMembershipFilter(connectionPtr, filterPtr);
+        }
+    }
+}
@@ -1,5 +1,8 @@
 package com.darkyen.sqlitelite;
 
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
 final class SQLiteNative {
     private SQLiteNative() {}
 
@@ -7,9 +10,10 @@ final class SQLiteNative {
         System.loadLibrary("sqlite3l");
     }
 
-    static native long nativeOpen(String path, int openFlags);
+    static native long nativeOpen(String path, int openFlags, int configFlags, int[] userVersionOut);
     static native void nativeClose(long connectionPtr);
     static native long nativePrepareStatement(long connectionPtr, String sql);
+    static native long nativePrepareStatementUtf8(long connectionPtr, byte[] sql);
     static native void nativeFinalizeStatement(long connectionPtr, long statementPtr);
     static native void nativeBindNull(long connectionPtr, long statementPtr,
                                               int index);
@@ -21,6 +25,12 @@ final class SQLiteNative {
                                                 int index, String value);
     static native void nativeBindBlob(long connectionPtr, long statementPtr,
                                               int index, byte[] value);
+    static native void nativeBindBlobCompressed(long connectionPtr, long statementPtr,
+                                              int index, byte[] value, byte[] dictionary);
+    static native void nativeBindStringCompressed(long connectionPtr, long statementPtr,
+                                              int index, String value, byte[] dictionary);
+    static native void nativeBindPrimitiveArray(long connectionPtr, long statementPtr,
+                                              int index, Object array, int elementSize);
 
     static native void nativeExecuteAndReset(long connectionPtr, long statementPtr);
     static native void nativeExecuteIgnoreAndReset(long connectionPtr, long statementPtr);
@@ -36,10 +46,39 @@ final class SQLiteNative {
     static native double nativeCursorGetDouble(long connectionPtr, long statementPtr, int index);
     static native String nativeCursorGetString(long connectionPtr, long statementPtr, int index);
     static native byte[] nativeCursorGetBlob(long connectionPtr, long statementPtr, int index);
+    static native String nativeCursorGetStringDecompressed(long connectionPtr, long statementPtr, int index, byte[] dictionary);
+    static native byte[] nativeCursorGetBlobDecompressed(long connectionPtr, long statementPtr, int index, byte[] dictionary);
+    static native int nativeCursorGetPrimitiveArray(long connectionPtr, long statementPtr, int index, Object dst, int elementSize);
     static native void nativeResetStatement(long statementPtr);
     static native void nativeClearBindings(long statementPtr);
 
+    static native int nativeExecuteForSharedMemoryAndReset(long connectionPtr, long statementPtr);
+    static native long nativeExportAndReset(long connectionPtr, long statementPtr, int format, int fd);
+    static native ByteBuffer nativeMapSharedMemory(int fd) throws IOException;
+    static native void nativeUnmapSharedMemory(ByteBuffer buffer);
+    static native ByteBuffer nativeExecuteForRowsAndReset(long connectionPtr, long statementPtr, int stride, long[] rowCountOut);
+    static native void nativeFreeRows(ByteBuffer buffer);
+
+    static native void nativeCreateColumnarTable(long connectionPtr, String name, String[] columnNames,
+                                                 int[] columnTypes, Object[] columnData, boolean[] columnDirect,
+                                                 int rowCount, int sortedColumn);
+    static native void nativeDropColumnarTable(long connectionPtr, String name);
+    static native long nativeCreateMembershipFilter(long connectionPtr, String table, String column, double falsePositiveRate);
+    static native void nativeDropMembershipFilter(long connectionPtr, long filterPtr);
+    static native int nativeMembershipFilterContainsLongs(long connectionPtr, long filterPtr, long[] values, boolean[] results);
+    static native int nativeMembershipFilterContainsStrings(long connectionPtr, long filterPtr, String[] values, boolean[] results);
+    static native long[] nativeImportFile(long connectionPtr, String path, int format, String table, String[] columns, int batchRows, String[] errorMessages);
+    static native int nativeCloneDatabase(long connectionPtr, String destPath);
+    static native void nativeSetFileGrowth(long connectionPtr, int chunkSize, int walSize);
+
     static native String nativeExecutePragma(long connectionPtr, String sql);
+    static native int nativeDbStatus(long connectionPtr, int op, boolean reset);
+    static native boolean nativeIsAutocommit(long connectionPtr);
+    static native int[] nativeWalCheckpoint(long connectionPtr, int mode);
+    static native String nativeDbFilename(long connectionPtr);
     static native void nativeInterrupt(long connectionPtr);
     static native int nativeReleaseMemory();
+    static native void nativeConfigure(int option, int value);
+    static native long nativeMemoryUsed();
+    static native long nativeMemoryHighwater(boolean reset);
 }
@@ -0,0 +1,164 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteDatabase;
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+
+import java.io.File;
+import java.util.Locale;
+
+/**
+ * Finds out which page size suits a database and its workload, and changes the page size of a database.
+ * <pre>
+ *   SQLitePageSizeAdvisor.Result[] results = SQLitePageSizeAdvisor.evaluate(db, context.getCacheDir(),
+ *           new int[]{4096, 8192, 16384}, 20, copy -&gt; {
+ *               ... run typical queries on copy ...
+ *           });
+ *   int pageSize = SQLitePageSizeAdvisor.fastest(results).pageSize;
+ *   // Later, in a maintenance window
+ *   SQLitePageSizeAdvisor.migrate(db, pageSize);
+ * </pre>
+ */
+public final class SQLitePageSizeAdvisor {
+
+    private SQLitePageSizeAdvisor() {}
+
+    /** Representative work done on the database. */
+    public interface Workload {
+        /** Do the work on the connection. It is a copy of the database, so it may be modified. */
+        void run(@NotNull SQLiteConnection db) throws Exception;
+    }
+
+    /** Measurement of a workload with one page size. */
+    public static final class Result {
+        public final int pageSize;
+        /** How many times per second the workload ran. */
+        public final double runsPerSecond;
+        /** Size of the database file with this page size, before the workload ran. */
+        public final long fileSize;
+        /** Fraction of page reads served from the page cache. */
+        public final double cacheHitRate;
+
+        Result(int pageSize, double runsPerSecond, long fileSize, double cacheHitRate) {
+            this.pageSize = pageSize;
+            this.runsPerSecond = runsPerSecond;
+            this.fileSize = fileSize;
+            this.cacheHitRate = cacheHitRate;
+        }
+
+        @Override
+        public String toString() {
+            return String.format(Locale.ROOT, "%6d B pages: %10.2f runs/second, %d KiB, %.1f%% cache hits",
+                    pageSize, runsPerSecond, fileSize / 1024, cacheHitRate * 100.0);
+        }
+    }
+
+    private static void checkPageSize(int pageSize) {
+        if (pageSize < 512 || pageSize > 65536 || (pageSize & (pageSize - 1)) != 0) {
+            throw new IllegalArgumentException("Page size must be a power of two between 512 and 65536: " + pageSize);
+        }
+    }
+
+    /**
+     * Copy the database once for each page size and measure how the workload performs on the copy.
+     * Each copy starts with a cold page cache and uses the journal mode of the original.
+     * The original database is only read.
+     * @param db the original database
+     * @param directory for temporary copies of the database, which need as much space as the database
+     * @param pageSizes to try
+     * @param runs how many times to run the workload on each copy
+     * @throws SQLiteException if the database can't be copied
+     * @throws RuntimeException when the workload fails, with the failure as its cause
+     */
+    public static @NotNull Result[] evaluate(@NotNull SQLiteConnection db, @NotNull File directory, @NotNull int[] pageSizes,
+                                             int runs, @NotNull Workload workload) throws SQLiteException {
+        if (runs <= 0) throw new IllegalArgumentException("runs must be positive: " + runs);
+        for (int pageSize : pageSizes) {
+            checkPageSize(pageSize);
+        }
+        final String journalMode = db.pragma("PRAGMA journal_mode");
+
+        final Result[] results = new Result[pageSizes.length];
+        for (int i = 0; i < pageSizes.length; i++) {
+            final int pageSize = pageSizes[i];
+            final File copy = new File(directory, "page_size_" + pageSize + ".db");
+            SQLiteDatabase.deleteDatabase(copy);
+            try {
+                try (SQLiteStatement vacuum = db.statement("VACUUM INTO ?")) {
+                    vacuum.bind(1, copy.getPath());
+                    vacuum.executeForNothing();
+                }
+                try (SQLiteConnection copyDb = SQLiteConnection.open(copy.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE)) {
+                    // Copies are made in rollback journal mode, in which page size can change
+                    copyDb.pragma("PRAGMA page_size=" + pageSize);
+                    copyDb.command("VACUUM");
+                    copyDb.pragma("PRAGMA journal_mode=" + journalMode);
+                }
+                final long fileSize = copy.length();
+
+                // Reopen for a cold cache
+                try (SQLiteConnection copyDb = SQLiteConnection.open(copy.getPath(), SQLiteConnection.SQLITE_OPEN_READWRITE)) {
+                    copyDb.status(SQLiteConnection.SQLITE_DBSTATUS_CACHE_HIT, true);
+                    copyDb.status(SQLiteConnection.SQLITE_DBSTATUS_CACHE_MISS, true);
+                    final long start = System.nanoTime();
+                    for (int run = 0; run < runs; run++) {
+                        try {
+                            workload.run(copyDb);
+                        } catch (RuntimeException e) {
+                            throw e;
+                        } catch (Exception e) {
+                            throw new RuntimeException("Workload failed", e);
+                        }
+                    }
+                    final long duration = System.nanoTime() - start;
+                    final long hits = copyDb.status(SQLiteConnection.SQLITE_DBSTATUS_CACHE_HIT, false);
+                    final long misses = copyDb.status(SQLiteConnection.SQLITE_DBSTATUS_CACHE_MISS, false);
+                    results[i] = new Result(pageSize, runs / (duration / 1_000_000_000.0), fileSize,
+                            hits + misses == 0 ? 1.0 : (double) hits / (hits + misses));
+                }
+            } finally {
+                SQLiteDatabase.deleteDatabase(copy);
+            }
+        }
+        return results;
+    }
+
+    /** @return the result with the highest throughput */
+    public static @NotNull Result fastest(@NotNull Result[] results) {
+        if (results.length == 0) throw new IllegalArgumentException("No results");
+        Result fastest = results[0];
+        for (Result result : results) {
+            if (result.runsPerSecond > fastest.runsPerSecond) fastest = result;
+        }
+        return fastest;
+    }
+
+    /**
+     * Change the page size of the database, by rebuilding it with VACUUM.
+     * This rewrites the whole database, needs free space for a temporary copy of it and blocks other connections
+     * until done, so do this in a maintenance window. WAL databases are switched to rollback journal mode
+     * for the change, which requires that no other connection has the database open, and switched back.
+     * Does nothing if the page size is already the same.
+     * @throws SQLiteException if the page size did not change, for example because the database is in a transaction
+     */
+    public static void migrate(@NotNull SQLiteConnection db, int pageSize) throws SQLiteException {
+        checkPageSize(pageSize);
+        if (Integer.toString(pageSize).equals(db.pragma("PRAGMA page_size"))) return;
+
+        final boolean wal = "wal".equalsIgnoreCase(db.pragma("PRAGMA journal_mode"));
+        if (wal && !"delete".equalsIgnoreCase(db.pragma("PRAGMA journal_mode=DELETE"))) {
+            throw new SQLiteException("Can't leave WAL mode to change the page size, is the database open elsewhere?");
+        }
+        try {
+            db.pragma("PRAGMA page_size=" + pageSize);
+            db.command("VACUUM");
+        } finally {
+            if (wal) db.pragma("PRAGMA journal_mode=WAL");
+        }
+
+        final String newPageSize = db.pragma("PRAGMA page_size");
+        if (!Integer.toString(pageSize).equals(newPageSize)) {
+            throw new SQLiteException("Page size is " + newPageSize + " instead of " + pageSize);
+        }
+    }
+}
@@ -0,0 +1,174 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import android.net.LocalSocket;
+import android.net.LocalSocketAddress;
+import android.os.Process;
+import org.jetbrains.annotations.NotNull;
+
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.HashMap;
+import java.util.List;
+
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_CLOSE_STATEMENT;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_EXECUTE;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_EXECUTE_BATCH;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_INSERT;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_PREPARE;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.OP_QUERY;
+import static com.darkyen.sqlitelite.SQLiteQueryServer.STATUS_OK;
+
+/**
+ * Executes statements on the connection of a {@link SQLiteQueryServer}, usually in another process.
+ * Statements are prepared on the server the first time their SQL is used and then only referenced.
+ * Parameters can be null, Long, Integer, Short, Byte, Boolean (as 0 or 1), Double, Float, String or byte[],
+ * other types throw {@link IllegalArgumentException}.
+ * Note that, unlike in {@link SQLiteStatement}, parameter at index 0 of the array is bound to parameter 1.
+ * <p>
+ * Each call is executed in its own transaction on the server, a batch in one transaction.
+ * Statements which would leave the transaction open, such as BEGIN or SAVEPOINT, are rolled back and fail.
+ * Not thread safe, but several clients can be connected at once.
+ */
+public final class SQLiteQueryClient implements AutoCloseable {
+
+    private final LocalSocket socket;
+    private final DataInputStream in;
+    private final DataOutputStream out;
+    /** Statement ids by their SQL. */
+    private final HashMap<String, Integer> statements = new HashMap<>();
+
+    private SQLiteQueryClient(LocalSocket socket) throws IOException {
+        this.socket = socket;
+        this.in = new DataInputStream(new BufferedInputStream(socket.getInputStream(), 64 * 1024));
+        this.out = new DataOutputStream(new BufferedOutputStream(socket.getOutputStream(), 64 * 1024));
+    }
+
+    /**
+     * Connect to the server with the name in the abstract namespace.
+     * Any app can bind a name there, so the server must run with the same user id as this process.
+     * @throws IOException if there is no such server, or it is of another user id
+     */
+    public static @NotNull SQLiteQueryClient connect(@NotNull String name) throws IOException {
+        final LocalSocket socket = new LocalSocket();
+        try {
+            socket.connect(new LocalSocketAddress(name));
+            final int uid = socket.getPeerCredentials().getUid();
+            if (uid != Process.myUid()) throw new IOException("Server " + name + " is of another uid " + uid);
+            return new SQLiteQueryClient(socket);
+        } catch (IOException e) {
+            socket.close();
+            throw e;
+        }
+    }
+
+    /** Send the request and read the status of the response. */
+    private void finishRequest() throws IOException {
+        out.flush();
+        final int status = in.readByte();
+        if (status != STATUS_OK) {
+            throw new SQLiteException(new String(SQLiteQueryServer.readBytes(in), StandardCharsets.UTF_8));
+        }
+    }
+
+    private int statementId(String sql) throws IOException {
+        final Integer cached = statements.get(sql);
+        if (cached != null) return cached;
+        out.writeByte(OP_PREPARE);
+        SQLiteQueryServer.writeBytes(out, sql.getBytes(StandardCharsets.UTF_8));
+        finishRequest();
+        final int id = in.readInt();
+        statements.put(sql, id);
+        return id;
+    }
+
+    private void request(byte op, String sql, Object[] parameters) throws IOException {
+        SQLiteQueryServer.checkParameters(parameters);
+        final int id = statementId(sql);
+        out.writeByte(op);
+        out.writeInt(id);
+        SQLiteQueryServer.writeParameters(out, parameters);
+        finishRequest();
+    }
+
+    /**
+     * Fully execute the query on the server and receive all of its rows.
+     * @return rows, like {@link SQLiteStatement#executeForRows()}
+     * @throws SQLiteException on any error of the statement
+     * @throws IOException if the connection to the server failed
+     */
+    public @NotNull SQLiteRowReader query(@NotNull String sql, @NotNull Object... parameters) throws IOException {
+        request(OP_QUERY, sql, parameters);
+        return new SQLiteRowReader(ByteBuffer.wrap(SQLiteQueryServer.readBytes(in)));
+    }
+
+    /**
+     * Fully execute the statement on the server.
+     * @return number of changed rows, like {@link SQLiteStatement#executeForChangedRowCount()}
+     * @throws SQLiteException on any error of the statement
+     * @throws IOException if the connection to the server failed
+     */
+    public long execute(@NotNull String sql, @NotNull Object... parameters) throws IOException {
+        request(OP_EXECUTE, sql, parameters);
+        return in.readLong();
+    }
+
+    /**
+     * Fully execute the insert statement on the server.
+     * @return ROWID of the inserted row, like {@link SQLiteStatement#executeForRowID()}
+     * @throws SQLiteException on any error of the statement
+     * @throws IOException if the connection to the server failed
+     */
+    public long insert(@NotNull String sql, @NotNull Object... parameters) throws IOException {
+        request(OP_INSERT, sql, parameters);
+        return in.readLong();
+    }
+
+    /**
+     * Execute the statement once for each of the parameter arrays, in one transaction on the server.
+     * All of them are sent in one message.
+     * @return total number of changed rows
+     * @throws SQLiteException on any error of the statement, in which case no changes are made
+     * @throws IllegalArgumentException if the batch has more than 1048576 parameter arrays
+     * @throws IOException if the connection to the server failed
+     */
+    public long executeBatch(@NotNull String sql, @NotNull List<Object[]> batch) throws IOException {
+        if (batch.size() > SQLiteQueryServer.MAX_BATCH_SIZE) throw new IllegalArgumentException("Batch is too large: " + batch.size());
+        for (Object[] parameters : batch) {
+            SQLiteQueryServer.checkParameters(parameters);
+        }
+        final int id = statementId(sql);
+        out.writeByte(OP_EXECUTE_BATCH);
+        out.writeInt(id);
+        out.writeInt(batch.size());
+        for (Object[] parameters : batch) {
+            SQLiteQueryServer.writeParameters(out, parameters);
+        }
+        finishRequest();
+        return in.readLong();
+    }
+
+    /**
+     * Close the statement with the SQL on the server, if it was prepared.
+     * Statements are closed when the client disconnects, so this is only needed for clients with many statements.
+     */
+    public void closeStatement(@NotNull String sql) throws IOException {
+        final Integer id = statements.remove(sql);
+        if (id == null) return;
+        out.writeByte(OP_CLOSE_STATEMENT);
+        out.writeInt(id);
+        finishRequest();
+    }
+
+    /** Disconnect from the server, which closes the statements of this client. Calling this again is a no-op. */
+    @Override
+    public void close() throws IOException {
+        statements.clear();
+        socket.close();
+    }
+}
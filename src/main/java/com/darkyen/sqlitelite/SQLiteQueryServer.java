@@ -0,0 +1,415 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import android.net.LocalServerSocket;
+import android.net.LocalSocket;
+import android.net.LocalSocketAddress;
+import android.os.Process;
+import android.util.Log;
+import org.jetbrains.annotations.NotNull;
+
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.HashMap;
+
+/**
+ * Serves statements of one connection to {@link SQLiteQueryClient}s in other processes of the same app,
+ * over a Unix domain socket in the abstract namespace.
+ * <pre>
+ *   // In the process which owns the database
+ *   SQLiteQueryServer server = new SQLiteQueryServer(db, context.getPackageName() + ".db");
+ *
+ *   // In other processes
+ *   try (SQLiteQueryClient client = SQLiteQueryClient.connect(context.getPackageName() + ".db");
+ *        SQLiteRowReader rows = client.query("SELECT Id, Name FROM Item WHERE Category = ?", category)) {
+ *       ...
+ *   }
+ * </pre>
+ * All processes then share one page cache and one writer, instead of coordinating through file locks
+ * and the WAL index. Only processes with the same user id as the server may connect.
+ * <p>
+ * Each client is served by its own thread, statements are executed while holding the monitor of the connection,
+ * so the owning process should also synchronize on it when it uses the connection.
+ * A statement which leaves the connection in a transaction, such as BEGIN or SAVEPOINT, is rolled back
+ * and fails, because the transaction would block all other clients.
+ * Statements are prepared once per client and kept until it disconnects.
+ * Query results are sent in one message in the format of {@link SQLiteStatement#executeForRows()},
+ * so bound their size with LIMIT.
+ */
+public final class SQLiteQueryServer implements AutoCloseable {
+
+    private static final String TAG = "SQLiteQueryServer";
+
+    // Protocol: each request is an opcode byte and its arguments, each response a status byte and its result.
+    // Numbers are big-endian, strings and byte arrays are prefixed by their length as int.
+    /** sql string -&gt; int statement id */
+    static final byte OP_PREPARE = 1;
+    /** int statement id, parameters -&gt; int length, serialized rows */
+    static final byte OP_QUERY = 2;
+    /** int statement id, parameters -&gt; long changed rows */
+    static final byte OP_EXECUTE = 3;
+    /** int statement id, parameters -&gt; long row id */
+    static final byte OP_INSERT = 4;
+    /** int statement id, int count, count times parameters -&gt; long changed rows, all in one transaction */
+    static final byte OP_EXECUTE_BATCH = 5;
+    /** int statement id -&gt; nothing */
+    static final byte OP_CLOSE_STATEMENT = 6;
+
+    static final byte STATUS_OK = 0;
+    /** Followed by the message string */
+    static final byte STATUS_ERROR = 1;
+
+    // Parameters are an int count and a type byte with a value for each, types are the same as in SQLite
+    static final byte TYPE_INTEGER = 1;
+    static final byte TYPE_FLOAT = 2;
+    static final byte TYPE_TEXT = 3;
+    static final byte TYPE_BLOB = 4;
+    static final byte TYPE_NULL = 5;
+
+    /** Longest string or byte array accepted from the other side. */
+    static final int MAX_LENGTH = 256 * 1024 * 1024;
+    /** Most parameter arrays in one batch accepted from the other side. */
+    static final int MAX_BATCH_SIZE = 1024 * 1024;
+
+    private final SQLiteConnection db;
+    private final String name;
+    private final LocalServerSocket serverSocket;
+    private final ArrayList<LocalSocket> clients = new ArrayList<>();
+    private final ArrayList<Thread> clientThreads = new ArrayList<>();
+    private volatile boolean closed = false;
+
+    /**
+     * Start serving the connection on a socket with the name in the abstract namespace.
+     * @throws IOException if the name is already in use
+     */
+    public SQLiteQueryServer(@NotNull SQLiteConnection db, @NotNull String name) throws IOException {
+        this.db = db;
+        this.name = name;
+        this.serverSocket = new LocalServerSocket(name);
+        final Thread acceptThread = new Thread(this::acceptClients, TAG + " " + name);
+        acceptThread.setDaemon(true);
+        acceptThread.start();
+    }
+
+    private void acceptClients() {
+        while (!closed) {
+            final LocalSocket client;
+            try {
+                client = serverSocket.accept();
+            } catch (IOException e) {
+                if (!closed) Log.e(TAG, "Failed to accept client", e);
+                return;
+            }
+            synchronized (clients) {
+                if (closed) {
+                    closeQuietly(client);
+                    return;
+                }
+                clients.add(client);
+                final Thread clientThread = new Thread(() -> serveClient(client), TAG + " client");
+                clientThread.setDaemon(true);
+                clientThreads.add(clientThread);
+                clientThread.start();
+            }
+        }
+    }
+
+    private void serveClient(LocalSocket client) {
+        final HashMap<Integer, SQLiteStatement> statements = new HashMap<>();
+        try {
+            if (client.getPeerCredentials().getUid() != Process.myUid()) {
+                Log.w(TAG, "Refused client of uid " + client.getPeerCredentials().getUid());
+                return;
+            }
+            final DataInputStream in = new DataInputStream(new BufferedInputStream(client.getInputStream(), 64 * 1024));
+            final DataOutputStream out = new DataOutputStream(new BufferedOutputStream(client.getOutputStream(), 64 * 1024));
+            int nextStatementId = 1;
+            while (true) {
+                final int op = in.read();
+                if (op == -1) break;// Disconnected
+
+                // Arguments are read before locking the connection, so that a slow client does not block others
+                int id = 0;
+                String sql = null;
+                Object[] parameters = null;
+                Object[][] batch = null;
+                switch (op) {
+                    case OP_PREPARE:
+                        sql = new String(readBytes(in), StandardCharsets.UTF_8);
+                        break;
+                    case OP_QUERY:
+                    case OP_EXECUTE:
+                    case OP_INSERT:
+                        id = in.readInt();
+                        parameters = readParameters(in);
+                        break;
+                    case OP_EXECUTE_BATCH: {
+                        id = in.readInt();
+                        final int count = in.readInt();
+                        if (count < 0 || count > MAX_BATCH_SIZE) throw new IOException("Invalid batch size " + count);
+                        batch = new Object[count][];
+                        for (int i = 0; i < count; i++) {
+                            batch[i] = readParameters(in);
+                        }
+                        break;
+                    }
+                    case OP_CLOSE_STATEMENT:
+                        id = in.readInt();
+                        break;
+                    default:
+                        throw new IOException("Unknown operation " + op);
+                }
+
+                // Rows are in native memory, which does not need the lock, so they are sent after releasing it
+                SQLiteRowReader rows = null;
+                long result = 0;
+                try {
+                    synchronized (db) {
+                        final boolean autocommit = db.isAutocommit();
+                        switch (op) {
+                            case OP_PREPARE:
+                                statements.put(nextStatementId, db.statement(sql));
+                                result = nextStatementId++;
+                                break;
+                            case OP_QUERY:
+                                rows = bound(statements, id, parameters).executeForRows();
+                                break;
+                            case OP_EXECUTE:
+                                result = bound(statements, id, parameters).executeForChangedRowCount();
+                                break;
+                            case OP_INSERT:
+                                result = bound(statements, id, parameters).executeForRowID();
+                                break;
+                            case OP_EXECUTE_BATCH: {
+                                final SQLiteStatement statement = statement(statements, id);
+                                db.beginTransactionImmediate();
+                                try {
+                                    for (Object[] batchParameters : batch) {
+                                        bind(statement, batchParameters);
+                                        result += statement.executeForChangedRowCount();
+                                    }
+                                    db.setTransactionSuccessful();
+                                } finally {
+                                    db.endTransaction();
+                                }
+                                break;
+                            }
+                            case OP_CLOSE_STATEMENT: {
+                                final SQLiteStatement statement = statements.remove(id);
+                                if (statement != null) statement.close();
+                                break;
+                            }
+                        }
+                        if (autocommit && !db.isAutocommit()) {
+                            db.command("ROLLBACK");
+                            if (rows != null) rows.close();
+                            throw new SQLiteException("Statements must not leave a transaction open, it was rolled back");
+                        }
+                    }
+                } catch (SQLiteException | IllegalStateException | IllegalArgumentException e) {
+                    out.writeByte(STATUS_ERROR);
+                    writeBytes(out, String.valueOf(e.getMessage()).getBytes(StandardCharsets.UTF_8));
+                    out.flush();
+                    continue;
+                }
+
+                out.writeByte(STATUS_OK);
+                if (op == OP_PREPARE) {
+                    out.writeInt((int) result);
+                } else if (op == OP_QUERY) {
+                    try {
+                        writeRows(out, rows);
+                    } finally {
+                        rows.close();
+                    }
+                } else if (op != OP_CLOSE_STATEMENT) {
+                    out.writeLong(result);
+                }
+                out.flush();
+            }
+        } catch (IOException e) {
+            if (!closed) Log.w(TAG, "Client failed", e);
+        } finally {
+            synchronized (db) {
+                for (SQLiteStatement statement : statements.values()) {
+                    statement.close();
+                }
+            }
+            synchronized (clients) {
+                clients.remove(client);
+                clientThreads.remove(Thread.currentThread());
+            }
+            closeQuietly(client);
+        }
+    }
+
+    private static SQLiteStatement statement(HashMap<Integer, SQLiteStatement> statements, int id) {
+        final SQLiteStatement statement = statements.get(id);
+        if (statement == null) throw new IllegalArgumentException("Unknown statement " + id);
+        return statement;
+    }
+
+    private static SQLiteStatement bound(HashMap<Integer, SQLiteStatement> statements, int id, Object[] parameters) {
+        final SQLiteStatement statement = statement(statements, id);
+        bind(statement, parameters);
+        return statement;
+    }
+
+    private static void writeRows(DataOutputStream out, SQLiteRowReader rows) throws IOException {
+        final ByteBuffer serialized = rows.serialized();
+        out.writeInt(serialized.remaining());
+        final byte[] chunk = new byte[Math.min(serialized.remaining(), 64 * 1024)];
+        while (serialized.hasRemaining()) {
+            final int length = Math.min(chunk.length, serialized.remaining());
+            serialized.get(chunk, 0, length);
+            out.write(chunk, 0, length);
+        }
+    }
+
+    private static void bind(SQLiteStatement statement, Object[] parameters) {
+        statement.clearBindings();
+        for (int i = 0; i < parameters.length; i++) {
+            final Object parameter = parameters[i];
+            if (parameter == null) {
+                statement.bindNull(i + 1);
+            } else if (parameter instanceof Long) {
+                statement.bind(i + 1, (long) (Long) parameter);
+            } else if (parameter instanceof Double) {
+                statement.bind(i + 1, (double) (Double) parameter);
+            } else if (parameter instanceof String) {
+                statement.bind(i + 1, (String) parameter);
+            } else {
+                statement.bind(i + 1, (byte[]) parameter);
+            }
+        }
+    }
+
+    static byte[] readBytes(DataInputStream in) throws IOException {
+        final int length = in.readInt();
+        if (length < 0 || length > MAX_LENGTH) throw new IOException("Invalid length " + length);
+        final byte[] bytes = new byte[length];
+        in.readFully(bytes);
+        return bytes;
+    }
+
+    static void writeBytes(DataOutputStream out, byte[] bytes) throws IOException {
+        out.writeInt(bytes.length);
+        out.write(bytes);
+    }
+
+    /** @return Long, Double, String, byte[] or null for each parameter */
+    static Object[] readParameters(DataInputStream in) throws IOException {
+        final int count = in.readInt();
+        if (count < 0 || count > 32766) throw new IOException("Invalid parameter count " + count);
+        final Object[] parameters = new Object[count];
+        for (int i = 0; i < count; i++) {
+            final int type = in.readByte();
+            switch (type) {
+                case TYPE_INTEGER: parameters[i] = in.readLong(); break;
+                case TYPE_FLOAT: parameters[i] = in.readDouble(); break;
+                case TYPE_TEXT: parameters[i] = new String(readBytes(in), StandardCharsets.UTF_8); break;
+                case TYPE_BLOB: parameters[i] = readBytes(in); break;
+                case TYPE_NULL: break;
+                default: throw new IOException("Invalid parameter type " + type);
+            }
+        }
+        return parameters;
+    }
+
+    /** @throws IllegalArgumentException for parameters which {@link #writeParameters} can't write */
+    static void checkParameters(Object[] parameters) {
+        for (Object parameter : parameters) {
+            if (parameter != null && !(parameter instanceof Number || parameter instanceof Boolean
+                    || parameter instanceof String || parameter instanceof byte[])) {
+                throw new IllegalArgumentException("Unsupported parameter type " + parameter.getClass().getName());
+            }
+        }
+    }
+
+    /**
+     * Write the parameters checked by {@link #checkParameters(Object[])}.
+     * Integer types and Boolean are sent as INTEGER, other numbers as FLOAT.
+     */
+    static void writeParameters(DataOutputStream out, Object[] parameters) throws IOException {
+        out.writeInt(parameters.length);
+        for (Object parameter : parameters) {
+            if (parameter == null) {
+                out.writeByte(TYPE_NULL);
+            } else if (parameter instanceof Long || parameter instanceof Integer || parameter instanceof Short || parameter instanceof Byte) {
+                out.writeByte(TYPE_INTEGER);
+                out.writeLong(((Number) parameter).longValue());
+            } else if (parameter instanceof Boolean) {
+                out.writeByte(TYPE_INTEGER);
+                out.writeLong((Boolean) parameter ? 1L : 0L);
+            } else if (parameter instanceof Number) {
+                out.writeByte(TYPE_FLOAT);
+                out.writeDouble(((Number) parameter).doubleValue());
+            } else if (parameter instanceof String) {
+                out.writeByte(TYPE_TEXT);
+                writeBytes(out, ((String) parameter).getBytes(StandardCharsets.UTF_8));
+            } else {
+                out.writeByte(TYPE_BLOB);
+                writeBytes(out, (byte[]) parameter);
+            }
+        }
+    }
+
+    private static void closeQuietly(LocalSocket socket) {
+        try {
+            socket.close();
+        } catch (IOException ignored) {}
+    }
+
+    /**
+     * Stop accepting clients, disconnect the connected ones and wait until they are done with the connection,
+     * which stays open. Must not be called while holding the monitor of the connection.
+     * Calling this again is a no-op.
+     */
+    @Override
+    public void close() {
+        if (closed) return;
+        closed = true;
+        // Closing the server socket does not interrupt accept(), connecting does
+        final LocalSocket wakeUp = new LocalSocket();
+        try {
+            wakeUp.connect(new LocalSocketAddress(name));
+        } catch (IOException ignored) {
+        } finally {
+            closeQuietly(wakeUp);
+        }
+        try {
+            serverSocket.close();
+        } catch (IOException ignored) {}
+        final ArrayList<Thread> threads;
+        synchronized (clients) {
+            for (LocalSocket client : clients) {
+                try {
+                    client.shutdownInput();
+                } catch (IOException ignored) {}
+            }
+            threads = new ArrayList<>(clientThreads);
+        }
+        boolean interrupted = false;
+        for (Thread thread : threads) {
+            while (thread.isAlive()) {
+                try {
+                    thread.join();
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+        }
+        if (interrupted) Thread.currentThread().interrupt();
+    }
+
+    @Override
+    public String toString() {
+        return "SQLiteQueryServer(" + name + ", " + db + ")";
+    }
+}
@@ -0,0 +1,293 @@
+package com.darkyen.sqlitelite;
+
+import android.database.Cursor;
+import android.os.ParcelFileDescriptor;
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+
+/**
+ * Random access reader of rows serialized by {@link SQLiteStatement#executeForSharedMemory()}
+ * or {@link SQLiteStatement#executeForRows()}.
+ * Values are read directly from the buffer, no rows are copied.
+ * Not thread safe.
+ */
+public final class SQLiteRowReader implements AutoCloseable {
+
+    private static final int MAGIC = 0x524C5153;// "SQLR"
+    private static final int VERSION = 1;
+    private static final int HEADER_LENGTH = 32;
+
+    // Type bytes of the format, same as in SQLite
+    private static final byte SQLITE_INTEGER = 1;
+    private static final byte SQLITE_FLOAT = 2;
+    private static final byte SQLITE_TEXT = 3;
+    private static final byte SQLITE_BLOB = 4;
+    private static final byte SQLITE_NULL = 5;
+
+    /** Buffer is owned by the caller. */
+    private static final int MEMORY_EXTERNAL = 0;
+    /** Buffer is a mapping of shared memory. */
+    private static final int MEMORY_MAPPED = 1;
+    /** Buffer was allocated by SQLite. */
+    private static final int MEMORY_NATIVE = 2;
+
+    private ByteBuffer buffer;
+    private final int memory;
+    private final String[] columnNames;
+    private final int rowCount;
+    private final int rowIndexOffset;
+
+    private int position = -1;
+    /** Offsets of the type bytes of the columns of the current row. */
+    private final int[] columnOffsets;
+
+    private SQLiteRowReader(ByteBuffer buffer, int memory) {
+        // Read-only, because writing to a read-only mapping would crash the process instead of throwing
+        this.buffer = buffer = buffer.slice().asReadOnlyBuffer().order(ByteOrder.LITTLE_ENDIAN);
+        this.memory = memory;
+        if (buffer.remaining() < HEADER_LENGTH || buffer.getInt(0) != MAGIC) {
+            throw new IllegalArgumentException("Not serialized rows");
+        }
+        if (buffer.getInt(4) != VERSION) {
+            throw new IllegalArgumentException("Unsupported version of serialized rows: " + buffer.getInt(4));
+        }
+        final int columnCount = buffer.getInt(8);
+        final long rowCount = buffer.getLong(16);
+        final long rowIndexOffset = buffer.getLong(24);
+        if (columnCount < 0 || rowCount < 0 || rowIndexOffset < HEADER_LENGTH
+                || rowIndexOffset + rowCount * 8 > buffer.limit()) {
+            throw new IllegalArgumentException("Corrupted serialized rows");
+        }
+        this.rowCount = (int) rowCount;
+        this.rowIndexOffset = (int) rowIndexOffset;
+
+        columnNames = new String[columnCount];
+        int offset = HEADER_LENGTH;
+        for (int i = 0; i < columnCount; i++) {
+            final int length = buffer.getInt(offset);
+            columnNames[i] = readString(offset + 4, length);
+            offset += 4 + length;
+        }
+        columnOffsets = new int[columnCount];
+    }
+
+    /**
+     * Read rows from a buffer, starting at its position.
+     * The buffer must not be modified while it is read.
+     */
+    public SQLiteRowReader(@NotNull ByteBuffer buffer) {
+        this(buffer, MEMORY_EXTERNAL);
+    }
+
+    /**
+     * Map the shared memory region read-only. The descriptor can be closed afterwards,
+     * the mapping stays valid until {@link #close()}.
+     * @throws IOException if the region can't be mapped
+     * @throws IllegalArgumentException if the region does not contain serialized rows
+     */
+    public static @NotNull SQLiteRowReader map(@NotNull ParcelFileDescriptor fd) throws IOException {
+        final ByteBuffer buffer = SQLiteNative.nativeMapSharedMemory(fd.getFd());
+        try {
+            return new SQLiteRowReader(buffer, MEMORY_MAPPED);
+        } catch (Throwable t) {
+            SQLiteNative.nativeUnmapSharedMemory(buffer);
+            throw t;
+        }
+    }
+
+    /** Take ownership of rows allocated by {@link SQLiteNative#nativeExecuteForRowsAndReset(long, long, int, long[])}. */
+    static @NotNull SQLiteRowReader adoptNative(@NotNull ByteBuffer buffer) {
+        try {
+            return new SQLiteRowReader(buffer, MEMORY_NATIVE);
+        } catch (Throwable t) {
+            SQLiteNative.nativeFreeRows(buffer);
+            throw t;
+        }
+    }
+
+    private ByteBuffer buffer() {
+        final ByteBuffer buffer = this.buffer;
+        if (buffer == null) throw new IllegalStateException("Reader already closed");
+        return buffer;
+    }
+
+    /** @return the serialized rows, for example to send them to another process */
+    @NotNull ByteBuffer serialized() {
+        return buffer().duplicate();
+    }
+
+    public int getColumnCount() {
+        return columnNames.length;
+    }
+
+    /** @param index starts at 0 */
+    public @NotNull String getColumnName(int index) {
+        return columnNames[index];
+    }
+
+    public int getRowCount() {
+        return rowCount;
+    }
+
+    /** @return current row, -1 before the first row */
+    public int getPosition() {
+        return position;
+    }
+
+    /**
+     * Move to the row at given position.
+     * @param position starts at 0
+     * @return false if there is no such row
+     */
+    public boolean moveToPosition(int position) {
+        if (position < 0 || position >= rowCount) {
+            this.position = position < 0 ? -1 : rowCount;
+            return false;
+        }
+        final ByteBuffer buffer = buffer();
+        int offset = (int) buffer.getLong(rowIndexOffset + position * 8);
+        for (int c = 0; c < columnOffsets.length; c++) {
+            columnOffsets[c] = offset;
+            switch (buffer.get(offset)) {
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT:
+                    offset += 1 + 8;
+                    break;
+                case SQLITE_TEXT:
+                case SQLITE_BLOB:
+                    offset += 1 + 4 + buffer.getInt(offset + 1);
+                    break;
+                default:
+                    offset += 1;
+                    break;
+            }
+        }
+        this.position = position;
+        return true;
+    }
+
+    /** @return false if there are no more rows */
+    public boolean moveToNext() {
+        return moveToPosition(position + 1);
+    }
+
+    private int columnOffset(int index) {
+        if (position < 0 || position >= rowCount) throw new IllegalStateException("Reader is not at any row");
+        return columnOffsets[index];
+    }
+
+    /**
+     * @param index starts at 0
+     * @return one of {@link Cursor#FIELD_TYPE_NULL}, {@link Cursor#FIELD_TYPE_INTEGER}, {@link Cursor#FIELD_TYPE_FLOAT},
+     * {@link Cursor#FIELD_TYPE_STRING} or {@link Cursor#FIELD_TYPE_BLOB}
+     */
+    public int getType(int index) {
+        switch (buffer().get(columnOffset(index))) {
+            case SQLITE_INTEGER: return Cursor.FIELD_TYPE_INTEGER;
+            case SQLITE_FLOAT: return Cursor.FIELD_TYPE_FLOAT;
+            case SQLITE_TEXT: return Cursor.FIELD_TYPE_STRING;
+            case SQLITE_BLOB: return Cursor.FIELD_TYPE_BLOB;
+            default: return Cursor.FIELD_TYPE_NULL;
+        }
+    }
+
+    /** @param index starts at 0 */
+    public boolean isNull(int index) {
+        return buffer().get(columnOffset(index)) == SQLITE_NULL;
+    }
+
+    /**
+     * @param index starts at 0
+     * @return INTEGER value, REAL value converted to long or 0 for NULL
+     * @throws IllegalStateException if the value is TEXT or BLOB
+     */
+    public long getLong(int index) {
+        final ByteBuffer buffer = buffer();
+        final int offset = columnOffset(index);
+        switch (buffer.get(offset)) {
+            case SQLITE_INTEGER: return buffer.getLong(offset + 1);
+            case SQLITE_FLOAT: return (long) buffer.getDouble(offset + 1);
+            case SQLITE_NULL: return 0L;
+            default: throw new IllegalStateException("Column " + index + " is not a number");
+        }
+    }
+
+    /**
+     * @param index starts at 0
+     * @return REAL value, INTEGER value converted to double or 0 for NULL
+     * @throws IllegalStateException if the value is TEXT or BLOB
+     */
+    public double getDouble(int index) {
+        final ByteBuffer buffer = buffer();
+        final int offset = columnOffset(index);
+        switch (buffer.get(offset)) {
+            case SQLITE_INTEGER: return buffer.getLong(offset + 1);
+            case SQLITE_FLOAT: return buffer.getDouble(offset + 1);
+            case SQLITE_NULL: return 0.0;
+            default: throw new IllegalStateException("Column " + index + " is not a number");
+        }
+    }
+
+    /**
+     * @param index starts at 0
+     * @return TEXT value, number converted to String or null for NULL
+     * @throws IllegalStateException if the value is BLOB
+     */
+    public @Nullable String getString(int index) {
+        final ByteBuffer buffer = buffer();
+        final int offset = columnOffset(index);
+        switch (buffer.get(offset)) {
+            case SQLITE_INTEGER: return Long.toString(buffer.getLong(offset + 1));
+            case SQLITE_FLOAT: return Double.toString(buffer.getDouble(offset + 1));
+            case SQLITE_TEXT: return readString(offset + 5, buffer.getInt(offset + 1));
+            case SQLITE_NULL: return null;
+            default: throw new IllegalStateException("Column " + index + " is a BLOB");
+        }
+    }
+
+    /**
+     * @param index starts at 0
+     * @return BLOB value, UTF-8 bytes of TEXT value or null for NULL
+     * @throws IllegalStateException if the value is a number
+     */
+    public @Nullable byte[] getBlob(int index) {
+        final ByteBuffer buffer = buffer();
+        final int offset = columnOffset(index);
+        switch (buffer.get(offset)) {
+            case SQLITE_TEXT:
+            case SQLITE_BLOB: return readBytes(offset + 5, buffer.getInt(offset + 1));
+            case SQLITE_NULL: return null;
+            default: throw new IllegalStateException("Column " + index + " is a number");
+        }
+    }
+
+    private byte[] readBytes(int offset, int length) {
+        final byte[] bytes = new byte[length];
+        final ByteBuffer view = buffer().duplicate();
+        view.position(offset);
+        view.get(bytes);
+        return bytes;
+    }
+
+    private String readString(int offset, int length) {
+        return new String(readBytes(offset, length), StandardCharsets.UTF_8);
+    }
+
+    /** Unmap the shared memory or free the native memory of the rows, if any. Calling this again is a no-op. */
+    @Override
+    public void close() {
+        final ByteBuffer buffer = this.buffer;
+        if (buffer == null) return;
+        this.buffer = null;
+        if (memory == MEMORY_MAPPED) {
+            SQLiteNative.nativeUnmapSharedMemory(buffer);
+        } else if (memory == MEMORY_NATIVE) {
+            SQLiteNative.nativeFreeRows(buffer);
+        }
+    }
+}
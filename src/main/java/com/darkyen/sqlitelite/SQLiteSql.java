@@ -0,0 +1,21 @@
+package com.darkyen.sqlitelite;
+
+import java.lang.annotation.Documented;
+import java.lang.annotation.ElementType;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.annotation.Target;
+
+/**
+ * Marks a static String or byte[] (UTF-8) field with one SQL statement,
+ * which is then checked against the schema by {@link SQLiteConnection#validateSql(Class[])}.
+ * <pre>
+ *   &#64;SQLiteSql
+ *   static final byte[] SELECT_ITEM = "SELECT Name FROM Items WHERE Id = ?".getBytes(StandardCharsets.UTF_8);
+ * </pre>
+ */
+@Documented
+@Retention(RetentionPolicy.RUNTIME)
+@Target(ElementType.FIELD)
+public @interface SQLiteSql {
+}
@@ -1,18 +1,40 @@
 package com.darkyen.sqlitelite;
 
 import android.database.sqlite.SQLiteException;
+import android.os.ParcelFileDescriptor;
+import org.jetbrains.annotations.NotNull;
 import org.jetbrains.annotations.Nullable;
 
+import java.io.ByteArrayInputStream;
+import java.io.File;
+import java.io.IOException;
+import java.io.InputStream;
+import java.nio.charset.StandardCharsets;
+
 import static com.darkyen.sqlitelite.SQLiteNative.nativeBindBlob;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeBindBlobCompressed;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeBindDouble;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeBindLong;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeBindNull;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeBindPrimitiveArray;
 import static com.darkyen.sqlitelite.SQLiteNative.nativeBindString;
+import static com.darkyen.sqlitelite.SQLiteNative.nativeBindStringCompressed;
 
 public final class SQLiteStatement implements AutoCloseable {
-    private final SQLiteConnection connection;
+    final SQLiteConnection connection;
     int managementIndex = -1;
     private long statementPtr;
+    /** String or UTF-8 byte[] this was prepared from. */
+    private final Object sql;
+    /** {@link System#nanoTime()} when the cursor started, 0 when not tracked by {@link SQLiteCursorTracker}. */
+    volatile long cursorSince = 0L;
+    /** Where the tracked cursor started, if {@link SQLiteCursorTracker} captures stacks. */
+    @Nullable Throwable cursorStack = null;
+    /**
+     * {@link #cursorSince} of the cursor that {@link SQLiteCursorTracker#heldCursors(long, boolean)} requested to reset,
+     * or 0. The cursor is reset by the owning thread, only if it is still the same one.
+     */
+    volatile long resetRequestedFor = 0L;
 
     /** Not evaluating through a cursor,
      * ready to start cursor row or direct execution. */
@@ -23,18 +45,64 @@ public final class SQLiteStatement implements AutoCloseable {
     private static final int STATE_CURSOR_END = 2;
     /** Cursor errored out while iterating. Only reset is now possible. */
     private static final int STATE_CURSOR_ERROR = 3;
+    /** Cursor was reset on request of {@link SQLiteCursorTracker}. Only reset is now possible. */
+    private static final int STATE_CURSOR_EXPIRED = 4;
     private int state = STATE_NORMAL;
 
-    SQLiteStatement(SQLiteConnection connection, long statementPtr) {
+    /** Bit mask of parameter indices, whose String and byte[] bindings are compressed. */
+    private long compressedParameters = 0L;
+    /** Bit mask of column indices, whose values are decompressed by {@link #cursorGetString(int)} and {@link #cursorGetBlob(int)}. */
+    private long compressedColumns = 0L;
+    private byte[] compressionDictionary = null;
+    /** Stores large byte[] bindings and resolves references in BLOB columns. */
+    private @Nullable SQLiteLargeValueStore largeValueStore = null;
+
+    SQLiteStatement(SQLiteConnection connection, long statementPtr, Object sql) {
         this.connection = connection;
         this.statementPtr = statementPtr;
+        this.sql = sql;
+    }
+
+    /** @return SQL of this statement */
+    public @NotNull String sql() {
+        final Object sql = this.sql;
+        return sql instanceof byte[] ? new String((byte[]) sql, StandardCharsets.UTF_8) : (String) sql;
     }
 
     private void assertNormalState() {
         if (state != STATE_NORMAL) throw new IllegalStateException("This operation can be performed only when not in cursor mode");
+        if (connection.cursorResetRequested) connection.resetRequestedCursors();
     }
     private void assertCursorRowState() {
-        if (state != STATE_CURSOR_ROW) throw new IllegalStateException("Cursor is not at any row");
+        if (state != STATE_CURSOR_ROW) {
+            throw new IllegalStateException(state == STATE_CURSOR_EXPIRED ? EXPIRED_MESSAGE : "Cursor is not at any row");
+        }
+    }
+
+    private static final String EXPIRED_MESSAGE = "Cursor was held open for too long and SQLiteCursorTracker reset it";
+
+    /** Reset the cursor if {@link SQLiteCursorTracker} requested it. Must be called by the thread using the connection. */
+    void resetIfRequested() {
+        final long requestedFor = resetRequestedFor;
+        if (requestedFor == 0L) return;
+        resetRequestedFor = 0L;
+        if (state != STATE_CURSOR_ROW || requestedFor != cursorSince) return;// Reset or restarted meanwhile
+        state = STATE_CURSOR_EXPIRED;
+        if (cursorSince != 0L) SQLiteCursorTracker.ended(this);
+        SQLiteNative.nativeResetStatement(statementPtr());
+    }
+
+    private static long compressionBit(int index) {
+        if (index < 0 || index >= 64) throw new IllegalArgumentException("Only indices 0-63 can be compressed: " + index);
+        return 1L << index;
+    }
+
+    private boolean isParameterCompressed(int index) {
+        return compressedParameters != 0L && index >= 0 && index < 64 && (compressedParameters & (1L << index)) != 0L;
+    }
+
+    private boolean isColumnCompressed(int index) {
+        return compressedColumns != 0L && index >= 0 && index < 64 && (compressedColumns & (1L << index)) != 0L;
     }
 
     private long statementPtr() {
@@ -68,6 +136,8 @@ public final class SQLiteStatement implements AutoCloseable {
         assertNormalState();
         if (value == null) {
             nativeBindNull(connection.connectionPtr(), statementPtr(), index);
+        } else if (isParameterCompressed(index)) {
+            nativeBindStringCompressed(connection.connectionPtr(), statementPtr(), index, value, compressionDictionary);
         } else {
             nativeBindString(connection.connectionPtr(), statementPtr(), index, value);
         }
@@ -78,11 +148,126 @@ public final class SQLiteStatement implements AutoCloseable {
         if (statementPtr == 0) return;
         if (value == null) {
             nativeBindNull(connection.connectionPtr(), statementPtr(), index);
+        } else if (isParameterCompressed(index)) {
+            nativeBindBlobCompressed(connection.connectionPtr(), statementPtr(), index, value, compressionDictionary);
         } else {
+            final SQLiteLargeValueStore store = largeValueStore;
+            if (store != null) {
+                try {
+                    value = store.put(value);
+                } catch (IOException e) {
+                    throw new SQLiteException("Failed to store large value", e);
+                }
+            }
             nativeBindBlob(connection.connectionPtr(), statementPtr(), index, value);
         }
     }
 
+    /**
+     * Bind int[] or null to the parameter at given index, as a BLOB of 4 byte little-endian values.
+     * Note that indices start at 1.
+     * @see #cursorGetInts(int, int[])
+     */
+    public void bind(int index, int[] value) {
+        bindPrimitiveArray(index, value, 4);
+    }
+    /**
+     * Bind long[] or null to the parameter at given index, as a BLOB of 8 byte little-endian values.
+     * Note that indices start at 1.
+     * @see #cursorGetLongs(int, long[])
+     */
+    public void bind(int index, long[] value) {
+        bindPrimitiveArray(index, value, 8);
+    }
+    /**
+     * Bind float[] or null to the parameter at given index, as a BLOB of 4 byte little-endian values.
+     * This is the vector format of the {@code vec_*} SQL functions.
+     * Note that indices start at 1.
+     * @see #cursorGetFloats(int, float[])
+     */
+    public void bind(int index, float[] value) {
+        bindPrimitiveArray(index, value, 4);
+    }
+    /**
+     * Bind double[] or null to the parameter at given index, as a BLOB of 8 byte little-endian values.
+     * Note that indices start at 1.
+     * @see #cursorGetDoubles(int, double[])
+     */
+    public void bind(int index, double[] value) {
+        bindPrimitiveArray(index, value, 8);
+    }
+    private void bindPrimitiveArray(int index, Object value, int elementSize) {
+        assertNormalState();
+        if (value == null) {
+            nativeBindNull(connection.connectionPtr(), statementPtr(), index);
+        } else {
+            nativeBindPrimitiveArray(connection.connectionPtr(), statementPtr(), index, value, elementSize);
+        }
+    }
+
+    /**
+     * Set whether Strings and byte[]s bound to the parameter at given index are compressed,
+     * in the same format as the {@code compress()} SQL function produces.
+     * Such values are always bound as BLOBs.
+     * Note that indices start at 1 and that only indices up to 63 can be compressed.
+     * @see #setCompressionDictionary(byte[])
+     */
+    public void setParameterCompressed(int index, boolean compressed) {
+        if (compressed) {
+            compressedParameters |= compressionBit(index);
+        } else {
+            compressedParameters &= ~compressionBit(index);
+        }
+    }
+
+    /**
+     * Set whether the values of the column at given index are decompressed
+     * when read through {@link #cursorGetString(int)} and {@link #cursorGetBlob(int)}.
+     * BLOB values of such column must be in the format produced by the {@code compress()} SQL function,
+     * values of other types are returned as usual.
+     * The value is decompressed directly into the returned byte[].
+     * Note that indices start at 0 and that only indices up to 63 can be compressed.
+     * @see #setCompressionDictionary(byte[])
+     */
+    public void setColumnCompressed(int index, boolean compressed) {
+        if (compressed) {
+            compressedColumns |= compressionBit(index);
+        } else {
+            compressedColumns &= ~compressionBit(index);
+        }
+    }
+
+    /**
+     * Set the dictionary for compressed parameters and columns, or null for none.
+     * Dictionary should contain data typical for compressed values, which improves compression of small values.
+     * Values compressed with a dictionary can be decompressed only with the same dictionary.
+     * The array is not copied, do not modify it.
+     */
+    public void setCompressionDictionary(@Nullable byte[] dictionary) {
+        compressionDictionary = dictionary;
+    }
+
+    /**
+     * Set the store for large values, or null for none.
+     * byte[]s of at least {@link SQLiteLargeValueStore#threshold()} bytes (or which look like a reference)
+     * bound to parameters which are not compressed are then written to the store and bound as references,
+     * and references in BLOB columns are resolved by {@link #cursorGetBlob(int)}, {@link #cursorGetBlobStream(int)}
+     * and {@link #executeForBlob()}.
+     */
+    public void setLargeValueStore(@Nullable SQLiteLargeValueStore store) {
+        largeValueStore = store;
+    }
+
+    private byte[] resolveLargeValue(byte[] value) {
+        final SQLiteLargeValueStore store = largeValueStore;
+        if (store == null || value == null || !SQLiteLargeValueStore.isReference(value)) return value;
+        try {
+            return store.get(value);
+        } catch (IOException e) {
+            throw new SQLiteException("Failed to read large value", e);
+        }
+    }
+
     /** Remove all existing bindings. */
     public void clearBindings() {
         assertNormalState();
@@ -154,7 +339,85 @@ public final class SQLiteStatement implements AutoCloseable {
     @Nullable
     public byte[] executeForBlob() {
         assertNormalState();
-        return SQLiteNative.nativeExecuteForBlobOrNullAndReset(connection.connectionPtr(), statementPtr());
+        return resolveLargeValue(SQLiteNative.nativeExecuteForBlobOrNullAndReset(connection.connectionPtr(), statementPtr()));
+    }
+
+    /**
+     * Fully execute statement and write all of its rows into a new sealed read-only shared memory region,
+     * which can be sent to another process (for example through Binder) and read there with
+     * {@link SQLiteRowReader#map(ParcelFileDescriptor)} without copying.
+     * Keeps any bindings.
+     * @return descriptor of the region, owned by the caller
+     * @throws SQLiteException on any error
+     */
+    @NotNull
+    public ParcelFileDescriptor executeForSharedMemory() {
+        assertNormalState();
+        final int fd = SQLiteNative.nativeExecuteForSharedMemoryAndReset(connection.connectionPtr(), statementPtr());
+        return ParcelFileDescriptor.adoptFd(fd);
+    }
+
+    /**
+     * Fully execute statement and write all of its rows to the descriptor, without creating Java objects for rows.
+     * <ul>
+     *     <li>{@link SQLiteConnection#FORMAT_CSV} and {@link SQLiteConnection#FORMAT_CSV_HEADER}: NULL is an empty field, empty text is {@code ""}</li>
+     *     <li>{@link SQLiteConnection#FORMAT_NDJSON}: one object per row, keyed by column names</li>
+     *     <li>{@link SQLiteConnection#FORMAT_ROWS}: format of {@link #executeForSharedMemory()},
+     *     the file can be read with {@link SQLiteRowReader#map(ParcelFileDescriptor)}</li>
+     * </ul>
+     * Numbers are written like CAST(X AS TEXT) and BLOBs as lowercase hex.
+     * Text formats are written from the current position and the descriptor can be a pipe or a socket,
+     * ROWS needs a regular file and is written from its start.
+     * Keeps any bindings.
+     * @param format one of FORMAT_ constants of {@link SQLiteConnection}
+     * @param fd where to write, stays open
+     * @return number of written rows
+     * @throws SQLiteException on any error, including failed writes
+     */
+    public long exportTo(@NotNull ParcelFileDescriptor fd, int format) {
+        assertNormalState();
+        return SQLiteNative.nativeExportAndReset(connection.connectionPtr(), statementPtr(), format, fd.getFd());
+    }
+
+    /**
+     * Fully execute statement and write all of its rows to a new file at path, replacing any existing file,
+     * like {@link #exportTo(ParcelFileDescriptor, int)}.
+     * @return number of written rows
+     * @throws SQLiteException on any error, including failure to create the file
+     */
+    public long exportTo(@NotNull String path, int format) {
+        assertNormalState();
+        final int mode = ParcelFileDescriptor.MODE_WRITE_ONLY | ParcelFileDescriptor.MODE_CREATE | ParcelFileDescriptor.MODE_TRUNCATE;
+        try (ParcelFileDescriptor fd = ParcelFileDescriptor.open(new File(path), mode)) {
+            return exportTo(fd, format);
+        } catch (IOException e) {
+            throw new SQLiteException("Failed to export to " + path, e);
+        }
+    }
+
+    /**
+     * Fully execute statement and read all of its rows into native memory,
+     * in the same format as {@link #executeForSharedMemory()}.
+     * Bound the number of rows with LIMIT, all of them are held in memory.
+     * Keeps any bindings.
+     * @return rows, close the reader to free them
+     * @throws SQLiteException on any error
+     */
+    @NotNull
+    public SQLiteRowReader executeForRows() {
+        assertNormalState();
+        return SQLiteRowReader.adoptNative(SQLiteNative.nativeExecuteForRowsAndReset(connection.connectionPtr(), statementPtr(), 1, null));
+    }
+
+    /**
+     * Like {@link #executeForRows()}, but keeps only every stride-th row (rows stride - 1, 2 * stride - 1, ...),
+     * so that sampling a large result holds only the sampled rows in memory.
+     * @param rowCountOut receives the number of all rows at index 0
+     */
+    @NotNull
+    SQLiteRowReader executeForRows(int stride, @NotNull long[] rowCountOut) {
+        assertNormalState();
+        return SQLiteRowReader.adoptNative(SQLiteNative.nativeExecuteForRowsAndReset(connection.connectionPtr(), statementPtr(), stride, rowCountOut));
     }
 
     /**
@@ -186,18 +449,33 @@ public final class SQLiteStatement implements AutoCloseable {
      * @throws SQLiteException on any error
      */
     public boolean cursorNextRow() {
+        if (resetRequestedFor != 0L) resetIfRequested();
         switch (state) {
             case STATE_NORMAL:
+                if (connection.cursorResetRequested) connection.resetRequestedCursors();
+                // fallthrough
             case STATE_CURSOR_ROW:
                 state = STATE_CURSOR_ERROR;// Preemptively set error, will be changed later
                 break;
             case STATE_CURSOR_END:
                 return false;// SQLite does not like step calls when it returned DONE
+            case STATE_CURSOR_EXPIRED:
+                throw new IllegalStateException(EXPIRED_MESSAGE);
             case STATE_CURSOR_ERROR:
             default:
                 throw new IllegalStateException("Cursor needs to be reset after error");
         }
-        final boolean result = SQLiteNative.nativeCursorStep(connection.connectionPtr(), statementPtr());
+        boolean result = false;
+        try {
+            result = SQLiteNative.nativeCursorStep(connection.connectionPtr(), statementPtr());
+        } finally {
+            // Only statements with a row hold the read transaction
+            if (result) {
+                if (cursorSince == 0L && SQLiteCursorTracker.enabled) SQLiteCursorTracker.started(this);
+            } else if (cursorSince != 0L) {
+                SQLiteCursorTracker.ended(this);
+            }
+        }
         state = result ? STATE_CURSOR_ROW : STATE_CURSOR_END;
         return result;
     }
@@ -209,6 +487,7 @@ public final class SQLiteStatement implements AutoCloseable {
     public void cursorReset() {
         if (state == STATE_NORMAL) throw new IllegalStateException("Not in cursor mode, nothing to reset");
         state = STATE_NORMAL;
+        if (cursorSince != 0L) SQLiteCursorTracker.ended(this);
         SQLiteNative.nativeResetStatement(statementPtr());
     }
 
@@ -249,6 +528,9 @@ public final class SQLiteStatement implements AutoCloseable {
      */
     public @Nullable String cursorGetString(int index) {
         assertCursorRowState();
+        if (isColumnCompressed(index)) {
+            return SQLiteNative.nativeCursorGetStringDecompressed(connection.connectionPtr(), statementPtr(), index, compressionDictionary);
+        }
         return SQLiteNative.nativeCursorGetString(connection.connectionPtr(), statementPtr(), index);
     }
     /**
@@ -259,12 +541,84 @@ public final class SQLiteStatement implements AutoCloseable {
      */
     public @Nullable byte[] cursorGetBlob(int index) {
         assertCursorRowState();
-        return SQLiteNative.nativeCursorGetBlob(connection.connectionPtr(), statementPtr(), index);
+        if (isColumnCompressed(index)) {
+            return SQLiteNative.nativeCursorGetBlobDecompressed(connection.connectionPtr(), statementPtr(), index, compressionDictionary);
+        }
+        return resolveLargeValue(SQLiteNative.nativeCursorGetBlob(connection.connectionPtr(), statementPtr(), index));
+    }
+
+    /**
+     * Get BLOB on the current row in specified column as a stream, like {@link #cursorGetBlob(int)}.
+     * Values referenced from the {@link #setLargeValueStore(SQLiteLargeValueStore) large value store}
+     * are streamed from their file, without reading them into memory.
+     * NULL is returned as null.
+     * @param index starts at 0
+     * @throws SQLiteException if the referenced file can't be opened
+     */
+    public @Nullable InputStream cursorGetBlobStream(int index) {
+        assertCursorRowState();
+        final SQLiteLargeValueStore store = largeValueStore;
+        if (store == null || isColumnCompressed(index)) {
+            final byte[] value = cursorGetBlob(index);
+            return value == null ? null : new ByteArrayInputStream(value);
+        }
+        final byte[] value = SQLiteNative.nativeCursorGetBlob(connection.connectionPtr(), statementPtr(), index);
+        if (value == null) return null;
+        try {
+            return store.open(value);
+        } catch (IOException e) {
+            throw new SQLiteException("Failed to open large value", e);
+        }
+    }
+
+    /**
+     * Read BLOB of 4 byte little-endian values on the current row in specified column into dst,
+     * as written by {@link #bind(int, int[])}.
+     * Copies at most dst.length values, the return value may be larger, when dst is too small.
+     * @param index starts at 0
+     * @return number of values in the BLOB or -1 if the value is NULL
+     * @throws SQLiteException if the BLOB length is not a multiple of 4
+     */
+    public int cursorGetInts(int index, @NotNull int[] dst) {
+        return cursorGetPrimitiveArray(index, dst, 4);
+    }
+    /**
+     * Read BLOB of 8 byte little-endian values on the current row in specified column into dst,
+     * like {@link #cursorGetInts(int, int[])}.
+     * @param index starts at 0
+     * @return number of values in the BLOB or -1 if the value is NULL
+     */
+    public int cursorGetLongs(int index, @NotNull long[] dst) {
+        return cursorGetPrimitiveArray(index, dst, 8);
+    }
+    /**
+     * Read BLOB of 4 byte little-endian values on the current row in specified column into dst,
+     * like {@link #cursorGetInts(int, int[])}.
+     * @param index starts at 0
+     * @return number of values in the BLOB or -1 if the value is NULL
+     */
+    public int cursorGetFloats(int index, @NotNull float[] dst) {
+        return cursorGetPrimitiveArray(index, dst, 4);
+    }
+    /**
+     * Read BLOB of 8 byte little-endian values on the current row in specified column into dst,
+     * like {@link #cursorGetInts(int, int[])}.
+     * @param index starts at 0
+     * @return number of values in the BLOB or -1 if the value is NULL
+     */
+    public int cursorGetDoubles(int index, @NotNull double[] dst) {
+        return cursorGetPrimitiveArray(index, dst, 8);
+    }
+    private int cursorGetPrimitiveArray(int index, Object dst, int elementSize) {
+        if (dst == null) throw new IllegalArgumentException("dst must not be null");
+        assertCursorRowState();
+        return SQLiteNative.nativeCursorGetPrimitiveArray(connection.connectionPtr(), statementPtr(), index, dst, elementSize);
     }
 
     void close(long connectionPtr) throws SQLiteException {
         final long ptr = statementPtr;
         if (ptr == 0) return;// Already deleted
+        if (cursorSince != 0L) SQLiteCursorTracker.ended(this);
         SQLiteNative.nativeFinalizeStatement(connectionPtr, ptr);
         statementPtr = 0;
     }
@@ -0,0 +1,597 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteDatabase;
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileNotFoundException;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.FileChannel;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
+import java.util.Locale;
+import java.util.zip.Deflater;
+import java.util.zip.GZIPInputStream;
+import java.util.zip.GZIPOutputStream;
+
+/**
+ * Continuously archives committed WAL frames into compressed segment files,
+ * from which the database can be restored to the state of any segment.
+ * <pre>
+ *   SQLiteWalArchiver archiver = new SQLiteWalArchiver(archiveConnection, monitor, new File(context.getFilesDir(), "archive"));
+ *   scheduler.scheduleWithFixedDelay(() -&gt; archiver.archive(SQLiteWalMonitor.CHECKPOINT_PASSIVE), 1, 1, TimeUnit.MINUTES);
+ *
+ *   // Later, with the database closed
+ *   List&lt;SQLiteWalArchiver.Segment&gt; segments = SQLiteWalArchiver.segments(archiveDirectory);
+ *   SQLiteWalArchiver.restore(archiveDirectory, segments.get(i).number, databaseFile);
+ * </pre>
+ * The first segment is a base, a copy of the database file, the following ones contain only the frames
+ * committed since the previous segment, so archiving costs about as much as the writes since the last one.
+ * Segments are GZIP files with the pages of the frames, see {@link #archive(int)}.
+ * <p>
+ * Frames stay in the WAL only until a checkpoint copies them into the database and the next writer starts
+ * the WAL from the beginning, so the archiver must be the only one to checkpoint the database.
+ * Open all connections with {@code PRAGMA wal_autocheckpoint=0} and run checkpoints through the archiver.
+ * If frames were lost anyway, for example because the last connection to the database closed
+ * and checkpointed it, the archiver notices it from the WAL header or from {@code PRAGMA data_version}
+ * and starts with a new base. After a base taken without a WAL, the first WAL can't be told apart
+ * from a later one, so it starts with a new base too.
+ * Not thread safe.
+ */
+public final class SQLiteWalArchiver {
+
+    // WAL format, see https://www.sqlite.org/fileformat2.html#walformat
+    private static final int WAL_MAGIC = 0x377f0682;
+    private static final int WAL_VERSION = 3007000;
+    private static final int WAL_HEADER_SIZE = 32;
+    private static final int WAL_FRAME_HEADER_SIZE = 24;
+
+    // Segment format, all in the GZIP stream: header, base file if FLAG_BASE, then page number and page of each frame
+    private static final int SEGMENT_MAGIC = 0x53514c41;// SQLA
+    private static final int SEGMENT_VERSION = 1;
+    /** Segment starts with a copy of the database file. */
+    private static final int FLAG_BASE = 0x1;
+    /** There was no WAL when the base was taken, so the WAL fields are not valid. */
+    private static final int FLAG_NO_WAL = 0x2;
+    private static final String BASE_SUFFIX = ".base.gz";
+    private static final String WAL_SUFFIX = ".wal.gz";
+    private static final String TEMPORARY_SUFFIX = ".tmp";
+
+    /** An archived point. */
+    public static final class Segment {
+        /** Sequence number, starting at 1. */
+        public final long number;
+        /** The segment contains a copy of the database, so restoring it does not need earlier segments. */
+        public final boolean base;
+        /** When the segment was archived, it has all transactions committed before this. */
+        public final long createdMillis;
+        /** Number of WAL frames in the segment. */
+        public final int frames;
+        /** Size of the segment file in bytes. */
+        public final long size;
+
+        Segment(long number, boolean base, long createdMillis, int frames, long size) {
+            this.number = number;
+            this.base = base;
+            this.createdMillis = createdMillis;
+            this.frames = frames;
+            this.size = size;
+        }
+
+        @Override
+        public String toString() {
+            return "Segment(" + number + (base ? ", base" : "") + ", " + frames + " frames, " + size + " B, at " + createdMillis + ")";
+        }
+    }
+
+    /** Header of a segment file. */
+    private static final class SegmentHeader {
+        int flags;
+        long createdMillis;
+        int pageSize;
+        // WAL generation: checkpoint sequence number and salts from the WAL header
+        int checkpointSequence;
+        int salt1;
+        int salt2;
+        /** Index of the first frame in the WAL. */
+        int firstFrame;
+        int frameCount;
+        /** Cumulative WAL checksum of the last frame, to continue validation from it. */
+        int checksum1;
+        int checksum2;
+        /** Size of the database after the segment is applied. */
+        int databasePages;
+
+        void write(DataOutputStream out) throws IOException {
+            out.writeInt(SEGMENT_MAGIC);
+            out.writeInt(SEGMENT_VERSION);
+            out.writeInt(flags);
+            out.writeLong(createdMillis);
+            out.writeInt(pageSize);
+            out.writeInt(checkpointSequence);
+            out.writeInt(salt1);
+            out.writeInt(salt2);
+            out.writeInt(firstFrame);
+            out.writeInt(frameCount);
+            out.writeInt(checksum1);
+            out.writeInt(checksum2);
+            out.writeInt(databasePages);
+        }
+
+        static SegmentHeader read(DataInputStream in, File file) throws IOException {
+            if (in.readInt() != SEGMENT_MAGIC || in.readInt() != SEGMENT_VERSION) {
+                throw new IOException("Not a WAL archive segment: " + file);
+            }
+            final SegmentHeader header = new SegmentHeader();
+            header.flags = in.readInt();
+            header.createdMillis = in.readLong();
+            header.pageSize = in.readInt();
+            header.checkpointSequence = in.readInt();
+            header.salt1 = in.readInt();
+            header.salt2 = in.readInt();
+            header.firstFrame = in.readInt();
+            header.frameCount = in.readInt();
+            header.checksum1 = in.readInt();
+            header.checksum2 = in.readInt();
+            header.databasePages = in.readInt();
+            return header;
+        }
+    }
+
+    /** Valid WAL header. */
+    private static final class WalHeader {
+        ByteOrder checksumOrder;
+        int pageSize;
+        int checkpointSequence;
+        int salt1;
+        int salt2;
+        int checksum1;
+        int checksum2;
+    }
+
+    private final SQLiteConnection db;
+    private final SQLiteWalMonitor monitor;
+    private final File directory;
+    private final File databaseFile;
+    private final File walFile;
+
+    /** Header of the last segment, null if there is none or a new base is needed. */
+    private @Nullable SegmentHeader last = null;
+    /** data_version of the connection when the last segment was written, -1 if it is not known. */
+    private long lastDataVersion = -1;
+    private long nextSegment = 1;
+
+    /**
+     * @param db connection to the archived database, used only by the archiver, for read transactions
+     * @param monitor to run checkpoints with, on another connection to the same database
+     * @param directory where segments are stored, created when needed. Should be used only for this archive.
+     *                  If it already has segments, the archive continues after them.
+     * @throws IOException if the existing segments can't be read
+     */
+    public SQLiteWalArchiver(@NotNull SQLiteConnection db, @NotNull SQLiteWalMonitor monitor, @NotNull File directory) throws IOException {
+        final String path = db.path();
+        if (path == null) throw new IllegalArgumentException("In-memory database can't be archived");
+        this.db = db;
+        this.monitor = monitor;
+        this.directory = directory;
+        this.databaseFile = new File(path);
+        this.walFile = new File(path + "-wal");
+
+        final List<Segment> segments = segments(directory);
+        if (!segments.isEmpty()) {
+            final Segment segment = segments.get(segments.size() - 1);
+            try (DataInputStream in = openSegment(segmentFile(directory, segment))) {
+                last = SegmentHeader.read(in, segmentFile(directory, segment));
+            }
+            nextSegment = segment.number + 1;
+        }
+    }
+
+    public @NotNull File directory() {
+        return directory;
+    }
+
+    /** The next {@link #archive(int)} will write a base segment, for example to limit how many segments a restore needs. */
+    public void requestBase() {
+        last = null;
+        lastDataVersion = -1;
+    }
+
+    /**
+     * Archive the frames committed since the last segment into a new segment, then run a checkpoint.
+     * The segment is a base when there are no segments yet, when {@link #requestBase()} was called,
+     * when frames could have been lost since the last segment, or when the WAL is empty
+     * and the database changed since the last segment.
+     * <p>
+     * The whole archive runs in a read transaction on the connection of the archiver.
+     * It keeps the checkpoint from copying frames committed after the archived ones into the database,
+     * which would let the next writer overwrite them. For the same reason, the checkpoint can't wait for readers.
+     * @param checkpointMode {@link SQLiteWalMonitor#CHECKPOINT_PASSIVE} or {@link SQLiteWalMonitor#CHECKPOINT_FULL}
+     * @return the new segment, null if nothing was committed since the last one
+     * @throws IOException if the segment can't be written, in which case no checkpoint runs
+     * @throws SQLiteException if the database is not in WAL mode or the checkpoint fails
+     */
+    public @Nullable Segment archive(int checkpointMode) throws IOException, SQLiteException {
+        if (checkpointMode != SQLiteWalMonitor.CHECKPOINT_PASSIVE && checkpointMode != SQLiteWalMonitor.CHECKPOINT_FULL) {
+            throw new IllegalArgumentException("Checkpoint mode must be PASSIVE or FULL: " + checkpointMode);
+        }
+        if (!"wal".equalsIgnoreCase(db.pragma("PRAGMA journal_mode"))) {
+            throw new SQLiteException("Database is not in WAL mode: " + databaseFile);
+        }
+
+        final Segment segment;
+        db.beginTransactionDeferred();
+        try {
+            // Start the read transaction, this keeps the WAL from being started from the beginning
+            db.pragma("PRAGMA schema_version");
+            final int pageSize = Integer.parseInt(db.pragma("PRAGMA page_size"));
+            final long dataVersion = Long.parseLong(db.pragma("PRAGMA data_version"));
+            segment = archiveFrames(pageSize, dataVersion);
+            monitor.checkpoint(checkpointMode);
+        } finally {
+            db.endTransaction();
+        }
+        return segment;
+    }
+
+    private @Nullable Segment archiveFrames(int pageSize, long dataVersion) throws IOException {
+        try (FileInputStream walIn = walFile.isFile() ? new FileInputStream(walFile) : null) {
+            final FileChannel wal = walIn == null ? null : walIn.getChannel();
+            final WalHeader walHeader = wal == null ? null : readWalHeader(wal);
+
+            final SegmentHeader last = this.last;
+            final SegmentHeader header = new SegmentHeader();
+            header.createdMillis = System.currentTimeMillis();
+            header.pageSize = walHeader == null ? pageSize : walHeader.pageSize;
+            if (walHeader != null) {
+                header.checkpointSequence = walHeader.checkpointSequence;
+                header.salt1 = walHeader.salt1;
+                header.salt2 = walHeader.salt2;
+                header.checksum1 = walHeader.checksum1;
+                header.checksum2 = walHeader.checksum2;
+            }
+
+            if (walHeader == null) {
+                // Nothing was written since the last segment, or the WAL was checkpointed and truncated or deleted
+                if (last != null && last.pageSize == header.pageSize && dataVersion == lastDataVersion) return null;
+                header.flags = FLAG_BASE | FLAG_NO_WAL;
+            } else if (last == null || last.pageSize != header.pageSize || (last.flags & FLAG_NO_WAL) != 0) {
+                // Without a WAL in the last segment, there is no telling how many WALs came since
+                header.flags = FLAG_BASE;
+            } else if (walHeader.salt1 == last.salt1 && walHeader.salt2 == last.salt2
+                    && walHeader.checkpointSequence == last.checkpointSequence) {
+                // Continue in the same WAL
+                header.firstFrame = last.firstFrame + last.frameCount;
+                header.checksum1 = last.checksum1;
+                header.checksum2 = last.checksum2;
+            } else if (walHeader.checkpointSequence == last.checkpointSequence + 1 && walHeader.salt1 == last.salt1 + 1) {
+                // WAL was started from the beginning once, after all of its frames were archived
+                header.firstFrame = 0;
+            } else {
+                header.flags = FLAG_BASE;
+            }
+            final boolean base = (header.flags & FLAG_BASE) != 0;
+
+            // Find the last commit, further frames may belong to a transaction which is being written
+            final int[] startChecksum = {header.checksum1, header.checksum2};
+            final int[] checksum = startChecksum.clone();
+            int endFrame = header.firstFrame;
+            if (walHeader != null) {
+                final ByteBuffer frame = ByteBuffer.allocate(WAL_FRAME_HEADER_SIZE + walHeader.pageSize);
+                for (int i = header.firstFrame; readFrame(wal, walHeader, i, frame, checksum); i++) {
+                    final int commitPages = frame.getInt(4);
+                    if (commitPages != 0) {
+                        endFrame = i + 1;
+                        header.databasePages = commitPages;
+                        header.checksum1 = checksum[0];
+                        header.checksum2 = checksum[1];
+                    }
+                }
+            }
+            header.frameCount = endFrame - header.firstFrame;
+            if (!base && header.frameCount == 0) return null;
+            // The length may change while copying, when a checkpoint copies archived frames into the database.
+            // That is fine, because the frames are applied over the copy when restoring.
+            final long baseLength = base ? databaseFile.length() / header.pageSize * header.pageSize : 0L;
+            if (base && header.frameCount == 0) header.databasePages = (int) (baseLength / header.pageSize);
+
+            if (!directory.isDirectory() && !directory.mkdirs() && !directory.isDirectory()) {
+                throw new IOException("Can't create " + directory);
+            }
+            final File file = segmentFile(directory, nextSegment, base);
+            final File temporary = new File(file.getPath() + TEMPORARY_SUFFIX);
+            boolean done = false;
+            try {
+                final FileOutputStream fileOut = new FileOutputStream(temporary);
+                final GZIPOutputStream gzipOut = new GZIPOutputStream(fileOut, 64 * 1024) {
+                    {
+                        // Pages are mostly written once, so speed matters more than size
+                        def.setLevel(Deflater.BEST_SPEED);
+                    }
+                };
+                try (DataOutputStream out = new DataOutputStream(new BufferedOutputStream(gzipOut, 64 * 1024))) {
+                    header.write(out);
+                    if (base) {
+                        writeBase(out, baseLength);
+                    }
+                    if (header.frameCount > 0) {
+                        writeFrames(out, wal, walHeader, header, startChecksum);
+                    }
+                    out.flush();
+                    gzipOut.finish();
+                    fileOut.getFD().sync();
+                }
+                if (!temporary.renameTo(file)) throw new IOException("Can't rename " + temporary + " to " + file);
+                SQLiteDatabaseFiles.syncDirectory(directory);
+                done = true;
+            } finally {
+                if (!done) temporary.delete();
+            }
+
+            this.last = header;
+            this.lastDataVersion = dataVersion;
+            return new Segment(nextSegment++, base, header.createdMillis, header.frameCount, file.length());
+        }
+    }
+
+    /** Write the length and the first length bytes of the database file. */
+    private void writeBase(DataOutputStream out, long length) throws IOException {
+        try (FileInputStream in = new FileInputStream(databaseFile)) {
+            out.writeLong(length);
+            final byte[] buffer = new byte[64 * 1024];
+            long remaining = length;
+            while (remaining > 0) {
+                final int read = in.read(buffer, 0, (int) Math.min(buffer.length, remaining));
+                if (read < 0) {
+                    // Truncated by a checkpoint, the rest is written by the frames
+                    Arrays.fill(buffer, (byte) 0);
+                    while (remaining > 0) {
+                        final int zeros = (int) Math.min(buffer.length, remaining);
+                        out.write(buffer, 0, zeros);
+                        remaining -= zeros;
+                    }
+                    break;
+                }
+                out.write(buffer, 0, read);
+                remaining -= read;
+            }
+        }
+    }
+
+    /** Write the frames of the header, checking that they did not change since they were found. */
+    private static void writeFrames(DataOutputStream out, FileChannel wal, WalHeader walHeader, SegmentHeader header,
+                                    int[] checksum) throws IOException {
+        final ByteBuffer frame = ByteBuffer.allocate(WAL_FRAME_HEADER_SIZE + walHeader.pageSize);
+        for (int i = header.firstFrame; i < header.firstFrame + header.frameCount; i++) {
+            if (!readFrame(wal, walHeader, i, frame, checksum)) {
+                throw new IOException("WAL changed while it was archived");
+            }
+            out.writeInt(frame.getInt(0));
+            out.write(frame.array(), WAL_FRAME_HEADER_SIZE, walHeader.pageSize);
+        }
+        if (checksum[0] != header.checksum1 || checksum[1] != header.checksum2) {
+            throw new IOException("WAL changed while it was archived");
+        }
+    }
+
+    private static boolean readFully(FileChannel channel, ByteBuffer buffer, long position) throws IOException {
+        buffer.clear();
+        while (buffer.hasRemaining()) {
+            final int read = channel.read(buffer, position + buffer.position());
+            if (read < 0) return false;
+        }
+        return true;
+    }
+
+    /** Cumulative WAL checksum of the bytes, whose length is a multiple of 8, in the byte order of the buffer. */
+    private static void checksum(ByteBuffer bytes, int offset, int length, int[] checksum) {
+        int s1 = checksum[0];
+        int s2 = checksum[1];
+        for (int i = offset; i < offset + length; i += 8) {
+            s1 += bytes.getInt(i) + s2;
+            s2 += bytes.getInt(i + 4) + s1;
+        }
+        checksum[0] = s1;
+        checksum[1] = s2;
+    }
+
+    /** @return the header, null if the WAL is empty or its header is not valid */
+    private static @Nullable WalHeader readWalHeader(FileChannel wal) throws IOException {
+        final ByteBuffer bytes = ByteBuffer.allocate(WAL_HEADER_SIZE);
+        if (!readFully(wal, bytes, 0)) return null;
+        final int magic = bytes.getInt(0);
+        if ((magic & ~1) != WAL_MAGIC || bytes.getInt(4) != WAL_VERSION) return null;
+
+        final WalHeader header = new WalHeader();
+        header.checksumOrder = (magic & 1) != 0 ? ByteOrder.BIG_ENDIAN : ByteOrder.LITTLE_ENDIAN;
+        header.pageSize = bytes.getInt(8);
+        if (header.pageSize == 1) header.pageSize = 65536;
+        header.checkpointSequence = bytes.getInt(12);
+        header.salt1 = bytes.getInt(16);
+        header.salt2 = bytes.getInt(20);
+        header.checksum1 = bytes.getInt(24);
+        header.checksum2 = bytes.getInt(28);
+
+        final int[] checksum = {0, 0};
+        checksum(bytes.order(header.checksumOrder), 0, 24, checksum);
+        if (checksum[0] != header.checksum1 || checksum[1] != header.checksum2) return null;
+        return header;
+    }
+
+    /**
+     * Read frame at the index into the buffer and validate it, continuing the checksum.
+     * @return false if there is no valid frame at the index, when the checksum is not changed
+     */
+    private static boolean readFrame(FileChannel wal, WalHeader walHeader, int index, ByteBuffer frame, int[] checksum) throws IOException {
+        final long position = WAL_HEADER_SIZE + (long) index * (WAL_FRAME_HEADER_SIZE + walHeader.pageSize);
+        if (!readFully(wal, frame, position)) return false;
+        // Frame headers are big-endian, only the checksum uses the byte order of the WAL
+        frame.order(ByteOrder.BIG_ENDIAN);
+        if (frame.getInt(0) == 0 || frame.getInt(8) != walHeader.salt1 || frame.getInt(12) != walHeader.salt2) return false;
+        final int expected1 = frame.getInt(16);
+        final int expected2 = frame.getInt(20);
+        frame.order(walHeader.checksumOrder);
+        final int[] frameChecksum = {checksum[0], checksum[1]};
+        checksum(frame, 0, 8, frameChecksum);
+        checksum(frame, WAL_FRAME_HEADER_SIZE, walHeader.pageSize, frameChecksum);
+        frame.order(ByteOrder.BIG_ENDIAN);
+        if (frameChecksum[0] != expected1 || frameChecksum[1] != expected2) return false;
+        checksum[0] = frameChecksum[0];
+        checksum[1] = frameChecksum[1];
+        return true;
+    }
+
+    private static File segmentFile(File directory, long number, boolean base) {
+        return new File(directory, String.format(Locale.ROOT, "%010d", number) + (base ? BASE_SUFFIX : WAL_SUFFIX));
+    }
+
+    private static File segmentFile(File directory, Segment segment) {
+        return segmentFile(directory, segment.number, segment.base);
+    }
+
+    private static DataInputStream openSegment(File file) throws IOException {
+        final FileInputStream in = new FileInputStream(file);
+        try {
+            return new DataInputStream(new BufferedInputStream(new GZIPInputStream(in, 64 * 1024), 64 * 1024));
+        } catch (IOException e) {
+            in.close();
+            throw e;
+        }
+    }
+
+    /**
+     * @return segments in the directory, ordered by number
+     * @throws IOException if a segment can't be read
+     */
+    public static @NotNull List<Segment> segments(@NotNull File directory) throws IOException {
+        final ArrayList<Segment> segments = new ArrayList<>();
+        final File[] files = directory.listFiles();
+        if (files == null) return segments;
+        for (File file : files) {
+            final String name = file.getName();
+            final boolean base = name.endsWith(BASE_SUFFIX);
+            if (!base && !name.endsWith(WAL_SUFFIX)) continue;
+            final long number;
+            try {
+                number = Long.parseLong(name.substring(0, name.length() - (base ? BASE_SUFFIX : WAL_SUFFIX).length()));
+            } catch (NumberFormatException e) {
+                continue;
+            }
+            try (DataInputStream in = openSegment(file)) {
+                final SegmentHeader header = SegmentHeader.read(in, file);
+                segments.add(new Segment(number, base, header.createdMillis, header.frameCount, file.length()));
+            }
+        }
+        Collections.sort(segments, (a, b) -> Long.compare(a.number, b.number));
+        return segments;
+    }
+
+    /**
+     * Restore the database to the state of the segment, from the last base before it and the segments between them.
+     * The database must not be open, it is replaced and its WAL and other files are deleted.
+     * @param number of the segment to restore
+     * @throws IOException if the segments can't be read or some are missing, in which case the database is not changed
+     */
+    public static void restore(@NotNull File directory, long number, @NotNull File database) throws IOException {
+        final List<Segment> segments = segments(directory);
+        int end = segments.size() - 1;
+        while (end >= 0 && segments.get(end).number != number) end--;
+        if (end < 0) throw new FileNotFoundException("No segment " + number + " in " + directory);
+        int start = end;
+        while (start >= 0 && !segments.get(start).base) start--;
+        if (start < 0) throw new FileNotFoundException("No base segment for segment " + number + " in " + directory);
+        for (int i = start + 1; i <= end; i++) {
+            if (segments.get(i).number != segments.get(i - 1).number + 1) {
+                throw new FileNotFoundException("Missing segment " + (segments.get(i - 1).number + 1) + " in " + directory);
+            }
+        }
+
+        final File restored = new File(database.getPath() + TEMPORARY_SUFFIX);
+        boolean done = false;
+        try {
+            try (RandomAccessFile out = new RandomAccessFile(restored, "rw")) {
+                out.setLength(0);
+                SegmentHeader previous = null;
+                for (int i = start; i <= end; i++) {
+                    previous = applySegment(segmentFile(directory, segments.get(i)), out, previous);
+                }
+                out.getFD().sync();
+            }
+            SQLiteDatabase.deleteDatabase(database);
+            if (!restored.renameTo(database)) throw new IOException("Can't rename " + restored + " to " + database);
+            done = true;
+            SQLiteDatabaseFiles.syncDirectory(database.getAbsoluteFile().getParentFile());
+        } finally {
+            if (!done) restored.delete();
+        }
+    }
+
+    private static SegmentHeader applySegment(File file, RandomAccessFile out, @Nullable SegmentHeader previous) throws IOException {
+        try (DataInputStream in = openSegment(file)) {
+            final SegmentHeader header = SegmentHeader.read(in, file);
+            final boolean base = (header.flags & FLAG_BASE) != 0;
+            if (previous != null && !follows(previous, header)) {
+                throw new IOException("Segment does not continue the WAL of the previous one: " + file);
+            }
+            final byte[] page = new byte[header.pageSize];
+            if (base) {
+                // Length is a multiple of the page size
+                for (long remaining = in.readLong(); remaining > 0; remaining -= header.pageSize) {
+                    in.readFully(page);
+                    out.write(page);
+                }
+            }
+            for (int i = 0; i < header.frameCount; i++) {
+                final long pageNumber = in.readInt() & 0xFFFFFFFFL;
+                in.readFully(page);
+                out.seek((pageNumber - 1) * header.pageSize);
+                out.write(page);
+            }
+            out.setLength((header.databasePages & 0xFFFFFFFFL) * header.pageSize);
+            return header;
+        }
+    }
+
+    /** @return true if the next segment continues the frames of the previous one */
+    private static boolean follows(SegmentHeader previous, SegmentHeader next) {
+        // After a base without a WAL, the archiver always takes a new base
+        if (previous.pageSize != next.pageSize || (next.flags & FLAG_BASE) != 0 || (previous.flags & FLAG_NO_WAL) != 0) return false;
+        if (next.salt1 == previous.salt1 && next.salt2 == previous.salt2 && next.checkpointSequence == previous.checkpointSequence) {
+            return next.firstFrame == previous.firstFrame + previous.frameCount;
+        }
+        return next.firstFrame == 0 && next.checkpointSequence == previous.checkpointSequence + 1 && next.salt1 == previous.salt1 + 1;
+    }
+
+    /**
+     * Delete the segments which are not needed to restore the segment with the number and the later ones.
+     * @return number of deleted segments
+     */
+    public static int deleteSegmentsBefore(@NotNull File directory, long number) throws IOException {
+        final List<Segment> segments = segments(directory);
+        long firstNeeded = Long.MIN_VALUE;
+        for (Segment segment : segments) {
+            if (segment.number > number) break;
+            if (segment.base) firstNeeded = segment.number;
+        }
+        int deleted = 0;
+        for (Segment segment : segments) {
+            if (segment.number >= firstNeeded) break;
+            if (!segmentFile(directory, segment).delete()) throw new IOException("Can't delete " + segmentFile(directory, segment));
+            deleted++;
+        }
+        return deleted;
+    }
+}
@@ -0,0 +1,185 @@
+package com.darkyen.sqlitelite;
+
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.io.File;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Runs WAL checkpoints, collects their metrics and detects checkpoint starvation,
+ * when checkpoints repeatedly can't complete, because a read transaction keeps old frames in use.
+ * <pre>
+ *   SQLiteWalMonitor monitor = new SQLiteWalMonitor(checkpointConnection, 5, (last, incomplete, cursors) -&gt;
+ *           Log.w(TAG, incomplete + " incomplete checkpoints, WAL has " + last.walSize + " bytes, open cursors: " + cursors));
+ *   scheduler.scheduleWithFixedDelay(() -&gt; monitor.checkpoint(SQLiteWalMonitor.CHECKPOINT_PASSIVE), 1, 1, TimeUnit.MINUTES);
+ * </pre>
+ * Give the monitor its own connection, which is used only by the monitor, from one thread at a time.
+ * Statements holding read transactions are reported only when {@link SQLiteCursorTracker} is enabled,
+ * which the monitor does not do by itself.
+ * Not thread safe.
+ */
+public final class SQLiteWalMonitor {
+
+    /** Checkpoint as much as possible without waiting for readers or writers */
+    public static final int CHECKPOINT_PASSIVE = 0;
+    /** Wait for the writers, then checkpoint as much as possible */
+    public static final int CHECKPOINT_FULL = 1;
+    /** Like FULL, then wait for readers so that the next writer restarts the WAL from the beginning */
+    public static final int CHECKPOINT_RESTART = 2;
+    /** Like RESTART, then truncate the WAL file */
+    public static final int CHECKPOINT_TRUNCATE = 3;
+
+    /** Called when checkpoints repeatedly did not complete. */
+    public interface Listener {
+        /**
+         * @param last the last incomplete checkpoint
+         * @param incompleteCheckpoints number of incomplete checkpoints in a row
+         * @param openCursors statements of connections to the monitored database, whose read transactions may block
+         *                    the checkpoints, empty if {@link SQLiteCursorTracker} is not enabled
+         */
+        void onCheckpointStarvation(@NotNull Checkpoint last, int incompleteCheckpoints, @NotNull List<SQLiteCursorTracker.OpenCursor> openCursors);
+    }
+
+    /** Result of one checkpoint. */
+    public static final class Checkpoint {
+        public final int mode;
+        /** Checkpoint could not get a lock it needed, only in blocking modes */
+        public final boolean busy;
+        /** Frames in the WAL, -1 if the database is not in WAL mode */
+        public final int walFrames;
+        /** Frames in the WAL that are checkpointed, -1 if the database is not in WAL mode */
+        public final int checkpointedFrames;
+        /** Size of the WAL file after the checkpoint, in bytes */
+        public final long walSize;
+        public final long durationNanos;
+
+        Checkpoint(int mode, boolean busy, int walFrames, int checkpointedFrames, long walSize, long durationNanos) {
+            this.mode = mode;
+            this.busy = busy;
+            this.walFrames = walFrames;
+            this.checkpointedFrames = checkpointedFrames;
+            this.walSize = walSize;
+            this.durationNanos = durationNanos;
+        }
+
+        /** @return true if all frames in the WAL were checkpointed */
+        public boolean isComplete() {
+            return !busy && checkpointedFrames >= walFrames;
+        }
+
+        /** @return frames written since the last complete checkpoint, which readers still have to look up in the WAL */
+        public int uncheckpointedFrames() {
+            return Math.max(walFrames - checkpointedFrames, 0);
+        }
+
+        @Override
+        public String toString() {
+            return "Checkpoint(" + checkpointedFrames + "/" + walFrames + " frames" + (busy ? ", busy" : "")
+                    + ", WAL " + walSize + " B, " + (durationNanos / 1000L) + " us)";
+        }
+    }
+
+    private final SQLiteConnection db;
+    private final @Nullable String path;
+    private final @Nullable File walFile;
+    private final int starvationThreshold;
+    private final Listener listener;
+
+    private Checkpoint lastCheckpoint = null;
+    private int checkpoints = 0;
+    private int incompleteCheckpoints = 0;
+    private int consecutiveIncompleteCheckpoints = 0;
+    private long totalDurationNanos = 0L;
+    private long maxDurationNanos = 0L;
+
+    /**
+     * @param db connection to the monitored database, used only by the monitor
+     * @param starvationThreshold how many incomplete checkpoints in a row call the listener,
+     *                            which is called again after each further threshold of them
+     * @param listener to call on checkpoint starvation
+     */
+    public SQLiteWalMonitor(@NotNull SQLiteConnection db, int starvationThreshold, @NotNull Listener listener) {
+        if (starvationThreshold <= 0) throw new IllegalArgumentException("starvationThreshold must be positive: " + starvationThreshold);
+        this.db = db;
+        final String path = db.path();
+        this.path = path;
+        this.walFile = path == null ? null : new File(path + "-wal");
+        this.starvationThreshold = starvationThreshold;
+        this.listener = listener;
+    }
+
+    /** @return size of the WAL file in bytes, 0 if it does not exist */
+    public long walSize() {
+        final File walFile = this.walFile;
+        return walFile == null ? 0L : walFile.length();
+    }
+
+    /**
+     * Run a checkpoint, record it and call the listener if the checkpoints are starving.
+     * @param mode one of CHECKPOINT_ constants
+     * @throws SQLiteException if the checkpoint fails for other reason than being blocked
+     */
+    public @NotNull Checkpoint checkpoint(int mode) throws SQLiteException {
+        final long start = System.nanoTime();
+        final int[] result = SQLiteNative.nativeWalCheckpoint(db.connectionPtr(), mode);
+        final long duration = System.nanoTime() - start;
+        final Checkpoint checkpoint = new Checkpoint(mode, result[0] != 0, result[1], result[2], walSize(), duration);
+
+        lastCheckpoint = checkpoint;
+        checkpoints++;
+        totalDurationNanos += duration;
+        maxDurationNanos = Math.max(maxDurationNanos, duration);
+        if (checkpoint.isComplete()) {
+            consecutiveIncompleteCheckpoints = 0;
+        } else {
+            incompleteCheckpoints++;
+            consecutiveIncompleteCheckpoints++;
+            if (consecutiveIncompleteCheckpoints % starvationThreshold == 0) {
+                listener.onCheckpointStarvation(checkpoint, consecutiveIncompleteCheckpoints, openCursors());
+            }
+        }
+        return checkpoint;
+    }
+
+    /** @return cursors tracked by {@link SQLiteCursorTracker} on connections to the monitored database, longest held first */
+    public @NotNull List<SQLiteCursorTracker.OpenCursor> openCursors() {
+        final ArrayList<SQLiteCursorTracker.OpenCursor> result = new ArrayList<>();
+        final String path = this.path;
+        if (path == null) return result;// In-memory databases are not shared
+        for (SQLiteCursorTracker.OpenCursor cursor : SQLiteCursorTracker.openCursors()) {
+            if (path.equals(cursor.connection.path())) result.add(cursor);
+        }
+        return result;
+    }
+
+    /** @return the last checkpoint, null if none ran yet */
+    public @Nullable Checkpoint lastCheckpoint() {
+        return lastCheckpoint;
+    }
+
+    /** @return number of checkpoints run by this monitor */
+    public int checkpoints() {
+        return checkpoints;
+    }
+
+    /** @return number of checkpoints that did not complete */
+    public int incompleteCheckpoints() {
+        return incompleteCheckpoints;
+    }
+
+    /** @return number of the latest checkpoints that did not complete, 0 if the last one completed */
+    public int consecutiveIncompleteCheckpoints() {
+        return consecutiveIncompleteCheckpoints;
+    }
+
+    public long totalDurationNanos() {
+        return totalDurationNanos;
+    }
+
+    public long maxDurationNanos() {
+        return maxDurationNanos;
+    }
+}
@@ -0,0 +1,447 @@
+package com.darkyen.sqlitelite;
+
+import android.database.Cursor;
+import android.database.sqlite.SQLiteException;
+import org.jetbrains.annotations.NotNull;
+import org.jetbrains.annotations.Nullable;
+
+import java.util.concurrent.Executor;
+
+/**
+ * Random access cursor over a query with many rows, for list UIs.
+ * <pre>
+ *   try (SQLiteWindowedCursor items = SQLiteWindowedCursor.builder("SELECT Id, Name FROM Items WHERE Category = ?", "Id")
+ *           .orderBy("Name")
+ *           .arguments(category)
+ *           .prefetch(executor)
+ *           .open(db)) {
+ *       items.moveToPosition(position);
+ *       ... items.getString(1) ...
+ *   }
+ * </pre>
+ * Rows are read in windows of consecutive rows, which are held in native memory
+ * in the format of {@link SQLiteStatement#executeForRows()}. Only the current window and its neighbors are kept.
+ * <p>
+ * Rows are ordered by a unique id column, optionally preceded by a sort column.
+ * Opening the cursor counts the rows and remembers the key of the last row of each window,
+ * in one pass over the ordered keys, which holds only the remembered keys in memory.
+ * Reading any window is a seek by key ({@code WHERE (sort, id) > (?, ?) LIMIT window}),
+ * not by OFFSET, which would step over all previous rows.
+ * The sort and id columns should be indexed together, otherwise opening sorts the keys of all rows,
+ * and must not contain NULLs.
+ * <p>
+ * Row count and window boundaries are fixed when the cursor is opened,
+ * changes made later may be visible in windows read later. Open a new cursor to see the changes consistently.
+ * <p>
+ * Not thread safe. When prefetching, windows are also read on the executor, so the connection must be
+ * opened with {@link SQLiteConnection#SQLITE_OPEN_FULLMUTEX}, or not used by anything else while the cursor is open.
+ */
+public final class SQLiteWindowedCursor implements AutoCloseable {
+
+    /** Number of windows held in memory. */
+    private static final int CACHED_WINDOWS = 3;
+
+    private final SQLiteStatement firstWindow;
+    private final SQLiteStatement nextWindow;
+    /** Index of the first key parameter of {@link #nextWindow}. */
+    private final int keyParameter;
+    /** Sort key (if any) and id of the last row of each window, guarded by {@link #statementLock}. */
+    private final SQLiteRowReader lastKeys;
+    private final int windowSize;
+    private final int windowCount;
+    private final int rowCount;
+    private final String[] columnNames;
+    private final @Nullable Executor executor;
+    /** Held while the statements are used. Taken before the lock of this. */
+    private final Object statementLock = new Object();
+
+    // Guarded by this
+    private final int[] cachedIndices = new int[CACHED_WINDOWS];
+    private final SQLiteRowReader[] cachedRows = new SQLiteRowReader[CACHED_WINDOWS];
+    private int currentWindow = -1;
+    private int prefetchingWindow = -1;
+    private boolean closed = false;
+
+    // Used only by the reading thread
+    private SQLiteRowReader current = null;
+    private int position = -1;
+
+    private SQLiteWindowedCursor(SQLiteStatement firstWindow, SQLiteStatement nextWindow, int keyParameter,
+                                 SQLiteRowReader lastKeys, int windowSize, int rowCount, @Nullable Executor executor) {
+        this.firstWindow = firstWindow;
+        this.nextWindow = nextWindow;
+        this.keyParameter = keyParameter;
+        this.lastKeys = lastKeys;
+        this.windowSize = windowSize;
+        this.windowCount = (int) (((long) rowCount + windowSize - 1) / windowSize);
+        this.rowCount = rowCount;
+        this.executor = executor;
+
+        final SQLiteRowReader first = firstWindow.executeForRows();
+        final String[] columnNames = new String[first.getColumnCount()];
+        for (int i = 0; i < columnNames.length; i++) {
+            columnNames[i] = first.getColumnName(i);
+        }
+        this.columnNames = columnNames;
+        cache(0, first);
+    }
+
+    /**
+     * Start defining a new cursor.
+     * @param sql query, whose rows are listed, without ORDER BY and LIMIT
+     * @param idColumn name of a result column with unique values, which orders the rows
+     */
+    public static @NotNull Builder builder(@NotNull String sql, @NotNull String idColumn) {
+        return new Builder(sql, idColumn);
+    }
+
+    /** @return number of rows, as counted when the cursor was opened */
+    public int getCount() {
+        return rowCount;
+    }
+
+    /** @return current row, -1 before the first row */
+    public int getPosition() {
+        return position;
+    }
+
+    /**
+     * Move to the row at given position, reading its window if it is not in memory.
+     * @param position starts at 0
+     * @return false if there is no such row
+     * @throws SQLiteException if the window can't be read
+     */
+    public boolean moveToPosition(int position) {
+        if (position < 0 || position >= rowCount) {
+            this.position = position < 0 ? -1 : rowCount;
+            return false;
+        }
+        final int window = position / windowSize;
+        final int previousWindow;
+        synchronized (this) {
+            previousWindow = currentWindow;
+        }
+        if (window != previousWindow || current == null) {
+            // Previous window may be freed as soon as it is not current
+            current = null;
+            this.position = -1;
+            current = window(window);
+            prefetch(window < previousWindow ? window - 1 : window + 1);
+        }
+        this.position = position;
+        // Rows may have been deleted since the cursor was opened
+        return current.moveToPosition(position - window * windowSize);
+    }
+
+    /** @return false if there are no more rows */
+    public boolean moveToNext() {
+        return moveToPosition(position + 1);
+    }
+
+    /** @return false if there are no previous rows */
+    public boolean moveToPrevious() {
+        return moveToPosition(position - 1);
+    }
+
+    public int getColumnCount() {
+        return columnNames.length;
+    }
+
+    /** @param index starts at 0 */
+    public @NotNull String getColumnName(int index) {
+        return columnNames[index];
+    }
+
+    private SQLiteRowReader row() {
+        final SQLiteRowReader current = this.current;
+        if (current == null || position < 0 || position >= rowCount) throw new IllegalStateException("Cursor is not at any row");
+        return current;
+    }
+
+    /**
+     * @param index starts at 0
+     * @return one of {@link Cursor#FIELD_TYPE_NULL}, {@link Cursor#FIELD_TYPE_INTEGER}, {@link Cursor#FIELD_TYPE_FLOAT},
+     * {@link Cursor#FIELD_TYPE_STRING} or {@link Cursor#FIELD_TYPE_BLOB}
+     */
+    public int getType(int index) {
+        return row().getType(index);
+    }
+
+    /** @param index starts at 0 */
+    public boolean isNull(int index) {
+        return row().isNull(index);
+    }
+
+    /** @see SQLiteRowReader#getLong(int) */
+    public long getLong(int index) {
+        return row().getLong(index);
+    }
+
+    /** @see SQLiteRowReader#getDouble(int) */
+    public double getDouble(int index) {
+        return row().getDouble(index);
+    }
+
+    /** @see SQLiteRowReader#getString(int) */
+    public @Nullable String getString(int index) {
+        return row().getString(index);
+    }
+
+    /** @see SQLiteRowReader#getBlob(int) */
+    public @Nullable byte[] getBlob(int index) {
+        return row().getBlob(index);
+    }
+
+    private SQLiteRowReader cached(int window) {
+        for (int i = 0; i < CACHED_WINDOWS; i++) {
+            if (cachedRows[i] != null && cachedIndices[i] == window) return cachedRows[i];
+        }
+        return null;
+    }
+
+    /** Add the window to the cache, evicting the window farthest from the current one, which may be this one. */
+    private synchronized void cache(int window, SQLiteRowReader rows) {
+        if (closed) {
+            rows.close();
+            return;
+        }
+        int slot = -1;
+        int slotDistance = Math.abs(window - currentWindow);
+        for (int i = 0; i < CACHED_WINDOWS; i++) {
+            if (cachedRows[i] == null) {
+                slot = i;
+                break;
+            }
+            final int distance = Math.abs(cachedIndices[i] - currentWindow);
+            if (distance > slotDistance) {
+                slot = i;
+                slotDistance = distance;
+            }
+        }
+        if (slot == -1) {
+            rows.close();
+            return;
+        }
+        if (cachedRows[slot] != null) {
+            cachedRows[slot].close();
+        }
+        cachedIndices[slot] = window;
+        cachedRows[slot] = rows;
+    }
+
+    /** Make the window current and return its rows. */
+    private SQLiteRowReader window(int window) {
+        SQLiteRowReader rows;
+        synchronized (this) {
+            if (closed) throw new IllegalStateException("Cursor already closed");
+            currentWindow = window;
+            rows = cached(window);
+        }
+        if (rows != null) return rows;
+
+        synchronized (statementLock) {
+            // It may have been just prefetched
+            synchronized (this) {
+                rows = cached(window);
+            }
+            if (rows != null) return rows;
+            rows = read(window);
+            cache(window, rows);
+            return rows;
+        }
+    }
+
+    /** Must hold statementLock. */
+    private SQLiteRowReader read(int window) {
+        if (window == 0) return firstWindow.executeForRows();
+        final SQLiteRowReader lastKeys = this.lastKeys;
+        lastKeys.moveToPosition(window - 1);
+        for (int i = 0; i < lastKeys.getColumnCount(); i++) {
+            final int parameter = keyParameter + i;
+            switch (lastKeys.getType(i)) {
+                case Cursor.FIELD_TYPE_INTEGER:
+                    nextWindow.bind(parameter, lastKeys.getLong(i));
+                    break;
+                case Cursor.FIELD_TYPE_FLOAT:
+                    nextWindow.bind(parameter, lastKeys.getDouble(i));
+                    break;
+                case Cursor.FIELD_TYPE_STRING:
+                    nextWindow.bind(parameter, lastKeys.getString(i));
+                    break;
+                case Cursor.FIELD_TYPE_BLOB:
+                    nextWindow.bind(parameter, lastKeys.getBlob(i));
+                    break;
+                default:
+                    nextWindow.bindNull(parameter);
+                    break;
+            }
+        }
+        return nextWindow.executeForRows();
+    }
+
+    private void prefetch(int window) {
+        final Executor executor = this.executor;
+        if (executor == null || window < 0 || window >= windowCount) return;
+        synchronized (this) {
+            if (prefetchingWindow == window || cached(window) != null) return;
+            prefetchingWindow = window;
+        }
+        executor.execute(() -> {
+            try {
+                synchronized (statementLock) {
+                    synchronized (this) {
+                        if (closed || cached(window) != null || Math.abs(window - currentWindow) > 1) return;
+                    }
+                    cache(window, read(window));
+                }
+            } catch (RuntimeException ignored) {
+                // Read again when needed, which reports the error
+            } finally {
+                synchronized (this) {
+                    if (prefetchingWindow == window) prefetchingWindow = -1;
+                }
+            }
+        });
+    }
+
+    /**
+     * Free all windows and close the statements of the cursor.
+     * Waits for a running prefetch. Calling this again is a no-op.
+     */
+    @Override
+    public void close() {
+        synchronized (statementLock) {
+            synchronized (this) {
+                if (closed) return;
+                closed = true;
+                for (int i = 0; i < CACHED_WINDOWS; i++) {
+                    if (cachedRows[i] != null) {
+                        cachedRows[i].close();
+                        cachedRows[i] = null;
+                    }
+                }
+            }
+            current = null;
+            position = -1;
+            lastKeys.close();
+            firstWindow.close();
+            nextWindow.close();
+        }
+    }
+
+    public static final class Builder {
+        private final String sql;
+        private final String idColumn;
+        private String sortColumn = null;
+        private boolean descending = false;
+        private int windowSize = 256;
+        private Object[] arguments = new Object[0];
+        private Executor executor = null;
+
+        private Builder(String sql, String idColumn) {
+            this.sql = sql;
+            this.idColumn = idColumn;
+        }
+
+        /** Order the rows by the values of this result column first and by the id column second. */
+        public @NotNull Builder orderBy(@NotNull String sortColumn) {
+            this.sortColumn = sortColumn;
+            return this;
+        }
+
+        /** Order the rows in descending order. */
+        public @NotNull Builder descending() {
+            descending = true;
+            return this;
+        }
+
+        /** Set the number of rows read at once, 256 by default. */
+        public @NotNull Builder windowSize(int rows) {
+            if (rows <= 0) throw new IllegalArgumentException("Window size must be positive: " + rows);
+            windowSize = rows;
+            return this;
+        }
+
+        /**
+         * Set values of the parameters of the query, in order.
+         * Values may be null, Boolean, Integer, Long, Float, Double, String or byte[].
+         */
+        public @NotNull Builder arguments(@NotNull Object... arguments) {
+            this.arguments = arguments.clone();
+            return this;
+        }
+
+        /** Read the next window in the direction of movement on the executor, before it is needed. */
+        public @NotNull Builder prefetch(@NotNull Executor executor) {
+            this.executor = executor;
+            return this;
+        }
+
+        /**
+         * Count the rows, find the window boundaries and read the first window.
+         * This steps over the keys of all rows once.
+         * @throws SQLiteException on any error
+         */
+        public @NotNull SQLiteWindowedCursor open(@NotNull SQLiteConnection db) throws SQLiteException {
+            final String order = descending ? " DESC" : "";
+            final String keys = sortColumn == null ? quote(idColumn) : quote(sortColumn) + ", " + quote(idColumn);
+            final String orderBy = sortColumn == null ? quote(idColumn) + order
+                    : quote(sortColumn) + order + ", " + quote(idColumn) + order;
+            final String source = "(" + sql + ")";
+
+            // Streamed, only the key of each windowSize-th row is kept. Window functions would buffer all rows.
+            final String lastKeysSql = "SELECT " + keys + " FROM " + source + " ORDER BY " + orderBy;
+            final String firstWindowSql = "SELECT * FROM " + source + " ORDER BY " + orderBy + " LIMIT " + windowSize;
+            final String nextWindowSql = "SELECT * FROM " + source + " WHERE (" + keys + ") " + (descending ? "<" : ">")
+                    + " (" + (sortColumn == null ? "?" : "?, ?") + ") ORDER BY " + orderBy + " LIMIT " + windowSize;
+
+            final SQLiteRowReader lastKeys;
+            final long[] rowCount = new long[1];
+            try (SQLiteStatement statement = db.statement(lastKeysSql)) {
+                bindArguments(statement);
+                lastKeys = statement.executeForRows(windowSize, rowCount);
+            }
+            SQLiteStatement firstWindow = null;
+            SQLiteStatement nextWindow = null;
+            try {
+                if (rowCount[0] > Integer.MAX_VALUE) throw new SQLiteException("Too many rows: " + rowCount[0]);
+                firstWindow = db.statement(firstWindowSql);
+                bindArguments(firstWindow);
+                nextWindow = db.statement(nextWindowSql);
+                bindArguments(nextWindow);
+                return new SQLiteWindowedCursor(firstWindow, nextWindow, arguments.length + 1, lastKeys, windowSize, (int) rowCount[0], executor);
+            } catch (Throwable t) {
+                lastKeys.close();
+                if (firstWindow != null) firstWindow.close();
+                if (nextWindow != null) nextWindow.close();
+                throw t;
+            }
+        }
+
+        private void bindArguments(SQLiteStatement statement) {
+            for (int i = 0; i < arguments.length; i++) {
+                final Object argument = arguments[i];
+                final int index = i + 1;
+                if (argument == null) {
+                    statement.bindNull(index);
+                } else if (argument instanceof Boolean) {
+                    statement.bind(index, (boolean) (Boolean) argument);
+                } else if (argument instanceof Integer || argument instanceof Long) {
+                    statement.bind(index, ((Number) argument).longValue());
+                } else if (argument instanceof Float || argument instanceof Double) {
+                    statement.bind(index, ((Number) argument).doubleValue());
+                } else if (argument instanceof String) {
+                    statement.bind(index, (String) argument);
+                } else if (argument instanceof byte[]) {
+                    statement.bind(index, (byte[]) argument);
+                } else {
+                    throw new IllegalArgumentException("Unsupported argument " + index + ": " + argument.getClass());
+                }
+            }
+        }
+    }
+
+    private static String quote(String identifier) {
+        return '"' + identifier.replace("\"", "\"\"") + '"';
+    }
+}
@@ -5,6 +5,7 @@ include $(CLEAR_VARS)
 #   SQLITE_TEMP_STORE=3 causes all TEMP files to go into RAM. and thats the behavior we want
 #   SQLITE_ENABLE_FTS3   enables usage of FTS3 - NOT FTS1 or 2.
 #   SQLITE_DEFAULT_AUTOVACUUM=1  causes the databases to be subject to auto-vacuum
+#   SQLITE_ENABLE_SORTER_REFERENCES  lets ORDER BY read large columns after sorting, off until SQLiteConnection.setSorterReferenceSize
 sqlite_flags := \
 	-DNDEBUG=1 \
 	-DHAVE_USLEEP=1 \
@@ -37,6 +38,7 @@ sqlite_flags := \
     -DSQLITE_OMIT_DESERIALIZE \
     -DSQLITE_OMIT_TRACE \
     -DSQLITE_OMIT_LOAD_EXTENSION \
+    -DSQLITE_ENABLE_SORTER_REFERENCES \
     -Os
 
 LOCAL_CFLAGS += $(sqlite_flags)
@@ -54,9 +56,22 @@ endif
 LOCAL_SRC_FILES:= \
 	android_database_SQLiteCommon.cpp \
 	SQLiteNative.cpp \
+	SQLiteHashFunctions.cpp \
+	SQLiteCompression.cpp \
+	SQLiteVectorFunctions.cpp \
+	SQLiteRoaringFunctions.cpp \
+	SQLiteSketchFunctions.cpp \
+	SQLiteTimeSeriesFunctions.cpp \
+	SQLiteColumnarTable.cpp \
+	SQLiteMembershipFilter.cpp \
+	SQLiteImport.cpp \
+	SQLiteExport.cpp \
+	SQLiteRowFormat.cpp \
+	SQLiteDatabaseFiles.cpp \
 	JNIHelp.cpp
 
 LOCAL_SRC_FILES += sqlite3ex.c
+LOCAL_SRC_FILES += lz4.c
 
 LOCAL_C_INCLUDES += $(LOCAL_PATH)
 
@@ -0,0 +1,385 @@
+// Eponymous virtual tables over columns of primitive values in memory,
+// registered from Java through SQLiteColumnarTable.
+//
+// Each table is its own module, so it can be queried directly by name:
+//   SELECT * FROM scores WHERE id BETWEEN 10 AND 20
+// Rowid is the index of the row. When the table has a sorted key column,
+// EQ (including IN and joins), range constraints and ORDER BY on it are served by binary search.
+
+#define LOG_TAG "SQLiteColumnarTable"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sqlite3ex.h"
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+struct ColumnarTable {
+    ColumnarColumn* columns;
+    int columnCount;
+    sqlite3_int64 rowCount;
+    int sortedColumn;
+};
+
+void freeColumnarColumns(ColumnarColumn* columns, int columnCount) {
+    if (columns == NULL) return;
+    for (int i = 0; i < columnCount; i++) {
+        sqlite3_free(columns[i].name);
+        sqlite3_free(columns[i].owned);
+    }
+    sqlite3_free(columns);
+}
+
+static void columnarTableDestroy(void* data) {
+    ColumnarTable* table = static_cast<ColumnarTable*>(data);
+    freeColumnarColumns(table->columns, table->columnCount);
+    sqlite3_free(table);
+}
+
+struct ColumnarVtab {
+    sqlite3_vtab base;
+    const ColumnarTable* table;
+};
+
+struct ColumnarCursor {
+    sqlite3_vtab_cursor base;
+    sqlite3_int64 row;
+    sqlite3_int64 end;
+};
+
+// Constraints served by xFilter, in idxNum. Arguments follow in this order.
+enum {
+    FILTER_KEY_EQ = 1,
+    FILTER_KEY_LOWER = 2,
+    FILTER_KEY_LOWER_INCLUSIVE = 4,
+    FILTER_KEY_UPPER = 8,
+    FILTER_KEY_UPPER_INCLUSIVE = 16,
+    FILTER_ROWID_EQ = 32,
+};
+
+size_t columnarTypeSize(int type) {
+    switch (type) {
+        case COLUMNAR_INT32:
+        case COLUMNAR_FLOAT32:
+            return 4;
+        case COLUMNAR_INT64:
+        case COLUMNAR_FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static int columnarConnect(sqlite3* db, void* pAux, int argc, const char* const* argv, sqlite3_vtab** ppVtab, char** pzErr) {
+    const ColumnarTable* table = static_cast<const ColumnarTable*>(pAux);
+    sqlite3_str* schema = sqlite3_str_new(db);
+    sqlite3_str_appendall(schema, "CREATE TABLE x(");
+    for (int i = 0; i < table->columnCount; i++) {
+        const int type = table->columns[i].type;
+        sqlite3_str_appendf(schema, "%s\"%w\" %s", i == 0 ? "" : ", ", table->columns[i].name,
+                            type == COLUMNAR_INT32 || type == COLUMNAR_INT64 ? "INTEGER" : "REAL");
+    }
+    sqlite3_str_appendall(schema, ")");
+    char* sql = sqlite3_str_finish(schema);
+    if (sql == NULL) return SQLITE_NOMEM;
+    int err = sqlite3_declare_vtab(db, sql);
+    sqlite3_free(sql);
+    if (err != SQLITE_OK) return err;
+
+    ColumnarVtab* vtab = static_cast<ColumnarVtab*>(sqlite3_malloc(sizeof(ColumnarVtab)));
+    if (vtab == NULL) return SQLITE_NOMEM;
+    memset(vtab, 0, sizeof(ColumnarVtab));
+    vtab->table = table;
+    sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+    *ppVtab = &vtab->base;
+    return SQLITE_OK;
+}
+
+static int columnarDisconnect(sqlite3_vtab* pVtab) {
+    sqlite3_free(pVtab);
+    return SQLITE_OK;
+}
+
+static int columnarBestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* info) {
+    const ColumnarTable* table = reinterpret_cast<ColumnarVtab*>(pVtab)->table;
+    int eq = -1, lower = -1, upper = -1, rowid = -1;
+    int idxNum = 0;
+    for (int i = 0; i < info->nConstraint; i++) {
+        const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+        if (!constraint.usable) continue;
+        if (constraint.iColumn == -1) {
+            if (constraint.op == SQLITE_INDEX_CONSTRAINT_EQ && rowid < 0) rowid = i;
+            continue;
+        }
+        if (constraint.iColumn != table->sortedColumn) continue;
+        switch (constraint.op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ:
+                if (eq < 0) eq = i;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_GT:
+            case SQLITE_INDEX_CONSTRAINT_GE:
+                if (lower < 0) lower = i;
+                break;
+            case SQLITE_INDEX_CONSTRAINT_LT:
+            case SQLITE_INDEX_CONSTRAINT_LE:
+                if (upper < 0) upper = i;
+                break;
+        }
+    }
+
+    // Values are compared natively only when they are numbers, so constraints are not omitted
+    // and SQLite still checks them with its own type conversion rules
+    int argvIndex = 0;
+    double cost = (double) table->rowCount;
+    if (eq >= 0) {
+        idxNum |= FILTER_KEY_EQ;
+        info->aConstraintUsage[eq].argvIndex = ++argvIndex;
+        cost = 1.0;
+    } else {
+        if (lower >= 0) {
+            idxNum |= info->aConstraint[lower].op == SQLITE_INDEX_CONSTRAINT_GE ? FILTER_KEY_LOWER_INCLUSIVE : FILTER_KEY_LOWER;
+            info->aConstraintUsage[lower].argvIndex = ++argvIndex;
+            cost /= 4;
+        }
+        if (upper >= 0) {
+            idxNum |= info->aConstraint[upper].op == SQLITE_INDEX_CONSTRAINT_LE ? FILTER_KEY_UPPER_INCLUSIVE : FILTER_KEY_UPPER;
+            info->aConstraintUsage[upper].argvIndex = ++argvIndex;
+            cost /= 4;
+        }
+    }
+    if (rowid >= 0) {
+        idxNum |= FILTER_ROWID_EQ;
+        info->aConstraintUsage[rowid].argvIndex = ++argvIndex;
+        info->aConstraintUsage[rowid].omit = 1;
+        info->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+        cost = 1.0;
+    }
+    if (idxNum & (FILTER_KEY_EQ | FILTER_ROWID_EQ)) {
+        info->estimatedRows = 1;
+    } else {
+        info->estimatedRows = (sqlite3_int64) cost;
+    }
+    // Binary search on top of the per-row cost
+    info->estimatedCost = cost + (idxNum != 0 ? 20.0 : 0.0);
+    info->idxNum = idxNum;
+
+    if (info->nOrderBy == 1 && !info->aOrderBy[0].desc
+        && (info->aOrderBy[0].iColumn == -1 || (table->sortedColumn >= 0 && info->aOrderBy[0].iColumn == table->sortedColumn))) {
+        info->orderByConsumed = 1;
+    }
+    return SQLITE_OK;
+}
+
+static int columnarOpen(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor) {
+    ColumnarCursor* cursor = static_cast<ColumnarCursor*>(sqlite3_malloc(sizeof(ColumnarCursor)));
+    if (cursor == NULL) return SQLITE_NOMEM;
+    memset(cursor, 0, sizeof(ColumnarCursor));
+    *ppCursor = &cursor->base;
+    return SQLITE_OK;
+}
+
+static int columnarClose(sqlite3_vtab_cursor* pCursor) {
+    sqlite3_free(pCursor);
+    return SQLITE_OK;
+}
+
+/** Compare value of the key column in the row with a numeric value. */
+static int compareKey(const ColumnarColumn& column, sqlite3_int64 row, sqlite3_value* value, bool integerValue) {
+    switch (column.type) {
+        case COLUMNAR_INT32:
+        case COLUMNAR_INT64: {
+            sqlite3_int64 key;
+            if (column.type == COLUMNAR_INT32) {
+                int32_t key32;
+                memcpy(&key32, static_cast<const uint8_t*>(column.data) + row * 4, 4);
+                key = key32;
+            } else {
+                memcpy(&key, static_cast<const uint8_t*>(column.data) + row * 8, 8);
+            }
+            if (integerValue) {
+                const sqlite3_int64 other = sqlite3_value_int64(value);
+                return key < other ? -1 : key > other ? 1 : 0;
+            }
+            const double other = sqlite3_value_double(value);
+            return (double) key < other ? -1 : (double) key > other ? 1 : 0;
+        }
+        default: {
+            double key;
+            if (column.type == COLUMNAR_FLOAT32) {
+                float key32;
+                memcpy(&key32, static_cast<const uint8_t*>(column.data) + row * 4, 4);
+                key = key32;
+            } else {
+                memcpy(&key, static_cast<const uint8_t*>(column.data) + row * 8, 8);
+            }
+            const double other = sqlite3_value_double(value);
+            return key < other ? -1 : key > other ? 1 : 0;
+        }
+    }
+}
+
+/**
+ * First row in [begin, end) whose key is greater (or greater or equal, if not inclusive)
+ * than the value, or end. Keys must be sorted in ascending order.
+ */
+static sqlite3_int64 searchKey(const ColumnarColumn& column, sqlite3_int64 begin, sqlite3_int64 end,
+                               sqlite3_value* value, bool integerValue, bool inclusive) {
+    while (begin < end) {
+        const sqlite3_int64 middle = begin + (end - begin) / 2;
+        const int comparison = compareKey(column, middle, value, integerValue);
+        if (comparison < 0 || (inclusive && comparison == 0)) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return begin;
+}
+
+static int columnarFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr, int argc, sqlite3_value** argv) {
+    ColumnarCursor* cursor = reinterpret_cast<ColumnarCursor*>(pCursor);
+    const ColumnarTable* table = reinterpret_cast<ColumnarVtab*>(pCursor->pVtab)->table;
+    sqlite3_int64 begin = 0, end = table->rowCount;
+
+    int arg = 0;
+    const int keyFilters = FILTER_KEY_EQ | FILTER_KEY_LOWER | FILTER_KEY_LOWER_INCLUSIVE | FILTER_KEY_UPPER | FILTER_KEY_UPPER_INCLUSIVE;
+    for (int filter = FILTER_KEY_EQ; filter & keyFilters; filter <<= 1) {
+        if (!(idxNum & filter)) continue;
+        sqlite3_value* value = argv[arg++];
+        const int type = sqlite3_value_numeric_type(value);
+        if (type == SQLITE_NULL) {
+            // Comparisons with NULL are never true
+            begin = end;
+            break;
+        }
+        // TEXT and BLOB values compare greater than any number, leave them to SQLite
+        if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) continue;
+        const ColumnarColumn& key = table->columns[table->sortedColumn];
+        const bool integerValue = type == SQLITE_INTEGER;
+        switch (filter) {
+            case FILTER_KEY_EQ:
+                begin = searchKey(key, begin, end, value, integerValue, false);
+                end = searchKey(key, begin, end, value, integerValue, true);
+                break;
+            case FILTER_KEY_LOWER:
+            case FILTER_KEY_LOWER_INCLUSIVE:
+                begin = searchKey(key, begin, end, value, integerValue, filter == FILTER_KEY_LOWER);
+                break;
+            case FILTER_KEY_UPPER:
+            case FILTER_KEY_UPPER_INCLUSIVE:
+                end = searchKey(key, begin, end, value, integerValue, filter == FILTER_KEY_UPPER_INCLUSIVE);
+                break;
+        }
+    }
+    if (idxNum & FILTER_ROWID_EQ) {
+        sqlite3_value* value = argv[arg++];
+        const int type = sqlite3_value_numeric_type(value);
+        const sqlite3_int64 row = sqlite3_value_int64(value);
+        const bool integer = type == SQLITE_INTEGER || (type == SQLITE_FLOAT && sqlite3_value_double(value) == (double) row);
+        if (integer && row >= begin && row < end) {
+            begin = row;
+            end = row + 1;
+        } else {
+            begin = end;
+        }
+    }
+
+    cursor->row = begin;
+    cursor->end = end;
+    return SQLITE_OK;
+}
+
+static int columnarNext(sqlite3_vtab_cursor* pCursor) {
+    reinterpret_cast<ColumnarCursor*>(pCursor)->row++;
+    return SQLITE_OK;
+}
+
+static int columnarEof(sqlite3_vtab_cursor* pCursor) {
+    const ColumnarCursor* cursor = reinterpret_cast<ColumnarCursor*>(pCursor);
+    return cursor->row >= cursor->end;
+}
+
+static int columnarColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int index) {
+    const ColumnarCursor* cursor = reinterpret_cast<ColumnarCursor*>(pCursor);
+    const ColumnarColumn& column = reinterpret_cast<ColumnarVtab*>(pCursor->pVtab)->table->columns[index];
+    const uint8_t* data = static_cast<const uint8_t*>(column.data);
+    switch (column.type) {
+        case COLUMNAR_INT32: {
+            int32_t value;
+            memcpy(&value, data + cursor->row * 4, 4);
+            sqlite3_result_int64(context, value);
+            break;
+        }
+        case COLUMNAR_INT64: {
+            sqlite3_int64 value;
+            memcpy(&value, data + cursor->row * 8, 8);
+            sqlite3_result_int64(context, value);
+            break;
+        }
+        case COLUMNAR_FLOAT32: {
+            float value;
+            memcpy(&value, data + cursor->row * 4, 4);
+            sqlite3_result_double(context, value);
+            break;
+        }
+        case COLUMNAR_FLOAT64: {
+            double value;
+            memcpy(&value, data + cursor->row * 8, 8);
+            sqlite3_result_double(context, value);
+            break;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static int columnarRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    *pRowid = reinterpret_cast<ColumnarCursor*>(pCursor)->row;
+    return SQLITE_OK;
+}
+
+static sqlite3_module columnarModule = {
+    /* iVersion    */ 0,
+    /* xCreate     */ NULL,
+    /* xConnect    */ columnarConnect,
+    /* xBestIndex  */ columnarBestIndex,
+    /* xDisconnect */ columnarDisconnect,
+    /* xDestroy    */ NULL,
+    /* xOpen       */ columnarOpen,
+    /* xClose      */ columnarClose,
+    /* xFilter     */ columnarFilter,
+    /* xNext       */ columnarNext,
+    /* xEof        */ columnarEof,
+    /* xColumn     */ columnarColumn,
+    /* xRowid      */ columnarRowid,
+};
+
+int createColumnarTable(sqlite3* db, const char* name, ColumnarColumn* columns, int columnCount,
+                        sqlite3_int64 rowCount, int sortedColumn) {
+    // Replacing a module, such as json_each or another columnar table, would break statements that use it.
+    // Names of pragma table-valued functions are resolved only when no module has them.
+    if (sqlite3ex_module(db, name) != NULL || sqlite3_strnicmp(name, "pragma_", 7) == 0) {
+        freeColumnarColumns(columns, columnCount);
+        return SQLITE_ERROR;
+    }
+    ColumnarTable* table = static_cast<ColumnarTable*>(sqlite3_malloc(sizeof(ColumnarTable)));
+    if (table == NULL) {
+        freeColumnarColumns(columns, columnCount);
+        return SQLITE_NOMEM;
+    }
+    table->columns = columns;
+    table->columnCount = columnCount;
+    table->rowCount = rowCount;
+    table->sortedColumn = sortedColumn;
+    // Destructor is called also on failure
+    return sqlite3_create_module_v2(db, name, &columnarModule, table, columnarTableDestroy);
+}
+
+int dropColumnarTable(sqlite3* db, const char* name) {
+    if (sqlite3ex_module(db, name) != &columnarModule) return SQLITE_OK;
+    // Previous module is destroyed once no statement uses it
+    return sqlite3_create_module_v2(db, name, NULL, NULL, NULL);
+}
+
+} // namespace android
@@ -0,0 +1,193 @@
+// Value compression with LZ4, see SQLiteCompression.h for the format.
+//
+// compress(X[, D])   - compress TEXT or BLOB X, optionally with a dictionary BLOB D
+// decompress(X[, D]) - decompress value created by compress(), returns TEXT or BLOB
+//
+// Other types (NULL, INTEGER, REAL) are passed through both functions unchanged.
+// Dictionaries should contain data typical for the compressed values, at most the last 64 kB are used.
+// Values compressed with a dictionary can be decompressed only with the same dictionary.
+
+#define LOG_TAG "SQLiteCompression"
+
+#include <string.h>
+
+#include "lz4.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "SQLiteCompression.h"
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+static const size_t HEADER_LENGTH = 5;
+static const size_t DICTIONARY_HEADER_LENGTH = 9;
+
+size_t compressedValueBound(size_t length) {
+    return DICTIONARY_HEADER_LENGTH + length + length / 255 + 16;
+}
+
+static void writeLittleEndian32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t) (value >> (i * 8));
+    }
+}
+
+static uint32_t readLittleEndian32(const uint8_t* in) {
+    return (uint32_t) in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16 | (uint32_t) in[3] << 24;
+}
+
+size_t compressValue(const void* src, size_t length, bool text,
+        const void* dictionary, size_t dictionaryLength, uint8_t* dst) {
+    uint8_t flags = text ? COMPRESSED_VALUE_TEXT : 0;
+    size_t headerLength = HEADER_LENGTH;
+    if (dictionary != NULL && dictionaryLength > 0) {
+        flags |= COMPRESSED_VALUE_DICTIONARY;
+        writeLittleEndian32(dst + HEADER_LENGTH, XXH32(dictionary, dictionaryLength, 0));
+        headerLength = DICTIONARY_HEADER_LENGTH;
+    }
+    writeLittleEndian32(dst + 1, (uint32_t) length);
+
+    const int capacity = (int) (compressedValueBound(length) - headerLength);
+    int compressedLength = 0;
+    if (length > 0 && length <= LZ4_MAX_INPUT_SIZE) {
+        char* out = reinterpret_cast<char*>(dst + headerLength);
+        if (flags & COMPRESSED_VALUE_DICTIONARY) {
+            LZ4_stream_t* stream = static_cast<LZ4_stream_t*>(sqlite3_malloc64(sizeof(LZ4_stream_t)));
+            if (stream != NULL) {
+                LZ4_initStream(stream, sizeof(LZ4_stream_t));
+                LZ4_loadDict(stream, static_cast<const char*>(dictionary), (int) dictionaryLength);
+                compressedLength = LZ4_compress_fast_continue(stream, static_cast<const char*>(src), out,
+                        (int) length, capacity, 1);
+                sqlite3_free(stream);
+            }
+        } else {
+            compressedLength = LZ4_compress_default(static_cast<const char*>(src), out, (int) length, capacity);
+        }
+    }
+
+    if (compressedLength <= 0 || (size_t) compressedLength >= length) {
+        // Does not compress, store as is, without the dictionary, which would only complicate decompression
+        flags = (flags & COMPRESSED_VALUE_TEXT) | COMPRESSED_VALUE_STORED;
+        headerLength = HEADER_LENGTH;
+        if (length > 0) {
+            memcpy(dst + headerLength, src, length);
+        }
+        compressedLength = (int) length;
+    }
+    dst[0] = COMPRESSED_VALUE_MAGIC | flags;
+    return headerLength + compressedLength;
+}
+
+bool readCompressedValue(const void* src, size_t length, CompressedValue* out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    if (length < HEADER_LENGTH || (bytes[0] & 0xF8) != COMPRESSED_VALUE_MAGIC) {
+        return false;
+    }
+    out->flags = bytes[0] & 0x07;
+    out->length = readLittleEndian32(bytes + 1);
+    size_t headerLength = HEADER_LENGTH;
+    out->dictionaryChecksum = 0;
+    if (out->flags & COMPRESSED_VALUE_DICTIONARY) {
+        if (length < DICTIONARY_HEADER_LENGTH) return false;
+        out->dictionaryChecksum = readLittleEndian32(bytes + HEADER_LENGTH);
+        headerLength = DICTIONARY_HEADER_LENGTH;
+    }
+    out->payload = bytes + headerLength;
+    out->payloadLength = length - headerLength;
+    return true;
+}
+
+const char* decompressValue(const CompressedValue& value,
+        const void* dictionary, size_t dictionaryLength, void* dst) {
+    if (value.flags & COMPRESSED_VALUE_STORED) {
+        if (value.payloadLength != value.length) return "Corrupted compressed value";
+        if (value.length > 0) {
+            memcpy(dst, value.payload, value.length);
+        }
+        return NULL;
+    }
+
+    const char* src = reinterpret_cast<const char*>(value.payload);
+    char* out = static_cast<char*>(dst);
+    int decompressedLength;
+    if (value.flags & COMPRESSED_VALUE_DICTIONARY) {
+        if (dictionary == NULL || dictionaryLength == 0) return "Value is compressed with a dictionary";
+        if (XXH32(dictionary, dictionaryLength, 0) != value.dictionaryChecksum) return "Value is compressed with a different dictionary";
+        decompressedLength = LZ4_decompress_safe_usingDict(src, out, (int) value.payloadLength, (int) value.length,
+                static_cast<const char*>(dictionary), (int) dictionaryLength);
+    } else {
+        decompressedLength = LZ4_decompress_safe(src, out, (int) value.payloadLength, (int) value.length);
+    }
+    if (decompressedLength < 0 || (uint32_t) decompressedLength != value.length) return "Corrupted compressed value";
+    return NULL;
+}
+
+static void compressFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    const int type = sqlite3_value_type(argv[0]);
+    if (type != SQLITE_TEXT && type != SQLITE_BLOB) {
+        sqlite3_result_value(context, argv[0]);
+        return;
+    }
+    const void* value = type == SQLITE_TEXT ? sqlite3_value_text(argv[0]) : sqlite3_value_blob(argv[0]);
+    const size_t length = (size_t) sqlite3_value_bytes(argv[0]);
+    const void* dictionary = argc > 1 ? sqlite3_value_blob(argv[1]) : NULL;
+    const size_t dictionaryLength = argc > 1 ? (size_t) sqlite3_value_bytes(argv[1]) : 0;
+
+    uint8_t* compressed = static_cast<uint8_t*>(sqlite3_malloc64(compressedValueBound(length)));
+    if (compressed == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    size_t compressedLength = compressValue(value, length, type == SQLITE_TEXT, dictionary, dictionaryLength, compressed);
+    sqlite3_result_blob64(context, compressed, compressedLength, sqlite3_free);
+}
+
+static void decompressFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) {
+        sqlite3_result_value(context, argv[0]);
+        return;
+    }
+    CompressedValue value;
+    if (!readCompressedValue(sqlite3_value_blob(argv[0]), (size_t) sqlite3_value_bytes(argv[0]), &value)) {
+        sqlite3_result_error(context, "decompress(): not a compressed value", -1);
+        return;
+    }
+    if (value.length > (uint32_t) sqlite3_limit(sqlite3_context_db_handle(context), SQLITE_LIMIT_LENGTH, -1)) {
+        sqlite3_result_error_toobig(context);
+        return;
+    }
+    const void* dictionary = argc > 1 ? sqlite3_value_blob(argv[1]) : NULL;
+    const size_t dictionaryLength = argc > 1 ? (size_t) sqlite3_value_bytes(argv[1]) : 0;
+
+    // +1 so that empty values are not a NULL allocation
+    void* decompressed = sqlite3_malloc64(value.length + 1);
+    if (decompressed == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    const char* error = decompressValue(value, dictionary, dictionaryLength, decompressed);
+    if (error != NULL) {
+        sqlite3_free(decompressed);
+        sqlite3_result_error(context, error, -1);
+    } else if (value.flags & COMPRESSED_VALUE_TEXT) {
+        sqlite3_result_text64(context, static_cast<const char*>(decompressed), value.length, sqlite3_free, SQLITE_UTF8);
+    } else {
+        sqlite3_result_blob64(context, decompressed, value.length, sqlite3_free);
+    }
+}
+
+int registerCompressionFunctions(sqlite3* db) {
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    int err = SQLITE_OK;
+    for (int argc = 1; argc <= 2 && err == SQLITE_OK; argc++) {
+        err = sqlite3_create_function_v2(db, "compress", argc, flags, NULL, compressFunction, NULL, NULL, NULL);
+        if (err == SQLITE_OK) {
+            err = sqlite3_create_function_v2(db, "decompress", argc, flags, NULL, decompressFunction, NULL, NULL, NULL);
+        }
+    }
+    return err;
+}
+
+} // namespace android
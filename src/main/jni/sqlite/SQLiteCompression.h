@@ -0,0 +1,55 @@
+#ifndef SQLITE_COMPRESSION_H
+#define SQLITE_COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed value format, shared by the compress()/decompress() SQL functions
+// and by the compressed bindings and columns of SQLiteStatement:
+//
+// byte 0:    COMPRESSED_VALUE_MAGIC | flags
+// bytes 1-4: uncompressed length, little-endian
+// bytes 5-8: XXH32 of the dictionary, only if COMPRESSED_VALUE_DICTIONARY flag is set
+// rest:      LZ4 block, or the value itself if COMPRESSED_VALUE_STORED flag is set
+
+namespace android {
+
+static const uint8_t COMPRESSED_VALUE_MAGIC = 0xB0;
+/** Uncompressed value is TEXT in UTF-8, otherwise BLOB. */
+static const uint8_t COMPRESSED_VALUE_TEXT = 0x01;
+/** Value was compressed with a dictionary. */
+static const uint8_t COMPRESSED_VALUE_DICTIONARY = 0x02;
+/** Value did not compress, so it is stored as is. */
+static const uint8_t COMPRESSED_VALUE_STORED = 0x04;
+
+struct CompressedValue {
+    uint8_t flags;
+    uint32_t length;
+    uint32_t dictionaryChecksum;
+    const uint8_t* payload;
+    size_t payloadLength;
+};
+
+/** How big the buffer for compressValue must be. */
+size_t compressedValueBound(size_t length);
+
+/**
+ * Compress value into dst, which has at least compressedValueBound(length) bytes.
+ * Dictionary may be NULL. Returns the length of the compressed value.
+ */
+size_t compressValue(const void* src, size_t length, bool text,
+        const void* dictionary, size_t dictionaryLength, uint8_t* dst);
+
+/** Parse the header of the compressed value. Returns false if the value is not a compressed value. */
+bool readCompressedValue(const void* src, size_t length, CompressedValue* out);
+
+/**
+ * Decompress value into dst, which has at least out.length bytes.
+ * Returns NULL on success or an error message.
+ */
+const char* decompressValue(const CompressedValue& value,
+        const void* dictionary, size_t dictionaryLength, void* dst);
+
+}
+
+#endif // SQLITE_COMPRESSION_H
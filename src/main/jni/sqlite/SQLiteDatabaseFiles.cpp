@@ -0,0 +1,204 @@
+// Operations on whole database files, see SQLiteDatabaseFiles.h.
+
+#define LOG_TAG "SQLiteDatabaseFiles"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sqlite3ex.h"
+#include "SQLiteDatabaseFiles.h"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#ifndef SEEK_DATA
+#define SEEK_DATA 3
+#define SEEK_HOLE 4
+#endif
+
+namespace android {
+
+static const size_t COPY_BUFFER_LENGTH = 256 * 1024;
+
+static bool copyRange(int srcFd, int dstFd, off_t offset, off_t end, uint8_t* buffer) {
+    while (offset < end) {
+        size_t length = COPY_BUFFER_LENGTH;
+        if ((off_t) length > end - offset) length = (size_t) (end - offset);
+        const ssize_t read = pread(srcFd, buffer, length, offset);
+        if (read < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (read == 0) break;// Shorter than its size, the rest stays a hole
+        for (ssize_t written = 0; written < read;) {
+            const ssize_t result = pwrite(dstFd, buffer + written, (size_t) (read - written), offset + written);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += result;
+        }
+        offset += read;
+    }
+    return true;
+}
+
+/** Copy the data of the file, skipping holes, which stay holes in the copy. */
+static bool copySparse(int srcFd, int dstFd) {
+    struct stat srcStat;
+    if (fstat(srcFd, &srcStat) != 0 || ftruncate(dstFd, srcStat.st_size) != 0) return false;
+    uint8_t* buffer = static_cast<uint8_t*>(sqlite3_malloc64(COPY_BUFFER_LENGTH));
+    if (buffer == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    // The offset of the descriptor is changed by SEEK_DATA, but SQLite always seeks or uses pread
+    const off_t size = srcStat.st_size;
+    bool ok = true;
+    for (off_t offset = 0; ok && offset < size;) {
+        off_t data = lseek(srcFd, offset, SEEK_DATA);
+        off_t hole = size;
+        if (data < 0) {
+            if (errno == ENXIO) break;// Only a hole is left
+            if (errno != EINVAL) {
+                ok = false;
+                break;
+            }
+            // Holes are not supported, copy everything
+            data = offset;
+        } else {
+            hole = lseek(srcFd, data, SEEK_HOLE);
+            if (hole < 0 || hole > size) hole = size;
+        }
+        ok = copyRange(srcFd, dstFd, data, hole, buffer);
+        offset = hole;
+    }
+    sqlite3_free(buffer);
+    return ok;
+}
+
+/** Copy the database file, while the caller keeps writers out and the file has all committed transactions. */
+static int cloneFile(int srcFd, const char* destPath, int* method) {
+    const int dstFd = open(destPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (dstFd < 0) return SQLITE_CANTOPEN;
+
+    bool ok;
+    if (ioctl(dstFd, FICLONE, srcFd) == 0) {
+        *method = CLONE_METHOD_REFLINK;
+        ok = true;
+    } else {
+        // Not supported by the file system, or the files are on different ones
+        *method = CLONE_METHOD_COPY;
+        ok = copySparse(srcFd, dstFd);
+    }
+    ok = ok && fsync(dstFd) == 0;
+    const int savedErrno = errno;
+    close(dstFd);
+    errno = savedErrno;
+    return ok ? SQLITE_OK : SQLITE_IOERR_WRITE;
+}
+
+static int backupDatabase(sqlite3* db, const char* destPath) {
+    unlink(destPath);
+    sqlite3* dest = NULL;
+    int err = sqlite3_open_v2(destPath, &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (err == SQLITE_OK) {
+        sqlite3_backup* backup = sqlite3_backup_init(dest, "main", db, "main");
+        if (backup == NULL) {
+            err = sqlite3_errcode(dest);
+        } else {
+            // All pages in one step, so that the copy is of one snapshot
+            sqlite3_backup_step(backup, -1);
+            err = sqlite3_backup_finish(backup);
+        }
+    }
+    sqlite3_close(dest);
+    return err;
+}
+
+/** Is the WAL empty, or missing because the database is not in WAL mode? */
+static bool isWalEmpty(const char* path) {
+    struct stat walStat;
+    const char* walPath = sqlite3_filename_wal(path);
+    if (walPath == NULL || stat(walPath, &walStat) != 0) return true;
+    return walStat.st_size == 0;
+}
+
+int cloneDatabase(sqlite3* db, const char* destPath, int* method) {
+    const char* path = sqlite3_db_filename(db, "main");
+    if (path == NULL || path[0] == 0) return SQLITE_MISUSE;
+
+    // Move the WAL into the database file, then lock out writers and check that none came in between.
+    // Checkpoint fails when other connections read from the WAL, BEGIN IMMEDIATE when they write.
+    int err = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+    if (err == SQLITE_OK) {
+        err = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+        if (err == SQLITE_OK) {
+            int fd = -1;
+            if (isWalEmpty(path)) {
+                fd = sqlite3ex_file_descriptor(db, "main");
+            }
+            err = fd == -1 ? SQLITE_BUSY : cloneFile(fd, destPath, method);
+            const int savedErrno = errno;
+            sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+            errno = savedErrno;
+            if (err != SQLITE_BUSY) return err;
+        }
+    }
+
+    sqlite3ex_clear_errcode(db);
+    *method = CLONE_METHOD_BACKUP;
+    return backupDatabase(db, destPath);
+}
+
+static bool isWalMode(sqlite3* db) {
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(db, "PRAGMA main.journal_mode", -1, &statement, NULL) != SQLITE_OK) return false;
+    bool wal = false;
+    if (sqlite3_step(statement) == SQLITE_ROW) {
+        const char* mode = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+        wal = mode != NULL && sqlite3_stricmp(mode, "wal") == 0;
+    }
+    sqlite3_finalize(statement);
+    return wal;
+}
+
+int setFileGrowth(sqlite3* db, int chunkSize, int walSize) {
+    if (chunkSize > 0) {
+        const int err = sqlite3_file_control(db, "main", SQLITE_FCNTL_CHUNK_SIZE, &chunkSize);
+        if (err != SQLITE_OK) return err;
+    }
+    if (walSize <= 0 || !isWalMode(db)) return SQLITE_OK;
+
+    char* sql = sqlite3_mprintf("PRAGMA main.journal_size_limit=%d", walSize);
+    if (sql == NULL) return SQLITE_NOMEM;
+    int err = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+    if (err != SQLITE_OK) return err;
+
+    // Writers append to the WAL and checkpoints truncate it, both with the write lock.
+    // The file is only extended past its end, the bytes there are not valid frames.
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        sqlite3ex_clear_errcode(db);
+        return SQLITE_OK;
+    }
+    // In WAL mode, the journal of the pager is the WAL
+    sqlite3_file* wal = NULL;
+    err = sqlite3_file_control(db, "main", SQLITE_FCNTL_JOURNAL_POINTER, &wal);
+    if (err == SQLITE_OK && wal != NULL && wal->pMethods != NULL) {
+        err = wal->pMethods->xFileControl(wal, SQLITE_FCNTL_CHUNK_SIZE, &walSize);
+        if (err == SQLITE_OK) {
+            sqlite3_int64 size = walSize;
+            err = wal->pMethods->xFileControl(wal, SQLITE_FCNTL_SIZE_HINT, &size);
+        }
+    }
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    return err == SQLITE_NOTFOUND ? SQLITE_OK : err;
+}
+
+}
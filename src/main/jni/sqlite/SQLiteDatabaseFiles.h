@@ -0,0 +1,43 @@
+#ifndef SQLITE_DATABASE_FILES_H
+#define SQLITE_DATABASE_FILES_H
+
+#include <sqlite3.h>
+
+// Operations on whole database files.
+
+namespace android {
+
+/** How cloneDatabase copied the database, must match SQLiteDatabaseFiles.CLONE_ constants. */
+enum CloneMethod {
+    /** The file shares its blocks with the template until either is written (FICLONE). */
+    CLONE_METHOD_REFLINK = 1,
+    /** The file was copied, without the holes of the template. */
+    CLONE_METHOD_COPY = 2,
+    /** The pages were copied by the backup API, because the WAL could not be checkpointed first. */
+    CLONE_METHOD_BACKUP = 3,
+};
+
+/**
+ * Copy the main database of the connection into a new file at destPath, which is replaced if it exists.
+ * The WAL of the template is checkpointed first and writers are locked out while the file is copied,
+ * so the copy has all transactions committed before the call and needs no WAL.
+ * When the WAL can't be emptied, or the file can't be accessed directly, the backup API is used instead.
+ * The connection must not be in a transaction.
+ * Returns SQLITE_OK and sets method to CloneMethod, SQLITE_MISUSE for in-memory databases, an error of SQLite
+ * (with the message in the connection when it is from it) or SQLITE_CANTOPEN or SQLITE_IOERR_WRITE (with errno set).
+ */
+int cloneDatabase(sqlite3* db, const char* destPath, int* method);
+
+/**
+ * Set how the files of the main database grow, for write-heavy databases.
+ * When chunkSize is positive, the database file grows and shrinks in multiples of it (SQLITE_FCNTL_CHUNK_SIZE).
+ * When walSize is positive and the database is in WAL mode, the WAL is preallocated to walSize
+ * and truncated back to a multiple of it when it is restarted (journal_size_limit).
+ * The WAL is extended only while writers are locked out; when they can't be, it is left for the next call.
+ * The connection must not be in a transaction.
+ */
+int setFileGrowth(sqlite3* db, int chunkSize, int walSize);
+
+}
+
+#endif // SQLITE_DATABASE_FILES_H
@@ -0,0 +1,256 @@
+// Export of query results, see SQLiteFileFormats.h for the formats.
+//
+// Text formats are written sequentially through a large buffer, so the descriptor can also be a pipe or a socket.
+
+#define LOG_TAG "SQLiteExport"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SQLiteFileFormats.h"
+#include "SQLiteRowFormat.h"
+
+namespace android {
+
+static const size_t EXPORT_BUFFER_LENGTH = 256 * 1024;
+
+struct Exporter {
+    int fd;
+    char* buffer;
+    size_t length;
+    int err;
+};
+
+static bool flush(Exporter* exporter) {
+    const char* data = exporter->buffer;
+    size_t length = exporter->length;
+    while (length > 0) {
+        const ssize_t written = write(exporter->fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            exporter->err = SQLITE_IOERR_WRITE;
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    exporter->length = 0;
+    return true;
+}
+
+static void output(Exporter* exporter, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (exporter->err == SQLITE_OK && length > 0) {
+        if (exporter->length == EXPORT_BUFFER_LENGTH && !flush(exporter)) return;
+        size_t chunk = EXPORT_BUFFER_LENGTH - exporter->length;
+        if (chunk > length) chunk = length;
+        memcpy(exporter->buffer + exporter->length, bytes, chunk);
+        exporter->length += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+static inline void outputByte(Exporter* exporter, char c) {
+    if (exporter->length < EXPORT_BUFFER_LENGTH) {
+        exporter->buffer[exporter->length++] = c;
+    } else {
+        output(exporter, &c, 1);
+    }
+}
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static void outputHex(Exporter* exporter, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        outputByte(exporter, HEX_DIGITS[data[i] >> 4]);
+        outputByte(exporter, HEX_DIGITS[data[i] & 0xF]);
+    }
+}
+
+// CSV
+
+/** Field, quoted if it contains a comma, quote or newline, or if it is empty, to tell it apart from NULL. */
+static void outputCsvField(Exporter* exporter, const char* text, size_t length) {
+    bool quote = length == 0;
+    for (size_t i = 0; i < length && !quote; i++) {
+        const char c = text[i];
+        quote = c == ',' || c == '"' || c == '\n' || c == '\r';
+    }
+    if (!quote) {
+        output(exporter, text, length);
+        return;
+    }
+    outputByte(exporter, '"');
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '"') {
+            // Doubled
+            output(exporter, text + start, i + 1 - start);
+            start = i;
+        }
+    }
+    output(exporter, text + start, length - start);
+    outputByte(exporter, '"');
+}
+
+static void outputCsvRow(Exporter* exporter, sqlite3_stmt* statement, int columnCount) {
+    for (int c = 0; c < columnCount; c++) {
+        if (c > 0) outputByte(exporter, ',');
+        switch (sqlite3_column_type(statement, c)) {
+            case SQLITE_NULL:
+                break;
+            case SQLITE_BLOB:
+                outputHex(exporter, static_cast<const uint8_t*>(sqlite3_column_blob(statement, c)),
+                          (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            default: {
+                // Numbers are converted like CAST(X AS TEXT)
+                const char* text = reinterpret_cast<const char*>(sqlite3_column_text(statement, c));
+                if (text == NULL) {
+                    exporter->err = SQLITE_NOMEM;
+                    return;
+                }
+                outputCsvField(exporter, text, (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            }
+        }
+    }
+    outputByte(exporter, '\n');
+}
+
+// NDJSON
+
+static void outputJsonString(Exporter* exporter, const char* text, size_t length) {
+    outputByte(exporter, '"');
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t c = (uint8_t) text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        output(exporter, text + start, i - start);
+        start = i + 1;
+        char escape[7] = { '\\', 0 };
+        size_t escapeLength = 2;
+        switch (c) {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = HEX_DIGITS[c >> 4];
+                escape[5] = HEX_DIGITS[c & 0xF];
+                escapeLength = 6;
+                break;
+        }
+        output(exporter, escape, escapeLength);
+    }
+    output(exporter, text + start, length - start);
+    outputByte(exporter, '"');
+}
+
+static void outputJsonRow(Exporter* exporter, sqlite3_stmt* statement, int columnCount) {
+    outputByte(exporter, '{');
+    for (int c = 0; c < columnCount; c++) {
+        if (c > 0) outputByte(exporter, ',');
+        const char* name = sqlite3_column_name(statement, c);
+        if (name == NULL) {
+            exporter->err = SQLITE_NOMEM;
+            return;
+        }
+        outputJsonString(exporter, name, strlen(name));
+        outputByte(exporter, ':');
+        switch (sqlite3_column_type(statement, c)) {
+            case SQLITE_NULL:
+                output(exporter, "null", 4);
+                break;
+            case SQLITE_FLOAT:
+                // JSON has no infinity
+                if (!isfinite(sqlite3_column_double(statement, c))) {
+                    output(exporter, "null", 4);
+                    break;
+                }
+                // fallthrough
+            case SQLITE_INTEGER: {
+                const char* text = reinterpret_cast<const char*>(sqlite3_column_text(statement, c));
+                if (text == NULL) {
+                    exporter->err = SQLITE_NOMEM;
+                    return;
+                }
+                output(exporter, text, (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            }
+            case SQLITE_TEXT:
+                outputJsonString(exporter, reinterpret_cast<const char*>(sqlite3_column_text(statement, c)),
+                                 (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            case SQLITE_BLOB:
+                outputByte(exporter, '"');
+                outputHex(exporter, static_cast<const uint8_t*>(sqlite3_column_blob(statement, c)),
+                          (size_t) sqlite3_column_bytes(statement, c));
+                outputByte(exporter, '"');
+                break;
+        }
+    }
+    output(exporter, "}\n", 2);
+}
+
+int exportRows(sqlite3_stmt* statement, int format, int fd, int64_t* rowCount) {
+    *rowCount = 0;
+    if (format == FILE_FORMAT_ROWS) {
+        RowFormatOutput out;
+        const int err = writeRowFormat(statement, -1, 1, fd, &out);
+        *rowCount = out.rowCount;
+        return err;
+    }
+    if (format != FILE_FORMAT_CSV && format != FILE_FORMAT_CSV_HEADER && format != FILE_FORMAT_NDJSON) {
+        return SQLITE_MISUSE;
+    }
+
+    Exporter exporter;
+    exporter.fd = fd;
+    exporter.length = 0;
+    exporter.err = SQLITE_OK;
+    exporter.buffer = static_cast<char*>(sqlite3_malloc64(EXPORT_BUFFER_LENGTH));
+    if (exporter.buffer == NULL) return SQLITE_NOMEM;
+
+    const int columnCount = sqlite3_column_count(statement);
+    if (format == FILE_FORMAT_CSV_HEADER) {
+        for (int c = 0; c < columnCount && exporter.err == SQLITE_OK; c++) {
+            if (c > 0) outputByte(&exporter, ',');
+            const char* name = sqlite3_column_name(statement, c);
+            if (name == NULL) {
+                exporter.err = SQLITE_NOMEM;
+                break;
+            }
+            outputCsvField(&exporter, name, strlen(name));
+        }
+        outputByte(&exporter, '\n');
+    }
+
+    while (exporter.err == SQLITE_OK) {
+        const int err = sqlite3_step(statement);
+        if (err == SQLITE_DONE) break;
+        if (err != SQLITE_ROW) {
+            exporter.err = err;
+            break;
+        }
+        if (format == FILE_FORMAT_NDJSON) {
+            outputJsonRow(&exporter, statement, columnCount);
+        } else {
+            outputCsvRow(&exporter, statement, columnCount);
+        }
+        (*rowCount)++;
+    }
+    if (exporter.err == SQLITE_OK) flush(&exporter);
+
+    sqlite3_free(exporter.buffer);
+    return exporter.err;
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef SQLITE_EXTENSIONS_H
+#define SQLITE_EXTENSIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+// SQL functions and modules built into the library.
+// Each register function is called for every new connection
+// and returns SQLITE_OK or an error code.
+
+namespace android {
+
+// SQLiteHashFunctions.cpp
+int registerHashFunctions(sqlite3* db);
+/** XXH3 of the value, same as xxh3(X) SQL function. Returns false for NULL. */
+bool hashValue(sqlite3_value* value, uint64_t* hash);
+/** XXH3 of the bytes, same as xxh3(X) SQL function of TEXT or BLOB with these bytes. */
+uint64_t hashBytes(const void* data, size_t length);
+// SQLiteCompression.cpp
+int registerCompressionFunctions(sqlite3* db);
+// SQLiteVectorFunctions.cpp
+int registerVectorFunctions(sqlite3* db);
+// SQLiteRoaringFunctions.cpp
+int registerRoaringFunctions(sqlite3* db);
+// SQLiteSketchFunctions.cpp
+int registerSketchFunctions(sqlite3* db);
+// SQLiteTimeSeriesFunctions.cpp
+int registerTimeSeriesFunctions(sqlite3* db);
+// SQLiteColumnarTable.cpp
+enum ColumnarType {
+    COLUMNAR_INT32 = 1,
+    COLUMNAR_INT64 = 2,
+    COLUMNAR_FLOAT32 = 3,
+    COLUMNAR_FLOAT64 = 4,
+};
+struct ColumnarColumn {
+    /** Allocated with sqlite3_malloc. */
+    char* name;
+    /** ColumnarType */
+    int type;
+    /** Little-endian values, at least row count of them. */
+    const void* data;
+    /** Copy of the data owned by the table, freed with sqlite3_free, or NULL. */
+    void* owned;
+};
+/** Free the columns array with names and copies. */
+void freeColumnarColumns(ColumnarColumn* columns, int columnCount);
+/** Size of the ColumnarType in bytes, 0 for invalid types. */
+size_t columnarTypeSize(int type);
+/**
+ * Register eponymous virtual table NAME over the columns. Takes ownership of the columns array
+ * (allocated with sqlite3_malloc), their names and copies, also on failure.
+ * sortedColumn is the index of a column with values in ascending order, or -1.
+ * Returns SQLITE_ERROR if a module of the name already exists.
+ */
+int createColumnarTable(sqlite3* db, const char* name, ColumnarColumn* columns, int columnCount,
+                        sqlite3_int64 rowCount, int sortedColumn);
+/** Unregister the table created by createColumnarTable. Modules not created by it are left registered. */
+int dropColumnarTable(sqlite3* db, const char* name);
+// SQLiteMembershipFilter.cpp
+struct MembershipFilter;
+/**
+ * Build a Bloom filter of the column of the table in main database, kept up to date by TEMP triggers.
+ * The filter is freed by dropMembershipFilter or when the connection closes.
+ * On failure, errorMessage may be set to a message to free with sqlite3_free.
+ */
+int createMembershipFilter(sqlite3* db, const char* table, const char* column, double falsePositiveRate,
+                           MembershipFilter** result, char** errorMessage);
+/** Remove the triggers and free the filter. */
+int dropMembershipFilter(MembershipFilter* filter);
+/** Rebuild the filter if other connections changed the database or it is too full. Call before querying. */
+int syncMembershipFilter(MembershipFilter* filter);
+/** Prepare the statement which verifies positives of the filter, to be passed to the contains functions. */
+int prepareMembershipProbe(MembershipFilter* filter, sqlite3_stmt** probe);
+/** Is the INTEGER value in the column? The table is queried only when the filter contains the value. */
+int membershipFilterContainsInt64(MembershipFilter* filter, sqlite3_stmt* probe, int64_t value, bool* result);
+/** Is the TEXT value in the column? The table is queried only when the filter contains the value. */
+int membershipFilterContainsText(MembershipFilter* filter, sqlite3_stmt* probe,
+                                  const uint8_t* utf8, size_t length, bool* result);
+
+}
+
+#endif // SQLITE_EXTENSIONS_H
@@ -0,0 +1,75 @@
+#ifndef SQLITE_FILE_FORMATS_H
+#define SQLITE_FILE_FORMATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+// Import of files into tables and export of query results into files, without creating Java objects for rows.
+//
+// CSV follows RFC 4180: fields separated by commas, records by LF or CRLF,
+// fields with commas, quotes or newlines quoted with '"', quotes in them doubled.
+// Fields are bound as TEXT, so that column affinity converts them, and empty unquoted fields as NULL.
+//
+// NDJSON has one JSON object per line. Values are bound by their type: strings as TEXT, integers as INTEGER,
+// other numbers as REAL, true and false as 1 and 0, null as NULL, nested objects and arrays as their JSON TEXT.
+// Keys without a column are ignored, columns without a key are NULL.
+//
+// Exported CSV quotes only fields which need it and writes NULL as an empty field.
+// Exported NDJSON has one object per row, keyed by column names. Numbers are converted to text like CAST(X AS TEXT).
+// Both write BLOBs as lowercase hex. ROWS is the format of SQLiteRowFormat.h and can't be imported.
+
+namespace android {
+
+enum FileFormat {
+    FILE_FORMAT_CSV = 1,
+    /** CSV with a header line of column names, which is skipped on import. */
+    FILE_FORMAT_CSV_HEADER = 2,
+    FILE_FORMAT_NDJSON = 3,
+    /** Binary format of SQLiteRowFormat.h, export only. */
+    FILE_FORMAT_ROWS = 4,
+};
+
+struct ImportError {
+    /** Line where the failed record starts, from 1. */
+    int64_t line;
+    /** Allocated with sqlite3_malloc. */
+    char* message;
+};
+
+struct ImportResult {
+    /** Records read, without the header. */
+    int64_t records;
+    int64_t insertedRows;
+    int64_t failedRecords;
+    /** The first failures, at most maxErrors of them. */
+    ImportError* errors;
+    int errorCount;
+};
+
+/**
+ * Insert the records of the file into the table of the main database, with one prepared statement.
+ * CSV field i (NDJSON key columns[i]) is inserted into column columns[i], NULL columns skip their CSV field.
+ * Records which fail to parse, or to insert because of a constraint or a too big value, are recorded in result
+ * and skipped. Other errors stop the import and are returned, with errorMessage set to a message to free with sqlite3_free.
+ * When the connection is not in a transaction, rows are inserted in transactions of batchRows rows,
+ * otherwise they are inserted into the current transaction.
+ * Free the result with freeImportResult, also on failure.
+ */
+int importFile(sqlite3* db, const char* path, int format, const char* table,
+               const char* const* columns, int columnCount, int batchRows, int maxErrors,
+               ImportResult* result, char** errorMessage);
+
+void freeImportResult(ImportResult* result);
+
+/**
+ * Step the statement until done and write its rows to fd.
+ * Text formats are written sequentially from the current position of fd, ROWS needs a file and starts at offset 0.
+ * Returns SQLITE_OK, error of sqlite3_step, SQLITE_NOMEM, SQLITE_MISUSE for unknown formats
+ * or SQLITE_IOERR_WRITE (with errno set).
+ */
+int exportRows(sqlite3_stmt* statement, int format, int fd, int64_t* rowCount);
+
+}
+
+#endif // SQLITE_FILE_FORMATS_H
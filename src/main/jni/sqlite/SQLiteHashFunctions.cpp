@@ -0,0 +1,273 @@
+// Deterministic hashing SQL functions, for fingerprinting rows without pulling them into Java.
+//
+// xxh3(X)         - 64-bit XXH3 of the bytes of X, as INTEGER
+// xxh3(X, Y, ...) - 64-bit XXH3 of the whole row of values, as INTEGER
+// xxh3_128(...)   - same as above, but 128-bit XXH3 as a 16 byte big-endian BLOB
+// crc32c(X[, C])  - CRC-32C of the bytes of X, optionally continuing from a previous result C
+//
+// Bytes of a value are: UTF-8 for TEXT, raw bytes for BLOB,
+// 8 bytes little-endian for INTEGER and for the IEEE 754 bits of REAL.
+// Single NULL argument results in NULL.
+//
+// Row hashes prefix each value with its type (1 byte) and TEXT and BLOB also with their length
+// (4 bytes little-endian), so that ('ab', 'c') and ('a', 'bc') or (1, '1') hash differently.
+
+#define LOG_TAG "SQLiteHashFunctions"
+
+#include <stdint.h>
+#include <string.h>
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "SQLiteExtensions.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace android {
+
+static const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;// Reversed
+
+struct Crc32cTable {
+    uint32_t entries[256];
+
+    constexpr Crc32cTable() : entries() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1u)));
+            }
+            entries[i] = crc;
+        }
+    }
+};
+static constexpr Crc32cTable CRC32C_TABLE;
+
+typedef uint32_t (*Crc32cUpdate)(uint32_t crc, const uint8_t* data, size_t length);
+
+static uint32_t crc32cUpdateSoftware(uint32_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc = CRC32C_TABLE.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32cUpdateHardware(uint32_t crc, const uint8_t* data, size_t length) {
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t) crc64;
+#endif
+    for (; length >= 4; data += 4, length -= 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; data++, length--) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+
+static Crc32cUpdate selectCrc32cUpdate() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") ? crc32cUpdateHardware : crc32cUpdateSoftware;
+}
+#elif defined(__aarch64__)
+__attribute__((target("crc")))
+static uint32_t crc32cUpdateHardware(uint32_t crc, const uint8_t* data, size_t length) {
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; length > 0; data++, length--) {
+        crc = __crc32cb(crc, *data);
+    }
+    return crc;
+}
+
+static Crc32cUpdate selectCrc32cUpdate() {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) ? crc32cUpdateHardware : crc32cUpdateSoftware;
+}
+#else
+static Crc32cUpdate selectCrc32cUpdate() {
+    return crc32cUpdateSoftware;
+}
+#endif
+
+static Crc32cUpdate crc32cUpdate = NULL;// Selected on first use
+
+static uint32_t crc32c(uint32_t previousCrc, const uint8_t* data, size_t length) {
+    Crc32cUpdate update = __atomic_load_n(&crc32cUpdate, __ATOMIC_RELAXED);
+    if (update == NULL) {
+        update = selectCrc32cUpdate();
+        __atomic_store_n(&crc32cUpdate, update, __ATOMIC_RELAXED);
+    }
+    return ~update(~previousCrc, data, length);
+}
+
+static void writeLittleEndian64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t) (value >> (i * 8));
+    }
+}
+
+// Bytes of a single value, as described at the top.
+struct ValueBytes {
+    const uint8_t* data;
+    size_t length;
+    uint8_t number[8];
+};
+
+// Returns false for NULL.
+static bool getValueBytes(sqlite3_value* value, ValueBytes* out) {
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER:
+            writeLittleEndian64(out->number, (uint64_t) sqlite3_value_int64(value));
+            out->data = out->number;
+            out->length = 8;
+            return true;
+        case SQLITE_FLOAT: {
+            double number = sqlite3_value_double(value);
+            uint64_t bits;
+            memcpy(&bits, &number, 8);
+            writeLittleEndian64(out->number, bits);
+            out->data = out->number;
+            out->length = 8;
+            return true;
+        }
+        case SQLITE_TEXT:
+            out->data = sqlite3_value_text(value);
+            out->length = (size_t) sqlite3_value_bytes(value);
+            return true;
+        case SQLITE_BLOB:
+            out->data = static_cast<const uint8_t*>(sqlite3_value_blob(value));
+            out->length = (size_t) sqlite3_value_bytes(value);
+            return true;
+        default:
+            return false;
+    }
+}
+
+typedef XXH_errorcode (*XXH3Update)(XXH3_state_t* state, const void* input, size_t length);
+
+// Feeds the typed and length-prefixed encoding of all values to the hash state.
+static void updateRow(XXH3_state_t* state, XXH3Update update, int argc, sqlite3_value** argv) {
+    for (int i = 0; i < argc; i++) {
+        uint8_t header[5];
+        header[0] = (uint8_t) sqlite3_value_type(argv[i]);
+
+        ValueBytes bytes;
+        if (!getValueBytes(argv[i], &bytes)) {
+            update(state, header, 1);
+            continue;
+        }
+        if (header[0] == SQLITE_TEXT || header[0] == SQLITE_BLOB) {
+            const uint32_t length = (uint32_t) bytes.length;
+            for (int b = 0; b < 4; b++) {
+                header[1 + b] = (uint8_t) (length >> (b * 8));
+            }
+            update(state, header, 5);
+        } else {
+            update(state, header, 1);
+        }
+        if (bytes.length > 0) {
+            update(state, bytes.data, bytes.length);
+        }
+    }
+}
+
+uint64_t hashBytes(const void* data, size_t length) {
+    return XXH3_64bits(data, length);
+}
+
+bool hashValue(sqlite3_value* value, uint64_t* hash) {
+    ValueBytes bytes;
+    if (!getValueBytes(value, &bytes)) return false;
+    *hash = XXH3_64bits(bytes.data, bytes.length);
+    return true;
+}
+
+static void xxh3Function(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    XXH64_hash_t hash;
+    if (argc == 1) {
+        if (!hashValue(argv[0], &hash)) {
+            sqlite3_result_null(context);
+            return;
+        }
+    } else if (argc > 1) {
+        XXH3_state_t state;
+        XXH3_INITSTATE(&state);
+        XXH3_64bits_reset(&state);
+        updateRow(&state, XXH3_64bits_update, argc, argv);
+        hash = XXH3_64bits_digest(&state);
+    } else {
+        sqlite3_result_error(context, "xxh3() requires at least one argument", -1);
+        return;
+    }
+    sqlite3_result_int64(context, (sqlite3_int64) hash);
+}
+
+static void xxh3_128Function(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    XXH128_hash_t hash;
+    if (argc == 1) {
+        ValueBytes bytes;
+        if (!getValueBytes(argv[0], &bytes)) {
+            sqlite3_result_null(context);
+            return;
+        }
+        hash = XXH3_128bits(bytes.data, bytes.length);
+    } else if (argc > 1) {
+        XXH3_state_t state;
+        XXH3_INITSTATE(&state);
+        XXH3_128bits_reset(&state);
+        updateRow(&state, XXH3_128bits_update, argc, argv);
+        hash = XXH3_128bits_digest(&state);
+    } else {
+        sqlite3_result_error(context, "xxh3_128() requires at least one argument", -1);
+        return;
+    }
+    XXH128_canonical_t canonical;
+    XXH128_canonicalFromHash(&canonical, hash);
+    sqlite3_result_blob(context, canonical.digest, sizeof(canonical.digest), SQLITE_TRANSIENT);
+}
+
+static void crc32cFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    ValueBytes bytes;
+    if (!getValueBytes(argv[0], &bytes)) {
+        sqlite3_result_null(context);
+        return;
+    }
+    uint32_t previousCrc = argc > 1 ? (uint32_t) sqlite3_value_int64(argv[1]) : 0;
+    sqlite3_result_int64(context, crc32c(previousCrc, bytes.data, bytes.length));
+}
+
+int registerHashFunctions(sqlite3* db) {
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    int err = sqlite3_create_function_v2(db, "xxh3", -1, flags, NULL, xxh3Function, NULL, NULL, NULL);
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_function_v2(db, "xxh3_128", -1, flags, NULL, xxh3_128Function, NULL, NULL, NULL);
+    }
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_function_v2(db, "crc32c", 1, flags, NULL, crc32cFunction, NULL, NULL, NULL);
+    }
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_function_v2(db, "crc32c", 2, flags, NULL, crc32cFunction, NULL, NULL, NULL);
+    }
+    return err;
+}
+
+} // namespace android
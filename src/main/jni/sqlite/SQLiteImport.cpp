@@ -0,0 +1,609 @@
+// Import of CSV and NDJSON files, see SQLiteFileFormats.h for the formats.
+//
+// The file is mapped into memory and parsed in place. Values without escapes are bound directly
+// from the mapping, escaped values are unescaped into a scratch buffer and copied by SQLite.
+
+#define LOG_TAG "SQLiteImport"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SQLiteFileFormats.h"
+
+namespace android {
+
+struct Importer {
+    sqlite3* db;
+    sqlite3_stmt* insert;
+    const char* const* columns;
+    int columnCount;
+    /** Parameter of each column, 0 for skipped columns. */
+    int* parameters;
+    int maxErrors;
+    ImportResult* result;
+
+    /** Line of the current position, and of the start of the current record. */
+    int64_t line;
+    int64_t recordLine;
+    /** Parse error of the current record, static string. */
+    const char* parseError;
+
+    char* scratch;
+    size_t scratchCapacity;
+};
+
+static int recordError(Importer* importer, const char* message) {
+    ImportResult* result = importer->result;
+    result->failedRecords++;
+    if (result->errorCount >= importer->maxErrors) return SQLITE_OK;
+    if (result->errorCount % 16 == 0) {
+        ImportError* errors = static_cast<ImportError*>(sqlite3_realloc64(result->errors, sizeof(ImportError) * (result->errorCount + 16)));
+        if (errors == NULL) return SQLITE_NOMEM;
+        result->errors = errors;
+    }
+    char* copy = sqlite3_mprintf("%s", message);
+    if (copy == NULL) return SQLITE_NOMEM;
+    result->errors[result->errorCount].line = importer->recordLine;
+    result->errors[result->errorCount].message = copy;
+    result->errorCount++;
+    return SQLITE_OK;
+}
+
+/** Make the scratch buffer at least length bytes long. */
+static char* scratch(Importer* importer, size_t length) {
+    if (length <= importer->scratchCapacity) return importer->scratch;
+    size_t capacity = importer->scratchCapacity < 256 ? 256 : importer->scratchCapacity * 2;
+    while (capacity < length) capacity *= 2;
+    char* buffer = static_cast<char*>(sqlite3_realloc64(importer->scratch, capacity));
+    if (buffer == NULL) return NULL;
+    importer->scratch = buffer;
+    importer->scratchCapacity = capacity;
+    return buffer;
+}
+
+/** Insert the bound record, or record why it can't be inserted. Returns SQLITE_OK unless the import must stop. */
+static int insertRecord(Importer* importer) {
+    importer->result->records++;
+    if (importer->parseError != NULL) {
+        sqlite3_clear_bindings(importer->insert);
+        return recordError(importer, importer->parseError);
+    }
+    const int err = sqlite3_step(importer->insert);
+    sqlite3_reset(importer->insert);
+    sqlite3_clear_bindings(importer->insert);
+    if (err == SQLITE_DONE) {
+        importer->result->insertedRows++;
+        return SQLITE_OK;
+    }
+    // Problems of the record, not of the database
+    switch (err & 0xFF) {
+        case SQLITE_CONSTRAINT:
+        case SQLITE_MISMATCH:
+        case SQLITE_TOOBIG:
+            return recordError(importer, sqlite3_errmsg(importer->db));
+        default:
+            return err;
+    }
+}
+
+// CSV
+
+/**
+ * Find the first delimiter or newline, 8 bytes at a time.
+ * A byte equal to the pattern is zero after XOR, and (x - 0x01..) & ~x & 0x80.. sets the high bit of zero bytes.
+ * Borrows can set it also above a zero byte, but never below, so the lowest set bit is always a match.
+ */
+static inline const char* findDelimiterOrNewline(const char* p, const char* end, char delimiter) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t delimiters = ones * (uint8_t) delimiter;
+    const uint64_t newlines = ones * (uint8_t) '\n';
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        const uint64_t x = word ^ delimiters;
+        const uint64_t y = word ^ newlines;
+        const uint64_t found = (((x - ones) & ~x) | ((y - ones) & ~y)) & highs;
+        if (found != 0) return p + (__builtin_ctzll(found) >> 3);// Little-endian, first byte is the lowest
+        p += 8;
+    }
+    while (p < end && *p != delimiter && *p != '\n') p++;
+    return p;
+}
+
+static void bindCsvField(Importer* importer, int field, const char* value, size_t length, bool quoted, bool escaped) {
+    if (field >= importer->columnCount || importer->parameters[field] == 0) return;
+    const int parameter = importer->parameters[field];
+    if (length == 0 && !quoted) {
+        sqlite3_bind_null(importer->insert, parameter);
+        return;
+    }
+    if (!escaped) {
+        sqlite3_bind_text64(importer->insert, parameter, value, length, SQLITE_STATIC, SQLITE_UTF8);
+        return;
+    }
+    char* unescaped = scratch(importer, length);
+    if (unescaped == NULL) {
+        importer->parseError = "Out of memory";
+        return;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
+        unescaped[out++] = value[i];
+        if (value[i] == '"') i++;// Doubled quote
+    }
+    sqlite3_bind_text64(importer->insert, parameter, unescaped, out, SQLITE_TRANSIENT, SQLITE_UTF8);
+}
+
+/** Parse the CSV record at p and bind its fields, unless skip. Returns the start of the next record. */
+static const char* parseCsvRecord(Importer* importer, const char* p, const char* end, bool skip) {
+    int field = 0;
+    while (true) {
+        const char* value;
+        size_t length;
+        bool quoted = false, escaped = false;
+        if (p < end && *p == '"') {
+            quoted = true;
+            value = ++p;
+            while (true) {
+                const char* quote = static_cast<const char*>(memchr(p, '"', end - p));
+                for (const char* c = p; c < (quote == NULL ? end : quote); c++) {
+                    if (*c == '\n') importer->line++;
+                }
+                if (quote == NULL) {
+                    if (importer->parseError == NULL) importer->parseError = "Unterminated quoted field";
+                    return end;
+                }
+                if (quote + 1 < end && quote[1] == '"') {
+                    escaped = true;
+                    p = quote + 2;
+                    continue;
+                }
+                length = quote - value;
+                p = quote + 1;
+                break;
+            }
+            if (p < end && *p == '\r' && p + 1 < end && p[1] == '\n') p++;
+            if (p < end && *p != ',' && *p != '\n') {
+                if (importer->parseError == NULL) importer->parseError = "Unexpected character after quoted field";
+                p = findDelimiterOrNewline(p, end, ',');
+            }
+        } else {
+            value = p;
+            p = findDelimiterOrNewline(p, end, ',');
+            length = p - value;
+            if (length > 0 && (p == end || *p == '\n') && value[length - 1] == '\r') length--;
+        }
+
+        if (!skip) bindCsvField(importer, field, value, length, quoted, escaped);
+        field++;
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+        if (p < end) {
+            p++;// Newline
+            importer->line++;
+        }
+        break;
+    }
+    if (field != importer->columnCount && importer->parseError == NULL) {
+        importer->parseError = field < importer->columnCount ? "Too few fields" : "Too many fields";
+    }
+    return p;
+}
+
+/** Import at most maxRecords records from position, and advance it past them. */
+static int importCsv(Importer* importer, const char** position, const char* end, bool* header, int maxRecords) {
+    const char* p = *position;
+    const int64_t last = importer->result->records + maxRecords;
+    int err = SQLITE_OK;
+    while (err == SQLITE_OK && p < end && importer->result->records < last) {
+        // Skip blank lines
+        if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+            p += *p == '\r' ? 2 : 1;
+            importer->line++;
+            continue;
+        }
+        importer->recordLine = importer->line;
+        importer->parseError = NULL;
+        p = parseCsvRecord(importer, p, end, *header);
+        if (*header) {
+            *header = false;
+            continue;
+        }
+        err = insertRecord(importer);
+    }
+    *position = p;
+    return err;
+}
+
+// NDJSON
+
+static inline const char* skipWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool parseHex4(const char* p, const char* end, uint32_t* result) {
+    if (end - p < 4) return false;
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        const int digit = hexDigit(p[i]);
+        if (digit < 0) return false;
+        value = value << 4 | (uint32_t) digit;
+    }
+    *result = value;
+    return true;
+}
+
+/**
+ * Parse the JSON string at p, after the opening quote. Sets the value, which is unescaped into the scratch buffer
+ * if it has escapes, and returns the position after the closing quote, or NULL on error.
+ */
+static const char* parseJsonString(Importer* importer, const char* p, const char* end,
+                                   const char** value, size_t* length, bool* escaped) {
+    const char* start = p;
+    while (p < end && *p != '"' && *p != '\\') p++;
+    if (p < end && *p == '"') {
+        *value = start;
+        *length = p - start;
+        *escaped = false;
+        return p + 1;
+    }
+
+    // Escaped strings are never longer than in JSON
+    char* out = scratch(importer, end - start);
+    if (out == NULL) return NULL;
+    size_t o = p - start;
+    memcpy(out, start, o);
+    while (p < end && *p != '"') {
+        if (*p != '\\') {
+            out[o++] = *p++;
+            continue;
+        }
+        if (++p >= end) return NULL;
+        switch (*p++) {
+            case '"': out[o++] = '"'; break;
+            case '\\': out[o++] = '\\'; break;
+            case '/': out[o++] = '/'; break;
+            case 'b': out[o++] = '\b'; break;
+            case 'f': out[o++] = '\f'; break;
+            case 'n': out[o++] = '\n'; break;
+            case 'r': out[o++] = '\r'; break;
+            case 't': out[o++] = '\t'; break;
+            case 'u': {
+                uint32_t c;
+                if (!parseHex4(p, end, &c)) return NULL;
+                p += 4;
+                uint32_t low;
+                if (c >= 0xD800 && c < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                        && parseHex4(p + 2, end, &low) && low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                } else if (c >= 0xD800 && c < 0xE000) {
+                    c = 0xFFFD;// Unpaired surrogate
+                }
+                // At most 4 bytes from at least 6 escaped
+                if (c < 0x80) {
+                    out[o++] = (char) c;
+                } else if (c < 0x800) {
+                    out[o++] = (char) (0xC0 | c >> 6);
+                    out[o++] = (char) (0x80 | (c & 0x3F));
+                } else if (c < 0x10000) {
+                    out[o++] = (char) (0xE0 | c >> 12);
+                    out[o++] = (char) (0x80 | ((c >> 6) & 0x3F));
+                    out[o++] = (char) (0x80 | (c & 0x3F));
+                } else {
+                    out[o++] = (char) (0xF0 | c >> 18);
+                    out[o++] = (char) (0x80 | ((c >> 12) & 0x3F));
+                    out[o++] = (char) (0x80 | ((c >> 6) & 0x3F));
+                    out[o++] = (char) (0x80 | (c & 0x3F));
+                }
+                break;
+            }
+            default:
+                return NULL;
+        }
+    }
+    if (p >= end) return NULL;
+    *value = out;
+    *length = o;
+    *escaped = true;
+    return p + 1;
+}
+
+/** Skip nested object or array at p. Returns the position after it, or NULL if it does not end on this line. */
+static const char* skipJsonNested(const char* p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        const char c = *p++;
+        if (c == '"') {
+            while (p < end && *p != '"') {
+                if (*p == '\\') p++;
+                p++;
+            }
+            if (p >= end) return NULL;
+            p++;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) return p;
+        }
+    }
+    return NULL;
+}
+
+/** Parameter of the column for the key, 0 if there is none. */
+static int jsonKeyParameter(Importer* importer, const char* key, size_t length) {
+    for (int i = 0; i < importer->columnCount; i++) {
+        const char* column = importer->columns[i];
+        if (column != NULL && strncmp(column, key, length) == 0 && column[length] == 0) {
+            return importer->parameters[i];
+        }
+    }
+    return 0;
+}
+
+static bool matchLiteral(const char* p, const char* end, const char* literal, size_t length) {
+    return (size_t) (end - p) >= length && memcmp(p, literal, length) == 0;
+}
+
+/** Parse and bind the JSON value at p. Returns the position after it, or NULL on error. */
+static const char* parseJsonValue(Importer* importer, const char* p, const char* end, int parameter) {
+    sqlite3_stmt* insert = importer->insert;
+    if (*p == '"') {
+        const char* value;
+        size_t length;
+        bool escaped;
+        p = parseJsonString(importer, p + 1, end, &value, &length, &escaped);
+        if (p != NULL && parameter != 0) {
+            sqlite3_bind_text64(insert, parameter, value, length, escaped ? SQLITE_TRANSIENT : SQLITE_STATIC, SQLITE_UTF8);
+        }
+        return p;
+    }
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        const char* start = p;
+        bool integer = true;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+            if (*p == '.' || *p == 'e' || *p == 'E') integer = false;
+            p++;
+        }
+        char number[64];
+        const size_t length = p - start;
+        if (length >= sizeof(number)) return NULL;
+        memcpy(number, start, length);
+        number[length] = 0;
+        char* numberEnd;
+        if (integer) {
+            errno = 0;
+            const long long value = strtoll(number, &numberEnd, 10);
+            if (errno == 0) {
+                if (numberEnd != number + length) return NULL;
+                if (parameter != 0) sqlite3_bind_int64(insert, parameter, value);
+                return p;
+            }
+            // Too large for INTEGER, stored as REAL like SQLite does with such literals
+        }
+        const double value = strtod(number, &numberEnd);
+        if (numberEnd != number + length) return NULL;
+        if (parameter != 0) sqlite3_bind_double(insert, parameter, value);
+        return p;
+    }
+    if (matchLiteral(p, end, "true", 4)) {
+        if (parameter != 0) sqlite3_bind_int(insert, parameter, 1);
+        return p + 4;
+    }
+    if (matchLiteral(p, end, "false", 5)) {
+        if (parameter != 0) sqlite3_bind_int(insert, parameter, 0);
+        return p + 5;
+    }
+    if (matchLiteral(p, end, "null", 4)) {
+        if (parameter != 0) sqlite3_bind_null(insert, parameter);
+        return p + 4;
+    }
+    if (*p == '{' || *p == '[') {
+        const char* start = p;
+        p = skipJsonNested(p, end);
+        if (p != NULL && parameter != 0) {
+            sqlite3_bind_text64(insert, parameter, start, p - start, SQLITE_STATIC, SQLITE_UTF8);
+        }
+        return p;
+    }
+    return NULL;
+}
+
+/** Parse the object on the line and bind its values. Returns a static error message, or NULL. */
+static const char* parseJsonLine(Importer* importer, const char* p, const char* end) {
+    if (*p != '{') return "Expected JSON object";
+    p = skipWhitespace(p + 1, end);
+    if (p < end && *p == '}') {
+        p++;
+    } else {
+        while (true) {
+            if (p >= end || *p != '"') return "Expected key";
+            const char* key;
+            size_t keyLength;
+            bool escaped;
+            p = parseJsonString(importer, p + 1, end, &key, &keyLength, &escaped);
+            if (p == NULL) return "Invalid key";
+            // Before the value, which may reuse the scratch buffer
+            const int parameter = jsonKeyParameter(importer, key, keyLength);
+            p = skipWhitespace(p, end);
+            if (p >= end || *p != ':') return "Expected ':'";
+            p = skipWhitespace(p + 1, end);
+            if (p >= end || (p = parseJsonValue(importer, p, end, parameter)) == NULL) return "Invalid value";
+            p = skipWhitespace(p, end);
+            if (p < end && *p == ',') {
+                p = skipWhitespace(p + 1, end);
+                continue;
+            }
+            if (p < end && *p == '}') {
+                p++;
+                break;
+            }
+            return "Expected ',' or '}'";
+        }
+    }
+    if (skipWhitespace(p, end) != end) return "Unexpected characters after JSON object";
+    return NULL;
+}
+
+/** Import at most maxRecords records from position, and advance it past them. */
+static int importNdjson(Importer* importer, const char** position, const char* end, int maxRecords) {
+    const char* p = *position;
+    const int64_t last = importer->result->records + maxRecords;
+    int err = SQLITE_OK;
+    while (err == SQLITE_OK && p < end && importer->result->records < last) {
+        const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* lineEnd = newline == NULL ? end : newline;
+        importer->recordLine = importer->line++;
+        const char* start = skipWhitespace(p, lineEnd);
+        p = newline == NULL ? end : newline + 1;
+        if (start == lineEnd) continue;// Blank line
+
+        importer->parseError = parseJsonLine(importer, start, lineEnd);
+        err = insertRecord(importer);
+    }
+    *position = p;
+    return err;
+}
+
+static int prepareInsert(Importer* importer, const char* table) {
+    char* sql = sqlite3_mprintf("INSERT INTO main.\"%w\" (", table);
+    int parameter = 0;
+    for (int i = 0; i < importer->columnCount; i++) {
+        if (importer->columns[i] == NULL) continue;
+        importer->parameters[i] = ++parameter;
+        sql = sql == NULL ? NULL : sqlite3_mprintf("%z%s\"%w\"", sql, parameter > 1 ? ", " : "", importer->columns[i]);
+    }
+    if (parameter == 0) {
+        sqlite3_free(sql);
+        return SQLITE_MISUSE;
+    }
+    sql = sql == NULL ? NULL : sqlite3_mprintf("%z) VALUES (?", sql);
+    for (int i = 1; i < parameter; i++) {
+        sql = sql == NULL ? NULL : sqlite3_mprintf("%z, ?", sql);
+    }
+    sql = sql == NULL ? NULL : sqlite3_mprintf("%z)", sql);
+    if (sql == NULL) return SQLITE_NOMEM;
+    const int err = sqlite3_prepare_v3(importer->db, sql, -1, SQLITE_PREPARE_PERSISTENT, &importer->insert, NULL);
+    sqlite3_free(sql);
+    return err;
+}
+
+/** Import all records, committing after every batchRows records when the transaction is ours. */
+static int importRecords(Importer* importer, int format, const char* data, size_t length, int batchRows, bool ownTransaction) {
+    const char* p = data;
+    const char* end = data + length;
+    if (length >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;// UTF-8 BOM
+
+    bool header = format == FILE_FORMAT_CSV_HEADER;
+    int err = ownTransaction ? sqlite3_exec(importer->db, "BEGIN IMMEDIATE", NULL, NULL, NULL) : SQLITE_OK;
+    while (err == SQLITE_OK && p < end) {
+        err = format == FILE_FORMAT_NDJSON
+                ? importNdjson(importer, &p, end, batchRows)
+                : importCsv(importer, &p, end, &header, batchRows);
+        if (err == SQLITE_OK && ownTransaction && p < end) {
+            err = sqlite3_exec(importer->db, "COMMIT", NULL, NULL, NULL);
+            if (err == SQLITE_OK) err = sqlite3_exec(importer->db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+        }
+    }
+    if (err == SQLITE_OK && ownTransaction) err = sqlite3_exec(importer->db, "COMMIT", NULL, NULL, NULL);
+    return err;
+}
+
+int importFile(sqlite3* db, const char* path, int format, const char* table,
+               const char* const* columns, int columnCount, int batchRows, int maxErrors,
+               ImportResult* result, char** errorMessage) {
+    memset(result, 0, sizeof(ImportResult));
+    *errorMessage = NULL;
+    if (format != FILE_FORMAT_CSV && format != FILE_FORMAT_CSV_HEADER && format != FILE_FORMAT_NDJSON) {
+        *errorMessage = sqlite3_mprintf("Unknown format %d", format);
+        return SQLITE_MISUSE;
+    }
+
+    Importer importer;
+    memset(&importer, 0, sizeof(importer));
+    importer.db = db;
+    importer.columns = columns;
+    importer.columnCount = columnCount;
+    importer.maxErrors = maxErrors;
+    importer.result = result;
+    importer.line = 1;
+    importer.parameters = static_cast<int*>(sqlite3_malloc64(sizeof(int) * (columnCount + 1)));
+    if (importer.parameters == NULL) return SQLITE_NOMEM;
+    memset(importer.parameters, 0, sizeof(int) * (columnCount + 1));
+
+    int err = prepareInsert(&importer, table);
+    if (err != SQLITE_OK) {
+        *errorMessage = sqlite3_mprintf("%s", err == SQLITE_MISUSE ? "No columns to import" : sqlite3_errmsg(db));
+        sqlite3_free(importer.parameters);
+        return err;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fd == -1 || fstat(fd, &status) != 0) {
+        *errorMessage = sqlite3_mprintf("Could not open %s: %s", path, strerror(errno));
+        if (fd != -1) close(fd);
+        sqlite3_finalize(importer.insert);
+        sqlite3_free(importer.parameters);
+        return SQLITE_CANTOPEN;
+    }
+    const size_t length = (size_t) status.st_size;
+    void* data = NULL;
+    if (length > 0) {
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            *errorMessage = sqlite3_mprintf("Could not map %s: %s", path, strerror(errno));
+            close(fd);
+            sqlite3_finalize(importer.insert);
+            sqlite3_free(importer.parameters);
+            return SQLITE_IOERR_READ;
+        }
+        madvise(data, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    const bool ownTransaction = sqlite3_get_autocommit(db) != 0;
+    err = importRecords(&importer, format, static_cast<const char*>(data), length, batchRows > 0 ? batchRows : 1, ownTransaction);
+    if (err != SQLITE_OK) {
+        *errorMessage = err == SQLITE_NOMEM
+                ? sqlite3_mprintf("Out of memory")
+                : sqlite3_mprintf("Import failed at line %lld: %s", (long long) importer.recordLine, sqlite3_errmsg(db));
+        // Rows of the current batch, committed batches stay
+        if (ownTransaction && sqlite3_get_autocommit(db) == 0) {
+            sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        }
+    }
+
+    if (data != NULL) munmap(data, length);
+    sqlite3_finalize(importer.insert);
+    sqlite3_free(importer.parameters);
+    sqlite3_free(importer.scratch);
+    return err;
+}
+
+void freeImportResult(ImportResult* result) {
+    for (int i = 0; i < result->errorCount; i++) {
+        sqlite3_free(result->errors[i].message);
+    }
+    sqlite3_free(result->errors);
+    result->errors = NULL;
+    result->errorCount = 0;
+}
+
+}
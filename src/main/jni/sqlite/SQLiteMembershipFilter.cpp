@@ -0,0 +1,254 @@
+// Bloom filters of the values of a column, for answering "is this value in the table?"
+// for many values without a B-tree probe for each, registered from Java through SQLiteMembershipFilter.
+//
+// The filter is built by scanning the column and kept up to date with the writes of its connection
+// by temporary triggers, which call a function of the filter with each inserted or updated value.
+// (Update hook would be cheaper, but it reports only rowids, not values of other columns.)
+// Writes of other connections are detected through PRAGMA data_version, which rebuilds the filter.
+// Deleted values stay in the filter, which only adds false positives.
+//
+// Values are hashed like in the xxh3(X) SQL function, so a value is found only when it is queried
+// with the same type as it is stored with (INTEGER or TEXT).
+
+#define LOG_TAG "SQLiteMembershipFilter"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+/** Filter is sized for this many times the rows it was built from, then it is rebuilt. */
+static const int64_t GROWTH_FACTOR = 2;
+static const int64_t MIN_CAPACITY = 1024;
+static const int MAX_HASH_COUNT = 16;
+
+struct MembershipFilter {
+    sqlite3* db;
+    /** Name of the add function, also the prefix of the trigger names. */
+    char* name;
+    char* table;
+    char* column;
+    double falsePositiveRate;
+
+    uint64_t* bits;
+    uint64_t bitCount;
+    int hashCount;
+    /** Values the filter was sized for, and values added to it. */
+    int64_t capacity;
+    int64_t added;
+    int64_t dataVersion;
+    bool stale;
+};
+
+static void membershipFilterDestroy(void* data) {
+    MembershipFilter* filter = static_cast<MembershipFilter*>(data);
+    sqlite3_free(filter->name);
+    sqlite3_free(filter->table);
+    sqlite3_free(filter->column);
+    sqlite3_free(filter->bits);
+    sqlite3_free(filter);
+}
+
+static inline void filterAdd(MembershipFilter* filter, uint64_t hash) {
+    // Double hashing, the second hash must be odd to visit different bits
+    const uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for (int i = 0; i < filter->hashCount; i++) {
+        const uint64_t bit = hash % filter->bitCount;
+        filter->bits[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+        hash += step;
+    }
+    if (++filter->added > filter->capacity) filter->stale = true;
+}
+
+static inline bool filterMayContain(const MembershipFilter* filter, uint64_t hash) {
+    const uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for (int i = 0; i < filter->hashCount; i++) {
+        const uint64_t bit = hash % filter->bitCount;
+        if ((filter->bits[bit >> 6] & ((uint64_t) 1 << (bit & 63))) == 0) return false;
+        hash += step;
+    }
+    return true;
+}
+
+/** Called by the triggers with the new value. */
+static void membershipFilterAddFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    MembershipFilter* filter = static_cast<MembershipFilter*>(sqlite3_user_data(context));
+    uint64_t hash;
+    if (filter->bits != NULL && hashValue(argv[0], &hash)) {
+        filterAdd(filter, hash);
+    }
+}
+
+static int queryInt64(sqlite3* db, const char* sql, int64_t* result) {
+    sqlite3_stmt* statement;
+    int err = sqlite3_prepare_v2(db, sql, -1, &statement, NULL);
+    if (err != SQLITE_OK) return err;
+    err = sqlite3_step(statement);
+    if (err == SQLITE_ROW) {
+        *result = sqlite3_column_int64(statement, 0);
+        err = SQLITE_OK;
+    }
+    sqlite3_finalize(statement);
+    return err;
+}
+
+/** Size the filter for the current rows and add all values of the column. */
+static int rebuildMembershipFilter(MembershipFilter* filter) {
+    // Version first, so that a concurrent change during the scan causes another rebuild, not a missed value
+    int err = queryInt64(filter->db, "PRAGMA data_version", &filter->dataVersion);
+    if (err != SQLITE_OK) return err;
+
+    int64_t rows = 0;
+    char* sql = sqlite3_mprintf("SELECT count(*) FROM main.\"%w\"", filter->table);
+    if (sql == NULL) return SQLITE_NOMEM;
+    err = queryInt64(filter->db, sql, &rows);
+    sqlite3_free(sql);
+    if (err != SQLITE_OK) return err;
+
+    const int64_t capacity = rows * GROWTH_FACTOR > MIN_CAPACITY ? rows * GROWTH_FACTOR : MIN_CAPACITY;
+    // Optimal size and number of hashes for the false positive rate
+    const double bitsPerValue = -log(filter->falsePositiveRate) / (M_LN2 * M_LN2);
+    const uint64_t words = ((uint64_t) ceil(capacity * bitsPerValue) + 63) / 64;
+    int hashCount = (int) lround(bitsPerValue * M_LN2);
+    if (hashCount < 1) hashCount = 1;
+    if (hashCount > MAX_HASH_COUNT) hashCount = MAX_HASH_COUNT;
+
+    uint64_t* bits = static_cast<uint64_t*>(sqlite3_malloc64(words * sizeof(uint64_t)));
+    if (bits == NULL) return SQLITE_NOMEM;
+    memset(bits, 0, words * sizeof(uint64_t));
+    sqlite3_free(filter->bits);
+    filter->bits = bits;
+    filter->bitCount = words * 64;
+    filter->hashCount = hashCount;
+    filter->capacity = capacity;
+    filter->added = 0;
+    filter->stale = true;// Until all values are added, must not be used
+
+    // Qualified column name, because unknown "column" would be a string literal
+    sql = sqlite3_mprintf("SELECT \"%w\".\"%w\" FROM main.\"%w\"", filter->table, filter->column, filter->table);
+    if (sql == NULL) return SQLITE_NOMEM;
+    sqlite3_stmt* statement;
+    err = sqlite3_prepare_v2(filter->db, sql, -1, &statement, NULL);
+    sqlite3_free(sql);
+    if (err != SQLITE_OK) return err;
+    while ((err = sqlite3_step(statement)) == SQLITE_ROW) {
+        uint64_t hash;
+        if (hashValue(sqlite3_column_value(statement, 0), &hash)) {
+            filterAdd(filter, hash);
+        }
+    }
+    sqlite3_finalize(statement);
+    if (err != SQLITE_DONE) return err;
+    filter->stale = filter->added > filter->capacity;
+    return SQLITE_OK;
+}
+
+int createMembershipFilter(sqlite3* db, const char* table, const char* column, double falsePositiveRate,
+                           MembershipFilter** result, char** errorMessage) {
+    *errorMessage = NULL;
+    MembershipFilter* filter = static_cast<MembershipFilter*>(sqlite3_malloc(sizeof(MembershipFilter)));
+    if (filter == NULL) return SQLITE_NOMEM;
+    memset(filter, 0, sizeof(MembershipFilter));
+    filter->db = db;
+    filter->falsePositiveRate = falsePositiveRate;
+    filter->name = sqlite3_mprintf("membership_filter_%p", filter);
+    filter->table = sqlite3_mprintf("%s", table);
+    filter->column = sqlite3_mprintf("%s", column);
+    if (filter->name == NULL || filter->table == NULL || filter->column == NULL) {
+        membershipFilterDestroy(filter);
+        return SQLITE_NOMEM;
+    }
+
+    // Direct only, so that it can't be called from the persistent schema. TEMP triggers are allowed to.
+    // Destructor is called also on failure, and when the connection closes.
+    int err = sqlite3_create_function_v2(db, filter->name, 1, SQLITE_UTF8 | SQLITE_DIRECTONLY, filter,
+                                         membershipFilterAddFunction, NULL, NULL, membershipFilterDestroy);
+    if (err != SQLITE_OK) return err;
+
+    // Built first, which also checks that the table and column exist
+    err = rebuildMembershipFilter(filter);
+    if (err == SQLITE_OK) {
+        char* sql = sqlite3_mprintf(
+                "CREATE TEMP TRIGGER \"%w_insert\" AFTER INSERT ON main.\"%w\" BEGIN SELECT \"%w\"(NEW.\"%w\"); END;"
+                "CREATE TEMP TRIGGER \"%w_update\" AFTER UPDATE OF \"%w\" ON main.\"%w\" BEGIN SELECT \"%w\"(NEW.\"%w\"); END;",
+                filter->name, table, filter->name, column,
+                filter->name, column, table, filter->name, column);
+        err = sql == NULL ? SQLITE_NOMEM : sqlite3_exec(db, sql, NULL, NULL, NULL);
+        sqlite3_free(sql);
+    }
+    if (err != SQLITE_OK) {
+        // Cleanup would replace the error message of the connection
+        *errorMessage = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        dropMembershipFilter(filter);
+        return err;
+    }
+    *result = filter;
+    return SQLITE_OK;
+}
+
+int dropMembershipFilter(MembershipFilter* filter) {
+    sqlite3* db = filter->db;
+    char* sql = sqlite3_mprintf("DROP TRIGGER IF EXISTS temp.\"%w_insert\"; DROP TRIGGER IF EXISTS temp.\"%w_update\";",
+                                filter->name, filter->name);
+    int err = sql == NULL ? SQLITE_NOMEM : sqlite3_exec(db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+    // Destroys the filter once no statement uses the function
+    const int removeErr = sqlite3_create_function_v2(db, filter->name, 1, SQLITE_UTF8 | SQLITE_DIRECTONLY,
+                                                     NULL, NULL, NULL, NULL, NULL);
+    return err != SQLITE_OK ? err : removeErr;
+}
+
+int syncMembershipFilter(MembershipFilter* filter) {
+    int64_t dataVersion;
+    int err = queryInt64(filter->db, "PRAGMA data_version", &dataVersion);
+    if (err != SQLITE_OK) return err;
+    if (dataVersion != filter->dataVersion || filter->stale) {
+        err = rebuildMembershipFilter(filter);
+    }
+    return err;
+}
+
+int prepareMembershipProbe(MembershipFilter* filter, sqlite3_stmt** probe) {
+    char* sql = sqlite3_mprintf("SELECT 1 FROM main.\"%w\" WHERE \"%w\".\"%w\" = ?", filter->table, filter->table, filter->column);
+    if (sql == NULL) return SQLITE_NOMEM;
+    const int err = sqlite3_prepare_v2(filter->db, sql, -1, probe, NULL);
+    sqlite3_free(sql);
+    return err;
+}
+
+/** Probe with the value bound to parameter 1. */
+static int probe(sqlite3_stmt* probe, bool* result) {
+    const int err = sqlite3_step(probe);
+    sqlite3_reset(probe);
+    sqlite3_clear_bindings(probe);
+    *result = err == SQLITE_ROW;
+    return err == SQLITE_ROW || err == SQLITE_DONE ? SQLITE_OK : err;
+}
+
+int membershipFilterContainsInt64(MembershipFilter* filter, sqlite3_stmt* probeStatement, int64_t value, bool* result) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t) ((uint64_t) value >> (i * 8));
+    }
+    if (!filterMayContain(filter, hashBytes(bytes, sizeof(bytes)))) {
+        *result = false;
+        return SQLITE_OK;
+    }
+    sqlite3_bind_int64(probeStatement, 1, value);
+    return probe(probeStatement, result);
+}
+
+int membershipFilterContainsText(MembershipFilter* filter, sqlite3_stmt* probeStatement,
+                                  const uint8_t* utf8, size_t length, bool* result) {
+    if (!filterMayContain(filter, hashBytes(utf8, length))) {
+        *result = false;
+        return SQLITE_OK;
+    }
+    sqlite3_bind_text64(probeStatement, 1, reinterpret_cast<const char*>(utf8), length, SQLITE_STATIC, SQLITE_UTF8);
+    return probe(probeStatement, result);
+}
+
+} // namespace android
@@ -18,13 +18,21 @@
 #define LOG_TAG "SQLiteConnection"
 
 #include <jni.h>
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include "sqlite3ex.h"
 #include "JNIHelp.h"
 #include "ALog-priv.h"
 #include "android_database_SQLiteCommon.h"
+#include "SQLiteExtensions.h"
+#include "SQLiteCompression.h"
+#include "SQLiteDatabaseFiles.h"
+#include "SQLiteFileFormats.h"
+#include "SQLiteRowFormat.h"
 
 namespace android {
 
@@ -59,6 +67,17 @@ static void sqliteLogCallback(void* data, int iErrCode, const char* zMsg) {
     }
 }
 
+// Registers SQL functions and modules of this library on each new connection.
+static int registerExtensions(sqlite3* db, const char** pzErrMsg, const struct sqlite3_api_routines* pThunk) {
+    int err = registerHashFunctions(db);
+    if (err == SQLITE_OK) err = registerCompressionFunctions(db);
+    if (err == SQLITE_OK) err = registerVectorFunctions(db);
+    if (err == SQLITE_OK) err = registerRoaringFunctions(db);
+    if (err == SQLITE_OK) err = registerSketchFunctions(db);
+    if (err == SQLITE_OK) err = registerTimeSeriesFunctions(db);
+    return err;
+}
+
 // Sets the global SQLite configuration.
 // This must be called before any other SQLite functions are called.
 static void sqliteInitialize() {
@@ -81,13 +100,53 @@ static void sqliteInitialize() {
 
     // Initialize SQLite.
     sqlite3_initialize();
+
+    // Must be after initialization, because of SQLITE_OMIT_AUTOINIT.
+    sqlite3_auto_extension((void (*)(void)) registerExtensions);
 }
 
 static jint nativeReleaseMemory(JNIEnv* env, jclass clazz) {
     return sqlite3_release_memory(SOFT_HEAP_LIMIT);
 }
 
-static jlong nativeOpen(JNIEnv* env, jclass clazz, jstring pathStr, jint openFlags) {
+// Global configuration can be changed only while SQLite is not initialized,
+// the caller makes sure that no connection is open.
+static void nativeConfigure(JNIEnv* env, jclass clazz, jint option, jint value) {
+    sqlite3_shutdown();
+    int err = sqlite3_config(option, value);
+    sqliteInitialize();
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, "Could not change configuration");
+    }
+}
+
+static jlong nativeMemoryUsed(JNIEnv* env, jclass clazz) {
+    return sqlite3_memory_used();
+}
+
+static jlong nativeMemoryHighwater(JNIEnv* env, jclass clazz, jboolean reset) {
+    return sqlite3_memory_highwater(reset);
+}
+
+// Connection configuration applied by nativeOpen, must match SQLiteConnection.OPEN_CONFIG_ constants.
+static const int OPEN_CONFIG_FOREIGN_KEYS = 0x1;
+static const int OPEN_CONFIG_WAL = 0x2;
+
+static int readUserVersion(sqlite3* dbConnection, int* userVersion) {
+    sqlite3_stmt* statement;
+    int err = sqlite3_prepare_v2(dbConnection, "PRAGMA user_version", -1, &statement, NULL);
+    if (err != SQLITE_OK) return err;
+    err = sqlite3_step(statement);
+    if (err == SQLITE_ROW) {
+        *userVersion = sqlite3_column_int(statement, 0);
+        err = SQLITE_OK;
+    }
+    sqlite3_finalize(statement);
+    return err;
+}
+
+static jlong nativeOpen(JNIEnv* env, jclass clazz, jstring pathStr, jint openFlags,
+        jint configFlags, jintArray userVersionOut) {
     const char* pathChars = env->GetStringUTFChars(pathStr, NULL);
     sqlite3* dbConnection = NULL;
     int err = sqlite3_open_v2(pathChars, &dbConnection, openFlags | SQLITE_OPEN_EXRESCODE, NULL);
@@ -113,6 +172,37 @@ static jlong nativeOpen(JNIEnv* env, jclass clazz, jstring pathStr, jint openFla
         return 0;
     }
 
+    // Common configuration in the same call, to save a statement and a JNI round trip for each
+    if (configFlags & OPEN_CONFIG_FOREIGN_KEYS) {
+        err = sqlite3_db_config(dbConnection, SQLITE_DBCONFIG_ENABLE_FKEY, 1, NULL);
+        if (err != SQLITE_OK) {
+            throw_sqlite3_exception(env, dbConnection, "Could not enable foreign keys");
+            sqlite3_close(dbConnection);
+            return 0;
+        }
+    }
+
+    if (userVersionOut != NULL) {
+        int userVersion = 0;
+        err = readUserVersion(dbConnection, &userVersion);
+        if (err != SQLITE_OK) {
+            throw_sqlite3_exception(env, dbConnection, "Could not read user_version");
+            sqlite3_close(dbConnection);
+            return 0;
+        }
+        env->SetIntArrayRegion(userVersionOut, 0, 1, &userVersion);
+    }
+
+    if (configFlags & OPEN_CONFIG_WAL) {
+        // In-memory databases stay in their journal mode, like with the PRAGMA
+        err = sqlite3_exec(dbConnection, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+        if (err != SQLITE_OK) {
+            throw_sqlite3_exception(env, dbConnection, "Could not enable write-ahead logging");
+            sqlite3_close(dbConnection);
+            return 0;
+        }
+    }
+
     return reinterpret_cast<jlong>(dbConnection);
 }
 
@@ -157,6 +247,33 @@ static jlong nativePrepareStatement(JNIEnv* env, jclass clazz, jlong connectionP
     return reinterpret_cast<jlong>(statement);
 }
 
+static jlong nativePrepareStatementUtf8(JNIEnv* env, jclass clazz, jlong connectionPtr, jbyteArray sqlArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    // Copied out, because preparing may read the schema, wait in the busy handler or do I/O,
+    // which must not happen in a critical region that blocks the GC
+    const jsize sqlLength = env->GetArrayLength(sqlArray);
+    char stackSql[1024];
+    char* sql = sqlLength <= (jsize) sizeof(stackSql) ? stackSql : static_cast<char*>(sqlite3_malloc(sqlLength));
+    if (sql == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate SQL");
+        return 0;
+    }
+    env->GetByteArrayRegion(sqlArray, 0, sqlLength, reinterpret_cast<jbyte*>(sql));
+    // Already UTF-8, no transcoding. Persistent, because such statements are expected to be kept and reused.
+    sqlite3_stmt* statement;
+    int err = sqlite3_prepare_v3(dbConnection, sql, sqlLength,
+            SQLITE_PREPARE_PERSISTENT, &statement, NULL);
+    if (sql != stackSql) sqlite3_free(sql);
+
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, NULL);
+        return 0;
+    }
+    ALOGV("Prepared statement %p on connection %p", statement, dbConnection);
+    return reinterpret_cast<jlong>(statement);
+}
+
 static void nativeFinalizeStatement(JNIEnv* env, jclass clazz, jlong connectionPtr,
         jlong statementPtr) {
     sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
@@ -234,6 +351,176 @@ static void nativeBindBlob(JNIEnv* env, jclass clazz, jlong connectionPtr,
     }
 }
 
+// Primitive arrays are bound and read as BLOBs of little-endian elements,
+// which is their native layout on all supported architectures.
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Primitive array BLOBs assume a little-endian architecture"
+#endif
+
+static void nativeBindPrimitiveArray(JNIEnv* env, jclass clazz, jlong connectionPtr,
+        jlong statementPtr, jint index, jarray valueArray, jint elementSize) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    sqlite3_uint64 valueLength = (sqlite3_uint64) env->GetArrayLength(valueArray) * elementSize;
+    void* value = env->GetPrimitiveArrayCritical(valueArray, NULL);
+    int err = sqlite3_bind_blob64(statement, index, value, valueLength, SQLITE_TRANSIENT);
+    env->ReleasePrimitiveArrayCritical(valueArray, value, JNI_ABORT);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, NULL);
+    }
+}
+
+// Output must have space for 3 bytes per input char. Unpaired surrogates are replaced by U+FFFD.
+static size_t utf16ToUtf8(const jchar* in, size_t length, uint8_t* out) {
+    uint8_t* start = out;
+    for (size_t i = 0; i < length; i++) {
+        uint32_t c = in[i];
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            if (c <= 0xDBFF && i + 1 < length && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (in[++i] - 0xDC00);
+            } else {
+                c = 0xFFFD;
+            }
+        }
+        if (c < 0x80) {
+            *out++ = (uint8_t) c;
+        } else if (c < 0x800) {
+            *out++ = (uint8_t) (0xC0 | (c >> 6));
+            *out++ = (uint8_t) (0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            *out++ = (uint8_t) (0xE0 | (c >> 12));
+            *out++ = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+            *out++ = (uint8_t) (0x80 | (c & 0x3F));
+        } else {
+            *out++ = (uint8_t) (0xF0 | (c >> 18));
+            *out++ = (uint8_t) (0x80 | ((c >> 12) & 0x3F));
+            *out++ = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+            *out++ = (uint8_t) (0x80 | (c & 0x3F));
+        }
+    }
+    return out - start;
+}
+
+// Output must have space for 1 char per input byte. Invalid sequences are replaced by U+FFFD.
+static size_t utf8ToUtf16(const uint8_t* in, size_t length, jchar* out) {
+    jchar* start = out;
+    size_t i = 0;
+    while (i < length) {
+        const uint8_t b = in[i];
+        uint32_t c;
+        size_t continuation;
+        if (b < 0x80) {
+            *out++ = b;
+            i++;
+            continue;
+        } else if (b >= 0xC2 && b <= 0xDF) {
+            c = b & 0x1F;
+            continuation = 1;
+        } else if (b >= 0xE0 && b <= 0xEF) {
+            c = b & 0x0F;
+            continuation = 2;
+        } else if (b >= 0xF0 && b <= 0xF4) {
+            c = b & 0x07;
+            continuation = 3;
+        } else {
+            *out++ = 0xFFFD;
+            i++;
+            continue;
+        }
+        size_t j = 1;
+        for (; j <= continuation && i + j < length && (in[i + j] & 0xC0) == 0x80; j++) {
+            c = (c << 6) | (in[i + j] & 0x3F);
+        }
+        if (j <= continuation
+                || (continuation == 2 && (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF)))
+                || (continuation == 3 && (c < 0x10000 || c > 0x10FFFF))) {
+            *out++ = 0xFFFD;
+            i++;
+            continue;
+        }
+        if (c >= 0x10000) {
+            *out++ = (jchar) (0xD800 + ((c - 0x10000) >> 10));
+            *out++ = (jchar) (0xDC00 + ((c - 0x10000) & 0x3FF));
+        } else {
+            *out++ = (jchar) c;
+        }
+        i += j;
+    }
+    return out - start;
+}
+
+// Compresses the value into dst, which has compressedValueBound(valueLength) bytes.
+// Does not call any JNI functions other than critical array access, so that it can be called in a critical section.
+static size_t compressWithDictionary(JNIEnv* env, const void* value, size_t valueLength, bool text,
+        jbyteArray dictionaryArray, jsize dictionaryLength, uint8_t* dst) {
+    void* dictionary = dictionaryArray ? env->GetPrimitiveArrayCritical(dictionaryArray, NULL) : NULL;
+    size_t compressedLength = compressValue(value, valueLength, text, dictionary, dictionaryLength, dst);
+    if (dictionary) {
+        env->ReleasePrimitiveArrayCritical(dictionaryArray, dictionary, JNI_ABORT);
+    }
+    return compressedLength;
+}
+
+static void nativeBindBlobCompressed(JNIEnv* env, jclass clazz, jlong connectionPtr,
+        jlong statementPtr, jint index, jbyteArray valueArray, jbyteArray dictionaryArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    jsize valueLength = env->GetArrayLength(valueArray);
+    jsize dictionaryLength = dictionaryArray ? env->GetArrayLength(dictionaryArray) : 0;
+    uint8_t* compressed = static_cast<uint8_t*>(sqlite3_malloc64(compressedValueBound(valueLength)));
+    if (compressed == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate compressed value");
+        return;
+    }
+
+    // Compressing straight from the Java array, without copying it first
+    void* value = env->GetPrimitiveArrayCritical(valueArray, NULL);
+    size_t compressedLength = compressWithDictionary(env, value, valueLength, false,
+            dictionaryArray, dictionaryLength, compressed);
+    env->ReleasePrimitiveArrayCritical(valueArray, value, JNI_ABORT);
+
+    // The compressed buffer is handed over to SQLite
+    int err = sqlite3_bind_blob64(statement, index, compressed, compressedLength, sqlite3_free);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, NULL);
+    }
+}
+
+static void nativeBindStringCompressed(JNIEnv* env, jclass clazz, jlong connectionPtr,
+        jlong statementPtr, jint index, jstring valueString, jbyteArray dictionaryArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    jsize valueLength = env->GetStringLength(valueString);
+    jsize dictionaryLength = dictionaryArray ? env->GetArrayLength(dictionaryArray) : 0;
+    uint8_t* utf8 = static_cast<uint8_t*>(sqlite3_malloc64((sqlite3_uint64) valueLength * 3 + 1));
+    if (utf8 == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate compressed value");
+        return;
+    }
+    const jchar* value = env->GetStringCritical(valueString, NULL);
+    size_t utf8Length = utf16ToUtf8(value, valueLength, utf8);
+    env->ReleaseStringCritical(valueString, value);
+
+    uint8_t* compressed = static_cast<uint8_t*>(sqlite3_malloc64(compressedValueBound(utf8Length)));
+    if (compressed == NULL) {
+        sqlite3_free(utf8);
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate compressed value");
+        return;
+    }
+    size_t compressedLength = compressWithDictionary(env, utf8, utf8Length, true,
+            dictionaryArray, dictionaryLength, compressed);
+    sqlite3_free(utf8);
+
+    // The compressed buffer is handed over to SQLite
+    int err = sqlite3_bind_blob64(statement, index, compressed, compressedLength, sqlite3_free);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, NULL);
+    }
+}
+
 static jstring nativeExecutePragma(JNIEnv* env, jclass clazz, jlong connectionPtr, jstring sqlString) {
     sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
     sqlite3_stmt* statement = prepareStatement(env, dbConnection, sqlString);
@@ -487,6 +774,129 @@ static jbyteArray nativeCursorGetBlob(JNIEnv* env, jclass clazz, jlong connectio
     return result;
 }
 
+// Reads the compressed value in the column, returns false and throws if it is not one.
+static bool readCompressedColumn(JNIEnv* env, sqlite3_stmt* statement, jint index, CompressedValue* value) {
+    const void* blob = sqlite3_column_blob(statement, index);
+    size_t length = sqlite3_column_bytes(statement, index);
+    if (!readCompressedValue(blob, length, value)) {
+        throw_sqlite3_exception(env, "Column does not contain a compressed value");
+        return false;
+    }
+    // The length comes from the value itself, so bound it like decompress() does
+    if (value->length > (uint32_t) sqlite3_limit(sqlite3_db_handle(statement), SQLITE_LIMIT_LENGTH, -1)) {
+        throw_sqlite3_exception_errcode(env, SQLITE_TOOBIG, "Decompressed value is too big");
+        return false;
+    }
+    return true;
+}
+
+// Like compressWithDictionary, but in reverse. Returns NULL or an error message.
+static const char* decompressWithDictionary(JNIEnv* env, const CompressedValue& value,
+        jbyteArray dictionaryArray, jsize dictionaryLength, void* dst) {
+    void* dictionary = dictionaryArray ? env->GetPrimitiveArrayCritical(dictionaryArray, NULL) : NULL;
+    const char* error = decompressValue(value, dictionary, dictionaryLength, dst);
+    if (dictionary) {
+        env->ReleasePrimitiveArrayCritical(dictionaryArray, dictionary, JNI_ABORT);
+    }
+    return error;
+}
+
+static jstring nativeCursorGetStringDecompressed(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr, jint index, jbyteArray dictionaryArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+    if (sqlite3_column_type(statement, index) != SQLITE_BLOB) {
+        // Not compressed
+        return nativeCursorGetString(env, clazz, connectionPtr, statementPtr, index);
+    }
+    sqlite3ex_clear_errcode(dbConnection);
+
+    CompressedValue value;
+    if (!readCompressedColumn(env, statement, index, &value)) return NULL;
+
+    // Strings can't be written into directly, so decompress and transcode through a buffer,
+    // UTF-16 output is before UTF-8 input, so that it never overtakes it
+    uint8_t* buffer = static_cast<uint8_t*>(sqlite3_malloc64((sqlite3_uint64) value.length * 3 + 1));
+    if (buffer == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate decompressed value");
+        return NULL;
+    }
+    jchar* utf16 = reinterpret_cast<jchar*>(buffer);
+    uint8_t* utf8 = buffer + (size_t) value.length * 2;
+    jsize dictionaryLength = dictionaryArray ? env->GetArrayLength(dictionaryArray) : 0;
+    const char* error = decompressWithDictionary(env, value, dictionaryArray, dictionaryLength, utf8);
+    if (error != NULL) {
+        sqlite3_free(buffer);
+        throw_sqlite3_exception(env, error);
+        return NULL;
+    }
+    size_t utf16Length = utf8ToUtf16(utf8, value.length, utf16);
+    jstring result = env->NewString(utf16, utf16Length);
+    sqlite3_free(buffer);
+
+    maybe_throw_after_column_get(env, dbConnection);
+    return result;
+}
+static jbyteArray nativeCursorGetBlobDecompressed(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr, jint index, jbyteArray dictionaryArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+    if (sqlite3_column_type(statement, index) != SQLITE_BLOB) {
+        // Not compressed
+        return nativeCursorGetBlob(env, clazz, connectionPtr, statementPtr, index);
+    }
+    sqlite3ex_clear_errcode(dbConnection);
+
+    CompressedValue value;
+    if (!readCompressedColumn(env, statement, index, &value)) return NULL;
+
+    jbyteArray result = env->NewByteArray(value.length);
+    if (result == NULL) return NULL;// OutOfMemoryError is pending
+
+    // Decompressing straight into the Java array
+    jsize dictionaryLength = dictionaryArray ? env->GetArrayLength(dictionaryArray) : 0;
+    void* dst = env->GetPrimitiveArrayCritical(result, NULL);
+    const char* error = decompressWithDictionary(env, value, dictionaryArray, dictionaryLength, dst);
+    env->ReleasePrimitiveArrayCritical(result, dst, 0);
+    if (error != NULL) {
+        throw_sqlite3_exception(env, error);
+        return NULL;
+    }
+
+    maybe_throw_after_column_get(env, dbConnection);
+    return result;
+}
+
+// Copies as many elements of the BLOB in the column as fit into the array.
+// Returns the number of elements in the BLOB, or -1 if the value is NULL.
+static jint nativeCursorGetPrimitiveArray(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr, jint index,
+        jarray dstArray, jint elementSize) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+    sqlite3ex_clear_errcode(dbConnection);
+
+    int type = sqlite3_column_type(statement, index);
+    if (type == SQLITE_NULL) {
+        maybe_throw_after_column_get(env, dbConnection);
+        return -1;
+    }
+    const void* blob = sqlite3_column_blob(statement, index);
+    size_t length = sqlite3_column_bytes(statement, index);
+    if (length % elementSize != 0) {
+        throw_sqlite3_exception(env, "BLOB length is not a multiple of the element size");
+        return 0;
+    }
+    size_t elements = length / elementSize;
+    size_t dstElements = (size_t) env->GetArrayLength(dstArray);
+    size_t copied = elements < dstElements ? elements : dstElements;
+    if (copied > 0) {
+        void* dst = env->GetPrimitiveArrayCritical(dstArray, NULL);
+        memcpy(dst, blob, copied * elementSize);
+        env->ReleasePrimitiveArrayCritical(dstArray, dst, 0);
+    }
+
+    maybe_throw_after_column_get(env, dbConnection);
+    return (jint) elements;
+}
+
 static void nativeResetStatement(JNIEnv* env, jclass clazz, jlong statementPtr) {
     sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
 
@@ -498,6 +908,427 @@ static void nativeClearBindings(JNIEnv* env, jclass clazz, jlong statementPtr) {
     sqlite3_clear_bindings(statement);// No need to check error, can't fail
 }
 
+// Columns are direct ByteBuffers, which are used in place, or primitive arrays, which are copied.
+// Which one is given by columnDirect, GetDirectBufferAddress must not be called on arrays before Android P.
+// Their sizes are checked by SQLiteColumnarTable.
+static void nativeCreateColumnarTable(JNIEnv* env, jclass clazz, jlong connectionPtr, jstring nameStr,
+        jobjectArray columnNames, jintArray columnTypes, jobjectArray columnData, jbooleanArray columnDirect,
+        jint rowCount, jint sortedColumn) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    const jsize columnCount = env->GetArrayLength(columnNames);
+    ColumnarColumn* columns = static_cast<ColumnarColumn*>(sqlite3_malloc64(sizeof(ColumnarColumn) * columnCount));
+    if (columns == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate columnar table");
+        return;
+    }
+    memset(columns, 0, sizeof(ColumnarColumn) * columnCount);
+    for (jsize i = 0; i < columnCount; i++) {
+        ColumnarColumn& column = columns[i];
+        env->GetIntArrayRegion(columnTypes, i, 1, &column.type);
+        jboolean direct = JNI_FALSE;
+        env->GetBooleanArrayRegion(columnDirect, i, 1, &direct);
+        const size_t length = (size_t) rowCount * columnarTypeSize(column.type);
+
+        jstring columnName = static_cast<jstring>(env->GetObjectArrayElement(columnNames, i));
+        const char* columnNameChars = env->GetStringUTFChars(columnName, NULL);
+        column.name = sqlite3_mprintf("%s", columnNameChars);
+        env->ReleaseStringUTFChars(columnName, columnNameChars);
+        env->DeleteLocalRef(columnName);
+
+        jobject data = env->GetObjectArrayElement(columnData, i);
+        if (direct) {
+            column.data = env->GetDirectBufferAddress(data);
+        } else {
+            // +1 so that empty tables are not a NULL allocation
+            column.owned = sqlite3_malloc64(length + 1);
+            if (column.owned != NULL && length > 0) {
+                void* array = env->GetPrimitiveArrayCritical(static_cast<jarray>(data), NULL);
+                if (array == NULL) {
+                    sqlite3_free(column.owned);
+                    column.owned = NULL;
+                } else {
+                    memcpy(column.owned, array, length);
+                    env->ReleasePrimitiveArrayCritical(static_cast<jarray>(data), array, JNI_ABORT);
+                }
+            }
+            column.data = column.owned;
+        }
+        env->DeleteLocalRef(data);
+
+        if (column.name == NULL || column.data == NULL) {
+            freeColumnarColumns(columns, columnCount);
+            throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate columnar table");
+            return;
+        }
+    }
+
+    const char* nameChars = env->GetStringUTFChars(nameStr, NULL);
+    int err = createColumnarTable(dbConnection, nameChars, columns, columnCount, rowCount, sortedColumn);
+    env->ReleaseStringUTFChars(nameStr, nameChars);
+    if (err == SQLITE_ERROR) {
+        throw_sqlite3_exception_errcode(env, err, "Name of the columnar table is already used by a module");
+    } else if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Could not create columnar table");
+    }
+}
+
+static void nativeDropColumnarTable(JNIEnv* env, jclass clazz, jlong connectionPtr, jstring nameStr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    const char* nameChars = env->GetStringUTFChars(nameStr, NULL);
+    int err = dropColumnarTable(dbConnection, nameChars);
+    env->ReleaseStringUTFChars(nameStr, nameChars);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Could not drop columnar table");
+    }
+}
+
+static jlong nativeCreateMembershipFilter(JNIEnv* env, jclass clazz, jlong connectionPtr,
+        jstring tableStr, jstring columnStr, jdouble falsePositiveRate) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    const char* tableChars = env->GetStringUTFChars(tableStr, NULL);
+    const char* columnChars = env->GetStringUTFChars(columnStr, NULL);
+    MembershipFilter* filter = NULL;
+    char* errorMessage = NULL;
+    int err = createMembershipFilter(dbConnection, tableChars, columnChars, falsePositiveRate, &filter, &errorMessage);
+    env->ReleaseStringUTFChars(tableStr, tableChars);
+    env->ReleaseStringUTFChars(columnStr, columnChars);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, errorMessage != NULL ? errorMessage : "Could not create membership filter");
+        sqlite3_free(errorMessage);
+        return 0;
+    }
+    return reinterpret_cast<jlong>(filter);
+}
+
+static void nativeDropMembershipFilter(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong filterPtr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    MembershipFilter* filter = reinterpret_cast<MembershipFilter*>(filterPtr);
+
+    if (dropMembershipFilter(filter) != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Could not drop membership filter");
+    }
+}
+
+// Values are processed in chunks copied from and to the arrays,
+// because the table is queried for positives, which can take long.
+static const jsize MEMBERSHIP_CHUNK = 1024;
+
+static jint nativeMembershipFilterContainsLongs(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong filterPtr,
+        jlongArray valueArray, jbooleanArray resultArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    MembershipFilter* filter = reinterpret_cast<MembershipFilter*>(filterPtr);
+
+    sqlite3_stmt* probe = NULL;
+    int err = syncMembershipFilter(filter);
+    if (err == SQLITE_OK) err = prepareMembershipProbe(filter, &probe);
+
+    const jsize count = env->GetArrayLength(valueArray);
+    jint found = 0;
+    jlong values[MEMBERSHIP_CHUNK];
+    jboolean results[MEMBERSHIP_CHUNK];
+    for (jsize start = 0; start < count && err == SQLITE_OK; start += MEMBERSHIP_CHUNK) {
+        const jsize length = count - start < MEMBERSHIP_CHUNK ? count - start : MEMBERSHIP_CHUNK;
+        env->GetLongArrayRegion(valueArray, start, length, values);
+        for (jsize i = 0; i < length && err == SQLITE_OK; i++) {
+            bool contains;
+            err = membershipFilterContainsInt64(filter, probe, values[i], &contains);
+            results[i] = contains ? JNI_TRUE : JNI_FALSE;
+            if (contains) found++;
+        }
+        env->SetBooleanArrayRegion(resultArray, start, length, results);
+    }
+
+    if (err != SQLITE_OK) throw_sqlite3_exception(env, dbConnection, "Could not query membership filter");
+    sqlite3_finalize(probe);
+    return found;
+}
+
+static jint nativeMembershipFilterContainsStrings(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong filterPtr,
+        jobjectArray valueArray, jbooleanArray resultArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    MembershipFilter* filter = reinterpret_cast<MembershipFilter*>(filterPtr);
+
+    sqlite3_stmt* probe = NULL;
+    int err = syncMembershipFilter(filter);
+    if (err == SQLITE_OK) err = prepareMembershipProbe(filter, &probe);
+
+    const jsize count = env->GetArrayLength(valueArray);
+    jint found = 0;
+    jboolean results[MEMBERSHIP_CHUNK];
+    jchar* utf16 = NULL;
+    uint8_t* utf8 = NULL;
+    jsize capacity = 0;
+    for (jsize start = 0; start < count && err == SQLITE_OK; start += MEMBERSHIP_CHUNK) {
+        const jsize length = count - start < MEMBERSHIP_CHUNK ? count - start : MEMBERSHIP_CHUNK;
+        for (jsize i = 0; i < length && err == SQLITE_OK; i++) {
+            jstring value = static_cast<jstring>(env->GetObjectArrayElement(valueArray, start + i));
+            bool contains = false;
+            if (value != NULL) {
+                const jsize valueLength = env->GetStringLength(value);
+                if (utf8 == NULL || valueLength > capacity) {
+                    sqlite3_free(utf16);
+                    sqlite3_free(utf8);
+                    capacity = valueLength;
+                    // +1 so that empty strings are not a NULL allocation, which would be bound as NULL
+                    utf16 = static_cast<jchar*>(sqlite3_malloc64((sqlite3_uint64) capacity * sizeof(jchar) + 1));
+                    utf8 = static_cast<uint8_t*>(sqlite3_malloc64((sqlite3_uint64) capacity * 3 + 1));
+                    if (utf16 == NULL || utf8 == NULL) {
+                        capacity = 0;
+                        err = SQLITE_NOMEM;
+                    }
+                }
+                if (err == SQLITE_OK) {
+                    env->GetStringRegion(value, 0, valueLength, utf16);
+                    const size_t utf8Length = utf16ToUtf8(utf16, valueLength, utf8);
+                    err = membershipFilterContainsText(filter, probe, utf8, utf8Length, &contains);
+                }
+                env->DeleteLocalRef(value);
+            }
+            results[i] = contains ? JNI_TRUE : JNI_FALSE;
+            if (contains) found++;
+        }
+        env->SetBooleanArrayRegion(resultArray, start, length, results);
+    }
+    sqlite3_free(utf16);
+    sqlite3_free(utf8);
+
+    if (err == SQLITE_NOMEM) {
+        throw_sqlite3_exception_errcode(env, err, "Failed to allocate membership query");
+    } else if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Could not query membership filter");
+    }
+    sqlite3_finalize(probe);
+    return found;
+}
+
+// Returns { records, inserted rows, failed records, line of each reported error... },
+// with the messages of the reported errors in errorMessageArray, which also limits their count.
+static jlongArray nativeImportFile(JNIEnv* env, jclass clazz, jlong connectionPtr, jstring pathStr, jint format,
+        jstring tableStr, jobjectArray columnArray, jint batchRows, jobjectArray errorMessageArray) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    const jsize columnCount = env->GetArrayLength(columnArray);
+    const char** columns = static_cast<const char**>(sqlite3_malloc64(sizeof(char*) * (columnCount + 1)));
+    if (columns == NULL) {
+        throw_sqlite3_exception_errcode(env, SQLITE_NOMEM, "Failed to allocate import");
+        return NULL;
+    }
+    bool allocated = true;
+    for (jsize i = 0; i < columnCount; i++) {
+        jstring column = static_cast<jstring>(env->GetObjectArrayElement(columnArray, i));
+        columns[i] = NULL;
+        if (column != NULL) {
+            const char* columnChars = env->GetStringUTFChars(column, NULL);
+            columns[i] = sqlite3_mprintf("%s", columnChars);
+            env->ReleaseStringUTFChars(column, columnChars);
+            env->DeleteLocalRef(column);
+            if (columns[i] == NULL) allocated = false;
+        }
+    }
+
+    ImportResult result;
+    memset(&result, 0, sizeof(result));
+    char* errorMessage = NULL;
+    int err = SQLITE_NOMEM;
+    if (allocated) {
+        const char* pathChars = env->GetStringUTFChars(pathStr, NULL);
+        const char* tableChars = env->GetStringUTFChars(tableStr, NULL);
+        err = importFile(dbConnection, pathChars, format, tableChars, columns, columnCount, batchRows,
+                         env->GetArrayLength(errorMessageArray), &result, &errorMessage);
+        env->ReleaseStringUTFChars(pathStr, pathChars);
+        env->ReleaseStringUTFChars(tableStr, tableChars);
+    }
+    for (jsize i = 0; i < columnCount; i++) {
+        sqlite3_free(const_cast<char*>(columns[i]));
+    }
+    sqlite3_free(columns);
+
+    jlongArray resultArray = NULL;
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, errorMessage != NULL ? errorMessage : "Failed to allocate import");
+    } else if ((resultArray = env->NewLongArray(3 + result.errorCount)) != NULL) {
+        const jlong counts[3] = { result.records, result.insertedRows, result.failedRecords };
+        env->SetLongArrayRegion(resultArray, 0, 3, counts);
+        for (int i = 0; i < result.errorCount; i++) {
+            const jlong line = result.errors[i].line;
+            env->SetLongArrayRegion(resultArray, 3 + i, 1, &line);
+            jstring message = env->NewStringUTF(result.errors[i].message);
+            if (message == NULL) break;
+            env->SetObjectArrayElement(errorMessageArray, i, message);
+            env->DeleteLocalRef(message);
+        }
+    }
+    sqlite3_free(errorMessage);
+    freeImportResult(&result);
+    return resultArray;
+}
+
+// Rows are written into sealed shared memory, see SQLiteRowFormat.h
+static jint nativeExecuteForSharedMemoryAndReset(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    int err = SQLITE_OK;
+    int fd = writeRowFormatSharedMemory(statement, &err);
+    if (fd == -1) {
+        if (err == SQLITE_IOERR_WRITE) {
+            char message[128];
+            snprintf(message, sizeof(message), "Could not create shared memory: %s", strerror(errno));
+            throw_sqlite3_exception_errcode(env, err, message);
+        } else if (err == SQLITE_NOMEM) {
+            throw_sqlite3_exception_errcode(env, err, "Failed to allocate rows");
+        } else {
+            throw_sqlite3_exception(env, dbConnection, "Error evaluating");
+        }
+    }
+    sqlite3_reset(statement);
+    return fd;
+}
+
+// Rows are written to the descriptor, which stays owned by the caller, see SQLiteFileFormats.h
+static jlong nativeExportAndReset(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr, jint format, jint fd) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    int64_t rowCount = 0;
+    int err = exportRows(statement, format, fd, &rowCount);
+    if (err == SQLITE_IOERR_WRITE) {
+        char message[128];
+        snprintf(message, sizeof(message), "Could not write export: %s", strerror(errno));
+        throw_sqlite3_exception_errcode(env, err, message);
+    } else if (err == SQLITE_NOMEM) {
+        throw_sqlite3_exception_errcode(env, err, "Failed to allocate export");
+    } else if (err == SQLITE_MISUSE) {
+        throw_sqlite3_exception_errcode(env, err, "Unknown export format");
+    } else if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Error evaluating");
+    }
+    sqlite3_reset(statement);
+    return rowCount;
+}
+
+// Returns the CloneMethod, see SQLiteDatabaseFiles.h
+static jint nativeCloneDatabase(JNIEnv* env, jclass clazz, jlong connectionPtr, jstring destPathStr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    const char* destPath = env->GetStringUTFChars(destPathStr, NULL);
+    int method = 0;
+    int err = cloneDatabase(dbConnection, destPath, &method);
+    if (err == SQLITE_CANTOPEN || err == SQLITE_IOERR_WRITE) {
+        char message[256];
+        snprintf(message, sizeof(message), "Could not write %s: %s", destPath, strerror(errno));
+        throw_sqlite3_exception_errcode(env, err, message);
+    } else if (err == SQLITE_MISUSE) {
+        throw_sqlite3_exception_errcode(env, err, "In-memory database can't be cloned");
+    } else if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, "Could not clone database");
+    }
+    env->ReleaseStringUTFChars(destPathStr, destPath);
+    return method;
+}
+
+static void nativeSetFileGrowth(JNIEnv* env, jclass clazz, jlong connectionPtr, jint chunkSize, jint walSize) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+
+    int err = setFileGrowth(dbConnection, chunkSize, walSize);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, "Could not set file growth");
+    }
+}
+
+static jobject nativeMapSharedMemory(JNIEnv* env, jclass clazz, jint fd) {
+    size_t length = 0;
+    const void* memory = mapRowFormatSharedMemory(fd, &length);
+    if (memory == NULL) {
+        jniThrowException(env, "java/io/IOException", strerror(errno));
+        return NULL;
+    }
+    jobject buffer = env->NewDirectByteBuffer(const_cast<void*>(memory), (jlong) length);
+    if (buffer == NULL) {
+        munmap(const_cast<void*>(memory), length);
+    }
+    return buffer;
+}
+
+static void nativeUnmapSharedMemory(JNIEnv* env, jclass clazz, jobject buffer) {
+    void* memory = env->GetDirectBufferAddress(buffer);
+    if (memory != NULL) {
+        munmap(memory, (size_t) env->GetDirectBufferCapacity(buffer));
+    }
+}
+
+// Only every stride-th row is kept, the number of all rows is stored into rowCountOut, if not NULL.
+static jobject nativeExecuteForRowsAndReset(JNIEnv* env, jclass clazz, jlong connectionPtr, jlong statementPtr,
+        jint stride, jlongArray rowCountOut) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    RowFormatOutput output;
+    int err = writeRowFormat(statement, -1, stride, -1, &output);
+    jobject buffer = NULL;
+    if (err == SQLITE_NOMEM) {
+        throw_sqlite3_exception_errcode(env, err, "Failed to allocate rows");
+    } else if (err != SQLITE_OK) {
+        throw_sqlite3_exception(env, dbConnection, "Error evaluating");
+    } else {
+        buffer = env->NewDirectByteBuffer(output.data, (jlong) output.length);
+        if (buffer == NULL) {
+            sqlite3_free(output.data);
+        } else if (rowCountOut != NULL) {
+            const jlong rowCount = output.steppedRows;
+            env->SetLongArrayRegion(rowCountOut, 0, 1, &rowCount);
+        }
+    }
+    sqlite3_reset(statement);
+    return buffer;
+}
+
+static void nativeFreeRows(JNIEnv* env, jclass clazz, jobject buffer) {
+    sqlite3_free(env->GetDirectBufferAddress(buffer));
+}
+
+static jint nativeDbStatus(JNIEnv* env, jclass clazz, jlong connectionPtr, jint op, jboolean reset) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    int current = 0, highwater = 0;
+    int err = sqlite3_db_status(dbConnection, op, &current, &highwater, reset);
+    if (err != SQLITE_OK) {
+        throw_sqlite3_exception_errcode(env, err, "Unknown status");
+    }
+    return current;
+}
+
+static jboolean nativeIsAutocommit(JNIEnv* env, jclass clazz, jlong connectionPtr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    return sqlite3_get_autocommit(dbConnection) != 0;
+}
+
+static jintArray nativeWalCheckpoint(JNIEnv* env, jclass clazz, jlong connectionPtr, jint mode) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    int walFrames = -1, checkpointedFrames = -1;
+    int err = sqlite3_wal_checkpoint_v2(dbConnection, NULL, mode, &walFrames, &checkpointedFrames);
+    // Busy is a normal result of blocking checkpoint modes, when readers or writers are in the way
+    if (err != SQLITE_OK && err != SQLITE_BUSY) {
+        throw_sqlite3_exception(env, dbConnection, "Checkpoint failed");
+        return NULL;
+    }
+    jintArray result = env->NewIntArray(3);
+    if (result != NULL) {
+        const jint values[3] = { err == SQLITE_BUSY ? 1 : 0, walFrames, checkpointedFrames };
+        env->SetIntArrayRegion(result, 0, 3, values);
+    }
+    return result;
+}
+
+static jstring nativeDbFilename(JNIEnv* env, jclass clazz, jlong connectionPtr) {
+    sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
+    const char* filename = sqlite3_db_filename(dbConnection, "main");
+    if (filename == NULL || filename[0] == 0) return NULL;
+    return env->NewStringUTF(filename);
+}
+
 static void nativeInterrupt(JNIEnv* env, jobject clazz, jlong connectionPtr) {
     sqlite3* dbConnection = reinterpret_cast<sqlite3*>(connectionPtr);
     sqlite3_interrupt(dbConnection);
@@ -506,12 +1337,14 @@ static void nativeInterrupt(JNIEnv* env, jobject clazz, jlong connectionPtr) {
 static const JNINativeMethod sMethods[] =
 {
     /* name, signature, funcPtr */
-    { "nativeOpen", "(Ljava/lang/String;I)J",
+    { "nativeOpen", "(Ljava/lang/String;II[I)J",
             (void*)nativeOpen },
     { "nativeClose", "(J)V",
             (void*)nativeClose },
     { "nativePrepareStatement", "(JLjava/lang/String;)J",
             (void*)nativePrepareStatement },
+    { "nativePrepareStatementUtf8", "(J[B)J",
+            (void*)nativePrepareStatementUtf8 },
     { "nativeFinalizeStatement", "(JJ)V",
             (void*)nativeFinalizeStatement },
     { "nativeBindNull", "(JJI)V",
@@ -524,6 +1357,12 @@ static const JNINativeMethod sMethods[] =
             (void*)nativeBindString },
     { "nativeBindBlob", "(JJI[B)V",
             (void*)nativeBindBlob },
+    { "nativeBindBlobCompressed", "(JJI[B[B)V",
+            (void*)nativeBindBlobCompressed },
+    { "nativeBindStringCompressed", "(JJILjava/lang/String;[B)V",
+            (void*)nativeBindStringCompressed },
+    { "nativeBindPrimitiveArray", "(JJILjava/lang/Object;I)V",
+            (void*)nativeBindPrimitiveArray },
     { "nativeExecutePragma", "(JLjava/lang/String;)Ljava/lang/String;",
             (void*)nativeExecutePragma },
 
@@ -541,13 +1380,61 @@ static const JNINativeMethod sMethods[] =
     { "nativeCursorGetDouble", "(JJI)D", (void*) nativeCursorGetDouble },
     { "nativeCursorGetString", "(JJI)Ljava/lang/String;", (void*) nativeCursorGetString },
     { "nativeCursorGetBlob", "(JJI)[B", (void*) nativeCursorGetBlob },
+    { "nativeCursorGetStringDecompressed", "(JJI[B)Ljava/lang/String;", (void*) nativeCursorGetStringDecompressed },
+    { "nativeCursorGetBlobDecompressed", "(JJI[B)[B", (void*) nativeCursorGetBlobDecompressed },
+    { "nativeCursorGetPrimitiveArray", "(JJILjava/lang/Object;I)I", (void*) nativeCursorGetPrimitiveArray },
     { "nativeResetStatement", "(J)V", (void*) nativeResetStatement },
     { "nativeClearBindings", "(J)V", (void*) nativeClearBindings },
 
+    { "nativeExecuteForSharedMemoryAndReset", "(JJ)I",
+            (void*)nativeExecuteForSharedMemoryAndReset },
+    { "nativeExportAndReset", "(JJII)J",
+            (void*)nativeExportAndReset },
+    { "nativeMapSharedMemory", "(I)Ljava/nio/ByteBuffer;",
+            (void*)nativeMapSharedMemory },
+    { "nativeUnmapSharedMemory", "(Ljava/nio/ByteBuffer;)V",
+            (void*)nativeUnmapSharedMemory },
+    { "nativeExecuteForRowsAndReset", "(JJI[J)Ljava/nio/ByteBuffer;",
+            (void*)nativeExecuteForRowsAndReset },
+    { "nativeFreeRows", "(Ljava/nio/ByteBuffer;)V",
+            (void*)nativeFreeRows },
+    { "nativeCreateColumnarTable", "(JLjava/lang/String;[Ljava/lang/String;[I[Ljava/lang/Object;[ZII)V",
+            (void*)nativeCreateColumnarTable },
+    { "nativeDropColumnarTable", "(JLjava/lang/String;)V",
+            (void*)nativeDropColumnarTable },
+    { "nativeCreateMembershipFilter", "(JLjava/lang/String;Ljava/lang/String;D)J",
+            (void*)nativeCreateMembershipFilter },
+    { "nativeDropMembershipFilter", "(JJ)V",
+            (void*)nativeDropMembershipFilter },
+    { "nativeMembershipFilterContainsLongs", "(JJ[J[Z)I",
+            (void*)nativeMembershipFilterContainsLongs },
+    { "nativeMembershipFilterContainsStrings", "(JJ[Ljava/lang/String;[Z)I",
+            (void*)nativeMembershipFilterContainsStrings },
+    { "nativeImportFile", "(JLjava/lang/String;ILjava/lang/String;[Ljava/lang/String;I[Ljava/lang/String;)[J",
+            (void*)nativeImportFile },
+    { "nativeCloneDatabase", "(JLjava/lang/String;)I",
+            (void*)nativeCloneDatabase },
+    { "nativeSetFileGrowth", "(JII)V",
+            (void*)nativeSetFileGrowth },
+
+    { "nativeDbStatus", "(JIZ)I",
+            (void*)nativeDbStatus },
+    { "nativeIsAutocommit", "(J)Z",
+            (void*)nativeIsAutocommit },
+    { "nativeWalCheckpoint", "(JI)[I",
+            (void*)nativeWalCheckpoint },
+    { "nativeDbFilename", "(J)Ljava/lang/String;",
+            (void*)nativeDbFilename },
     { "nativeInterrupt", "(J)V",
             (void*)nativeInterrupt },
     { "nativeReleaseMemory", "()I",
             (void*)nativeReleaseMemory },
+    { "nativeConfigure", "(II)V",
+            (void*)nativeConfigure },
+    { "nativeMemoryUsed", "()J",
+            (void*)nativeMemoryUsed },
+    { "nativeMemoryHighwater", "(Z)J",
+            (void*)nativeMemoryHighwater },
 };
 
 } // namespace android
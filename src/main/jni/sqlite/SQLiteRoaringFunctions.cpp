@@ -0,0 +1,906 @@
+// Roaring bitmaps of 32-bit unsigned integers (typically rowids), stored as BLOBs
+// in the portable Roaring serialization format, compatible with other Roaring implementations.
+//
+// roaring_build(X)            - aggregate, bitmap of all non-NULL values X
+// roaring_and(A, B, ...)      - intersection
+// roaring_or(A, B, ...)       - union
+// roaring_andnot(A, B, ...)   - values of A, which are not in any of the other bitmaps
+// roaring_and_agg(A)          - aggregate intersection, NULLs are ignored
+// roaring_or_agg(A)           - aggregate union, NULLs are ignored
+// roaring_cardinality(A)      - number of values in the bitmap
+// roaring_contains(A, X)      - 1 if X is in the bitmap, 0 otherwise
+// roaring_each(A)             - table-valued function with the values of the bitmap in ascending order
+//
+// Scalar functions return NULL if any of the arguments is NULL.
+// Bitmaps with run containers can be read, but they are always written without them.
+
+#define LOG_TAG "SQLiteRoaringFunctions"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+static const uint32_t SERIAL_COOKIE_NO_RUNCONTAINER = 12346;
+static const uint32_t SERIAL_COOKIE = 12347;
+static const uint32_t NO_OFFSET_THRESHOLD = 4;
+
+/** Containers with more values are stored as bitmaps. */
+static const uint32_t ARRAY_MAX_CARDINALITY = 4096;
+static const uint32_t BITMAP_WORDS = 65536 / 64;
+static const size_t BITMAP_BYTES = BITMAP_WORDS * sizeof(uint64_t);
+
+static const char* const ERROR_CORRUPTED = "Not a valid roaring bitmap";
+
+/** Values with the same upper 16 bits. */
+struct Container {
+    uint16_t key;
+    uint32_t cardinality;
+    /** Sorted lower 16 bits of values, NULL for bitmap containers. */
+    uint16_t* array;
+    uint32_t arrayCapacity;
+    /** Bits of lower 16 bits of values, NULL for array containers. */
+    uint64_t* bitmap;
+};
+
+struct Bitmap {
+    Container* containers;// Sorted by key
+    uint32_t count;
+    uint32_t capacity;
+};
+
+enum Operation {
+    OPERATION_AND,
+    OPERATION_OR,
+    OPERATION_ANDNOT,
+};
+
+static void containerFree(Container* container) {
+    sqlite3_free(container->array);
+    sqlite3_free(container->bitmap);
+    container->array = NULL;
+    container->bitmap = NULL;
+    container->cardinality = 0;
+}
+
+static void bitmapFree(Bitmap* bitmap) {
+    for (uint32_t i = 0; i < bitmap->count; i++) {
+        containerFree(&bitmap->containers[i]);
+    }
+    sqlite3_free(bitmap->containers);
+    memset(bitmap, 0, sizeof(Bitmap));
+}
+
+/** Insert empty container at position, returns NULL when out of memory. */
+static Container* bitmapInsertContainer(Bitmap* bitmap, uint32_t position, uint16_t key) {
+    if (bitmap->count == bitmap->capacity) {
+        const uint32_t capacity = bitmap->capacity == 0 ? 4 : bitmap->capacity * 2;
+        Container* containers = static_cast<Container*>(sqlite3_realloc64(bitmap->containers, capacity * sizeof(Container)));
+        if (containers == NULL) return NULL;
+        bitmap->containers = containers;
+        bitmap->capacity = capacity;
+    }
+    Container* container = &bitmap->containers[position];
+    memmove(container + 1, container, (bitmap->count - position) * sizeof(Container));
+    bitmap->count++;
+    memset(container, 0, sizeof(Container));
+    container->key = key;
+    return container;
+}
+
+static bool containerReserveArray(Container* container, uint32_t capacity) {
+    if (capacity <= container->arrayCapacity) return true;
+    uint16_t* array = static_cast<uint16_t*>(sqlite3_realloc64(container->array, capacity * sizeof(uint16_t)));
+    if (array == NULL) return false;
+    container->array = array;
+    container->arrayCapacity = capacity;
+    return true;
+}
+
+static inline bool bitmapWordsContain(const uint64_t* words, uint16_t low) {
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+static bool containerContains(const Container& container, uint16_t low) {
+    if (container.bitmap != NULL) {
+        return bitmapWordsContain(container.bitmap, low);
+    }
+    uint32_t from = 0;
+    uint32_t to = container.cardinality;
+    while (from < to) {
+        const uint32_t middle = (from + to) / 2;
+        if (container.array[middle] < low) {
+            from = middle + 1;
+        } else {
+            to = middle;
+        }
+    }
+    return from < container.cardinality && container.array[from] == low;
+}
+
+static bool containerConvertToBitmap(Container* container) {
+    uint64_t* words = static_cast<uint64_t*>(sqlite3_malloc64(BITMAP_BYTES));
+    if (words == NULL) return false;
+    memset(words, 0, BITMAP_BYTES);
+    for (uint32_t i = 0; i < container->cardinality; i++) {
+        words[container->array[i] >> 6] |= 1ULL << (container->array[i] & 63);
+    }
+    sqlite3_free(container->array);
+    container->array = NULL;
+    container->arrayCapacity = 0;
+    container->bitmap = words;
+    return true;
+}
+
+/** Convert bitmap container to array container, if it is small enough. */
+static bool containerNormalize(Container* container) {
+    if (container->bitmap == NULL || container->cardinality > ARRAY_MAX_CARDINALITY) return true;
+    uint16_t* array = static_cast<uint16_t*>(sqlite3_malloc64(container->cardinality * sizeof(uint16_t) + 1));
+    if (array == NULL) return false;
+    uint32_t count = 0;
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        uint64_t word = container->bitmap[w];
+        while (word != 0) {
+            array[count++] = (uint16_t) (w * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    sqlite3_free(container->bitmap);
+    container->bitmap = NULL;
+    container->array = array;
+    container->arrayCapacity = container->cardinality;
+    return true;
+}
+
+static bool containerAdd(Container* container, uint16_t low) {
+    if (container->bitmap != NULL) {
+        uint64_t& word = container->bitmap[low >> 6];
+        const uint64_t bit = 1ULL << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            container->cardinality++;
+        }
+        return true;
+    }
+
+    // Values usually come in ascending order, so try appending first
+    uint32_t position = container->cardinality;
+    if (position > 0 && container->array[position - 1] >= low) {
+        uint32_t from = 0;
+        uint32_t to = container->cardinality;
+        while (from < to) {
+            const uint32_t middle = (from + to) / 2;
+            if (container->array[middle] < low) {
+                from = middle + 1;
+            } else {
+                to = middle;
+            }
+        }
+        if (container->array[from] == low) return true;
+        position = from;
+    }
+
+    if (container->cardinality == ARRAY_MAX_CARDINALITY) {
+        return containerConvertToBitmap(container) && containerAdd(container, low);
+    }
+    if (container->cardinality == container->arrayCapacity) {
+        const uint32_t capacity = container->arrayCapacity == 0 ? 16 : container->arrayCapacity * 2;
+        if (!containerReserveArray(container, capacity < ARRAY_MAX_CARDINALITY ? capacity : ARRAY_MAX_CARDINALITY)) return false;
+    }
+    memmove(container->array + position + 1, container->array + position, (container->cardinality - position) * sizeof(uint16_t));
+    container->array[position] = low;
+    container->cardinality++;
+    return true;
+}
+
+/** Find container with the key, or the position where it should be inserted. */
+static bool bitmapFindContainer(const Bitmap& bitmap, uint16_t key, uint32_t* position) {
+    uint32_t from = 0;
+    uint32_t to = bitmap.count;
+    // Values usually come in ascending order, so try the last container first
+    if (bitmap.count > 0 && bitmap.containers[bitmap.count - 1].key <= key) {
+        from = bitmap.count - 1;
+    }
+    while (from < to) {
+        const uint32_t middle = (from + to) / 2;
+        if (bitmap.containers[middle].key < key) {
+            from = middle + 1;
+        } else {
+            to = middle;
+        }
+    }
+    *position = from;
+    return from < bitmap.count && bitmap.containers[from].key == key;
+}
+
+static bool bitmapAdd(Bitmap* bitmap, uint32_t value) {
+    const uint16_t key = (uint16_t) (value >> 16);
+    uint32_t position;
+    Container* container;
+    if (bitmapFindContainer(*bitmap, key, &position)) {
+        container = &bitmap->containers[position];
+    } else {
+        container = bitmapInsertContainer(bitmap, position, key);
+        if (container == NULL) return false;
+    }
+    return containerAdd(container, (uint16_t) value);
+}
+
+static bool containerCopy(const Container& source, Container* out) {
+    out->key = source.key;
+    out->cardinality = source.cardinality;
+    if (source.bitmap != NULL) {
+        out->bitmap = static_cast<uint64_t*>(sqlite3_malloc64(BITMAP_BYTES));
+        if (out->bitmap == NULL) return false;
+        memcpy(out->bitmap, source.bitmap, BITMAP_BYTES);
+    } else {
+        out->array = static_cast<uint16_t*>(sqlite3_malloc64(source.cardinality * sizeof(uint16_t) + 1));
+        if (out->array == NULL) return false;
+        out->arrayCapacity = source.cardinality;
+        memcpy(out->array, source.array, source.cardinality * sizeof(uint16_t));
+    }
+    return true;
+}
+
+/** Combine two array containers by merging them. */
+static bool containerCombineArrays(const Container& a, const Container& b, Operation op, Container* out) {
+    if (!containerReserveArray(out, op == OPERATION_OR ? a.cardinality + b.cardinality : a.cardinality)) return false;
+    uint32_t i = 0, j = 0, count = 0;
+    while (i < a.cardinality && j < b.cardinality) {
+        if (a.array[i] < b.array[j]) {
+            if (op != OPERATION_AND) out->array[count++] = a.array[i];
+            i++;
+        } else if (a.array[i] > b.array[j]) {
+            if (op == OPERATION_OR) out->array[count++] = b.array[j];
+            j++;
+        } else {
+            if (op != OPERATION_ANDNOT) out->array[count++] = a.array[i];
+            i++;
+            j++;
+        }
+    }
+    if (op != OPERATION_AND) {
+        while (i < a.cardinality) out->array[count++] = a.array[i++];
+    }
+    if (op == OPERATION_OR) {
+        while (j < b.cardinality) out->array[count++] = b.array[j++];
+    }
+    out->cardinality = count;
+    if (count > ARRAY_MAX_CARDINALITY) {
+        return containerConvertToBitmap(out);
+    }
+    return true;
+}
+
+/** Filter array container by membership in the other container. */
+static bool containerFilterArray(const Container& array, const Container& other, bool keepMembers, Container* out) {
+    if (!containerReserveArray(out, array.cardinality + 1)) return false;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < array.cardinality; i++) {
+        if (containerContains(other, array.array[i]) == keepMembers) {
+            out->array[count++] = array.array[i];
+        }
+    }
+    out->cardinality = count;
+    return true;
+}
+
+static void expandToWords(const Container& container, uint64_t* words) {
+    memset(words, 0, BITMAP_BYTES);
+    for (uint32_t i = 0; i < container.cardinality; i++) {
+        words[container.array[i] >> 6] |= 1ULL << (container.array[i] & 63);
+    }
+}
+
+/** Combine two containers with the same key. Result may be empty. */
+static bool containerCombine(const Container& a, const Container& b, Operation op, Container* out) {
+    out->key = a.key;
+    if (a.bitmap == NULL && b.bitmap == NULL) {
+        return containerCombineArrays(a, b, op, out);
+    }
+    if (a.bitmap == NULL && op != OPERATION_OR) {
+        return containerFilterArray(a, b, op == OPERATION_AND, out);
+    }
+    if (b.bitmap == NULL && op == OPERATION_AND) {
+        return containerFilterArray(b, a, true, out);
+    }
+
+    out->bitmap = static_cast<uint64_t*>(sqlite3_malloc64(BITMAP_BYTES));
+    if (out->bitmap == NULL) return false;
+    const uint64_t* aWords = a.bitmap;
+    const uint64_t* bWords = b.bitmap;
+    if (aWords == NULL || bWords == NULL) {
+        // Expand the array container into the output and combine in place
+        expandToWords(aWords == NULL ? a : b, out->bitmap);
+        if (aWords == NULL) aWords = out->bitmap; else bWords = out->bitmap;
+    }
+    uint32_t cardinality = 0;
+    for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+        uint64_t word;
+        switch (op) {
+            case OPERATION_AND: word = aWords[w] & bWords[w]; break;
+            case OPERATION_OR: word = aWords[w] | bWords[w]; break;
+            case OPERATION_ANDNOT:
+            default: word = aWords[w] & ~bWords[w]; break;
+        }
+        out->bitmap[w] = word;
+        cardinality += __builtin_popcountll(word);
+    }
+    out->cardinality = cardinality;
+    return containerNormalize(out);
+}
+
+/** Combine two bitmaps into a new bitmap out. */
+static bool bitmapCombine(const Bitmap& a, const Bitmap& b, Operation op, Bitmap* out) {
+    memset(out, 0, sizeof(Bitmap));
+    uint32_t i = 0, j = 0;
+    while (i < a.count || j < b.count) {
+        const bool hasA = i < a.count;
+        const bool hasB = j < b.count;
+        const Container* source = NULL;
+        const Container* other = NULL;
+        if (hasA && (!hasB || a.containers[i].key < b.containers[j].key)) {
+            if (op != OPERATION_AND) source = &a.containers[i];
+            i++;
+        } else if (hasB && (!hasA || b.containers[j].key < a.containers[i].key)) {
+            if (op == OPERATION_OR) source = &b.containers[j];
+            j++;
+        } else {
+            source = &a.containers[i++];
+            other = &b.containers[j++];
+        }
+        if (source == NULL) continue;
+
+        Container* container = bitmapInsertContainer(out, out->count, source->key);
+        if (container == NULL
+                || !(other == NULL ? containerCopy(*source, container) : containerCombine(*source, *other, op, container))) {
+            bitmapFree(out);
+            return false;
+        }
+        if (container->cardinality == 0) {
+            containerFree(container);
+            out->count--;
+        }
+    }
+    return true;
+}
+
+static inline uint16_t readLittleEndian16(const uint8_t* in) {
+    return (uint16_t) (in[0] | in[1] << 8);
+}
+
+static inline uint32_t readLittleEndian32(const uint8_t* in) {
+    return (uint32_t) in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16 | (uint32_t) in[3] << 24;
+}
+
+static inline void writeLittleEndian16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t) value;
+    out[1] = (uint8_t) (value >> 8);
+}
+
+static inline void writeLittleEndian32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t) (value >> (i * 8));
+    }
+}
+
+/** Parsed headers of a serialized bitmap. */
+struct SerializedBitmap {
+    uint32_t count;
+    const uint8_t* runFlags;// NULL if there are no run containers
+    const uint8_t* header;// count * (key, cardinality - 1)
+    const uint8_t* data;// Containers, one after another
+    const uint8_t* end;
+};
+
+static bool parseSerialized(const uint8_t* data, size_t length, SerializedBitmap* out) {
+    const uint8_t* end = data + length;
+    if (length < 4) return false;
+    const uint32_t cookie = readLittleEndian32(data);
+    data += 4;
+    out->runFlags = NULL;
+    if ((cookie & 0xFFFF) == SERIAL_COOKIE) {
+        out->count = (cookie >> 16) + 1;
+        const size_t runFlagsLength = (out->count + 7) / 8;
+        if ((size_t) (end - data) < runFlagsLength) return false;
+        out->runFlags = data;
+        data += runFlagsLength;
+    } else if (cookie == SERIAL_COOKIE_NO_RUNCONTAINER) {
+        if (end - data < 4) return false;
+        out->count = readLittleEndian32(data);
+        data += 4;
+        if (out->count > 65536) return false;
+    } else {
+        return false;
+    }
+    if ((size_t) (end - data) < out->count * 4) return false;
+    out->header = data;
+    data += out->count * 4;
+    if (out->runFlags == NULL || out->count >= NO_OFFSET_THRESHOLD) {
+        // Offsets are not needed, containers are stored one after another
+        if ((size_t) (end - data) < out->count * 4) return false;
+        data += out->count * 4;
+    }
+    out->data = data;
+    out->end = end;
+    return true;
+}
+
+static inline uint16_t serializedKey(const SerializedBitmap& serialized, uint32_t i) {
+    return readLittleEndian16(serialized.header + i * 4);
+}
+
+static inline uint32_t serializedCardinality(const SerializedBitmap& serialized, uint32_t i) {
+    return readLittleEndian16(serialized.header + i * 4 + 2) + 1u;
+}
+
+static const char* bitmapDeserialize(const void* blob, size_t length, Bitmap* out) {
+    memset(out, 0, sizeof(Bitmap));
+    SerializedBitmap serialized;
+    if (!parseSerialized(static_cast<const uint8_t*>(blob), length, &serialized)) return ERROR_CORRUPTED;
+
+    const uint8_t* data = serialized.data;
+    for (uint32_t i = 0; i < serialized.count; i++) {
+        const uint16_t key = serializedKey(serialized, i);
+        const uint32_t cardinality = serializedCardinality(serialized, i);
+        if (i > 0 && key <= out->containers[out->count - 1].key) {
+            bitmapFree(out);
+            return ERROR_CORRUPTED;
+        }
+        Container* container = bitmapInsertContainer(out, out->count, key);
+        if (container == NULL) {
+            bitmapFree(out);
+            return "Out of memory";
+        }
+
+        bool valid = true;
+        if (serialized.runFlags != NULL && (serialized.runFlags[i / 8] >> (i % 8)) & 1) {
+            // Runs of consecutive values
+            valid = serialized.end - data >= 2;
+            const uint32_t runs = valid ? readLittleEndian16(data) : 0;
+            data += 2;
+            valid = valid && (size_t) (serialized.end - data) >= runs * 4;
+            for (uint32_t r = 0; r < runs && valid; r++) {
+                const uint32_t start = readLittleEndian16(data + r * 4);
+                const uint32_t last = start + readLittleEndian16(data + r * 4 + 2);
+                valid = last <= 0xFFFF;
+                for (uint32_t value = start; value <= last && valid; value++) {
+                    valid = containerAdd(container, (uint16_t) value);
+                }
+            }
+            data += runs * 4;
+            valid = valid && container->cardinality == cardinality;
+        } else if (cardinality <= ARRAY_MAX_CARDINALITY) {
+            valid = (size_t) (serialized.end - data) >= cardinality * 2 && containerReserveArray(container, cardinality);
+            for (uint32_t v = 0; v < cardinality && valid; v++) {
+                container->array[v] = readLittleEndian16(data + v * 2);
+                valid = v == 0 || container->array[v - 1] < container->array[v];
+            }
+            container->cardinality = cardinality;
+            data += cardinality * 2;
+        } else {
+            valid = (size_t) (serialized.end - data) >= BITMAP_BYTES;
+            if (valid) {
+                container->bitmap = static_cast<uint64_t*>(sqlite3_malloc64(BITMAP_BYTES));
+                valid = container->bitmap != NULL;
+            }
+            if (valid) {
+                // Little-endian, like all supported architectures
+                memcpy(container->bitmap, data, BITMAP_BYTES);
+                uint32_t count = 0;
+                for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+                    count += __builtin_popcountll(container->bitmap[w]);
+                }
+                valid = count == cardinality;
+                container->cardinality = count;
+            }
+            data += BITMAP_BYTES;
+        }
+        if (!valid) {
+            bitmapFree(out);
+            return ERROR_CORRUPTED;
+        }
+    }
+    return NULL;
+}
+
+/** Serialize the bitmap into a buffer from sqlite3_malloc64, without run containers. */
+static uint8_t* bitmapSerialize(const Bitmap& bitmap, size_t* length) {
+    uint32_t count = 0;
+    size_t dataLength = 0;
+    for (uint32_t i = 0; i < bitmap.count; i++) {
+        const Container& container = bitmap.containers[i];
+        if (container.cardinality == 0) continue;
+        count++;
+        dataLength += container.bitmap != NULL ? BITMAP_BYTES : container.cardinality * 2;
+    }
+    const size_t headerLength = 8 + count * 8;
+    *length = headerLength + dataLength;
+    uint8_t* out = static_cast<uint8_t*>(sqlite3_malloc64(*length));
+    if (out == NULL) return NULL;
+
+    writeLittleEndian32(out, SERIAL_COOKIE_NO_RUNCONTAINER);
+    writeLittleEndian32(out + 4, count);
+    uint8_t* header = out + 8;
+    uint8_t* offsets = header + count * 4;
+    uint8_t* data = out + headerLength;
+    for (uint32_t i = 0; i < bitmap.count; i++) {
+        const Container& container = bitmap.containers[i];
+        if (container.cardinality == 0) continue;
+        writeLittleEndian16(header, container.key);
+        writeLittleEndian16(header + 2, (uint16_t) (container.cardinality - 1));
+        header += 4;
+        writeLittleEndian32(offsets, (uint32_t) (data - out));
+        offsets += 4;
+
+        // Containers must be normalized, so that readers pick the right type from the cardinality
+        if (container.bitmap != NULL && container.cardinality > ARRAY_MAX_CARDINALITY) {
+            memcpy(data, container.bitmap, BITMAP_BYTES);
+            data += BITMAP_BYTES;
+        } else if (container.bitmap != NULL) {
+            for (uint32_t w = 0; w < BITMAP_WORDS; w++) {
+                uint64_t word = container.bitmap[w];
+                while (word != 0) {
+                    writeLittleEndian16(data, (uint16_t) (w * 64 + __builtin_ctzll(word)));
+                    data += 2;
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for (uint32_t v = 0; v < container.cardinality; v++) {
+                writeLittleEndian16(data + v * 2, container.array[v]);
+            }
+            data += container.cardinality * 2;
+        }
+    }
+    return out;
+}
+
+static void resultBitmap(sqlite3_context* context, const Bitmap& bitmap) {
+    size_t length;
+    uint8_t* serialized = bitmapSerialize(bitmap, &length);
+    if (serialized == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    sqlite3_result_blob64(context, serialized, length, sqlite3_free);
+}
+
+/** Deserialize the argument, returns false and sets an error result on failure. */
+static bool valueBitmap(sqlite3_context* context, sqlite3_value* value, Bitmap* out) {
+    const char* error = bitmapDeserialize(sqlite3_value_blob(value), (size_t) sqlite3_value_bytes(value), out);
+    if (error != NULL) {
+        sqlite3_result_error(context, error, -1);
+        return false;
+    }
+    return true;
+}
+
+/** Read 32-bit unsigned value, returns false and sets an error result if it is out of range. */
+static bool valueMember(sqlite3_context* context, sqlite3_value* value, uint32_t* out) {
+    const sqlite3_int64 member = sqlite3_value_int64(value);
+    if (member < 0 || member > 0xFFFFFFFFLL) {
+        sqlite3_result_error(context, "Roaring bitmap values must be between 0 and 4294967295", -1);
+        return false;
+    }
+    *out = (uint32_t) member;
+    return true;
+}
+
+static void roaringBuildStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    Bitmap* bitmap = static_cast<Bitmap*>(sqlite3_aggregate_context(context, sizeof(Bitmap)));
+    if (bitmap == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    uint32_t value;
+    if (!valueMember(context, argv[0], &value)) return;
+    if (!bitmapAdd(bitmap, value)) {
+        sqlite3_result_error_nomem(context);
+    }
+}
+
+static void roaringBuildFinal(sqlite3_context* context) {
+    Bitmap* bitmap = static_cast<Bitmap*>(sqlite3_aggregate_context(context, 0));
+    if (bitmap == NULL) {
+        // No rows
+        Bitmap empty;
+        memset(&empty, 0, sizeof(Bitmap));
+        resultBitmap(context, empty);
+        return;
+    }
+    resultBitmap(context, *bitmap);
+    bitmapFree(bitmap);
+}
+
+static void roaringCombineFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    const Operation op = (Operation) reinterpret_cast<intptr_t>(sqlite3_user_data(context));
+    if (argc == 0) {
+        sqlite3_result_error(context, "At least one bitmap is required", -1);
+        return;
+    }
+    for (int i = 0; i < argc; i++) {
+        if (sqlite3_value_type(argv[i]) == SQLITE_NULL) {
+            sqlite3_result_null(context);
+            return;
+        }
+    }
+
+    Bitmap result;
+    if (!valueBitmap(context, argv[0], &result)) return;
+    for (int i = 1; i < argc; i++) {
+        Bitmap operand;
+        if (!valueBitmap(context, argv[i], &operand)) {
+            bitmapFree(&result);
+            return;
+        }
+        Bitmap combined;
+        const bool success = bitmapCombine(result, operand, op, &combined);
+        bitmapFree(&operand);
+        bitmapFree(&result);
+        if (!success) {
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        result = combined;
+    }
+    resultBitmap(context, result);
+    bitmapFree(&result);
+}
+
+struct CombineAggregate {
+    Bitmap bitmap;
+    bool initialized;
+    bool failed;
+};
+
+static void roaringCombineStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    const Operation op = (Operation) reinterpret_cast<intptr_t>(sqlite3_user_data(context));
+    CombineAggregate* aggregate = static_cast<CombineAggregate*>(sqlite3_aggregate_context(context, sizeof(CombineAggregate)));
+    if (aggregate == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    if (aggregate->failed || sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+
+    Bitmap operand;
+    if (!valueBitmap(context, argv[0], &operand)) {
+        aggregate->failed = true;
+        return;
+    }
+    if (!aggregate->initialized) {
+        aggregate->bitmap = operand;
+        aggregate->initialized = true;
+        return;
+    }
+    Bitmap combined;
+    const bool success = bitmapCombine(aggregate->bitmap, operand, op, &combined);
+    bitmapFree(&operand);
+    if (!success) {
+        aggregate->failed = true;
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    bitmapFree(&aggregate->bitmap);
+    aggregate->bitmap = combined;
+}
+
+static void roaringCombineFinal(sqlite3_context* context) {
+    CombineAggregate* aggregate = static_cast<CombineAggregate*>(sqlite3_aggregate_context(context, 0));
+    if (aggregate == NULL || !aggregate->initialized) {
+        sqlite3_result_null(context);
+    } else if (!aggregate->failed) {
+        resultBitmap(context, aggregate->bitmap);
+    }
+    if (aggregate != NULL) {
+        bitmapFree(&aggregate->bitmap);
+    }
+}
+
+static void roaringCardinalityFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    // Cardinality is in the header, no need to read the containers
+    SerializedBitmap serialized;
+    if (!parseSerialized(static_cast<const uint8_t*>(sqlite3_value_blob(argv[0])), (size_t) sqlite3_value_bytes(argv[0]), &serialized)) {
+        sqlite3_result_error(context, ERROR_CORRUPTED, -1);
+        return;
+    }
+    sqlite3_int64 cardinality = 0;
+    for (uint32_t i = 0; i < serialized.count; i++) {
+        cardinality += serializedCardinality(serialized, i);
+    }
+    sqlite3_result_int64(context, cardinality);
+}
+
+static void roaringContainsFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const sqlite3_int64 member = sqlite3_value_int64(argv[1]);
+    if (member < 0 || member > 0xFFFFFFFFLL) {
+        sqlite3_result_int(context, 0);
+        return;
+    }
+    Bitmap bitmap;
+    if (!valueBitmap(context, argv[0], &bitmap)) return;
+    uint32_t position;
+    const bool contains = bitmapFindContainer(bitmap, (uint16_t) (member >> 16), &position)
+            && containerContains(bitmap.containers[position], (uint16_t) member);
+    bitmapFree(&bitmap);
+    sqlite3_result_int(context, contains);
+}
+
+// roaring_each table-valued function
+
+enum EachColumn {
+    EACH_COLUMN_VALUE,
+    EACH_COLUMN_BITMAP,
+};
+
+struct EachCursor {
+    sqlite3_vtab_cursor base;
+    Bitmap bitmap;
+    uint32_t container;
+    uint32_t position;// Index in array containers, bit in bitmap containers
+};
+
+static int eachConnect(sqlite3* db, void* pAux, int argc, const char* const* argv, sqlite3_vtab** ppVtab, char** pzErr) {
+    int err = sqlite3_declare_vtab(db, "CREATE TABLE x(value INTEGER, bitmap HIDDEN)");
+    if (err != SQLITE_OK) return err;
+    sqlite3_vtab* table = static_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+    if (table == NULL) return SQLITE_NOMEM;
+    memset(table, 0, sizeof(sqlite3_vtab));
+    sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+    *ppVtab = table;
+    return SQLITE_OK;
+}
+
+static int eachDisconnect(sqlite3_vtab* pVtab) {
+    sqlite3_free(pVtab);
+    return SQLITE_OK;
+}
+
+static int eachBestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* info) {
+    int bitmapConstraint = -1;
+    for (int i = 0; i < info->nConstraint; i++) {
+        if (info->aConstraint[i].iColumn != EACH_COLUMN_BITMAP) continue;
+        if (info->aConstraint[i].op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        if (!info->aConstraint[i].usable) return SQLITE_CONSTRAINT;
+        bitmapConstraint = i;
+    }
+    if (bitmapConstraint < 0) {
+        pVtab->zErrMsg = sqlite3_mprintf("roaring_each requires a bitmap argument");
+        return SQLITE_ERROR;
+    }
+    info->aConstraintUsage[bitmapConstraint].argvIndex = 1;
+    info->aConstraintUsage[bitmapConstraint].omit = 1;
+    info->estimatedCost = 1000;
+    if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == EACH_COLUMN_VALUE && !info->aOrderBy[0].desc) {
+        info->orderByConsumed = 1;
+    }
+    return SQLITE_OK;
+}
+
+static int eachOpen(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor) {
+    EachCursor* cursor = static_cast<EachCursor*>(sqlite3_malloc(sizeof(EachCursor)));
+    if (cursor == NULL) return SQLITE_NOMEM;
+    memset(cursor, 0, sizeof(EachCursor));
+    *ppCursor = &cursor->base;
+    return SQLITE_OK;
+}
+
+static int eachClose(sqlite3_vtab_cursor* pCursor) {
+    EachCursor* cursor = reinterpret_cast<EachCursor*>(pCursor);
+    bitmapFree(&cursor->bitmap);
+    sqlite3_free(cursor);
+    return SQLITE_OK;
+}
+
+/** Move to the first value at or after the current position. */
+static void eachSeek(EachCursor* cursor) {
+    while (cursor->container < cursor->bitmap.count) {
+        const Container& container = cursor->bitmap.containers[cursor->container];
+        if (container.bitmap != NULL) {
+            while (cursor->position < 65536) {
+                const uint64_t word = container.bitmap[cursor->position >> 6] >> (cursor->position & 63);
+                if (word != 0) {
+                    cursor->position += __builtin_ctzll(word);
+                    return;
+                }
+                cursor->position = (cursor->position | 63) + 1;
+            }
+        } else if (cursor->position < container.cardinality) {
+            return;
+        }
+        cursor->container++;
+        cursor->position = 0;
+    }
+}
+
+static int eachFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr, int argc, sqlite3_value** argv) {
+    EachCursor* cursor = reinterpret_cast<EachCursor*>(pCursor);
+    bitmapFree(&cursor->bitmap);
+    cursor->container = 0;
+    cursor->position = 0;
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) return SQLITE_OK;
+    const char* error = bitmapDeserialize(sqlite3_value_blob(argv[0]), (size_t) sqlite3_value_bytes(argv[0]), &cursor->bitmap);
+    if (error != NULL) {
+        pCursor->pVtab->zErrMsg = sqlite3_mprintf("roaring_each: %s", error);
+        return SQLITE_ERROR;
+    }
+    eachSeek(cursor);
+    return SQLITE_OK;
+}
+
+static int eachNext(sqlite3_vtab_cursor* pCursor) {
+    EachCursor* cursor = reinterpret_cast<EachCursor*>(pCursor);
+    cursor->position++;
+    eachSeek(cursor);
+    return SQLITE_OK;
+}
+
+static int eachEof(sqlite3_vtab_cursor* pCursor) {
+    const EachCursor* cursor = reinterpret_cast<EachCursor*>(pCursor);
+    return cursor->container >= cursor->bitmap.count;
+}
+
+static sqlite3_int64 eachValue(const EachCursor* cursor) {
+    const Container& container = cursor->bitmap.containers[cursor->container];
+    const uint32_t low = container.bitmap != NULL ? cursor->position : container.array[cursor->position];
+    return (sqlite3_int64) ((uint32_t) container.key << 16 | low);
+}
+
+static int eachColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int column) {
+    if (column == EACH_COLUMN_VALUE) {
+        sqlite3_result_int64(context, eachValue(reinterpret_cast<EachCursor*>(pCursor)));
+    }
+    return SQLITE_OK;
+}
+
+static int eachRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    *pRowid = eachValue(reinterpret_cast<EachCursor*>(pCursor));
+    return SQLITE_OK;
+}
+
+static sqlite3_module eachModule = {
+    /* iVersion    */ 0,
+    /* xCreate     */ NULL,
+    /* xConnect    */ eachConnect,
+    /* xBestIndex  */ eachBestIndex,
+    /* xDisconnect */ eachDisconnect,
+    /* xDestroy    */ NULL,
+    /* xOpen       */ eachOpen,
+    /* xClose      */ eachClose,
+    /* xFilter     */ eachFilter,
+    /* xNext       */ eachNext,
+    /* xEof        */ eachEof,
+    /* xColumn     */ eachColumn,
+    /* xRowid      */ eachRowid,
+};
+
+int registerRoaringFunctions(sqlite3* db) {
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    void* const AND = reinterpret_cast<void*>(OPERATION_AND);
+    void* const OR = reinterpret_cast<void*>(OPERATION_OR);
+    void* const ANDNOT = reinterpret_cast<void*>(OPERATION_ANDNOT);
+
+    int err = sqlite3_create_function_v2(db, "roaring_build", 1, flags, NULL, NULL, roaringBuildStep, roaringBuildFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_and", -1, flags, AND, roaringCombineFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_or", -1, flags, OR, roaringCombineFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_andnot", -1, flags, ANDNOT, roaringCombineFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_and_agg", 1, flags, AND, NULL, roaringCombineStep, roaringCombineFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_or_agg", 1, flags, OR, NULL, roaringCombineStep, roaringCombineFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_cardinality", 1, flags, NULL, roaringCardinalityFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "roaring_contains", 2, flags, NULL, roaringContainsFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_module(db, "roaring_each", &eachModule, NULL);
+    return err;
+}
+
+} // namespace android
@@ -0,0 +1,292 @@
+// Serialization of query results, see SQLiteRowFormat.h for the format.
+
+#define LOG_TAG "SQLiteRowFormat"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <sys/ioctl.h>
+#include <linux/ashmem.h>
+#endif
+
+#include "SQLiteRowFormat.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#define F_SEAL_WRITE 0x0008
+#endif
+
+namespace android {
+
+/** When writing to a file, buffered data are flushed when they reach this length. */
+static const size_t FLUSH_LENGTH = 256 * 1024;
+
+struct RowWriter {
+    int fd;
+    uint8_t* buffer;
+    size_t length;
+    size_t capacity;
+    /** Bytes already written to fd. */
+    uint64_t flushed;
+    uint64_t* rowOffsets;
+    size_t rowCapacity;
+    int err;
+};
+
+static bool writeFully(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        const ssize_t written = pwrite(fd, data, length, (off_t) offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+        offset += (uint64_t) written;
+    }
+    return true;
+}
+
+/** Make space for length more bytes. */
+static bool reserve(RowWriter* writer, size_t length) {
+    if (writer->err != SQLITE_OK) return false;
+    if (writer->length + length <= writer->capacity) return true;
+    if (writer->fd != -1 && writer->length >= FLUSH_LENGTH) {
+        if (!writeFully(writer->fd, writer->buffer, writer->length, writer->flushed)) {
+            writer->err = SQLITE_IOERR_WRITE;
+            return false;
+        }
+        writer->flushed += writer->length;
+        writer->length = 0;
+        if (length <= writer->capacity) return true;
+    }
+    size_t capacity = writer->capacity < 4096 ? 4096 : writer->capacity * 2;
+    while (capacity < writer->length + length) capacity *= 2;
+    uint8_t* buffer = static_cast<uint8_t*>(sqlite3_realloc64(writer->buffer, capacity));
+    if (buffer == NULL) {
+        writer->err = SQLITE_NOMEM;
+        return false;
+    }
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    return true;
+}
+
+static void append(RowWriter* writer, const void* data, size_t length) {
+    if (!reserve(writer, length)) return;
+    if (length > 0) memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+}
+
+// Little-endian, like all supported architectures
+static void appendU32(RowWriter* writer, uint32_t value) {
+    append(writer, &value, sizeof(value));
+}
+
+static void appendByte(RowWriter* writer, uint8_t value) {
+    append(writer, &value, 1);
+}
+
+static void appendLengthPrefixed(RowWriter* writer, const void* data, size_t length) {
+    appendU32(writer, (uint32_t) length);
+    append(writer, data, length);
+}
+
+static void appendRow(RowWriter* writer, sqlite3_stmt* statement, int columnCount, sqlite3_int64 row) {
+    if ((size_t) row == writer->rowCapacity) {
+        const size_t capacity = writer->rowCapacity < 256 ? 256 : writer->rowCapacity * 2;
+        uint64_t* rowOffsets = static_cast<uint64_t*>(sqlite3_realloc64(writer->rowOffsets, capacity * sizeof(uint64_t)));
+        if (rowOffsets == NULL) {
+            writer->err = SQLITE_NOMEM;
+            return;
+        }
+        writer->rowOffsets = rowOffsets;
+        writer->rowCapacity = capacity;
+    }
+    writer->rowOffsets[row] = writer->flushed + writer->length;
+
+    for (int c = 0; c < columnCount; c++) {
+        const int type = sqlite3_column_type(statement, c);
+        appendByte(writer, (uint8_t) type);
+        switch (type) {
+            case SQLITE_INTEGER: {
+                const sqlite3_int64 value = sqlite3_column_int64(statement, c);
+                append(writer, &value, sizeof(value));
+                break;
+            }
+            case SQLITE_FLOAT: {
+                const double value = sqlite3_column_double(statement, c);
+                append(writer, &value, sizeof(value));
+                break;
+            }
+            case SQLITE_TEXT: {
+                const unsigned char* text = sqlite3_column_text(statement, c);
+                appendLengthPrefixed(writer, text, (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            }
+            case SQLITE_BLOB: {
+                const void* blob = sqlite3_column_blob(statement, c);
+                appendLengthPrefixed(writer, blob, (size_t) sqlite3_column_bytes(statement, c));
+                break;
+            }
+        }
+    }
+}
+
+int writeRowFormat(sqlite3_stmt* statement, sqlite3_int64 maxRows, sqlite3_int64 stride, int fd, RowFormatOutput* out) {
+    RowWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.fd = fd;
+
+    const int columnCount = sqlite3_column_count(statement);
+    uint8_t header[ROW_FORMAT_HEADER_LENGTH];
+    memset(header, 0, sizeof(header));
+    append(&writer, header, sizeof(header));
+    for (int c = 0; c < columnCount; c++) {
+        const char* name = sqlite3_column_name(statement, c);
+        if (name == NULL) {
+            writer.err = SQLITE_NOMEM;
+            break;
+        }
+        appendLengthPrefixed(&writer, name, strlen(name));
+    }
+
+    sqlite3_int64 rowCount = 0;
+    sqlite3_int64 steppedRows = 0;
+    bool done = false;
+    while (writer.err == SQLITE_OK && (maxRows < 0 || steppedRows < maxRows)) {
+        const int err = sqlite3_step(statement);
+        if (err == SQLITE_DONE) {
+            done = true;
+            break;
+        }
+        if (err != SQLITE_ROW) {
+            writer.err = err;
+            break;
+        }
+        if (++steppedRows % stride != 0) continue;
+        appendRow(&writer, statement, columnCount, rowCount);
+        rowCount++;
+    }
+
+    const uint64_t rowIndexOffset = writer.flushed + writer.length;
+    if (writer.err == SQLITE_OK && rowCount > 0) {
+        append(&writer, writer.rowOffsets, (size_t) rowCount * sizeof(uint64_t));
+    }
+
+    const uint32_t magic = ROW_FORMAT_MAGIC, version = ROW_FORMAT_VERSION, columns = (uint32_t) columnCount;
+    memcpy(header, &magic, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &columns, 4);
+    memcpy(header + 16, &rowCount, 8);
+    memcpy(header + 24, &rowIndexOffset, 8);
+
+    if (writer.err == SQLITE_OK) {
+        if (fd == -1) {
+            memcpy(writer.buffer, header, sizeof(header));
+        } else if (!writeFully(fd, writer.buffer, writer.length, writer.flushed)
+                   || !writeFully(fd, header, sizeof(header), 0)) {
+            writer.err = SQLITE_IOERR_WRITE;
+        }
+    }
+
+    out->rowCount = rowCount;
+    out->steppedRows = steppedRows;
+    out->done = done;
+    out->length = (size_t) (writer.flushed + writer.length);
+    if (writer.err == SQLITE_OK && fd == -1) {
+        out->data = writer.buffer;
+    } else {
+        out->data = NULL;
+        sqlite3_free(writer.buffer);
+    }
+    sqlite3_free(writer.rowOffsets);
+    return writer.err;
+}
+
+#ifdef __ANDROID__
+/** Kernels before 3.17 don't have memfd, so copy the rows to ashmem. */
+static int writeAshmem(sqlite3_stmt* statement, int* err) {
+    RowFormatOutput output;
+    *err = writeRowFormat(statement, -1, 1, -1, &output);
+    if (*err != SQLITE_OK) return -1;
+
+    char name[ASHMEM_NAME_LEN] = "sqlite-rows";
+    int fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+    void* memory = MAP_FAILED;
+    if (fd != -1 && ioctl(fd, ASHMEM_SET_NAME, name) == 0 && ioctl(fd, ASHMEM_SET_SIZE, output.length) == 0) {
+        memory = mmap(NULL, output.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (memory == MAP_FAILED) {
+        *err = SQLITE_IOERR_WRITE;
+        if (fd != -1) close(fd);
+        sqlite3_free(output.data);
+        return -1;
+    }
+    memcpy(memory, output.data, output.length);
+    munmap(memory, output.length);
+    sqlite3_free(output.data);
+
+    // Closest to sealing that ashmem can do
+    ioctl(fd, ASHMEM_SET_PROT_MASK, PROT_READ);
+    return fd;
+}
+#endif
+
+int writeRowFormatSharedMemory(sqlite3_stmt* statement, int* err) {
+    const int fd = (int) syscall(__NR_memfd_create, "sqlite-rows", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1) {
+#ifdef __ANDROID__
+        if (errno == ENOSYS) return writeAshmem(statement, err);
+#endif
+        *err = SQLITE_IOERR_WRITE;
+        return -1;
+    }
+
+    RowFormatOutput output;
+    *err = writeRowFormat(statement, -1, 1, fd, &output);
+    if (*err == SQLITE_OK && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        *err = SQLITE_IOERR_WRITE;
+    }
+    if (*err != SQLITE_OK) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+const void* mapRowFormatSharedMemory(int fd, size_t* length) {
+    struct stat stats;
+    if (fstat(fd, &stats) != 0) return NULL;
+    size_t size = (size_t) stats.st_size;
+#ifdef __ANDROID__
+    if (size == 0) {
+        // ashmem does not report its size through fstat
+        const int ashmemSize = ioctl(fd, ASHMEM_GET_SIZE, NULL);
+        if (ashmemSize > 0) size = (size_t) ashmemSize;
+    }
+#endif
+    if (size < ROW_FORMAT_HEADER_LENGTH) {
+        errno = EINVAL;
+        return NULL;
+    }
+    void* memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) return NULL;
+    *length = size;
+    return memory;
+}
+
+}
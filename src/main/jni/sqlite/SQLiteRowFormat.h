@@ -0,0 +1,64 @@
+#ifndef SQLITE_ROW_FORMAT_H
+#define SQLITE_ROW_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+// Compact format of query results, read by SQLiteRowReader in Java.
+// All numbers are little-endian.
+//
+// Header, ROW_FORMAT_HEADER_LENGTH bytes:
+//   bytes 0-3:   ROW_FORMAT_MAGIC
+//   bytes 4-7:   ROW_FORMAT_VERSION
+//   bytes 8-11:  column count
+//   bytes 12-15: reserved, 0
+//   bytes 16-23: row count
+//   bytes 24-31: offset of the row index
+// Column names, each as 4 byte length and UTF-8 bytes
+// Rows, each column as a type byte (SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL) followed by
+//   INTEGER: 8 byte signed integer
+//   FLOAT:   8 byte double
+//   TEXT:    4 byte length and UTF-8 bytes
+//   BLOB:    4 byte length and bytes
+//   NULL:    nothing
+// Row index, 8 byte offset of each row
+
+namespace android {
+
+static const uint32_t ROW_FORMAT_MAGIC = 0x524C5153;// "SQLR"
+static const uint32_t ROW_FORMAT_VERSION = 1;
+static const size_t ROW_FORMAT_HEADER_LENGTH = 32;
+
+struct RowFormatOutput {
+    /** Serialized rows, when not written to a file. Free with sqlite3_free. */
+    uint8_t* data;
+    /** Length of the serialized rows. */
+    size_t length;
+    sqlite3_int64 rowCount;
+    /** Rows stepped over, including those which were not serialized because of the stride. */
+    sqlite3_int64 steppedRows;
+    /** Statement has no more rows. */
+    bool done;
+};
+
+/**
+ * Step the statement at most maxRows times (all rows if negative) and serialize every stride-th row
+ * (rows stride - 1, 2 * stride - 1, ..., all rows when stride is 1).
+ * When fd is not -1, the rows are written to it, starting at offset 0, otherwise to out->data.
+ * Returns SQLITE_OK, error of sqlite3_step, SQLITE_NOMEM or SQLITE_IOERR_WRITE (with errno set).
+ */
+int writeRowFormat(sqlite3_stmt* statement, sqlite3_int64 maxRows, sqlite3_int64 stride, int fd, RowFormatOutput* out);
+
+/**
+ * Serialize all rows of the statement into a new sealed, read-only memfd (or ashmem, on old kernels).
+ * Returns the file descriptor, or -1 and the error in *err.
+ */
+int writeRowFormatSharedMemory(sqlite3_stmt* statement, int* err);
+
+/** Map shared memory created by writeRowFormatSharedMemory read-only. Returns NULL on failure. */
+const void* mapRowFormatSharedMemory(int fd, size_t* length);
+
+}
+
+#endif // SQLITE_ROW_FORMAT_H
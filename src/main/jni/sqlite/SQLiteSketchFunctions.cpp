@@ -0,0 +1,581 @@
+// Approximate sketch aggregates with mergeable states stored as BLOBs.
+// Values are hashed like in the xxh3(X) SQL function, NULLs are ignored.
+//
+// hll(X[, P])                 - HyperLogLog of distinct values, with 2^P registers (P is 4-18, 14 by default)
+// hll_merge(S)                - union of HyperLogLog sketches with the same P
+// hll_count(S)                - estimated number of distinct values
+//
+// tdigest(X[, COMPRESSION])   - t-digest of numeric values, COMPRESSION is 100 by default
+// tdigest_merge(S)            - union of t-digests
+// tdigest_quantile(S, Q)      - estimated value at quantile Q (0.0 - 1.0)
+//
+// cms(X[, WIDTH, DEPTH])      - count-min sketch of value frequencies, WIDTH is 1024 and DEPTH is 4 by default
+// cms_merge(S)                - union of count-min sketches with the same WIDTH and DEPTH
+// cms_estimate(S, X)          - estimated number of occurrences of X, never less than the real one
+//
+// Parameters of the aggregates are read from the first row. Memory used by sketches is bounded:
+// 2^P bytes for HyperLogLog, about 8 * COMPRESSION bytes for t-digest (96 * COMPRESSION while aggregating) and 4 * WIDTH * DEPTH bytes for count-min.
+
+#define LOG_TAG "SQLiteSketchFunctions"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+static const uint8_t SKETCH_VERSION = 1;
+static const uint8_t HLL_MAGIC = 'H';
+static const uint8_t TDIGEST_MAGIC = 'T';
+static const uint8_t CMS_MAGIC = 'C';
+
+static const char* const ERROR_NOT_SKETCH = "Not a valid sketch";
+static const char* const ERROR_DIFFERENT_PARAMETERS = "Cannot merge sketches with different parameters";
+
+static inline uint32_t readLittleEndian32(const uint8_t* in) {
+    return (uint32_t) in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16 | (uint32_t) in[3] << 24;
+}
+
+static inline void writeLittleEndian32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t) (value >> (i * 8));
+    }
+}
+
+static inline uint64_t readLittleEndian64(const uint8_t* in) {
+    return (uint64_t) readLittleEndian32(in) | (uint64_t) readLittleEndian32(in + 4) << 32;
+}
+
+static inline void writeLittleEndian64(uint8_t* out, uint64_t value) {
+    writeLittleEndian32(out, (uint32_t) value);
+    writeLittleEndian32(out + 4, (uint32_t) (value >> 32));
+}
+
+static inline double readDouble(const uint8_t* in) {
+    const uint64_t bits = readLittleEndian64(in);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline void writeDouble(uint8_t* out, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeLittleEndian64(out, bits);
+}
+
+/** State of hll and cms aggregates, which is directly the serialized sketch. */
+struct SketchAggregate {
+    uint8_t* sketch;
+    size_t length;
+    bool failed;
+};
+
+static SketchAggregate* getSketchAggregate(sqlite3_context* context) {
+    SketchAggregate* aggregate = static_cast<SketchAggregate*>(sqlite3_aggregate_context(context, sizeof(SketchAggregate)));
+    if (aggregate == NULL) {
+        sqlite3_result_error_nomem(context);
+        return NULL;
+    }
+    return aggregate->failed ? NULL : aggregate;
+}
+
+static void failSketchAggregate(sqlite3_context* context, SketchAggregate* aggregate, const char* error) {
+    aggregate->failed = true;
+    if (error == NULL) {
+        sqlite3_result_error_nomem(context);
+    } else {
+        sqlite3_result_error(context, error, -1);
+    }
+}
+
+/** Allocate zeroed sketch with the header. */
+static bool allocateSketch(sqlite3_context* context, SketchAggregate* aggregate, size_t length, const uint8_t* header, size_t headerLength) {
+    aggregate->sketch = static_cast<uint8_t*>(sqlite3_malloc64(length));
+    if (aggregate->sketch == NULL) {
+        failSketchAggregate(context, aggregate, NULL);
+        return false;
+    }
+    memset(aggregate->sketch, 0, length);
+    memcpy(aggregate->sketch, header, headerLength);
+    aggregate->length = length;
+    return true;
+}
+
+/** Result is the sketch, or NULL if there were no rows. */
+static void sketchAggregateFinal(sqlite3_context* context) {
+    SketchAggregate* aggregate = static_cast<SketchAggregate*>(sqlite3_aggregate_context(context, 0));
+    if (aggregate == NULL || aggregate->sketch == NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    if (aggregate->failed) {
+        sqlite3_free(aggregate->sketch);
+    } else {
+        sqlite3_result_blob64(context, aggregate->sketch, aggregate->length, sqlite3_free);
+    }
+    aggregate->sketch = NULL;
+}
+
+// HyperLogLog: magic, version, P, 0, 2^P registers of one byte
+
+static const size_t HLL_HEADER_LENGTH = 4;
+static const int HLL_MIN_PRECISION = 4;
+static const int HLL_MAX_PRECISION = 18;
+static const int HLL_DEFAULT_PRECISION = 14;
+
+static bool readHll(const uint8_t* sketch, size_t length, int* precision) {
+    if (length < HLL_HEADER_LENGTH || sketch[0] != HLL_MAGIC || sketch[1] != SKETCH_VERSION) return false;
+    *precision = sketch[2];
+    return *precision >= HLL_MIN_PRECISION && *precision <= HLL_MAX_PRECISION
+            && length == HLL_HEADER_LENGTH + ((size_t) 1 << *precision);
+}
+
+static void hllStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    SketchAggregate* aggregate = getSketchAggregate(context);
+    if (aggregate == NULL) return;
+    if (aggregate->sketch == NULL) {
+        const int precision = argc > 1 ? sqlite3_value_int(argv[1]) : HLL_DEFAULT_PRECISION;
+        if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+            failSketchAggregate(context, aggregate, "hll() precision must be between 4 and 18");
+            return;
+        }
+        const uint8_t header[HLL_HEADER_LENGTH] = { HLL_MAGIC, SKETCH_VERSION, (uint8_t) precision, 0 };
+        if (!allocateSketch(context, aggregate, HLL_HEADER_LENGTH + ((size_t) 1 << precision), header, sizeof(header))) return;
+    }
+
+    uint64_t hash;
+    if (!hashValue(argv[0], &hash)) return;
+    const int precision = aggregate->sketch[2];
+    const size_t index = (size_t) (hash >> (64 - precision));
+    // Position of the first 1 bit in the rest of the hash, with a sentinel bit so that it is never zero
+    const uint64_t rest = (hash << precision) | ((uint64_t) 1 << (precision - 1));
+    const uint8_t rank = (uint8_t) (__builtin_clzll(rest) + 1);
+    uint8_t& reg = aggregate->sketch[HLL_HEADER_LENGTH + index];
+    if (rank > reg) reg = rank;
+}
+
+static void hllMergeStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    SketchAggregate* aggregate = getSketchAggregate(context);
+    if (aggregate == NULL || sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    const size_t length = (size_t) sqlite3_value_bytes(argv[0]);
+    int precision;
+    if (!readHll(sketch, length, &precision)) {
+        failSketchAggregate(context, aggregate, ERROR_NOT_SKETCH);
+        return;
+    }
+    if (aggregate->sketch == NULL) {
+        allocateSketch(context, aggregate, length, sketch, length);
+        return;
+    }
+    if (aggregate->length != length || aggregate->sketch[2] != precision) {
+        failSketchAggregate(context, aggregate, ERROR_DIFFERENT_PARAMETERS);
+        return;
+    }
+    for (size_t i = HLL_HEADER_LENGTH; i < length; i++) {
+        if (sketch[i] > aggregate->sketch[i]) aggregate->sketch[i] = sketch[i];
+    }
+}
+
+static void hllCountFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    int precision;
+    if (!readHll(sketch, (size_t) sqlite3_value_bytes(argv[0]), &precision)) {
+        sqlite3_result_error(context, ERROR_NOT_SKETCH, -1);
+        return;
+    }
+
+    const size_t registers = (size_t) 1 << precision;
+    const double m = (double) registers;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < registers; i++) {
+        const uint8_t reg = sketch[HLL_HEADER_LENGTH + i];
+        sum += ldexp(1.0, -reg);
+        if (reg == 0) zeros++;
+    }
+    double alpha;
+    switch (precision) {
+        case 4: alpha = 0.673; break;
+        case 5: alpha = 0.697; break;
+        case 6: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / m); break;
+    }
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        // Linear counting is more precise for small cardinalities
+        estimate = m * log(m / (double) zeros);
+    }
+    sqlite3_result_int64(context, (sqlite3_int64) llround(estimate));
+}
+
+// t-digest: magic, version, 0, 0, centroid count (4), compression, min, max, centroids (mean, weight)
+
+static const size_t TDIGEST_HEADER_LENGTH = 32;
+static const size_t TDIGEST_CENTROID_LENGTH = 16;
+static const double TDIGEST_DEFAULT_COMPRESSION = 100.0;
+static const double TDIGEST_MAX_COMPRESSION = 10000.0;
+
+struct Centroid {
+    double mean;
+    double weight;
+};
+
+struct TDigestAggregate {
+    double compression;
+    double min;
+    double max;
+    /** Merged centroids, followed by the values added since the last compression. */
+    Centroid* centroids;
+    uint32_t count;
+    uint32_t capacity;
+    bool failed;
+};
+
+static int compareCentroids(const void* a, const void* b) {
+    const double meanA = static_cast<const Centroid*>(a)->mean;
+    const double meanB = static_cast<const Centroid*>(b)->mean;
+    return meanA < meanB ? -1 : meanA > meanB ? 1 : 0;
+}
+
+/** Scale function k1, which keeps centroids near the tails small, for precise extreme quantiles. */
+static double tdigestScale(double q, double compression) {
+    return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+static double tdigestScaleInverse(double k, double compression) {
+    if (k >= compression / 4.0) return 1.0;
+    return (sin(k * 2.0 * M_PI / compression) + 1.0) / 2.0;
+}
+
+/** Merge all centroids, so that each spans at most 1 unit of the scale function. */
+static void tdigestCompress(TDigestAggregate* digest) {
+    if (digest->count <= 1) return;
+    qsort(digest->centroids, digest->count, sizeof(Centroid), compareCentroids);
+
+    double total = 0.0;
+    for (uint32_t i = 0; i < digest->count; i++) {
+        total += digest->centroids[i].weight;
+    }
+    uint32_t merged = 0;
+    double weightBefore = 0.0;
+    double qLimit = tdigestScaleInverse(tdigestScale(0.0, digest->compression) + 1.0, digest->compression);
+    Centroid current = digest->centroids[0];
+    for (uint32_t i = 1; i < digest->count; i++) {
+        const Centroid& next = digest->centroids[i];
+        if ((weightBefore + current.weight + next.weight) / total <= qLimit) {
+            current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+            current.weight += next.weight;
+        } else {
+            weightBefore += current.weight;
+            digest->centroids[merged++] = current;
+            current = next;
+            qLimit = tdigestScaleInverse(tdigestScale(weightBefore / total, digest->compression) + 1.0, digest->compression);
+        }
+    }
+    digest->centroids[merged++] = current;
+    digest->count = merged;
+}
+
+static TDigestAggregate* getTDigestAggregate(sqlite3_context* context, double compression) {
+    TDigestAggregate* digest = static_cast<TDigestAggregate*>(sqlite3_aggregate_context(context, sizeof(TDigestAggregate)));
+    if (digest == NULL) {
+        sqlite3_result_error_nomem(context);
+        return NULL;
+    }
+    if (digest->failed) return NULL;
+    if (digest->centroids == NULL) {
+        if (!(compression >= 1.0 && compression <= TDIGEST_MAX_COMPRESSION)) {
+            digest->failed = true;
+            sqlite3_result_error(context, "t-digest compression must be between 1 and 10000", -1);
+            return NULL;
+        }
+        digest->compression = compression;
+        digest->min = INFINITY;
+        digest->max = -INFINITY;
+        // Compression bounds the number of merged centroids to about compression / 2, the rest is a buffer
+        digest->capacity = (uint32_t) (6 * compression) + 16;
+        digest->centroids = static_cast<Centroid*>(sqlite3_malloc64(digest->capacity * sizeof(Centroid)));
+        if (digest->centroids == NULL) {
+            digest->failed = true;
+            sqlite3_result_error_nomem(context);
+            return NULL;
+        }
+    }
+    return digest;
+}
+
+static void tdigestAdd(TDigestAggregate* digest, double mean, double weight) {
+    if (digest->count == digest->capacity) {
+        tdigestCompress(digest);
+        if (digest->count == digest->capacity) {
+            // Should not happen, but do not overflow if the compression does not keep up
+            Centroid& last = digest->centroids[digest->count - 1];
+            last.mean += (mean - last.mean) * weight / (last.weight + weight);
+            last.weight += weight;
+            return;
+        }
+    }
+    digest->centroids[digest->count].mean = mean;
+    digest->centroids[digest->count].weight = weight;
+    digest->count++;
+}
+
+static void tdigestStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    TDigestAggregate* digest = getTDigestAggregate(context, argc > 1 ? sqlite3_value_double(argv[1]) : TDIGEST_DEFAULT_COMPRESSION);
+    if (digest == NULL || sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    const double value = sqlite3_value_double(argv[0]);
+    if (isnan(value)) return;
+    if (value < digest->min) digest->min = value;
+    if (value > digest->max) digest->max = value;
+    tdigestAdd(digest, value, 1.0);
+}
+
+static bool readTDigest(const uint8_t* sketch, size_t length, uint32_t* count) {
+    if (length < TDIGEST_HEADER_LENGTH || sketch[0] != TDIGEST_MAGIC || sketch[1] != SKETCH_VERSION) return false;
+    *count = readLittleEndian32(sketch + 4);
+    return length == TDIGEST_HEADER_LENGTH + (size_t) *count * TDIGEST_CENTROID_LENGTH;
+}
+
+static void tdigestMergeStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    uint32_t count;
+    if (!readTDigest(sketch, (size_t) sqlite3_value_bytes(argv[0]), &count)) {
+        TDigestAggregate* digest = static_cast<TDigestAggregate*>(sqlite3_aggregate_context(context, sizeof(TDigestAggregate)));
+        if (digest != NULL) digest->failed = true;
+        sqlite3_result_error(context, ERROR_NOT_SKETCH, -1);
+        return;
+    }
+    TDigestAggregate* digest = getTDigestAggregate(context, readDouble(sketch + 8));
+    if (digest == NULL) return;
+    if (count == 0) return;
+    const double min = readDouble(sketch + 16);
+    const double max = readDouble(sketch + 24);
+    if (min < digest->min) digest->min = min;
+    if (max > digest->max) digest->max = max;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* centroid = sketch + TDIGEST_HEADER_LENGTH + i * TDIGEST_CENTROID_LENGTH;
+        tdigestAdd(digest, readDouble(centroid), readDouble(centroid + 8));
+    }
+}
+
+static void tdigestFinal(sqlite3_context* context) {
+    TDigestAggregate* digest = static_cast<TDigestAggregate*>(sqlite3_aggregate_context(context, 0));
+    if (digest == NULL || digest->centroids == NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    if (!digest->failed) {
+        tdigestCompress(digest);
+        const size_t length = TDIGEST_HEADER_LENGTH + digest->count * TDIGEST_CENTROID_LENGTH;
+        uint8_t* sketch = static_cast<uint8_t*>(sqlite3_malloc64(length));
+        if (sketch == NULL) {
+            sqlite3_result_error_nomem(context);
+        } else {
+            sketch[0] = TDIGEST_MAGIC;
+            sketch[1] = SKETCH_VERSION;
+            sketch[2] = 0;
+            sketch[3] = 0;
+            writeLittleEndian32(sketch + 4, digest->count);
+            writeDouble(sketch + 8, digest->compression);
+            writeDouble(sketch + 16, digest->min);
+            writeDouble(sketch + 24, digest->max);
+            for (uint32_t i = 0; i < digest->count; i++) {
+                uint8_t* centroid = sketch + TDIGEST_HEADER_LENGTH + i * TDIGEST_CENTROID_LENGTH;
+                writeDouble(centroid, digest->centroids[i].mean);
+                writeDouble(centroid + 8, digest->centroids[i].weight);
+            }
+            sqlite3_result_blob64(context, sketch, length, sqlite3_free);
+        }
+    }
+    sqlite3_free(digest->centroids);
+    digest->centroids = NULL;
+}
+
+static void tdigestQuantileFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    uint32_t count;
+    if (!readTDigest(sketch, (size_t) sqlite3_value_bytes(argv[0]), &count)) {
+        sqlite3_result_error(context, ERROR_NOT_SKETCH, -1);
+        return;
+    }
+    const double q = sqlite3_value_double(argv[1]);
+    if (!(q >= 0.0 && q <= 1.0)) {
+        sqlite3_result_error(context, "Quantile must be between 0 and 1", -1);
+        return;
+    }
+    if (count == 0) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const double min = readDouble(sketch + 16);
+    const double max = readDouble(sketch + 24);
+    const uint8_t* centroids = sketch + TDIGEST_HEADER_LENGTH;
+    double total = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += readDouble(centroids + i * TDIGEST_CENTROID_LENGTH + 8);
+    }
+
+    // Interpolate between centroid centers, tails are interpolated towards min and max
+    const double target = q * total;
+    double previousCenter = 0.0;
+    double previousMean = min;
+    double weightBefore = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        const double mean = readDouble(centroids + i * TDIGEST_CENTROID_LENGTH);
+        const double weight = readDouble(centroids + i * TDIGEST_CENTROID_LENGTH + 8);
+        const double center = weightBefore + weight / 2.0;
+        if (target < center) {
+            const double t = center > previousCenter ? (target - previousCenter) / (center - previousCenter) : 0.0;
+            sqlite3_result_double(context, previousMean + t * (mean - previousMean));
+            return;
+        }
+        previousCenter = center;
+        previousMean = mean;
+        weightBefore += weight;
+    }
+    const double t = total > previousCenter ? (target - previousCenter) / (total - previousCenter) : 1.0;
+    sqlite3_result_double(context, previousMean + t * (max - previousMean));
+}
+
+// Count-min: magic, version, 0, 0, width (4), depth (4), 0 (4), total (8), width * depth counters (4)
+
+static const size_t CMS_HEADER_LENGTH = 24;
+static const uint32_t CMS_DEFAULT_WIDTH = 1024;
+static const uint32_t CMS_DEFAULT_DEPTH = 4;
+static const uint64_t CMS_MAX_COUNTERS = 1 << 24;
+
+static bool readCms(const uint8_t* sketch, size_t length, uint32_t* width, uint32_t* depth) {
+    if (length < CMS_HEADER_LENGTH || sketch[0] != CMS_MAGIC || sketch[1] != SKETCH_VERSION) return false;
+    *width = readLittleEndian32(sketch + 4);
+    *depth = readLittleEndian32(sketch + 8);
+    return *width > 0 && *depth > 0 && (uint64_t) *width * *depth <= CMS_MAX_COUNTERS
+            && length == CMS_HEADER_LENGTH + (size_t) *width * *depth * 4;
+}
+
+/** Index of the counter for the hash in the row, with double hashing. */
+static inline size_t cmsIndex(uint64_t hash, uint32_t row, uint32_t width) {
+    const uint32_t h1 = (uint32_t) hash;
+    const uint32_t h2 = (uint32_t) (hash >> 32) | 1;
+    return (size_t) row * width + (h1 + row * h2) % width;
+}
+
+static inline uint32_t saturatingAdd(uint32_t a, uint32_t b) {
+    const uint32_t sum = a + b;
+    return sum < a ? UINT32_MAX : sum;
+}
+
+static void cmsStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    SketchAggregate* aggregate = getSketchAggregate(context);
+    if (aggregate == NULL) return;
+    if (aggregate->sketch == NULL) {
+        const sqlite3_int64 width = argc > 1 ? sqlite3_value_int64(argv[1]) : CMS_DEFAULT_WIDTH;
+        const sqlite3_int64 depth = argc > 2 ? sqlite3_value_int64(argv[2]) : CMS_DEFAULT_DEPTH;
+        if (width <= 0 || depth <= 0 || depth > 64 || width > (sqlite3_int64) CMS_MAX_COUNTERS
+                || (uint64_t) (width * depth) > CMS_MAX_COUNTERS) {
+            failSketchAggregate(context, aggregate, "cms() width and depth must be positive, depth at most 64 and width * depth at most 16777216");
+            return;
+        }
+        uint8_t header[CMS_HEADER_LENGTH];
+        memset(header, 0, sizeof(header));
+        header[0] = CMS_MAGIC;
+        header[1] = SKETCH_VERSION;
+        writeLittleEndian32(header + 4, (uint32_t) width);
+        writeLittleEndian32(header + 8, (uint32_t) depth);
+        if (!allocateSketch(context, aggregate, CMS_HEADER_LENGTH + (size_t) (width * depth) * 4, header, sizeof(header))) return;
+    }
+
+    uint64_t hash;
+    if (!hashValue(argv[0], &hash)) return;
+    uint8_t* sketch = aggregate->sketch;
+    const uint32_t width = readLittleEndian32(sketch + 4);
+    const uint32_t depth = readLittleEndian32(sketch + 8);
+    writeLittleEndian64(sketch + 16, readLittleEndian64(sketch + 16) + 1);
+    for (uint32_t row = 0; row < depth; row++) {
+        uint8_t* counter = sketch + CMS_HEADER_LENGTH + cmsIndex(hash, row, width) * 4;
+        writeLittleEndian32(counter, saturatingAdd(readLittleEndian32(counter), 1));
+    }
+}
+
+static void cmsMergeStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    SketchAggregate* aggregate = getSketchAggregate(context);
+    if (aggregate == NULL || sqlite3_value_type(argv[0]) == SQLITE_NULL) return;
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    const size_t length = (size_t) sqlite3_value_bytes(argv[0]);
+    uint32_t width, depth;
+    if (!readCms(sketch, length, &width, &depth)) {
+        failSketchAggregate(context, aggregate, ERROR_NOT_SKETCH);
+        return;
+    }
+    if (aggregate->sketch == NULL) {
+        allocateSketch(context, aggregate, length, sketch, length);
+        return;
+    }
+    if (aggregate->length != length || memcmp(aggregate->sketch + 4, sketch + 4, 8) != 0) {
+        failSketchAggregate(context, aggregate, ERROR_DIFFERENT_PARAMETERS);
+        return;
+    }
+    writeLittleEndian64(aggregate->sketch + 16, readLittleEndian64(aggregate->sketch + 16) + readLittleEndian64(sketch + 16));
+    for (size_t offset = CMS_HEADER_LENGTH; offset < length; offset += 4) {
+        writeLittleEndian32(aggregate->sketch + offset,
+                saturatingAdd(readLittleEndian32(aggregate->sketch + offset), readLittleEndian32(sketch + offset)));
+    }
+}
+
+static void cmsEstimateFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const uint8_t* sketch = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    uint32_t width, depth;
+    if (!readCms(sketch, (size_t) sqlite3_value_bytes(argv[0]), &width, &depth)) {
+        sqlite3_result_error(context, ERROR_NOT_SKETCH, -1);
+        return;
+    }
+    uint64_t hash;
+    if (!hashValue(argv[1], &hash)) {
+        sqlite3_result_int(context, 0);// NULLs are not counted
+        return;
+    }
+    uint32_t estimate = UINT32_MAX;
+    for (uint32_t row = 0; row < depth; row++) {
+        const uint32_t counter = readLittleEndian32(sketch + CMS_HEADER_LENGTH + cmsIndex(hash, row, width) * 4);
+        if (counter < estimate) estimate = counter;
+    }
+    sqlite3_result_int64(context, estimate);
+}
+
+int registerSketchFunctions(sqlite3* db) {
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    int err = SQLITE_OK;
+    for (int argc = 1; argc <= 2 && err == SQLITE_OK; argc++) {
+        err = sqlite3_create_function_v2(db, "hll", argc, flags, NULL, NULL, hllStep, sketchAggregateFinal, NULL);
+        if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "tdigest", argc, flags, NULL, NULL, tdigestStep, tdigestFinal, NULL);
+    }
+    for (int argc = 1; argc <= 3 && err == SQLITE_OK; argc++) {
+        err = sqlite3_create_function_v2(db, "cms", argc, flags, NULL, NULL, cmsStep, sketchAggregateFinal, NULL);
+    }
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "hll_merge", 1, flags, NULL, NULL, hllMergeStep, sketchAggregateFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "hll_count", 1, flags, NULL, hllCountFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "tdigest_merge", 1, flags, NULL, NULL, tdigestMergeStep, tdigestFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "tdigest_quantile", 2, flags, NULL, tdigestQuantileFunction, NULL, NULL, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "cms_merge", 1, flags, NULL, NULL, cmsMergeStep, sketchAggregateFinal, NULL);
+    if (err == SQLITE_OK) err = sqlite3_create_function_v2(db, "cms_estimate", 2, flags, NULL, cmsEstimateFunction, NULL, NULL, NULL);
+    return err;
+}
+
+} // namespace android
@@ -0,0 +1,206 @@
+// Time-series SQL functions.
+//
+// time_bucket(TS, WIDTH[, ORIGIN]) - start of the bucket of given WIDTH containing TS,
+//                                    buckets are aligned to ORIGIN (0 by default).
+//                                    Returns INTEGER if all arguments are INTEGERs, REAL otherwise.
+// lttb(X, Y, N)                    - aggregate, downsamples the series of points to N points
+//                                    with the Largest-Triangle-Three-Buckets algorithm.
+//                                    Returns BLOB of little-endian float64 X, Y pairs ordered by X,
+//                                    readable with SQLiteStatement.cursorGetDoubles.
+//                                    Rows with NULL X or Y are skipped, N must be at least 3.
+
+#define LOG_TAG "SQLiteTimeSeriesFunctions"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SQLiteExtensions.h"
+
+namespace android {
+
+static void timeBucketFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    bool integers = true;
+    for (int i = 0; i < argc; i++) {
+        const int type = sqlite3_value_numeric_type(argv[i]);
+        if (type == SQLITE_NULL) {
+            sqlite3_result_null(context);
+            return;
+        }
+        integers = integers && type == SQLITE_INTEGER;
+    }
+
+    if (integers) {
+        const sqlite3_int64 ts = sqlite3_value_int64(argv[0]);
+        const sqlite3_int64 width = sqlite3_value_int64(argv[1]);
+        const sqlite3_int64 origin = argc > 2 ? sqlite3_value_int64(argv[2]) : 0;
+        if (width <= 0) {
+            sqlite3_result_error(context, "time_bucket() width must be positive", -1);
+            return;
+        }
+        const sqlite3_int64 offset = ts - origin;
+        // Round towards negative infinity, also for timestamps before the origin
+        sqlite3_int64 bucket = offset / width;
+        if (offset % width < 0) bucket--;
+        sqlite3_result_int64(context, bucket * width + origin);
+    } else {
+        const double ts = sqlite3_value_double(argv[0]);
+        const double width = sqlite3_value_double(argv[1]);
+        const double origin = argc > 2 ? sqlite3_value_double(argv[2]) : 0.0;
+        if (!(width > 0.0)) {
+            sqlite3_result_error(context, "time_bucket() width must be positive", -1);
+            return;
+        }
+        sqlite3_result_double(context, floor((ts - origin) / width) * width + origin);
+    }
+}
+
+struct Point {
+    double x;
+    double y;
+};
+
+struct LttbAggregate {
+    Point* points;
+    size_t count;
+    size_t capacity;
+    sqlite3_int64 threshold;
+    bool sorted;
+    bool failed;
+};
+
+static void lttbStep(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    LttbAggregate* aggregate = static_cast<LttbAggregate*>(sqlite3_aggregate_context(context, sizeof(LttbAggregate)));
+    if (aggregate == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    if (aggregate->failed) return;
+    if (aggregate->points == NULL) {
+        aggregate->threshold = sqlite3_value_int64(argv[2]);
+        if (aggregate->threshold < 3) {
+            aggregate->failed = true;
+            sqlite3_result_error(context, "lttb() needs at least 3 points", -1);
+            return;
+        }
+        aggregate->sorted = true;
+    }
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) return;
+
+    if (aggregate->count == aggregate->capacity) {
+        const size_t capacity = aggregate->capacity == 0 ? 1024 : aggregate->capacity * 2;
+        Point* points = static_cast<Point*>(sqlite3_realloc64(aggregate->points, capacity * sizeof(Point)));
+        if (points == NULL) {
+            aggregate->failed = true;
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        aggregate->points = points;
+        aggregate->capacity = capacity;
+    }
+    Point& point = aggregate->points[aggregate->count];
+    point.x = sqlite3_value_double(argv[0]);
+    point.y = sqlite3_value_double(argv[1]);
+    if (aggregate->count > 0 && point.x < aggregate->points[aggregate->count - 1].x) {
+        aggregate->sorted = false;
+    }
+    aggregate->count++;
+}
+
+static int comparePoints(const void* a, const void* b) {
+    const double xA = static_cast<const Point*>(a)->x;
+    const double xB = static_cast<const Point*>(b)->x;
+    return xA < xB ? -1 : xA > xB ? 1 : 0;
+}
+
+static inline void writePoint(uint8_t* out, const Point& point) {
+    // Little-endian, like all supported architectures
+    memcpy(out, &point.x, sizeof(double));
+    memcpy(out + sizeof(double), &point.y, sizeof(double));
+}
+
+/** Downsample points into out, which has space for threshold points. */
+static size_t lttb(const Point* points, size_t count, size_t threshold, uint8_t* out) {
+    const size_t pointLength = 2 * sizeof(double);
+    if (count <= threshold) {
+        for (size_t i = 0; i < count; i++) {
+            writePoint(out + i * pointLength, points[i]);
+        }
+        return count;
+    }
+
+    // First and last points are always kept, the rest is split into threshold - 2 buckets
+    const double bucketSize = (double) (count - 2) / (double) (threshold - 2);
+    size_t selected = 0;
+    writePoint(out, points[0]);
+    for (size_t bucket = 0; bucket < threshold - 2; bucket++) {
+        // Average of the next bucket is the third point of the triangle
+        const size_t nextStart = (size_t) ((bucket + 1) * bucketSize) + 1;
+        size_t nextEnd = (size_t) ((bucket + 2) * bucketSize) + 1;
+        if (nextEnd > count) nextEnd = count;
+        double averageX = 0.0, averageY = 0.0;
+        for (size_t i = nextStart; i < nextEnd; i++) {
+            averageX += points[i].x;
+            averageY += points[i].y;
+        }
+        averageX /= (double) (nextEnd - nextStart);
+        averageY /= (double) (nextEnd - nextStart);
+
+        // Point of this bucket, which forms the largest triangle with the previously selected point
+        const Point& a = points[selected];
+        const size_t start = (size_t) (bucket * bucketSize) + 1;
+        const size_t end = nextStart;
+        double maxArea = -1.0;
+        size_t maxIndex = start;
+        for (size_t i = start; i < end; i++) {
+            const double area = fabs((a.x - averageX) * (points[i].y - a.y) - (a.x - points[i].x) * (averageY - a.y));
+            if (area > maxArea) {
+                maxArea = area;
+                maxIndex = i;
+            }
+        }
+        writePoint(out + (bucket + 1) * pointLength, points[maxIndex]);
+        selected = maxIndex;
+    }
+    writePoint(out + (threshold - 1) * pointLength, points[count - 1]);
+    return threshold;
+}
+
+static void lttbFinal(sqlite3_context* context) {
+    LttbAggregate* aggregate = static_cast<LttbAggregate*>(sqlite3_aggregate_context(context, 0));
+    if (aggregate == NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    if (!aggregate->failed) {
+        if (!aggregate->sorted) {
+            qsort(aggregate->points, aggregate->count, sizeof(Point), comparePoints);
+        }
+        const size_t threshold = aggregate->count < (size_t) aggregate->threshold ? aggregate->count : (size_t) aggregate->threshold;
+        // +1 so that empty results are not a NULL allocation
+        uint8_t* out = static_cast<uint8_t*>(sqlite3_malloc64(threshold * 2 * sizeof(double) + 1));
+        if (out == NULL) {
+            sqlite3_result_error_nomem(context);
+        } else {
+            const size_t count = lttb(aggregate->points, aggregate->count, threshold, out);
+            sqlite3_result_blob64(context, out, count * 2 * sizeof(double), sqlite3_free);
+        }
+    }
+    sqlite3_free(aggregate->points);
+    aggregate->points = NULL;
+}
+
+int registerTimeSeriesFunctions(sqlite3* db) {
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    int err = SQLITE_OK;
+    for (int argc = 2; argc <= 3 && err == SQLITE_OK; argc++) {
+        err = sqlite3_create_function_v2(db, "time_bucket", argc, flags, NULL, timeBucketFunction, NULL, NULL, NULL);
+    }
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_function_v2(db, "lttb", 3, flags, NULL, NULL, lttbStep, lttbFinal, NULL);
+    }
+    return err;
+}
+
+} // namespace android
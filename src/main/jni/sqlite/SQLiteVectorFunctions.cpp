@@ -0,0 +1,731 @@
+// Vector similarity SQL functions, over vectors stored as BLOBs of little-endian numbers.
+//
+// vec_dot(A, B)    - dot product
+// vec_cosine(A, B) - cosine similarity, NULL if any of the vectors is zero
+// vec_l2(A, B)     - Euclidean distance
+//
+// Vectors are float32 by default. Functions with suffix _f16 work with float16 vectors
+// and functions with suffix _i8 with int8 vectors.
+// vec_f16(A) and vec_i8(A[, SCALE]) convert float32 vectors to these formats,
+// int8 elements are round(element * SCALE) clamped to [-127, 127], SCALE is 127 by default.
+// Note that dot product and distance of int8 vectors are not scaled back.
+//
+// vec_top_k(QUERY, K, TABLE, COLUMN[, METRIC]) is a table-valued function,
+// which scans the vectors in the column of the table and returns rowids and distances
+// of K vectors closest to the QUERY vector, ordered from the closest.
+// It can be used only in top-level SQL, not in triggers, views or the schema, because it reads any table.
+// METRIC is 'l2' (default), 'cosine' (distance is 1 - similarity) or 'dot' (distance is negative dot product),
+// optionally with _f16 or _i8 suffix for other vector formats.
+//
+// Float kernels use NEON, SSE or AVX2 with FMA, depending on what the CPU supports.
+
+#define LOG_TAG "SQLiteVectorFunctions"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "SQLiteExtensions.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace android {
+
+// Sums needed by the metrics
+struct VectorSums {
+    float ab;// Dot product
+    float aa;// Squared norm of a
+    float bb;// Squared norm of b
+    float diff;// Squared Euclidean distance
+};
+
+enum VectorMetric {
+    METRIC_DOT,
+    METRIC_COSINE,
+    METRIC_L2,
+};
+
+// Kernel over float32 vectors of n elements, with no alignment requirements
+typedef void (*VectorKernel)(const uint8_t* a, const uint8_t* b, size_t n, VectorMetric metric, VectorSums* sums);
+
+static inline float loadFloat(const uint8_t* data, size_t index) {
+    float value;
+    memcpy(&value, data + index * sizeof(float), sizeof(float));
+    return value;
+}
+
+static void vectorKernelScalar(const uint8_t* a, const uint8_t* b, size_t n, VectorMetric metric, VectorSums* sums) {
+    for (size_t i = 0; i < n; i++) {
+        const float va = loadFloat(a, i);
+        const float vb = loadFloat(b, i);
+        if (metric == METRIC_L2) {
+            const float d = va - vb;
+            sums->diff += d * d;
+        } else {
+            sums->ab += va * vb;
+            if (metric == METRIC_COSINE) {
+                sums->aa += va * va;
+                sums->bb += vb * vb;
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline float horizontalSum(__m128 v) {
+    __m128 shuffled = _mm_movehl_ps(v, v);
+    v = _mm_add_ps(v, shuffled);
+    shuffled = _mm_shuffle_ps(v, v, 1);
+    return _mm_cvtss_f32(_mm_add_ss(v, shuffled));
+}
+
+static void vectorKernelSse(const uint8_t* a, const uint8_t* b, size_t n, VectorMetric metric, VectorSums* sums) {
+    __m128 ab = _mm_setzero_ps();
+    __m128 aa = _mm_setzero_ps();
+    __m128 bb = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(reinterpret_cast<const float*>(a + i * sizeof(float)));
+        const __m128 vb = _mm_loadu_ps(reinterpret_cast<const float*>(b + i * sizeof(float)));
+        if (metric == METRIC_L2) {
+            const __m128 d = _mm_sub_ps(va, vb);
+            ab = _mm_add_ps(ab, _mm_mul_ps(d, d));
+        } else {
+            ab = _mm_add_ps(ab, _mm_mul_ps(va, vb));
+            if (metric == METRIC_COSINE) {
+                aa = _mm_add_ps(aa, _mm_mul_ps(va, va));
+                bb = _mm_add_ps(bb, _mm_mul_ps(vb, vb));
+            }
+        }
+    }
+    if (metric == METRIC_L2) {
+        sums->diff += horizontalSum(ab);
+    } else {
+        sums->ab += horizontalSum(ab);
+        sums->aa += horizontalSum(aa);
+        sums->bb += horizontalSum(bb);
+    }
+    vectorKernelScalar(a + i * sizeof(float), b + i * sizeof(float), n - i, metric, sums);
+}
+
+__attribute__((target("avx2,fma")))
+static inline float horizontalSumAvx(__m256 v) {
+    return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void vectorKernelAvx2(const uint8_t* a, const uint8_t* b, size_t n, VectorMetric metric, VectorSums* sums) {
+    __m256 ab = _mm256_setzero_ps();
+    __m256 aa = _mm256_setzero_ps();
+    __m256 bb = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 va = _mm256_loadu_ps(reinterpret_cast<const float*>(a + i * sizeof(float)));
+        const __m256 vb = _mm256_loadu_ps(reinterpret_cast<const float*>(b + i * sizeof(float)));
+        if (metric == METRIC_L2) {
+            const __m256 d = _mm256_sub_ps(va, vb);
+            ab = _mm256_fmadd_ps(d, d, ab);
+        } else {
+            ab = _mm256_fmadd_ps(va, vb, ab);
+            if (metric == METRIC_COSINE) {
+                aa = _mm256_fmadd_ps(va, va, aa);
+                bb = _mm256_fmadd_ps(vb, vb, bb);
+            }
+        }
+    }
+    if (metric == METRIC_L2) {
+        sums->diff += horizontalSumAvx(ab);
+    } else {
+        sums->ab += horizontalSumAvx(ab);
+        sums->aa += horizontalSumAvx(aa);
+        sums->bb += horizontalSumAvx(bb);
+    }
+    vectorKernelSse(a + i * sizeof(float), b + i * sizeof(float), n - i, metric, sums);
+}
+
+static VectorKernel selectVectorKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return vectorKernelAvx2;
+    }
+    return vectorKernelSse;
+}
+#elif defined(__ARM_NEON)
+static inline float32x4_t multiplyAdd(float32x4_t sum, float32x4_t a, float32x4_t b) {
+#if defined(__aarch64__)
+    return vfmaq_f32(sum, a, b);
+#else
+    return vmlaq_f32(sum, a, b);
+#endif
+}
+
+static inline float horizontalSum(float32x4_t v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#endif
+}
+
+static void vectorKernelNeon(const uint8_t* a, const uint8_t* b, size_t n, VectorMetric metric, VectorSums* sums) {
+    float32x4_t ab = vdupq_n_f32(0.0f);
+    float32x4_t aa = vdupq_n_f32(0.0f);
+    float32x4_t bb = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // Loading as bytes, because the data does not have to be aligned
+        const float32x4_t va = vreinterpretq_f32_u8(vld1q_u8(a + i * sizeof(float)));
+        const float32x4_t vb = vreinterpretq_f32_u8(vld1q_u8(b + i * sizeof(float)));
+        if (metric == METRIC_L2) {
+            const float32x4_t d = vsubq_f32(va, vb);
+            ab = multiplyAdd(ab, d, d);
+        } else {
+            ab = multiplyAdd(ab, va, vb);
+            if (metric == METRIC_COSINE) {
+                aa = multiplyAdd(aa, va, va);
+                bb = multiplyAdd(bb, vb, vb);
+            }
+        }
+    }
+    if (metric == METRIC_L2) {
+        sums->diff += horizontalSum(ab);
+    } else {
+        sums->ab += horizontalSum(ab);
+        sums->aa += horizontalSum(aa);
+        sums->bb += horizontalSum(bb);
+    }
+    vectorKernelScalar(a + i * sizeof(float), b + i * sizeof(float), n - i, metric, sums);
+}
+
+static VectorKernel selectVectorKernel() {
+    return vectorKernelNeon;
+}
+#else
+static VectorKernel selectVectorKernel() {
+    return vectorKernelScalar;
+}
+#endif
+
+static VectorKernel vectorKernel = NULL;// Selected on first use
+
+static VectorKernel getVectorKernel() {
+    VectorKernel kernel = __atomic_load_n(&vectorKernel, __ATOMIC_RELAXED);
+    if (kernel == NULL) {
+        kernel = selectVectorKernel();
+        __atomic_store_n(&vectorKernel, kernel, __ATOMIC_RELAXED);
+    }
+    return kernel;
+}
+
+enum VectorFormat {
+    FORMAT_F32 = 4,
+    FORMAT_F16 = 2,
+    FORMAT_I8 = 1,
+};
+
+static float halfToFloat(uint16_t half) {
+    const uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0) {
+        // Zero or subnormal
+        float value = (float) mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    const uint32_t absolute = bits & 0x7FFFFFFF;
+    if (absolute > 0x7F800000) return sign | 0x7E00;// NaN
+    if (absolute >= 0x477FF000) return sign | 0x7C00;// Infinity or too big
+    if (absolute < 0x38800000) {
+        // Zero or subnormal, rounded to nearest even
+        float magnitude;
+        memcpy(&magnitude, &absolute, sizeof(magnitude));
+        return sign | (uint16_t) lrintf(magnitude * 16777216.0f);
+    }
+    // Normal, rounded to nearest even
+    return sign | (uint16_t) ((absolute + 0xFFF + ((absolute >> 13) & 1) - 0x38000000) >> 13);
+}
+
+// Number of elements converted to float32 at once, for formats other than float32
+static const size_t CONVERSION_BLOCK = 64;
+
+static void convertToFloats(const uint8_t* data, size_t offset, size_t n, VectorFormat format, float* out) {
+    if (format == FORMAT_F16) {
+        for (size_t i = 0; i < n; i++) {
+            uint16_t half;
+            memcpy(&half, data + (offset + i) * 2, 2);
+            out[i] = halfToFloat(half);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = (float) (int8_t) data[offset + i];
+        }
+    }
+}
+
+static void computeSums(const uint8_t* a, const uint8_t* b, size_t n, VectorFormat format, VectorMetric metric, VectorSums* sums) {
+    memset(sums, 0, sizeof(VectorSums));
+    const VectorKernel kernel = getVectorKernel();
+    if (format == FORMAT_F32) {
+        kernel(a, b, n, metric, sums);
+        return;
+    }
+
+    float blockA[CONVERSION_BLOCK];
+    float blockB[CONVERSION_BLOCK];
+    for (size_t offset = 0; offset < n; offset += CONVERSION_BLOCK) {
+        const size_t blockLength = n - offset < CONVERSION_BLOCK ? n - offset : CONVERSION_BLOCK;
+        convertToFloats(a, offset, blockLength, format, blockA);
+        convertToFloats(b, offset, blockLength, format, blockB);
+        kernel(reinterpret_cast<const uint8_t*>(blockA), reinterpret_cast<const uint8_t*>(blockB), blockLength, metric, sums);
+    }
+}
+
+// Distance used by vec_top_k, lower is closer
+static double metricDistance(const VectorSums& sums, VectorMetric metric) {
+    switch (metric) {
+        case METRIC_DOT:
+            return -(double) sums.ab;
+        case METRIC_COSINE:
+            if (sums.aa == 0.0f || sums.bb == 0.0f) return 1.0;
+            return 1.0 - (double) sums.ab / (sqrt((double) sums.aa) * sqrt((double) sums.bb));
+        case METRIC_L2:
+        default:
+            return sqrt((double) sums.diff);
+    }
+}
+
+// Function user data, format and metric packed together
+static void* functionKind(VectorFormat format, VectorMetric metric) {
+    return reinterpret_cast<void*>((intptr_t) (format << 4 | metric));
+}
+
+static void vectorMetricFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    const intptr_t kind = reinterpret_cast<intptr_t>(sqlite3_user_data(context));
+    const VectorFormat format = (VectorFormat) (kind >> 4);
+    const VectorMetric metric = (VectorMetric) (kind & 0xF);
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const uint8_t* a = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    const size_t aLength = (size_t) sqlite3_value_bytes(argv[0]);
+    const uint8_t* b = static_cast<const uint8_t*>(sqlite3_value_blob(argv[1]));
+    const size_t bLength = (size_t) sqlite3_value_bytes(argv[1]);
+    if (aLength != bLength) {
+        sqlite3_result_error(context, "Vectors have different dimensions", -1);
+        return;
+    }
+    if (aLength % format != 0) {
+        sqlite3_result_error(context, "Vector length is not a multiple of its element size", -1);
+        return;
+    }
+
+    VectorSums sums;
+    computeSums(a, b, aLength / format, format, metric, &sums);
+    switch (metric) {
+        case METRIC_DOT:
+            sqlite3_result_double(context, sums.ab);
+            break;
+        case METRIC_COSINE:
+            if (sums.aa == 0.0f || sums.bb == 0.0f) {
+                sqlite3_result_null(context);
+            } else {
+                sqlite3_result_double(context, (double) sums.ab / (sqrt((double) sums.aa) * sqrt((double) sums.bb)));
+            }
+            break;
+        case METRIC_L2:
+            sqlite3_result_double(context, sqrt((double) sums.diff));
+            break;
+    }
+}
+
+static void vectorConvertFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+    const VectorFormat format = (VectorFormat) reinterpret_cast<intptr_t>(sqlite3_user_data(context));
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const uint8_t* vector = static_cast<const uint8_t*>(sqlite3_value_blob(argv[0]));
+    const size_t length = (size_t) sqlite3_value_bytes(argv[0]);
+    if (length % sizeof(float) != 0) {
+        sqlite3_result_error(context, "Vector length is not a multiple of its element size", -1);
+        return;
+    }
+    const size_t n = length / sizeof(float);
+    const double scale = argc > 1 ? sqlite3_value_double(argv[1]) : 127.0;
+
+    // +1 so that empty vectors are not a NULL allocation
+    uint8_t* result = static_cast<uint8_t*>(sqlite3_malloc64(n * format + 1));
+    if (result == NULL) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        const float value = loadFloat(vector, i);
+        if (format == FORMAT_F16) {
+            const uint16_t half = floatToHalf(value);
+            memcpy(result + i * 2, &half, 2);
+        } else {
+            const double scaled = nearbyint(value * scale);
+            result[i] = (uint8_t) (int8_t) (scaled > 127.0 ? 127 : scaled < -127.0 ? -127 : (int) scaled);
+        }
+    }
+    sqlite3_result_blob64(context, result, n * format, sqlite3_free);
+}
+
+// vec_top_k table-valued function
+
+enum TopKColumn {
+    TOP_K_COLUMN_ID,
+    TOP_K_COLUMN_DISTANCE,
+    TOP_K_COLUMN_QUERY,
+    TOP_K_COLUMN_K,
+    TOP_K_COLUMN_TABLE,
+    TOP_K_COLUMN_COLUMN,
+    TOP_K_COLUMN_METRIC,
+};
+static const int TOP_K_FIRST_PARAMETER = TOP_K_COLUMN_QUERY;
+static const int TOP_K_PARAMETER_COUNT = 5;
+static const int TOP_K_REQUIRED_PARAMETERS = 0xF;// All except the metric
+static const sqlite3_int64 TOP_K_MAX_K = 1000000;
+
+struct TopKTable {
+    sqlite3_vtab base;
+    sqlite3* db;
+};
+
+struct TopKResult {
+    sqlite3_int64 id;
+    double distance;
+};
+
+struct TopKCursor {
+    sqlite3_vtab_cursor base;
+    TopKResult* results;
+    sqlite3_int64 resultCount;
+    sqlite3_int64 position;
+};
+
+static int topKConnect(sqlite3* db, void* pAux, int argc, const char* const* argv, sqlite3_vtab** ppVtab, char** pzErr) {
+    int err = sqlite3_declare_vtab(db, "CREATE TABLE x(id INTEGER, distance REAL,"
+            " query HIDDEN, k HIDDEN, source_table HIDDEN, source_column HIDDEN, metric HIDDEN)");
+    if (err != SQLITE_OK) return err;
+
+    TopKTable* table = static_cast<TopKTable*>(sqlite3_malloc(sizeof(TopKTable)));
+    if (table == NULL) return SQLITE_NOMEM;
+    memset(table, 0, sizeof(TopKTable));
+    table->db = db;
+    // Reads any table named by its arguments, so it must not be used from triggers, views or the schema
+    sqlite3_vtab_config(db, SQLITE_VTAB_DIRECTONLY);
+    *ppVtab = &table->base;
+    return SQLITE_OK;
+}
+
+static int topKDisconnect(sqlite3_vtab* pVtab) {
+    sqlite3_free(pVtab);
+    return SQLITE_OK;
+}
+
+static int topKBestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* info) {
+    int constraintIndex[TOP_K_PARAMETER_COUNT];
+    for (int i = 0; i < TOP_K_PARAMETER_COUNT; i++) {
+        constraintIndex[i] = -1;
+    }
+    for (int i = 0; i < info->nConstraint; i++) {
+        const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+        if (constraint.iColumn < TOP_K_FIRST_PARAMETER) continue;
+        if (constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        if (!constraint.usable) return SQLITE_CONSTRAINT;
+        constraintIndex[constraint.iColumn - TOP_K_FIRST_PARAMETER] = i;
+    }
+
+    int parameters = 0;
+    int argvIndex = 0;
+    for (int p = 0; p < TOP_K_PARAMETER_COUNT; p++) {
+        if (constraintIndex[p] < 0) continue;
+        parameters |= 1 << p;
+        info->aConstraintUsage[constraintIndex[p]].argvIndex = ++argvIndex;
+        info->aConstraintUsage[constraintIndex[p]].omit = 1;
+    }
+    if ((parameters & TOP_K_REQUIRED_PARAMETERS) != TOP_K_REQUIRED_PARAMETERS) {
+        pVtab->zErrMsg = sqlite3_mprintf("vec_top_k requires QUERY, K, TABLE and COLUMN arguments");
+        return SQLITE_ERROR;
+    }
+    info->idxNum = parameters;
+    info->estimatedCost = 1000000;
+
+    // Results are always ordered by distance
+    if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == TOP_K_COLUMN_DISTANCE && !info->aOrderBy[0].desc) {
+        info->orderByConsumed = 1;
+    }
+    return SQLITE_OK;
+}
+
+static int topKOpen(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor) {
+    TopKCursor* cursor = static_cast<TopKCursor*>(sqlite3_malloc(sizeof(TopKCursor)));
+    if (cursor == NULL) return SQLITE_NOMEM;
+    memset(cursor, 0, sizeof(TopKCursor));
+    *ppCursor = &cursor->base;
+    return SQLITE_OK;
+}
+
+static int topKClose(sqlite3_vtab_cursor* pCursor) {
+    TopKCursor* cursor = reinterpret_cast<TopKCursor*>(pCursor);
+    sqlite3_free(cursor->results);
+    sqlite3_free(cursor);
+    return SQLITE_OK;
+}
+
+// Max-heap on distance, so that the furthest of the kept results is on top
+static void heapSiftDown(TopKResult* heap, sqlite3_int64 count, sqlite3_int64 i) {
+    while (true) {
+        sqlite3_int64 largest = i;
+        const sqlite3_int64 left = 2 * i + 1;
+        const sqlite3_int64 right = left + 1;
+        if (left < count && heap[left].distance > heap[largest].distance) largest = left;
+        if (right < count && heap[right].distance > heap[largest].distance) largest = right;
+        if (largest == i) return;
+        const TopKResult swap = heap[i];
+        heap[i] = heap[largest];
+        heap[largest] = swap;
+        i = largest;
+    }
+}
+
+static void heapSiftUp(TopKResult* heap, sqlite3_int64 i) {
+    while (i > 0) {
+        const sqlite3_int64 parent = (i - 1) / 2;
+        if (heap[parent].distance >= heap[i].distance) return;
+        const TopKResult swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+static bool parseMetric(const char* name, VectorFormat* format, VectorMetric* metric) {
+    if (name == NULL) return false;
+    static const struct { const char* name; VectorMetric metric; } METRICS[] = {
+            { "dot", METRIC_DOT }, { "cosine", METRIC_COSINE }, { "l2", METRIC_L2 } };
+    static const struct { const char* suffix; VectorFormat format; } FORMATS[] = {
+            { "", FORMAT_F32 }, { "_f16", FORMAT_F16 }, { "_i8", FORMAT_I8 } };
+    for (size_t m = 0; m < sizeof(METRICS) / sizeof(METRICS[0]); m++) {
+        const size_t nameLength = strlen(METRICS[m].name);
+        if (sqlite3_strnicmp(name, METRICS[m].name, nameLength) != 0) continue;
+        for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++) {
+            if (sqlite3_stricmp(name + nameLength, FORMATS[f].suffix) == 0) {
+                *metric = METRICS[m].metric;
+                *format = FORMATS[f].format;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int topKFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr, int argc, sqlite3_value** argv) {
+    TopKCursor* cursor = reinterpret_cast<TopKCursor*>(pCursor);
+    sqlite3_vtab* vtab = pCursor->pVtab;
+    sqlite3* db = reinterpret_cast<TopKTable*>(vtab)->db;
+    sqlite3_free(cursor->results);
+    cursor->results = NULL;
+    cursor->resultCount = 0;
+    cursor->position = 0;
+
+    sqlite3_value* query = argv[0];
+    const sqlite3_int64 k = sqlite3_value_int64(argv[1]);
+    const char* table = reinterpret_cast<const char*>(sqlite3_value_text(argv[2]));
+    const char* column = reinterpret_cast<const char*>(sqlite3_value_text(argv[3]));
+    VectorFormat format = FORMAT_F32;
+    VectorMetric metric = METRIC_L2;
+    if (argc > 4 && !parseMetric(reinterpret_cast<const char*>(sqlite3_value_text(argv[4])), &format, &metric)) {
+        vtab->zErrMsg = sqlite3_mprintf("vec_top_k: unknown metric");
+        return SQLITE_ERROR;
+    }
+    if (k > TOP_K_MAX_K) {
+        vtab->zErrMsg = sqlite3_mprintf("vec_top_k: K must be at most %lld", TOP_K_MAX_K);
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_value_type(query) == SQLITE_NULL || k <= 0) {
+        return SQLITE_OK;// No results
+    }
+    if (table == NULL || column == NULL) {
+        vtab->zErrMsg = sqlite3_mprintf("vec_top_k: TABLE and COLUMN must not be NULL");
+        return SQLITE_ERROR;
+    }
+    const uint8_t* queryVector = static_cast<const uint8_t*>(sqlite3_value_blob(query));
+    const size_t queryLength = (size_t) sqlite3_value_bytes(query);
+    if (queryLength % format != 0) {
+        vtab->zErrMsg = sqlite3_mprintf("vec_top_k: query vector length is not a multiple of its element size");
+        return SQLITE_ERROR;
+    }
+
+    char* sql = sqlite3_mprintf("SELECT rowid, \"%w\" FROM \"%w\"", column, table);
+    if (sql == NULL) return SQLITE_NOMEM;
+    sqlite3_stmt* statement;
+    int err = sqlite3_prepare_v2(db, sql, -1, &statement, NULL);
+    sqlite3_free(sql);
+    if (err != SQLITE_OK) {
+        vtab->zErrMsg = sqlite3_mprintf("vec_top_k: %s", sqlite3_errmsg(db));
+        return err;
+    }
+
+    TopKResult* heap = NULL;
+    sqlite3_int64 heapCapacity = 0;
+    sqlite3_int64 count = 0;
+    while ((err = sqlite3_step(statement)) == SQLITE_ROW) {
+        if (sqlite3_column_type(statement, 1) == SQLITE_NULL) continue;
+        const uint8_t* vector = static_cast<const uint8_t*>(sqlite3_column_blob(statement, 1));
+        const size_t vectorLength = (size_t) sqlite3_column_bytes(statement, 1);
+        if (vectorLength != queryLength) {
+            vtab->zErrMsg = sqlite3_mprintf("vec_top_k: vector of row %lld has different dimensions than the query",
+                    sqlite3_column_int64(statement, 0));
+            err = SQLITE_ERROR;
+            break;
+        }
+
+        VectorSums sums;
+        computeSums(queryVector, vector, queryLength / format, format, metric, &sums);
+        const double distance = metricDistance(sums, metric);
+
+        if (count < k) {
+            if (count == heapCapacity) {
+                // Grow gradually, K is often much bigger than the amount of rows
+                heapCapacity = heapCapacity == 0 ? 64 : heapCapacity * 2;
+                if (heapCapacity > k) heapCapacity = k;
+                TopKResult* grown = static_cast<TopKResult*>(sqlite3_realloc64(heap, heapCapacity * sizeof(TopKResult)));
+                if (grown == NULL) {
+                    err = SQLITE_NOMEM;
+                    break;
+                }
+                heap = grown;
+            }
+            heap[count].id = sqlite3_column_int64(statement, 0);
+            heap[count].distance = distance;
+            heapSiftUp(heap, count);
+            count++;
+        } else if (distance < heap[0].distance) {
+            heap[0].id = sqlite3_column_int64(statement, 0);
+            heap[0].distance = distance;
+            heapSiftDown(heap, count, 0);
+        }
+    }
+    sqlite3_finalize(statement);
+    if (err != SQLITE_DONE) {
+        sqlite3_free(heap);
+        if (vtab->zErrMsg == NULL) {
+            vtab->zErrMsg = sqlite3_mprintf("vec_top_k: %s", sqlite3_errmsg(db));
+        }
+        return err;
+    }
+
+    // Heap sort, so that the results are ordered from the closest
+    for (sqlite3_int64 end = count - 1; end > 0; end--) {
+        const TopKResult swap = heap[0];
+        heap[0] = heap[end];
+        heap[end] = swap;
+        heapSiftDown(heap, end, 0);
+    }
+    cursor->results = heap;
+    cursor->resultCount = count;
+    return SQLITE_OK;
+}
+
+static int topKNext(sqlite3_vtab_cursor* pCursor) {
+    reinterpret_cast<TopKCursor*>(pCursor)->position++;
+    return SQLITE_OK;
+}
+
+static int topKEof(sqlite3_vtab_cursor* pCursor) {
+    const TopKCursor* cursor = reinterpret_cast<TopKCursor*>(pCursor);
+    return cursor->position >= cursor->resultCount;
+}
+
+static int topKColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int column) {
+    const TopKCursor* cursor = reinterpret_cast<TopKCursor*>(pCursor);
+    const TopKResult& result = cursor->results[cursor->position];
+    if (column == TOP_K_COLUMN_ID) {
+        sqlite3_result_int64(context, result.id);
+    } else if (column == TOP_K_COLUMN_DISTANCE) {
+        sqlite3_result_double(context, result.distance);
+    }
+    // Hidden parameter columns are not needed
+    return SQLITE_OK;
+}
+
+static int topKRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+    *pRowid = reinterpret_cast<TopKCursor*>(pCursor)->position;
+    return SQLITE_OK;
+}
+
+static sqlite3_module topKModule = {
+    /* iVersion    */ 0,
+    /* xCreate     */ NULL,
+    /* xConnect    */ topKConnect,
+    /* xBestIndex  */ topKBestIndex,
+    /* xDisconnect */ topKDisconnect,
+    /* xDestroy    */ NULL,
+    /* xOpen       */ topKOpen,
+    /* xClose      */ topKClose,
+    /* xFilter     */ topKFilter,
+    /* xNext       */ topKNext,
+    /* xEof        */ topKEof,
+    /* xColumn     */ topKColumn,
+    /* xRowid      */ topKRowid,
+};
+
+int registerVectorFunctions(sqlite3* db) {
+    static const struct { const char* name; VectorFormat format; VectorMetric metric; } METRIC_FUNCTIONS[] = {
+            { "vec_dot", FORMAT_F32, METRIC_DOT },
+            { "vec_cosine", FORMAT_F32, METRIC_COSINE },
+            { "vec_l2", FORMAT_F32, METRIC_L2 },
+            { "vec_dot_f16", FORMAT_F16, METRIC_DOT },
+            { "vec_cosine_f16", FORMAT_F16, METRIC_COSINE },
+            { "vec_l2_f16", FORMAT_F16, METRIC_L2 },
+            { "vec_dot_i8", FORMAT_I8, METRIC_DOT },
+            { "vec_cosine_i8", FORMAT_I8, METRIC_COSINE },
+            { "vec_l2_i8", FORMAT_I8, METRIC_L2 },
+    };
+    const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+    int err = SQLITE_OK;
+    for (size_t i = 0; i < sizeof(METRIC_FUNCTIONS) / sizeof(METRIC_FUNCTIONS[0]) && err == SQLITE_OK; i++) {
+        err = sqlite3_create_function_v2(db, METRIC_FUNCTIONS[i].name, 2, flags,
+                functionKind(METRIC_FUNCTIONS[i].format, METRIC_FUNCTIONS[i].metric),
+                vectorMetricFunction, NULL, NULL, NULL);
+    }
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_function_v2(db, "vec_f16", 1, flags, reinterpret_cast<void*>(FORMAT_F16),
+                vectorConvertFunction, NULL, NULL, NULL);
+    }
+    for (int argc = 1; argc <= 2 && err == SQLITE_OK; argc++) {
+        err = sqlite3_create_function_v2(db, "vec_i8", argc, flags, reinterpret_cast<void*>(FORMAT_I8),
+                vectorConvertFunction, NULL, NULL, NULL);
+    }
+    if (err == SQLITE_OK) {
+        err = sqlite3_create_module(db, "vec_top_k", &topKModule, NULL);
+    }
+    return err;
+}
+
+} // namespace android
@@ -11,4 +11,30 @@
 SQLITE_API void sqlite3ex_clear_errcode(sqlite3 *db) {
     // Yes, this is a hack, but they already have this function, I just want to call it!
     if (db) sqlite3ErrorClear(db);
+}
+
+SQLITE_API int sqlite3ex_file_descriptor(sqlite3 *db, const char *zDbName) {
+#if SQLITE_OS_UNIX
+    // unixFile is private to the amalgamation, so this has to be here
+    sqlite3_vfs *vfs = NULL;
+    sqlite3_file *file = NULL;
+    if (sqlite3_file_control(db, zDbName, SQLITE_FCNTL_VFS_POINTER, &vfs) != SQLITE_OK
+            || vfs == NULL || vfs->xOpen != unixOpen) return -1;
+    if (sqlite3_file_control(db, zDbName, SQLITE_FCNTL_FILE_POINTER, &file) != SQLITE_OK
+            || file == NULL || file->pMethods == NULL) return -1;
+    return ((unixFile*) file)->h;
+#else
+    return -1;
+#endif
+}
+
+SQLITE_API const sqlite3_module *sqlite3ex_module(sqlite3 *db, const char *zName) {
+    // The public API can register modules, but not look them up
+    const sqlite3_module *pModule = NULL;
+    Module *pMod;
+    sqlite3_mutex_enter(db->mutex);
+    pMod = (Module*) sqlite3HashFind(&db->aModule, zName);
+    if (pMod) pModule = pMod->pModule;
+    sqlite3_mutex_leave(db->mutex);
+    return pModule;
 }
\ No newline at end of file
@@ -11,6 +11,14 @@ extern "C" {
 
 SQLITE_API void sqlite3ex_clear_errcode(sqlite3 *db);
 
+// File descriptor of the database file of the unix VFS, or -1 if it is not open or of another VFS.
+// SQLite keeps POSIX locks on the file, which the process loses when any descriptor of the file is closed,
+// so reading the file directly must use this descriptor.
+SQLITE_API int sqlite3ex_file_descriptor(sqlite3 *db, const char *zDbName);
+
+// Module registered under the name (case-insensitive), or NULL if there is none.
+SQLITE_API const sqlite3_module *sqlite3ex_module(sqlite3 *db, const char *zName);
+
 #ifdef __cplusplus
 }
 #endif